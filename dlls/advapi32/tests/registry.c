@@ -1600,6 +1600,96 @@ static void test_reg_unload_key(void)
     DeleteFileA("saved_key.LOG");
 }
 
+static void test_reg_load_symlink(void)
+{
+    static const WCHAR targetW[] = L"\\Registry\\Machine\\TestLink\\target";
+    BYTE buffer[256];
+    HKEY hkey, key, link;
+    DWORD err, type, len;
+    NTSTATUS status;
+
+    if (!pNtDeleteKey)
+    {
+        win_skip( "Can't perform symlink tests\n" );
+        return;
+    }
+
+    err = RegCreateKeyExA( hkey_main, "savelink", 0, NULL, 0, KEY_ALL_ACCESS, NULL, &hkey, NULL );
+    ok( err == ERROR_SUCCESS, "RegCreateKeyEx failed error %u\n", err );
+    err = RegCreateKeyExA( hkey, "target", 0, NULL, 0, KEY_ALL_ACCESS, NULL, &key, NULL );
+    ok( err == ERROR_SUCCESS, "RegCreateKeyEx failed error %u\n", err );
+    err = RegSetValueExA( key, "value", 0, REG_SZ, (BYTE *)"data", sizeof("data") );
+    ok( err == ERROR_SUCCESS, "RegSetValueEx failed error %u\n", err );
+    RegCloseKey( key );
+    err = RegCreateKeyExA( hkey, "target\\sub", 0, NULL, 0, KEY_ALL_ACCESS, NULL, &key, NULL );
+    ok( err == ERROR_SUCCESS, "RegCreateKeyEx failed error %u\n", err );
+    RegCloseKey( key );
+    err = RegCreateKeyExA( hkey, "link", 0, NULL, REG_OPTION_CREATE_LINK, KEY_ALL_ACCESS, NULL, &link, NULL );
+    ok( err == ERROR_SUCCESS, "RegCreateKeyEx failed error %u\n", err );
+    err = RegSetValueExA( link, "SymbolicLinkValue", 0, REG_LINK, (BYTE *)targetW, sizeof(targetW) - sizeof(WCHAR) );
+    ok( err == ERROR_SUCCESS, "RegSetValueEx failed error %u\n", err );
+
+    if (!set_privileges(SE_BACKUP_NAME, TRUE) ||
+        !set_privileges(SE_RESTORE_NAME, TRUE))
+    {
+        win_skip("Failed to set SE_BACKUP_NAME and SE_RESTORE_NAME privileges, skipping tests\n");
+        goto done;
+    }
+
+    DeleteFileA("saved_link");
+    err = RegSaveKeyA( hkey, "saved_link", NULL );
+    ok( err == ERROR_SUCCESS, "RegSaveKey failed error %u\n", err );
+    err = RegLoadKeyA( HKEY_LOCAL_MACHINE, "TestLink", "saved_link" );
+    ok( err == ERROR_SUCCESS, "RegLoadKey failed error %u\n", err );
+
+    /* the link is still a link to the target */
+    err = RegOpenKeyExA( HKEY_LOCAL_MACHINE, "TestLink\\link", REG_OPTION_OPEN_LINK, KEY_READ, &key );
+    ok( err == ERROR_SUCCESS, "RegOpenKeyEx failed error %u\n", err );
+    len = sizeof(buffer);
+    err = RegQueryValueExA( key, "SymbolicLinkValue", NULL, &type, buffer, &len );
+    ok( err == ERROR_SUCCESS, "RegQueryValueEx failed error %u\n", err );
+    ok( type == REG_LINK, "wrong type %u\n", type );
+    ok( len == sizeof(targetW) - sizeof(WCHAR), "wrong len %u\n", len );
+    RegCloseKey( key );
+
+    /* the target keeps its values and subkeys */
+    err = RegOpenKeyExA( HKEY_LOCAL_MACHINE, "TestLink\\target", 0, KEY_READ, &key );
+    ok( err == ERROR_SUCCESS, "RegOpenKeyEx failed error %u\n", err );
+    len = sizeof(buffer);
+    err = RegQueryValueExA( key, "value", NULL, &type, buffer, &len );
+    ok( err == ERROR_SUCCESS, "RegQueryValueEx failed error %u\n", err );
+    ok( type == REG_SZ && !strcmp( (char *)buffer, "data" ), "wrong value %u %s\n", type, buffer );
+    len = sizeof(buffer);
+    err = RegQueryValueExA( key, "SymbolicLinkValue", NULL, &type, buffer, &len );
+    ok( err == ERROR_FILE_NOT_FOUND, "RegQueryValueEx wrong error %u\n", err );
+    RegCloseKey( key );
+    err = RegOpenKeyExA( HKEY_LOCAL_MACHINE, "TestLink\\target\\sub", 0, KEY_READ, &key );
+    ok( err == ERROR_SUCCESS, "RegOpenKeyEx failed error %u\n", err );
+    RegCloseKey( key );
+
+    err = RegOpenKeyExA( HKEY_LOCAL_MACHINE, "TestLink\\link", 0, KEY_READ, &key );
+    ok( err == ERROR_SUCCESS, "RegOpenKeyEx failed error %u\n", err );
+    len = sizeof(buffer);
+    err = RegQueryValueExA( key, "value", NULL, &type, buffer, &len );
+    ok( err == ERROR_SUCCESS, "RegQueryValueEx failed error %u\n", err );
+    RegCloseKey( key );
+
+    err = RegUnLoadKeyA( HKEY_LOCAL_MACHINE, "TestLink" );
+    ok( err == ERROR_SUCCESS, "RegUnLoadKey failed error %u\n", err );
+
+done:
+    set_privileges(SE_BACKUP_NAME, FALSE);
+    set_privileges(SE_RESTORE_NAME, FALSE);
+    DeleteFileA("saved_link");
+    DeleteFileA("saved_link.LOG");
+
+    status = pNtDeleteKey( link );
+    ok( !status, "NtDeleteKey failed: 0x%08x\n", status );
+    RegCloseKey( link );
+    delete_key( hkey );
+    RegCloseKey( hkey );
+}
+
 /* tests that show that RegConnectRegistry and 
    OpenSCManager accept computer names without the
    \\ prefix (what MSDN says).   */
@@ -2328,6 +2418,98 @@ static void test_rw_order(void)
     ok(!RegDeleteKeyA(HKEY_CURRENT_USER, keyname), "Failed to delete key\n");
 }
 
+static void test_large_key(void)
+{
+    static const int count = 2000;
+    char name[32], prev[32];
+    DWORD i, j, subkeys, values, len, data;
+    HKEY hkey, subkey;
+    LONG ret;
+
+    ret = RegCreateKeyA( hkey_main, "large_key", &hkey );
+    ok( !ret, "RegCreateKeyA failed, error %d\n", ret );
+
+    /* create entries out of order, so that they can't simply be appended */
+    for (i = 0; i < count; i++)
+    {
+        j = (i * 7919) % count;
+        sprintf( name, "key%05u", j );
+        ret = RegCreateKeyA( hkey, name, &subkey );
+        ok( !ret, "RegCreateKeyA %s failed, error %d\n", name, ret );
+        RegCloseKey( subkey );
+        sprintf( name, "value%05u", j );
+        ret = RegSetValueExA( hkey, name, 0, REG_DWORD, (BYTE *)&j, sizeof(j) );
+        ok( !ret, "RegSetValueExA %s failed, error %d\n", name, ret );
+    }
+
+    ret = RegQueryInfoKeyA( hkey, NULL, NULL, NULL, &subkeys, NULL, NULL, &values, NULL, NULL, NULL, NULL );
+    ok( !ret, "RegQueryInfoKeyA failed, error %d\n", ret );
+    ok( subkeys == count, "got %u subkeys\n", subkeys );
+    ok( values == count, "got %u values\n", values );
+
+    /* lookups by name */
+    for (i = 0; i < count; i += 13)
+    {
+        sprintf( name, "VALUE%05u", i );
+        len = sizeof(data);
+        ret = RegQueryValueExA( hkey, name, NULL, NULL, (BYTE *)&data, &len );
+        ok( !ret, "RegQueryValueExA %s failed, error %d\n", name, ret );
+        ok( data == i, "got %u for %s\n", data, name );
+    }
+
+    /* subkeys are enumerated in sorted order */
+    prev[0] = 0;
+    for (i = 0; i < count; i++)
+    {
+        len = sizeof(name);
+        ret = RegEnumKeyExA( hkey, i, name, &len, NULL, NULL, NULL, NULL );
+        ok( !ret, "RegEnumKeyExA %u failed, error %d\n", i, ret );
+        if (ret) break;
+        ok( strcmp( prev, name ) < 0, "%s enumerated after %s\n", name, prev );
+        strcpy( prev, name );
+    }
+    len = sizeof(name);
+    ret = RegEnumKeyExA( hkey, count, name, &len, NULL, NULL, NULL, NULL );
+    ok( ret == ERROR_NO_MORE_ITEMS, "RegEnumKeyExA returned %d\n", ret );
+
+    for (i = 0; i < count; i++)
+    {
+        len = sizeof(name);
+        ret = RegEnumValueA( hkey, i, name, &len, NULL, NULL, NULL, NULL );
+        ok( !ret, "RegEnumValueA %u failed, error %d\n", i, ret );
+        if (ret) break;
+    }
+
+    /* delete every other entry, then check the remaining ones */
+    for (i = 0; i < count; i += 2)
+    {
+        sprintf( name, "key%05u", i );
+        ret = RegDeleteKeyA( hkey, name );
+        ok( !ret, "RegDeleteKeyA %s failed, error %d\n", name, ret );
+        sprintf( name, "value%05u", i );
+        ret = RegDeleteValueA( hkey, name );
+        ok( !ret, "RegDeleteValueA %s failed, error %d\n", name, ret );
+    }
+    for (i = 0; i < count; i++)
+    {
+        sprintf( name, "key%05u", i );
+        ret = RegOpenKeyA( hkey, name, &subkey );
+        ok( (i & 1) ? !ret : ret == ERROR_FILE_NOT_FOUND, "RegOpenKeyA %s returned %d\n", name, ret );
+        if (!ret) RegCloseKey( subkey );
+        sprintf( name, "value%05u", i );
+        ret = RegQueryValueExA( hkey, name, NULL, NULL, NULL, NULL );
+        ok( (i & 1) ? !ret : ret == ERROR_FILE_NOT_FOUND, "RegQueryValueExA %s returned %d\n", name, ret );
+    }
+
+    ret = RegQueryInfoKeyA( hkey, NULL, NULL, NULL, &subkeys, NULL, NULL, &values, NULL, NULL, NULL, NULL );
+    ok( !ret, "RegQueryInfoKeyA failed, error %d\n", ret );
+    ok( subkeys == count / 2, "got %u subkeys\n", subkeys );
+    ok( values == count / 2, "got %u values\n", values );
+
+    delete_key( hkey );
+    RegCloseKey( hkey );
+}
+
 static void test_symlinks(void)
 {
     static const WCHAR targetW[] = {'\\','S','o','f','t','w','a','r','e','\\','W','i','n','e',
@@ -4180,9 +4362,11 @@ START_TEST(registry)
     test_reg_save_key();
     test_reg_load_key();
     test_reg_unload_key();
+    test_reg_load_symlink();
     test_reg_copy_tree();
     test_reg_delete_tree();
     test_rw_order();
+    test_large_key();
     test_deleted_key();
     test_delete_value();
     test_delete_key_value();
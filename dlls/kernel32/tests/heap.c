@@ -976,6 +976,103 @@ static void test_HeapQueryInformation(void)
     ok(info == 0 || info == 1 || info == 2, "expected 0, 1 or 2, got %u\n", info);
 }
 
+struct lfh_thread_params
+{
+    HANDLE heap;
+    void **blocks;
+    UINT count;
+    UINT iterations;
+};
+
+static DWORD WINAPI lfh_thread( void *arg )
+{
+    struct lfh_thread_params *params = arg;
+    void *local[64];
+    UINT i, j;
+
+    /* free blocks allocated by the main thread */
+    for (i = 0; i < params->count; i++)
+    {
+        ok( *(UINT *)params->blocks[i] == i, "got unexpected block content %#x\n", *(UINT *)params->blocks[i] );
+        ok( HeapFree( params->heap, 0, params->blocks[i] ), "HeapFree failed, error %u\n", GetLastError() );
+    }
+
+    /* thread local allocation / free pairs */
+    for (i = 0; i < params->iterations; i++)
+    {
+        for (j = 0; j < ARRAY_SIZE(local); j++)
+        {
+            local[j] = HeapAlloc( params->heap, 0, 8 + (j % 16) * 24 );
+            if (!local[j]) break;
+            *(UINT *)local[j] = j;
+        }
+        ok( j == ARRAY_SIZE(local), "HeapAlloc failed, error %u\n", GetLastError() );
+        while (j--)
+        {
+            if (*(UINT *)local[j] != j) ok( 0, "got unexpected block content %#x\n", *(UINT *)local[j] );
+            HeapFree( params->heap, 0, local[j] );
+        }
+    }
+
+    return 0;
+}
+
+static void test_lfh_threads(void)
+{
+    struct lfh_thread_params params[4];
+    HANDLE threads[ARRAY_SIZE(params)];
+    void *blocks[ARRAY_SIZE(params) * 256];
+    ULONG hci = 2;
+    HANDLE heap;
+    UINT i;
+
+    if (!pHeapSetInformation)
+    {
+        win_skip("HeapSetInformation not available\n");
+        return;
+    }
+
+    heap = HeapCreate( 0, 0, 0 );
+    ok( !!heap, "HeapCreate failed\n" );
+    ok( pHeapSetInformation( heap, HeapCompatibilityInformation, &hci, sizeof(hci) ),
+        "HeapSetInformation failed, error %u\n", GetLastError() );
+
+    for (i = 0; i < ARRAY_SIZE(blocks); i++)
+    {
+        blocks[i] = HeapAlloc( heap, 0, 16 + (i % 32) * 16 );
+        ok( !!blocks[i], "HeapAlloc failed, error %u\n", GetLastError() );
+        *(UINT *)blocks[i] = i % 256;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(params); i++)
+    {
+        params[i].heap = heap;
+        params[i].blocks = blocks + i * 256;
+        params[i].count = 256;
+        params[i].iterations = 1000;
+        threads[i] = CreateThread( NULL, 0, lfh_thread, &params[i], 0, NULL );
+        ok( !!threads[i], "CreateThread failed, error %u\n", GetLastError() );
+    }
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+    {
+        ok( !WaitForSingleObject( threads[i], 10000 ), "wait failed\n" );
+        CloseHandle( threads[i] );
+    }
+
+    /* blocks freed by the other threads must be reusable */
+    for (i = 0; i < ARRAY_SIZE(blocks); i++)
+    {
+        blocks[i] = HeapAlloc( heap, 0, 16 + (i % 32) * 16 );
+        ok( !!blocks[i], "HeapAlloc failed, error %u\n", GetLastError() );
+        ok( HeapSize( heap, 0, blocks[i] ) == 16 + (i % 32) * 16, "got size %lu\n", HeapSize( heap, 0, blocks[i] ) );
+    }
+    ok( HeapValidate( heap, 0, NULL ), "HeapValidate failed\n" );
+    for (i = 0; i < ARRAY_SIZE(blocks); i++)
+        ok( HeapFree( heap, 0, blocks[i] ), "HeapFree failed, error %u\n", GetLastError() );
+
+    ok( HeapDestroy( heap ), "HeapDestroy failed\n" );
+}
+
 static void test_heap_checks( DWORD flags )
 {
     BYTE old, *p, *p2;
@@ -1377,6 +1474,7 @@ START_TEST(heap)
     test_sized_HeapReAlloc((1 << 20), 1);
 
     test_HeapQueryInformation();
+    test_lfh_threads();
     test_GetPhysicallyInstalledSystemMemory();
     test_GlobalMemoryStatus();
 
@@ -2226,6 +2226,191 @@ static void test_import_resolution(void)
     }
 }
 
+static void write_test_image( const char *name, IMAGE_NT_HEADERS *nt, const void *data, DWORD size )
+{
+    IMAGE_SECTION_HEADER section;
+    DWORD dummy;
+    HANDLE hfile;
+
+    nt->FileHeader.NumberOfSections = 1;
+    nt->FileHeader.SizeOfOptionalHeader = sizeof(IMAGE_OPTIONAL_HEADER);
+    nt->FileHeader.Characteristics = IMAGE_FILE_EXECUTABLE_IMAGE | IMAGE_FILE_32BIT_MACHINE |
+                                     IMAGE_FILE_RELOCS_STRIPPED | IMAGE_FILE_DLL;
+    nt->OptionalHeader.SectionAlignment = page_size;
+    nt->OptionalHeader.FileAlignment = 0x200;
+    nt->OptionalHeader.SizeOfImage = 2 * page_size;
+    nt->OptionalHeader.SizeOfHeaders = nt->OptionalHeader.FileAlignment;
+    nt->OptionalHeader.NumberOfRvaAndSizes = IMAGE_NUMBEROF_DIRECTORY_ENTRIES;
+
+    hfile = CreateFileA( name, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, 0, 0 );
+    ok( hfile != INVALID_HANDLE_VALUE, "creation failed\n" );
+
+    memset( &section, 0, sizeof(section) );
+    memcpy( section.Name, ".text", sizeof(".text") );
+    section.PointerToRawData = nt->OptionalHeader.FileAlignment;
+    section.VirtualAddress = nt->OptionalHeader.SectionAlignment;
+    section.Misc.VirtualSize = size;
+    section.SizeOfRawData = size;
+    section.Characteristics = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_WRITE;
+
+    WriteFile( hfile, &dos_header, sizeof(dos_header), &dummy, NULL );
+    WriteFile( hfile, nt, sizeof(*nt), &dummy, NULL );
+    WriteFile( hfile, &section, sizeof(section), &dummy, NULL );
+
+    SetFilePointer( hfile, section.PointerToRawData, NULL, SEEK_SET );
+    WriteFile( hfile, data, size, &dummy, NULL );
+
+    CloseHandle( hfile );
+}
+
+static void test_bound_imports(void)
+{
+    static const DWORD timestamp = 0x12345678;
+    char temp_path[MAX_PATH];
+    char exp_name[MAX_PATH];
+    char imp_name[MAX_PATH];
+    HMODULE exp_mod, mod;
+    ULONG_PTR bound_value, expect;
+    struct exports
+    {
+        IMAGE_EXPORT_DIRECTORY dir;
+        DWORD functions[1];
+        DWORD names[1];
+        WORD ordinals[1];
+        char module[16];
+        char name[16];
+        DWORD func;
+    } exp_data;
+    struct imports
+    {
+        IMAGE_BOUND_IMPORT_DESCRIPTOR bound[2];
+        char bound_module[16];
+        IMAGE_IMPORT_DESCRIPTOR descr[2];
+        IMAGE_THUNK_DATA original_thunks[2];
+        IMAGE_THUNK_DATA thunks[2];
+        char module[16];
+        struct { WORD hint; char name[16]; } function;
+    } data, *ptr;
+    IMAGE_NT_HEADERS nt;
+    const char *p;
+    int test;
+
+    GetTempPathA( MAX_PATH, temp_path );
+    GetTempFileNameA( temp_path, "ldr", 0, exp_name );
+    GetTempFileNameA( temp_path, "ldr", 0, imp_name );
+    p = strrchr( exp_name, '\\' ) + 1;
+
+#define DATA_RVA(ptr) (page_size + ((char *)(ptr) - (char *)&exp_data))
+    nt = nt_header_template;
+    nt.FileHeader.TimeDateStamp = timestamp;
+    nt.OptionalHeader.ImageBase = 0x12380000;
+    memset( nt.OptionalHeader.DataDirectory, 0, sizeof(nt.OptionalHeader.DataDirectory) );
+    nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].Size = offsetof( struct exports, func );
+    nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].VirtualAddress = DATA_RVA( &exp_data.dir );
+
+    memset( &exp_data, 0, sizeof(exp_data) );
+    exp_data.dir.Name = DATA_RVA( exp_data.module );
+    exp_data.dir.Base = 1;
+    exp_data.dir.NumberOfFunctions = 1;
+    exp_data.dir.NumberOfNames = 1;
+    exp_data.dir.AddressOfFunctions = DATA_RVA( exp_data.functions );
+    exp_data.dir.AddressOfNames = DATA_RVA( exp_data.names );
+    exp_data.dir.AddressOfNameOrdinals = DATA_RVA( exp_data.ordinals );
+    exp_data.functions[0] = DATA_RVA( &exp_data.func );
+    exp_data.names[0] = DATA_RVA( exp_data.name );
+    strcpy( exp_data.module, p );
+    strcpy( exp_data.name, "func" );
+    expect = nt.OptionalHeader.ImageBase + DATA_RVA( &exp_data.func );
+    bound_value = nt.OptionalHeader.ImageBase + DATA_RVA( exp_data.name );
+    write_test_image( exp_name, &nt, &exp_data, sizeof(exp_data) );
+#undef DATA_RVA
+
+    exp_mod = LoadLibraryA( exp_name );
+    ok( exp_mod != NULL, "failed to load err %u\n", GetLastError() );
+    if (!exp_mod) goto done;
+    /* the binding can only be used if the dll is at its preferred base */
+    if (exp_mod != (HMODULE)0x12380000) bound_value = expect = (ULONG_PTR)GetProcAddress( exp_mod, "func" );
+
+    for (test = 0; test < 2; test++)
+    {
+#define DATA_RVA(ptr) (page_size + ((char *)(ptr) - (char *)&data))
+        nt = nt_header_template;
+        nt.OptionalHeader.ImageBase = 0x12340000;
+        memset( nt.OptionalHeader.DataDirectory, 0, sizeof(nt.OptionalHeader.DataDirectory) );
+        nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].Size = sizeof(data.descr);
+        nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress = DATA_RVA( data.descr );
+        nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BOUND_IMPORT].Size = sizeof(data.bound) + sizeof(data.bound_module);
+        nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BOUND_IMPORT].VirtualAddress = DATA_RVA( data.bound );
+
+        memset( &data, 0, sizeof(data) );
+        /* a stale binding must be ignored */
+        data.bound[0].TimeDateStamp = test ? timestamp + 1 : timestamp;
+        data.bound[0].OffsetModuleName = offsetof( struct imports, bound_module );
+        strcpy( data.bound_module, p );
+        U(data.descr[0]).OriginalFirstThunk = DATA_RVA( data.original_thunks );
+        data.descr[0].TimeDateStamp = ~0u;
+        data.descr[0].FirstThunk = DATA_RVA( data.thunks );
+        data.descr[0].Name = DATA_RVA( data.module );
+        strcpy( data.module, p );
+        strcpy( data.function.name, "func" );
+        data.original_thunks[0].u1.AddressOfData = DATA_RVA( &data.function );
+        data.thunks[0].u1.Function = bound_value;
+        write_test_image( imp_name, &nt, &data, sizeof(data) );
+#undef DATA_RVA
+
+        mod = LoadLibraryA( imp_name );
+        ok( mod != NULL, "%u: failed to load err %u\n", test, GetLastError() );
+        if (!mod) continue;
+        ptr = (struct imports *)((char *)mod + page_size);
+        ok( ptr->thunks[0].u1.Function == (test ? expect : bound_value), "%u: thunk %p, expected %p\n",
+            test, (void *)ptr->thunks[0].u1.Function, (void *)(test ? expect : bound_value) );
+        FreeLibrary( mod );
+    }
+    FreeLibrary( exp_mod );
+
+done:
+    DeleteFileA( imp_name );
+    DeleteFileA( exp_name );
+}
+
+static void test_export_lookup(void)
+{
+    HMODULE mod = GetModuleHandleA( "kernel32.dll" );
+    const IMAGE_EXPORT_DIRECTORY *exports;
+    const DWORD *names, *functions;
+    const WORD *ordinals;
+    ULONG size;
+    DWORD i, rva, found = 0;
+    void *proc;
+
+    exports = pRtlImageDirectoryEntryToData( mod, TRUE, IMAGE_DIRECTORY_ENTRY_EXPORT, &size );
+    ok( exports != NULL, "no export directory\n" );
+    if (!exports) return;
+    names = RVAToAddr( exports->AddressOfNames, mod );
+    functions = RVAToAddr( exports->AddressOfFunctions, mod );
+    ordinals = RVAToAddr( exports->AddressOfNameOrdinals, mod );
+
+    /* look up every name, in reverse order to defeat any caching of the last position */
+    for (i = exports->NumberOfNames; i > 0; i--)
+    {
+        const char *name = RVAToAddr( names[i - 1], mod );
+
+        proc = GetProcAddress( mod, name );
+        ok( proc != NULL, "%s not found\n", name );
+        rva = functions[ordinals[i - 1]];
+        /* forwarded exports resolve to another module */
+        if (rva >= (char *)exports - (char *)mod && rva < (char *)exports - (char *)mod + size) continue;
+        ok( proc == RVAToAddr( rva, mod ), "%s: got %p, expected %p\n", name, proc, RVAToAddr( rva, mod ) );
+        found++;
+    }
+    ok( found > 0, "no exports checked\n" );
+
+    SetLastError( 0xdeadbeef );
+    proc = GetProcAddress( mod, "NoSuchExportInKernel32" );
+    ok( !proc, "got %p\n", proc );
+    ok( GetLastError() == ERROR_PROC_NOT_FOUND, "got error %u\n", GetLastError() );
+}
+
 #define MAX_COUNT 10
 static HANDLE attached_thread[MAX_COUNT];
 static DWORD attached_thread_count;
@@ -4071,6 +4256,8 @@ START_TEST(loader)
     test_ImportDescriptors();
     test_section_access();
     test_import_resolution();
+    test_bound_imports();
+    test_export_lookup();
     test_ExitProcess();
     test_InMemoryOrderModuleList();
     test_LoadPackagedLibrary();
@@ -1716,6 +1716,63 @@ static void test_WaitForMultipleObjects(void)
     todo_wine ok(status == STATUS_INVALID_HANDLE, "expected STATUS_INVALID_HANDLE, got %08x\n", status);
 }
 
+static void test_WaitForMultipleObjects_new_handles(void)
+{
+    HANDLE events[16], handles[16], semaphore;
+    DWORD r;
+    int i;
+
+    /* handles that were never waited on before, so that their objects are
+     * all looked up together when the wait starts */
+    for (i = 0; i < ARRAY_SIZE(events); i++)
+    {
+        events[i] = CreateEventW( NULL, TRUE, FALSE, NULL );
+        ok( events[i] != 0, "CreateEvent failed %u\n", GetLastError() );
+    }
+
+    for (i = 0; i < ARRAY_SIZE(handles); i++)
+        ok( DuplicateHandle( GetCurrentProcess(), events[i], GetCurrentProcess(), &handles[i],
+                             0, FALSE, DUPLICATE_SAME_ACCESS ), "DuplicateHandle failed %u\n", GetLastError() );
+    r = WaitForMultipleObjects( ARRAY_SIZE(handles), handles, FALSE, 0 );
+    ok( r == WAIT_TIMEOUT, "got %u\n", r );
+    for (i = 0; i < ARRAY_SIZE(handles); i++) CloseHandle( handles[i] );
+
+    SetEvent( events[ARRAY_SIZE(events) - 1] );
+    for (i = 0; i < ARRAY_SIZE(handles); i++)
+        DuplicateHandle( GetCurrentProcess(), events[i], GetCurrentProcess(), &handles[i],
+                         0, FALSE, DUPLICATE_SAME_ACCESS );
+    r = WaitForMultipleObjects( ARRAY_SIZE(handles), handles, FALSE, 0 );
+    ok( r == WAIT_OBJECT_0 + ARRAY_SIZE(handles) - 1, "got %u\n", r );
+    for (i = 0; i < ARRAY_SIZE(handles); i++) CloseHandle( handles[i] );
+
+    for (i = 0; i < ARRAY_SIZE(events); i++) SetEvent( events[i] );
+    for (i = 0; i < ARRAY_SIZE(handles); i++)
+        DuplicateHandle( GetCurrentProcess(), events[i], GetCurrentProcess(), &handles[i],
+                         0, FALSE, DUPLICATE_SAME_ACCESS );
+    r = WaitForMultipleObjects( ARRAY_SIZE(handles), handles, TRUE, 0 );
+    ok( r == WAIT_OBJECT_0, "got %u\n", r );
+
+    /* an invalid handle in the middle fails the whole wait */
+    CloseHandle( handles[8] );
+    SetLastError( 0xdeadbeef );
+    r = WaitForMultipleObjects( ARRAY_SIZE(handles), handles, FALSE, 0 );
+    ok( r == WAIT_FAILED, "got %u\n", r );
+    ok( GetLastError() == ERROR_INVALID_HANDLE, "got error %u\n", GetLastError() );
+    for (i = 0; i < ARRAY_SIZE(handles); i++)
+        if (i != 8) CloseHandle( handles[i] );
+
+    /* later server calls still get their replies */
+    semaphore = CreateSemaphoreW( NULL, 1, 2, NULL );
+    ok( semaphore != 0, "CreateSemaphore failed %u\n", GetLastError() );
+    r = WaitForSingleObject( semaphore, 0 );
+    ok( r == WAIT_OBJECT_0, "got %u\n", r );
+    r = WaitForSingleObject( semaphore, 0 );
+    ok( r == WAIT_TIMEOUT, "got %u\n", r );
+    CloseHandle( semaphore );
+
+    for (i = 0; i < ARRAY_SIZE(events); i++) CloseHandle( events[i] );
+}
+
 static BOOL g_initcallback_ret, g_initcallback_called;
 static void *g_initctxt;
 
@@ -3209,6 +3266,7 @@ START_TEST(sync)
     test_timer_queue();
     test_WaitForSingleObject();
     test_WaitForMultipleObjects();
+    test_WaitForMultipleObjects_new_handles();
     test_initonce();
     test_condvars_base(&aligned_cv);
     test_condvars_base(&unaligned_cv.cv);
@@ -34,6 +34,7 @@ typedef enum LFH_block_type LFH_block_type;
 typedef struct LFH_arena LFH_arena;
 typedef struct LFH_class LFH_class;
 typedef struct LFH_heap LFH_heap;
+typedef struct LFH_magazine LFH_magazine;
 typedef struct LFH_slist LFH_slist;
 
 #define ARENA_HEADER_SIZE (sizeof(LFH_arena))
@@ -71,6 +72,11 @@ typedef struct LFH_slist LFH_slist;
 #define TOTAL_BLOCK_CLASS_COUNT (MEDIUM_CLASS_LAST + 1)
 #define TOTAL_LARGE_CLASS_COUNT (LARGE_CLASS_LAST + 1)
 
+/* small classes keep a few free blocks aside, and remote frees are batched */
+#define MAGAZINE_CLASS_COUNT  SMALL_CLASS_COUNT
+#define MAGAZINE_MAX_COUNT    16
+#define REMOTE_BATCH_MAX_COUNT 16
+
 struct LFH_slist
 {
     LFH_slist *next;
@@ -84,6 +90,12 @@ static inline void LFH_slist_push(LFH_slist **list, LFH_slist *entry)
     while (!__atomic_compare_exchange_n(list, &entry->next, entry, 0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE));
 }
 
+static inline void LFH_slist_push_list(LFH_slist **list, LFH_slist *first, LFH_slist *last)
+{
+    last->next = __atomic_load_n(list, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(list, &last->next, first, 0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE));
+}
+
 static inline LFH_slist *LFH_slist_flush(LFH_slist **list)
 {
     if (!__atomic_load_n(list, __ATOMIC_RELAXED)) return NULL;
@@ -142,6 +154,13 @@ struct LFH_class
     size_t     size;
 };
 
+/* thread local free block cache, blocks are linked through their entry_defer */
+struct LFH_magazine
+{
+    LFH_slist *list;
+    size_t     count;
+};
+
 struct LFH_heap
 {
     LFH_slist *list_defer;
@@ -151,10 +170,18 @@ struct LFH_heap
     LFH_class large_class[TOTAL_LARGE_CLASS_COUNT];
 
     SLIST_ENTRY entry_orphan;
+
+    LFH_magazine magazine[MAGAZINE_CLASS_COUNT];
+
+    /* blocks freed by this thread to another thread heap, pushed at once to its list_defer */
+    LFH_heap  *remote_heap;
+    LFH_slist *remote_first;
+    LFH_slist *remote_last;
+    size_t     remote_count;
 #ifdef _WIN64
-    void *pad[0xc2];
+    void *pad[0x3e];
 #else
-    void *pad[0xc3];
+    void *pad[0x3f];
 #endif
 };
 
@@ -401,6 +428,58 @@ static BOOLEAN LFH_release_arena(LFH_heap *heap, LFH_arena *arena);
 static inline LFH_block *LFH_allocate_block(LFH_heap *heap, LFH_class *class, LFH_arena *arena);
 static inline BOOLEAN LFH_deallocate_block(LFH_heap *heap, LFH_arena *arena, LFH_block *block);
 
+static inline LFH_magazine *LFH_heap_get_magazine(LFH_heap *heap, LFH_class *class)
+{
+    size_t index = class - heap->block_class;
+    if (index >= MAGAZINE_CLASS_COUNT) return NULL;
+    return &heap->magazine[index];
+}
+
+static inline LFH_block *LFH_magazine_pop_block(LFH_magazine *magazine)
+{
+    LFH_slist *entry = magazine->list;
+    if (!entry) return NULL;
+    magazine->list = entry->next;
+    magazine->count--;
+    return LIST_ENTRY(entry, LFH_block, entry_defer);
+}
+
+static inline BOOLEAN LFH_magazine_push_block(LFH_magazine *magazine, LFH_block *block)
+{
+    if (magazine->count >= MAGAZINE_MAX_COUNT) return FALSE;
+    block->entry_defer.next = magazine->list;
+    magazine->list = &block->entry_defer;
+    magazine->count++;
+    return TRUE;
+}
+
+/* keep the block in its class magazine if possible, or return it to its arena */
+static inline BOOLEAN LFH_release_block(LFH_heap *heap, LFH_block *block)
+{
+    LFH_arena *arena = LFH_arena_from_block(block);
+    LFH_magazine *magazine = LFH_heap_get_magazine(heap, LFH_class_from_arena(arena));
+
+    if (magazine && LFH_magazine_push_block(magazine, block))
+        return TRUE;
+
+    return LFH_deallocate_block(heap, arena, block);
+}
+
+static inline BOOLEAN LFH_flush_magazines(LFH_heap *heap)
+{
+    LFH_block *block;
+    size_t i;
+
+    for (i = 0; i < MAGAZINE_CLASS_COUNT; ++i)
+    {
+        while ((block = LFH_magazine_pop_block(&heap->magazine[i])))
+            if (!LFH_deallocate_block(heap, LFH_arena_from_block(block), block))
+                return FALSE;
+    }
+
+    return TRUE;
+}
+
 static inline BOOLEAN LFH_deallocate_deferred_blocks(LFH_heap *heap)
 {
     LFH_slist *entry = LFH_slist_flush(&heap->list_defer);
@@ -410,13 +489,38 @@ static inline BOOLEAN LFH_deallocate_deferred_blocks(LFH_heap *heap)
         LFH_block *block = LIST_ENTRY(entry, LFH_block, entry_defer);
         entry = entry->next;
 
-        if (!LFH_deallocate_block(heap, LFH_arena_from_block(block), block))
+        if (!LFH_release_block(heap, block))
             return FALSE;
     }
 
     return TRUE;
 }
 
+static inline void LFH_flush_remote_blocks(LFH_heap *heap)
+{
+    if (!heap->remote_count) return;
+    LFH_slist_push_list(&heap->remote_heap->list_defer, heap->remote_first, heap->remote_last);
+    heap->remote_heap = NULL;
+    heap->remote_first = heap->remote_last = NULL;
+    heap->remote_count = 0;
+}
+
+static inline void LFH_defer_remote_block(LFH_heap *heap, LFH_heap *remote_heap, LFH_block *block)
+{
+    if (heap->remote_heap != remote_heap)
+    {
+        LFH_flush_remote_blocks(heap);
+        heap->remote_heap = remote_heap;
+    }
+
+    block->entry_defer.next = heap->remote_first;
+    if (!heap->remote_count++) heap->remote_last = &block->entry_defer;
+    heap->remote_first = &block->entry_defer;
+
+    if (heap->remote_count >= REMOTE_BATCH_MAX_COUNT)
+        LFH_flush_remote_blocks(heap);
+}
+
 static inline void LFH_deallocated_cached_arenas(LFH_heap *heap)
 {
     if (!heap->cached_large_arena) return;
@@ -532,9 +636,17 @@ static void LFH_heap_initialize(LFH_heap *heap)
         LFH_class_initialize(heap, &heap->large_class[i], i);
     for (i = 0; i < TOTAL_BLOCK_CLASS_COUNT; ++i)
         LFH_class_initialize(heap, &heap->block_class[i], i);
+    for (i = 0; i < MAGAZINE_CLASS_COUNT; ++i)
+    {
+        heap->magazine[i].list = NULL;
+        heap->magazine[i].count = 0;
+    }
 
     heap->list_defer = NULL;
     heap->cached_large_arena = NULL;
+    heap->remote_heap = NULL;
+    heap->remote_first = heap->remote_last = NULL;
+    heap->remote_count = 0;
 }
 
 static SLIST_HEADER *LFH_orphan_list(void)
@@ -569,7 +681,9 @@ static void LFH_heap_finalize(LFH_heap *heap)
 {
     LFH_arena *arena;
 
+    LFH_flush_remote_blocks(heap);
     LFH_deallocate_deferred_blocks(heap);
+    LFH_flush_magazines(heap);
 
     for (size_t i = 0; i < TOTAL_BLOCK_CLASS_COUNT; ++i)
     {
@@ -845,6 +959,24 @@ static BOOLEAN LFH_validate_heap_defer_blocks(ULONG flags, const LFH_heap *heap)
     return TRUE;
 }
 
+static BOOLEAN LFH_validate_heap_magazine_blocks(ULONG flags, const LFH_heap *heap)
+{
+    for (size_t i = 0; i < MAGAZINE_CLASS_COUNT; ++i)
+    {
+        const LFH_slist *entry = heap->magazine[i].list;
+
+        while (entry)
+        {
+            const LFH_block *block = LIST_ENTRY(entry, LFH_block, entry_defer);
+            if (!LFH_validate_free_block(flags, block))
+                return FALSE;
+            entry = entry->next;
+        }
+    }
+
+    return TRUE;
+}
+
 static BOOLEAN LFH_validate_heap(ULONG flags, const LFH_heap *heap)
 {
     const char *err = NULL;
@@ -856,6 +988,8 @@ static BOOLEAN LFH_validate_heap(ULONG flags, const LFH_heap *heap)
         err = "unable to validate foreign heap";
     else if (!LFH_validate_heap_defer_blocks(flags, heap))
         err = "invalid heap defer blocks";
+    else if (!LFH_validate_heap_magazine_blocks(flags, heap))
+        err = "invalid heap magazine blocks";
     else
     {
         for (i = 0; err == NULL && i < TOTAL_BLOCK_CLASS_COUNT; ++i)
@@ -907,10 +1041,13 @@ static FORCEINLINE LFH_ptr *LFH_allocate(ULONG flags, size_t size)
     if (!LFH_deallocate_deferred_blocks(heap))
         return NULL;
 
+    LFH_flush_remote_blocks(heap);
+
     if ((class = LFH_heap_get_class(heap, class_size)))
     {
-        arena = LFH_acquire_arena(heap, class);
-        if (arena) block = LFH_allocate_block(heap, class, arena);
+        LFH_magazine *magazine = LFH_heap_get_magazine(heap, class);
+        if (magazine) block = LFH_magazine_pop_block(magazine);
+        if (!block && (arena = LFH_acquire_arena(heap, class))) block = LFH_allocate_block(heap, class, arena);
         if (block) LFH_block_initialize(block, flags, 0, size, LFH_block_get_class_size(block));
     }
     else
@@ -930,7 +1067,7 @@ static FORCEINLINE BOOLEAN LFH_free(ULONG flags, LFH_ptr *ptr)
 {
     LFH_block *block = LFH_block_from_ptr(ptr);
     LFH_arena *arena = LFH_arena_from_block(block);
-    LFH_heap *heap = LFH_heap_from_arena(arena);
+    LFH_heap *heap = LFH_heap_from_arena(arena), *thread_heap;
 
     if (!LFH_class_from_arena(arena))
         return LFH_memory_deallocate(arena, LFH_block_get_class_size(block));
@@ -945,8 +1082,11 @@ static FORCEINLINE BOOLEAN LFH_free(ULONG flags, LFH_ptr *ptr)
 
     block->type = LFH_block_type_free;
 
-    if (heap == LFH_thread_heap(FALSE) && !(flags & HEAP_FREE_CHECKING_ENABLED))
-        LFH_deallocate_block(heap, LFH_arena_from_block(block), block);
+    thread_heap = LFH_thread_heap(FALSE);
+    if (heap == thread_heap && !(flags & HEAP_FREE_CHECKING_ENABLED))
+        LFH_release_block(heap, block);
+    else if (thread_heap && !(flags & HEAP_FREE_CHECKING_ENABLED))
+        LFH_defer_remote_block(thread_heap, heap, block);
     else
         LFH_slist_push(&heap->list_defer, &block->entry_defer);
 
@@ -1118,8 +1258,12 @@ void HEAP_lfh_notify_thread_destroy(BOOLEAN last)
         }
         LFH_memory_deallocate(list_orphan, BLOCK_ARENA_SIZE);
     }
-    else if ((heap = LFH_thread_heap(FALSE)) && LFH_validate_heap(0, heap))
-        RtlInterlockedPushEntrySList(list_orphan, &heap->entry_orphan);
+    else if ((heap = LFH_thread_heap(FALSE)))
+    {
+        /* give the batched remote frees back to their heaps, even if this one is then leaked */
+        LFH_flush_remote_blocks(heap);
+        if (LFH_validate_heap(0, heap)) RtlInterlockedPushEntrySList(list_orphan, &heap->entry_orphan);
+    }
 }
 
 void HEAP_lfh_set_debug_flags(ULONG flags)
@@ -1127,6 +1271,8 @@ void HEAP_lfh_set_debug_flags(ULONG flags)
     LFH_heap *heap = LFH_thread_heap(FALSE);
     if (!heap) return;
 
+    LFH_flush_remote_blocks(heap);
     LFH_deallocate_deferred_blocks(heap);
+    LFH_flush_magazines(heap);
     LFH_deallocated_cached_arenas(heap);
 }
@@ -44,6 +44,7 @@ WINE_DECLARE_DEBUG_CHANNEL(relay);
 WINE_DECLARE_DEBUG_CHANNEL(snoop);
 WINE_DECLARE_DEBUG_CHANNEL(loaddll);
 WINE_DECLARE_DEBUG_CHANNEL(imports);
+WINE_DECLARE_DEBUG_CHANNEL(startup);
 
 #ifdef _WIN64
 #define DEFAULT_SECURITY_COOKIE_64  (((ULONGLONG)0x00002b99 << 32) | 0x2ddfa232)
@@ -123,6 +124,11 @@ typedef struct _wine_modref
     int                   alloc_deps;
     int                   nDeps;
     struct _wine_modref **deps;
+    DWORD                *export_hash;     /* hash table of export name indexes, built lazily */
+    DWORD                 export_hash_mask;
+    DWORD                 export_lookups;  /* number of name lookups before the hash table was built */
+    LONGLONG              load_time;       /* time spent loading, without the dlls it loaded */
+    LONGLONG              attach_time;     /* time spent in the process attach call */
 } WINE_MODREF;
 
 static UINT tls_module_count;      /* number of modules with TLS directory */
@@ -169,7 +175,7 @@ static NTSTATUS load_dll( const WCHAR *load_path, const WCHAR *libname, const WC
 static NTSTATUS process_attach( WINE_MODREF *wm, LPVOID lpReserved );
 static FARPROC find_ordinal_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports,
                                     DWORD exp_size, DWORD ordinal, LPCWSTR load_path );
-static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports,
+static FARPROC find_named_export( WINE_MODREF *wm, const IMAGE_EXPORT_DIRECTORY *exports,
                                   DWORD exp_size, const char *name, int hint, LPCWSTR load_path );
 
 /* convert PE image VirtualAddress to Real Address */
@@ -184,6 +190,33 @@ static inline BOOL contains_path( LPCWSTR name )
     return ((*name && (name[1] == ':')) || wcschr(name, '/') || wcschr(name, '\\'));
 }
 
+/* time spent in nested loads and process attach calls, for the +startup report */
+static LONGLONG startup_nested_load;
+static LONGLONG startup_nested_attach;
+
+static LONGLONG startup_begin( LONGLONG *nested, LONGLONG *saved )
+{
+    LARGE_INTEGER now;
+
+    NtQuerySystemTime( &now );
+    *saved = *nested;
+    *nested = 0;
+    return now.QuadPart;
+}
+
+/* return the time since startup_begin() without the nested calls */
+static LONGLONG startup_end( LONGLONG *nested, LONGLONG saved, LONGLONG start )
+{
+    LARGE_INTEGER now;
+    LONGLONG total, self;
+
+    NtQuerySystemTime( &now );
+    total = now.QuadPart - start;
+    self = total - *nested;
+    *nested = saved + total;
+    return self;
+}
+
 static char *crash_log;
 static size_t crash_log_len;
 
@@ -677,7 +710,7 @@ static FARPROC find_forwarded_export( HMODULE module, const char *forward, LPCWS
         if (*name == '#')  /* ordinal */
             proc = find_ordinal_export( wm->ldr.DllBase, exports, exp_size, atoi(name+1), load_path );
         else
-            proc = find_named_export( wm->ldr.DllBase, exports, exp_size, name, -1, load_path );
+            proc = find_named_export( wm, exports, exp_size, name, -1, load_path );
     }
 
     if (!proc)
@@ -733,15 +766,60 @@ static FARPROC find_ordinal_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY
 }
 
 
+/*************************************************************************
+ *		hash_export_name
+ */
+static inline DWORD hash_export_name( const char *name )
+{
+    DWORD hash = 0x811c9dc5;
+
+    while (*name) hash = (hash ^ (unsigned char)*name++) * 0x01000193;
+    return hash;
+}
+
+
+/*************************************************************************
+ *		build_export_hash
+ *
+ * Build the hash table of export names of a module.
+ * The loader_section must be locked while calling this function.
+ */
+static BOOL build_export_hash( WINE_MODREF *wm, const IMAGE_EXPORT_DIRECTORY *exports )
+{
+    const DWORD *names = get_rva( wm->ldr.DllBase, exports->AddressOfNames );
+    DWORD i, pos, size = 1;
+
+    while (size < 2 * exports->NumberOfNames) size <<= 1;
+    if (!(wm->export_hash = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                             size * sizeof(*wm->export_hash) )))
+        return FALSE;
+    wm->export_hash_mask = size - 1;
+
+    for (i = 0; i < exports->NumberOfNames; i++)
+    {
+        pos = hash_export_name( get_rva( wm->ldr.DllBase, names[i] )) & wm->export_hash_mask;
+        while (wm->export_hash[pos]) pos = (pos + 1) & wm->export_hash_mask;
+        wm->export_hash[pos] = i + 1;
+    }
+    TRACE( "built export hash for %s with %u names\n",
+           debugstr_w(wm->ldr.BaseDllName.Buffer), exports->NumberOfNames );
+    return TRUE;
+}
+
+
 /*************************************************************************
  *		find_named_export
  *
  * Find an exported function by name.
  * The loader_section must be locked while calling this function.
  */
-static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports,
+static FARPROC find_named_export( WINE_MODREF *wm, const IMAGE_EXPORT_DIRECTORY *exports,
                                   DWORD exp_size, const char *name, int hint, LPCWSTR load_path )
 {
+    /* only worth hashing the names of large modules that are looked up repeatedly */
+    static const DWORD export_hash_min_names = 128;
+    static const DWORD export_hash_min_lookups = 32;
+    HMODULE module = wm->ldr.DllBase;
     const WORD *ordinals = get_rva( module, exports->AddressOfNameOrdinals );
     const DWORD *names = get_rva( module, exports->AddressOfNames );
     int min = 0, max = exports->NumberOfNames - 1;
@@ -754,7 +832,23 @@ static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *
             return find_ordinal_export( module, exports, exp_size, ordinals[hint], load_path );
     }
 
-    /* then do a binary search */
+    /* then use the hash table */
+    if (wm->export_hash || (exports->NumberOfNames >= export_hash_min_names &&
+                            ++wm->export_lookups >= export_hash_min_lookups &&
+                            build_export_hash( wm, exports )))
+    {
+        DWORD index, pos = hash_export_name( name ) & wm->export_hash_mask;
+
+        while ((index = wm->export_hash[pos]))
+        {
+            if (!strcmp( get_rva( module, names[index - 1] ), name ))
+                return find_ordinal_export( module, exports, exp_size, ordinals[index - 1], load_path );
+            pos = (pos + 1) & wm->export_hash_mask;
+        }
+        return NULL;
+    }
+
+    /* or do a binary search */
     while (min <= max)
     {
         int res, pos = (min + max) / 2;
@@ -769,6 +863,388 @@ static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *
 }
 
 
+/*************************************************************************
+ *		is_binding_valid
+ *
+ * Check that a bound import still matches the module it was bound against.
+ */
+static BOOL is_binding_valid( const WINE_MODREF *wm, DWORD timestamp )
+{
+    const IMAGE_NT_HEADERS *nt = RtlImageNtHeader( wm->ldr.DllBase );
+
+    /* builtins all share the same timestamp across Wine versions */
+    if (wm->ldr.Flags & LDR_WINE_INTERNAL) return FALSE;
+    if (nt->FileHeader.TimeDateStamp != timestamp) return FALSE;
+    return nt->OptionalHeader.ImageBase == (ULONG_PTR)wm->ldr.DllBase;
+}
+
+
+/*************************************************************************
+ *		is_import_bound
+ *
+ * Check if the import address table for a given dll was prebound by the
+ * image and is still valid, in which case it doesn't need to be resolved.
+ * The loader_section must be locked while calling this function.
+ */
+static BOOL is_import_bound( HMODULE module, const char *name, const WINE_MODREF *imp )
+{
+    const IMAGE_BOUND_IMPORT_DESCRIPTOR *bound, *first;
+    const IMAGE_BOUND_FORWARDER_REF *forward;
+    const char *end, *bound_name;
+    WINE_MODREF *wm;
+    WCHAR buffer[32];
+    DWORD size, len;
+    int i;
+
+    if (TRACE_ON(relay) || TRACE_ON(snoop)) return FALSE;
+    if (!(first = RtlImageDirectoryEntryToData( module, TRUE, IMAGE_DIRECTORY_ENTRY_BOUND_IMPORT, &size )))
+        return FALSE;
+    end = (const char *)first + size;
+
+    for (bound = first; (const char *)(bound + 1) <= end && bound->OffsetModuleName; bound = (const void *)forward)
+    {
+        forward = (const IMAGE_BOUND_FORWARDER_REF *)(bound + 1);
+        if ((const char *)(forward + bound->NumberOfModuleForwarderRefs) > end) return FALSE;
+        bound_name = (const char *)first + bound->OffsetModuleName;
+        if (_stricmp( bound_name, name ))
+        {
+            forward += bound->NumberOfModuleForwarderRefs;
+            continue;
+        }
+        if (!is_binding_valid( imp, bound->TimeDateStamp )) return FALSE;
+
+        /* modules that the bound forwards resolve to must already be loaded */
+        for (i = 0; i < bound->NumberOfModuleForwarderRefs; i++)
+        {
+            bound_name = (const char *)first + forward[i].OffsetModuleName;
+            if ((len = strlen( bound_name )) >= ARRAY_SIZE(buffer)) return FALSE;
+            ascii_to_unicode( buffer, bound_name, len + 1 );
+            if (!(wm = find_basename_module( buffer ))) return FALSE;
+            if (!is_binding_valid( wm, forward[i].TimeDateStamp )) return FALSE;
+        }
+        return TRUE;
+    }
+    return FALSE;
+}
+
+
+/* On-disk cache of the import address tables that builtin dlls get from other builtins.
+ * Entries are keyed by the file id and load address of both modules, and by the import
+ * address table rva. A process reads the cache once at startup and writes it back after
+ * resolving the imports of the main exe, if it added entries. */
+
+#define IMPORT_CACHE_MAGIC     0x48434d49  /* "IMCH" */
+#define IMPORT_CACHE_VERSION   1
+#define IMPORT_CACHE_MAX_SIZE  (16 * 1024 * 1024)
+
+struct import_cache_module
+{
+    struct builtin_file_id file;   /* file the module was loaded from */
+    ULONG64                base;   /* load address */
+};
+
+struct import_cache_entry
+{
+    struct import_cache_module importer;  /* module owning the import address table */
+    struct import_cache_module exporter;  /* module named by the import descriptor */
+    DWORD                      iat_rva;   /* rva of the import address table */
+    DWORD                      count;     /* number of entries in the import address table */
+    DWORD                      forwards;  /* number of modules that forwarded exports resolve to */
+    DWORD                      size;      /* size of the whole entry */
+    /* followed by struct import_cache_module[forwards] and ULONG_PTR[count] */
+};
+
+#define IMPORT_CACHE_KEY_SIZE offsetof( struct import_cache_entry, count )
+
+struct import_cache_header
+{
+    DWORD magic;
+    DWORD version;
+    DWORD count;     /* number of entries following the header */
+    DWORD reserved;
+};
+
+static BOOL import_cache_enabled;
+static char *import_cache_data;     /* contents of the cache file */
+static SIZE_T import_cache_data_size;
+static const struct import_cache_entry **import_cache_table;
+static unsigned int import_cache_size;   /* size of the hash table, a power of 2 */
+static unsigned int import_cache_count;  /* number of entries in the hash table */
+static BOOL import_cache_dirty;
+static unsigned int import_cache_hits;
+static unsigned int import_cache_misses;
+
+static BOOL is_import_cache_file_entry( const struct import_cache_entry *entry )
+{
+    return (const char *)entry >= import_cache_data &&
+           (const char *)entry < import_cache_data + import_cache_data_size;
+}
+
+static unsigned int hash_import_cache_key( const struct import_cache_entry *key )
+{
+    const BYTE *ptr = (const BYTE *)key;
+    unsigned int i, hash = 2166136261u;
+
+    for (i = 0; i < IMPORT_CACHE_KEY_SIZE; i++) hash = (hash ^ ptr[i]) * 16777619;
+    return hash;
+}
+
+static const struct import_cache_entry **find_import_cache_slot( const struct import_cache_entry *key )
+{
+    unsigned int pos = hash_import_cache_key( key ) & (import_cache_size - 1);
+
+    while (import_cache_table[pos] && memcmp( import_cache_table[pos], key, IMPORT_CACHE_KEY_SIZE ))
+        pos = (pos + 1) & (import_cache_size - 1);
+    return &import_cache_table[pos];
+}
+
+static BOOL add_import_cache_entry( const struct import_cache_entry *entry )
+{
+    const struct import_cache_entry **slot;
+
+    if (import_cache_count * 2 >= import_cache_size)
+    {
+        const struct import_cache_entry **old_table = import_cache_table;
+        unsigned int i, old_size = import_cache_size;
+        unsigned int size = old_size ? old_size * 2 : 256;
+
+        if (!(import_cache_table = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                                    size * sizeof(*import_cache_table) )))
+        {
+            import_cache_table = old_table;
+            return FALSE;
+        }
+        import_cache_size = size;
+        for (i = 0; i < old_size; i++)
+            if (old_table[i]) *find_import_cache_slot( old_table[i] ) = old_table[i];
+        RtlFreeHeap( GetProcessHeap(), 0, old_table );
+    }
+    slot = find_import_cache_slot( entry );
+    if (!*slot) import_cache_count++;
+    *slot = entry;
+    return TRUE;
+}
+
+/*************************************************************************
+ *		init_import_cache
+ *
+ * Load the import cache, if enabled with WINE_IMPORT_CACHE=1.
+ */
+static void init_import_cache(void)
+{
+    const struct import_cache_header *header;
+    const struct import_cache_entry *entry;
+    SIZE_T len, pos, size = 0;
+    WCHAR buffer[4];
+    DWORD i;
+
+    if (RtlQueryEnvironmentVariable( NULL, L"WINE_IMPORT_CACHE", wcslen(L"WINE_IMPORT_CACHE"),
+                                     buffer, ARRAY_SIZE(buffer) - 1, &len ))
+        return;
+    if (len != 1 || buffer[0] != '1') return;
+    /* relay and snoop thunks are not part of the cached addresses */
+    if (TRACE_ON(relay) || TRACE_ON(snoop)) return;
+    import_cache_enabled = TRUE;
+
+    if (unix_funcs->read_import_cache( NULL, &size ) != STATUS_BUFFER_TOO_SMALL) return;
+    if (size < sizeof(*header) || size > IMPORT_CACHE_MAX_SIZE) return;
+    if (!(import_cache_data = RtlAllocateHeap( GetProcessHeap(), 0, size ))) return;
+    if (unix_funcs->read_import_cache( import_cache_data, &size )) goto failed;
+    import_cache_data_size = size;
+
+    header = (const struct import_cache_header *)import_cache_data;
+    if (header->magic != IMPORT_CACHE_MAGIC || header->version != IMPORT_CACHE_VERSION) goto failed;
+
+    for (i = 0, pos = sizeof(*header); i < header->count; i++, pos += entry->size)
+    {
+        entry = (const struct import_cache_entry *)(import_cache_data + pos);
+        if (size - pos < sizeof(*entry) || entry->size > size - pos || entry->size % 8) goto failed;
+        if (entry->forwards > entry->size / sizeof(struct import_cache_module) ||
+            entry->count > entry->size / sizeof(ULONG_PTR) ||
+            sizeof(*entry) + entry->forwards * sizeof(struct import_cache_module) +
+            entry->count * sizeof(ULONG_PTR) > entry->size)
+            goto failed;
+        if (!add_import_cache_entry( entry )) goto failed;
+    }
+    TRACE_(imports)( "loaded %u import cache entries\n", import_cache_count );
+    return;
+
+failed:
+    WARN( "ignoring invalid import cache\n" );
+    RtlFreeHeap( GetProcessHeap(), 0, import_cache_table );
+    RtlFreeHeap( GetProcessHeap(), 0, import_cache_data );
+    import_cache_table = NULL;
+    import_cache_data = NULL;
+    import_cache_data_size = 0;
+    import_cache_size = import_cache_count = 0;
+}
+
+/*************************************************************************
+ *		save_import_cache
+ *
+ * Write back the import cache if entries were added.
+ * The loader_section must be locked while calling this function.
+ */
+static void save_import_cache(void)
+{
+    struct import_cache_header *header;
+    const struct import_cache_entry *entry;
+    SIZE_T size = sizeof(*header);
+    BOOL all = TRUE;
+    unsigned int i;
+    char *data;
+
+    if (!import_cache_dirty) return;
+    import_cache_dirty = FALSE;
+
+    for (i = 0; i < import_cache_size; i++)
+        if ((entry = import_cache_table[i])) size += entry->size;
+
+    /* start over with the entries of this process when the cache has grown too large */
+    if (size > IMPORT_CACHE_MAX_SIZE)
+    {
+        all = FALSE;
+        size = sizeof(*header);
+        for (i = 0; i < import_cache_size; i++)
+        {
+            if (!(entry = import_cache_table[i])) continue;
+            if (is_import_cache_file_entry( entry )) continue;
+            size += entry->size;
+        }
+    }
+
+    if (!(data = RtlAllocateHeap( GetProcessHeap(), 0, size ))) return;
+    header = (struct import_cache_header *)data;
+    header->magic = IMPORT_CACHE_MAGIC;
+    header->version = IMPORT_CACHE_VERSION;
+    header->count = 0;
+    header->reserved = 0;
+    size = sizeof(*header);
+    for (i = 0; i < import_cache_size; i++)
+    {
+        if (!(entry = import_cache_table[i])) continue;
+        if (!all && is_import_cache_file_entry( entry )) continue;
+        memcpy( data + size, entry, entry->size );
+        size += entry->size;
+        header->count++;
+    }
+    if (unix_funcs->write_import_cache( data, size )) WARN( "failed to write the import cache\n" );
+    else TRACE_(imports)( "saved %u import cache entries\n", header->count );
+    RtlFreeHeap( GetProcessHeap(), 0, data );
+}
+
+static BOOL get_import_cache_module( const WINE_MODREF *wm, struct import_cache_module *module )
+{
+    if (!(wm->ldr.Flags & LDR_WINE_INTERNAL)) return FALSE;
+    memset( module, 0, sizeof(*module) );
+    if (unix_funcs->get_builtin_file_id( wm->ldr.DllBase, &module->file )) return FALSE;
+    module->base = (ULONG_PTR)wm->ldr.DllBase;
+    return TRUE;
+}
+
+static BOOL get_import_cache_key( const WINE_MODREF *wm, const WINE_MODREF *imp, DWORD iat_rva,
+                                  struct import_cache_entry *key )
+{
+    memset( key, 0, sizeof(*key) );
+    if (!get_import_cache_module( wm, &key->importer )) return FALSE;
+    if (!get_import_cache_module( imp, &key->exporter )) return FALSE;
+    key->iat_rva = iat_rva;
+    return TRUE;
+}
+
+/*************************************************************************
+ *		get_cached_imports
+ *
+ * Fill an import address table from the import cache. The modules that the
+ * cached forwarded exports resolve to must already be loaded.
+ * The loader_section must be locked while calling this function.
+ */
+static BOOL get_cached_imports( const WINE_MODREF *wm, const WINE_MODREF *imp, DWORD iat_rva,
+                                IMAGE_THUNK_DATA *thunk_list, DWORD count )
+{
+    const struct import_cache_entry **slot, *entry;
+    const struct import_cache_module *forwards;
+    struct import_cache_module module;
+    struct import_cache_entry key;
+    const ULONG_PTR *funcs;
+    WINE_MODREF *fwd;
+    DWORD i;
+
+    if (!import_cache_count || !get_import_cache_key( wm, imp, iat_rva, &key )) return FALSE;
+    slot = find_import_cache_slot( &key );
+    if (!(entry = *slot) || entry->count != count) return FALSE;
+
+    forwards = (const struct import_cache_module *)(entry + 1);
+    for (i = 0; i < entry->forwards; i++)
+    {
+        if (!(fwd = get_modref( (HMODULE)(ULONG_PTR)forwards[i].base ))) return FALSE;
+        if (!get_import_cache_module( fwd, &module )) return FALSE;
+        if (memcmp( &module, &forwards[i], sizeof(module) )) return FALSE;
+    }
+
+    funcs = (const ULONG_PTR *)(forwards + entry->forwards);
+    for (i = 0; i < count; i++) thunk_list[i].u1.Function = funcs[i];
+    return TRUE;
+}
+
+/*************************************************************************
+ *		add_cached_imports
+ *
+ * Add a resolved import address table to the import cache. Tables with
+ * stubs for missing exports or pointing to non-builtin modules are skipped.
+ * The loader_section must be locked while calling this function.
+ */
+static void add_cached_imports( const WINE_MODREF *wm, const WINE_MODREF *imp, DWORD iat_rva,
+                                const IMAGE_THUNK_DATA *thunk_list, DWORD count )
+{
+    const WINE_MODREF *targets[16];
+    struct import_cache_module *forwards;
+    struct import_cache_entry key, *entry;
+    LDR_DATA_TABLE_ENTRY *mod;
+    ULONG_PTR *funcs;
+    DWORD i, j, nb_targets = 0, size;
+
+    if (!get_import_cache_key( wm, imp, iat_rva, &key )) return;
+
+    for (i = 0; i < count; i++)
+    {
+        const char *addr = (const char *)thunk_list[i].u1.Function;
+
+        if (addr >= (char *)imp->ldr.DllBase && addr < (char *)imp->ldr.DllBase + imp->ldr.SizeOfImage)
+            continue;
+        for (j = 0; j < nb_targets; j++)
+            if (addr >= (char *)targets[j]->ldr.DllBase &&
+                addr < (char *)targets[j]->ldr.DllBase + targets[j]->ldr.SizeOfImage) break;
+        if (j < nb_targets) continue;
+        if (nb_targets == ARRAY_SIZE(targets)) return;
+        if (LdrFindEntryForAddress( addr, &mod )) return;  /* import stub */
+        targets[nb_targets++] = CONTAINING_RECORD( mod, WINE_MODREF, ldr );
+    }
+
+    size = sizeof(*entry) + nb_targets * sizeof(*forwards) + count * sizeof(*funcs);
+    size = (size + 7) & ~7;
+    if (!(entry = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, size ))) return;
+    *entry = key;
+    entry->count = count;
+    entry->forwards = nb_targets;
+    entry->size = size;
+    forwards = (struct import_cache_module *)(entry + 1);
+    for (i = 0; i < nb_targets; i++)
+    {
+        if (!get_import_cache_module( targets[i], &forwards[i] ))
+        {
+            RtlFreeHeap( GetProcessHeap(), 0, entry );
+            return;
+        }
+    }
+    funcs = (ULONG_PTR *)(forwards + nb_targets);
+    for (i = 0; i < count; i++) funcs[i] = thunk_list[i].u1.Function;
+
+    if (add_import_cache_entry( entry )) import_cache_dirty = TRUE;
+    else RtlFreeHeap( GetProcessHeap(), 0, entry );
+}
+
+
 /*************************************************************************
  *		import_dll
  *
@@ -789,7 +1265,7 @@ static BOOL import_dll( HMODULE module, const IMAGE_IMPORT_DESCRIPTOR *descr, LP
     DWORD len = strlen(name);
     PVOID protect_base;
     SIZE_T protect_size = 0;
-    DWORD protect_old;
+    DWORD protect_old, count;
 
     thunk_list = get_rva( module, (DWORD)descr->FirstThunk );
     if (descr->u.OriginalFirstThunk)
@@ -841,14 +1317,34 @@ static BOOL import_dll( HMODULE module, const IMAGE_IMPORT_DESCRIPTOR *descr, LP
         return FALSE;
     }
 
+    /* a valid binding means the import address table is already filled */
+    if (descr->TimeDateStamp == ~0u && is_import_bound( module, name, wmImp ))
+    {
+        TRACE_(imports)( "using bound imports for %s\n", name );
+        *pwm = wmImp;
+        return TRUE;
+    }
+
     /* unprotect the import address table since it can be located in
      * readonly section */
     while (import_list[protect_size].u1.Ordinal) protect_size++;
+    count = protect_size;
     protect_base = thunk_list;
     protect_size *= sizeof(*thunk_list);
     NtProtectVirtualMemory( NtCurrentProcess(), &protect_base,
                             &protect_size, PAGE_READWRITE, &protect_old );
 
+    if (import_cache_enabled)
+    {
+        if (get_cached_imports( current_modref, wmImp, descr->FirstThunk, thunk_list, count ))
+        {
+            TRACE_(imports)( "using cached imports for %s\n", name );
+            import_cache_hits++;
+            goto done;
+        }
+        import_cache_misses++;
+    }
+
     imp_mod = wmImp->ldr.DllBase;
     exports = RtlImageDirectoryEntryToData( imp_mod, TRUE, IMAGE_DIRECTORY_ENTRY_EXPORT, &exp_size );
 
@@ -899,7 +1395,7 @@ static BOOL import_dll( HMODULE module, const IMAGE_IMPORT_DESCRIPTOR *descr, LP
         {
             IMAGE_IMPORT_BY_NAME *pe_name;
             pe_name = get_rva( module, (DWORD)import_list->u1.AddressOfData );
-            thunk_list->u1.Function = (ULONG_PTR)find_named_export( imp_mod, exports, exp_size,
+            thunk_list->u1.Function = (ULONG_PTR)find_named_export( wmImp, exports, exp_size,
                                                                     (const char*)pe_name->Name,
                                                                     pe_name->Hint, load_path );
             if (!thunk_list->u1.Function)
@@ -916,6 +1412,10 @@ static BOOL import_dll( HMODULE module, const IMAGE_IMPORT_DESCRIPTOR *descr, LP
         thunk_list++;
     }
 
+    if (import_cache_enabled)
+        add_cached_imports( current_modref, wmImp, descr->FirstThunk,
+                            get_rva( module, (DWORD)descr->FirstThunk ), count );
+
 done:
     /* restore old protection of the import address table */
     NtProtectVirtualMemory( NtCurrentProcess(), &protect_base, &protect_size, protect_old, &protect_old );
@@ -1123,7 +1623,7 @@ static NTSTATUS fixup_imports_ilonly( WINE_MODREF *wm, LPCWSTR load_path, void *
                                                  IMAGE_DIRECTORY_ENTRY_EXPORT, &exp_size )))
     {
         const char *name = (wm->ldr.Flags & LDR_IMAGE_IS_DLL) ? "_CorDllMain" : "_CorExeMain";
-        proc = find_named_export( imp->ldr.DllBase, exports, exp_size, name, -1, load_path );
+        proc = find_named_export( imp, exports, exp_size, name, -1, load_path );
     }
     if (!proc) return STATUS_PROCEDURE_NOT_FOUND;
     *entry = proc;
@@ -1446,10 +1946,14 @@ static NTSTATUS process_attach( WINE_MODREF *wm, LPVOID lpReserved )
     if (status == STATUS_SUCCESS)
     {
         WINE_MODREF *prev = current_modref;
+        LONGLONG start = 0, nested = 0;
+
         current_modref = wm;
 
         call_ldr_notifications( LDR_DLL_NOTIFICATION_REASON_LOADED, &wm->ldr );
+        if (TRACE_ON(startup)) start = startup_begin( &startup_nested_attach, &nested );
         status = MODULE_InitDLL( wm, DLL_PROCESS_ATTACH, lpReserved );
+        if (start) wm->attach_time = startup_end( &startup_nested_attach, nested, start );
         if (status == STATUS_SUCCESS)
         {
             wm->ldr.Flags |= LDR_PROCESS_ATTACHED;
@@ -1717,17 +2221,18 @@ NTSTATUS WINAPI LdrGetProcedureAddress(HMODULE module, const ANSI_STRING *name,
 {
     IMAGE_EXPORT_DIRECTORY *exports;
     DWORD exp_size;
+    WINE_MODREF *wm;
     NTSTATUS ret = STATUS_PROCEDURE_NOT_FOUND;
 
     RtlEnterCriticalSection( &loader_section );
 
     /* check if the module itself is invalid to return the proper error */
-    if (!get_modref( module )) ret = STATUS_DLL_NOT_FOUND;
+    if (!(wm = get_modref( module ))) ret = STATUS_DLL_NOT_FOUND;
     else if ((exports = RtlImageDirectoryEntryToData( module, TRUE,
                                                       IMAGE_DIRECTORY_ENTRY_EXPORT, &exp_size )))
     {
         LPCWSTR load_path = NtCurrentTeb()->Peb->ProcessParameters->DllPath.Buffer;
-        void *proc = name ? find_named_export( module, exports, exp_size, name->Buffer, -1, load_path )
+        void *proc = name ? find_named_export( wm, exports, exp_size, name->Buffer, -1, load_path )
                           : find_ordinal_export( module, exports, exp_size, ord - exports->Base, load_path );
         if (proc)
         {
@@ -1865,6 +2370,294 @@ static NTSTATUS perform_relocations( void *module, IMAGE_NT_HEADERS *nt, SIZE_T
 }
 
 
+/* Builtin dlls mapped and relocated ahead of time by worker threads while the imports of
+ * the main exe are fixed up, see prefetch_imports(). The main thread still resolves the
+ * imports and calls DllMain in order, under the loader lock. */
+
+#define PREFETCH_MAX_THREADS 8
+#define PREFETCH_MAX_DLLS    512
+
+enum prefetch_state
+{
+    PREFETCH_QUEUED,     /* waiting for a worker */
+    PREFETCH_BUSY,       /* being mapped by a worker */
+    PREFETCH_DONE,       /* mapped by a worker, or failed */
+    PREFETCH_CANCELLED   /* loaded by the main thread itself */
+};
+
+struct prefetch_dll
+{
+    WCHAR               name[64];  /* lower-case base name */
+    enum prefetch_state state;
+    void               *module;    /* module mapped and relocated by a worker */
+};
+
+static struct prefetch_dll *prefetch_dlls;
+static unsigned int prefetch_count;
+static unsigned int prefetch_busy;
+static unsigned int prefetch_threads;
+static unsigned int prefetch_used;
+static BOOL prefetch_stopping;
+static const WCHAR *prefetch_app_name;
+
+static RTL_CONDITION_VARIABLE prefetch_cv = RTL_CONDITION_VARIABLE_INIT;
+static RTL_CRITICAL_SECTION prefetch_section;
+static RTL_CRITICAL_SECTION_DEBUG prefetch_critsect_debug =
+{
+    0, 0, &prefetch_section,
+    { &prefetch_critsect_debug.ProcessLocksList, &prefetch_critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": prefetch_section") }
+};
+static RTL_CRITICAL_SECTION prefetch_section = { &prefetch_critsect_debug, -1, 0, 0, 0, 0 };
+
+/* the prefetch_section must be held while calling this function */
+static struct prefetch_dll *find_prefetch_dll( const WCHAR *name, SIZE_T len )
+{
+    unsigned int i;
+
+    for (i = 0; i < prefetch_count; i++)
+        if (!wcsnicmp( prefetch_dlls[i].name, name, len ) && !prefetch_dlls[i].name[len])
+            return &prefetch_dlls[i];
+    return NULL;
+}
+
+/* the prefetch_section must be held while calling this function */
+static struct prefetch_dll *add_prefetch_dll( const WCHAR *name, SIZE_T len, enum prefetch_state state )
+{
+    struct prefetch_dll *dll;
+
+    if (prefetch_count == PREFETCH_MAX_DLLS || len >= ARRAY_SIZE(dll->name)) return NULL;
+    dll = &prefetch_dlls[prefetch_count++];
+    memcpy( dll->name, name, len * sizeof(WCHAR) );
+    dll->name[len] = 0;
+    wcslwr( dll->name );
+    dll->state = state;
+    dll->module = NULL;
+    return dll;
+}
+
+/*************************************************************************
+ *		queue_prefetch_imports
+ *
+ * Queue the dlls imported by a module for the workers.
+ * The prefetch_section must be held while calling this function.
+ */
+static void queue_prefetch_imports( HMODULE module )
+{
+    const IMAGE_IMPORT_DESCRIPTOR *imports;
+    WCHAR name[64];
+    DWORD size;
+    int i, len;
+
+    if (!(imports = RtlImageDirectoryEntryToData( module, TRUE, IMAGE_DIRECTORY_ENTRY_IMPORT, &size )))
+        return;
+
+    for (i = 0; i * sizeof(*imports) < size && imports[i].Name && imports[i].FirstThunk; i++)
+    {
+        const char *str = get_rva( module, imports[i].Name );
+
+        for (len = 0; str[len] && len < ARRAY_SIZE(name); len++) name[len] = (unsigned char)str[len];
+        if (len == ARRAY_SIZE(name)) continue;
+        name[len] = 0;
+        if (contains_path( name ) || !wcschr( name, '.' )) continue;
+        if (find_prefetch_dll( name, len )) continue;
+        if (!add_prefetch_dll( name, len, PREFETCH_QUEUED )) break;
+    }
+    RtlWakeAllConditionVariable( &prefetch_cv );
+}
+
+/*************************************************************************
+ *		prefetch_dll
+ *
+ * Map and relocate a builtin dll from a worker thread.
+ */
+static void *prefetch_dll( const WCHAR *name )
+{
+    SECTION_IMAGE_INFORMATION image_info;
+    UNICODE_STRING nt_name;
+    enum loadorder loadorder;
+    IMAGE_NT_HEADERS *nt;
+    void *module = NULL;
+    WCHAR path[MAX_PATH];
+
+    if (wcslen( system_dir ) + wcslen( name ) >= ARRAY_SIZE(path)) return NULL;
+    wcscpy( path, system_dir );
+    wcscat( path, name );
+    if (!RtlDosPathNameToNtPathName_U( path, &nt_name, NULL, NULL )) return NULL;
+
+    /* only map the dlls that the main thread would load as builtin */
+    loadorder = get_load_order( prefetch_app_name, &nt_name );
+    if ((loadorder == LO_BUILTIN || loadorder == LO_BUILTIN_NATIVE || loadorder == LO_DEFAULT) &&
+        !unix_funcs->prefetch_builtin_dll( &nt_name, &module, &image_info ) &&
+        (nt = RtlImageNtHeader( module )))
+    {
+        SIZE_T map_size = (nt->OptionalHeader.SizeOfImage + page_size - 1) & ~(page_size - 1);
+
+        if (!(nt->FileHeader.Characteristics & IMAGE_FILE_DLL) || perform_relocations( module, nt, map_size ))
+        {
+            unix_funcs->unload_builtin_dll( module );
+            NtUnmapViewOfSection( NtCurrentProcess(), module );
+            module = NULL;
+        }
+    }
+    RtlFreeUnicodeString( &nt_name );
+    return module;
+}
+
+/*************************************************************************
+ *		prefetch_thread
+ *
+ * Entry point of the loader workers. They are started before kernel32 is loaded,
+ * so they are dispatched directly from LdrInitializeThunk and never return.
+ */
+static void WINAPI prefetch_thread( void *arg )
+{
+    struct prefetch_dll *dll;
+    unsigned int i;
+    void *module;
+
+    RtlEnterCriticalSection( &prefetch_section );
+    while (!prefetch_stopping)
+    {
+        for (i = 0; i < prefetch_count; i++) if (prefetch_dlls[i].state == PREFETCH_QUEUED) break;
+        if (i == prefetch_count)
+        {
+            /* a busy worker may still queue more dlls */
+            if (!prefetch_busy) break;
+            RtlSleepConditionVariableCS( &prefetch_cv, &prefetch_section, NULL );
+            continue;
+        }
+        dll = &prefetch_dlls[i];
+        dll->state = PREFETCH_BUSY;
+        prefetch_busy++;
+        RtlLeaveCriticalSection( &prefetch_section );
+
+        module = prefetch_dll( dll->name );
+
+        RtlEnterCriticalSection( &prefetch_section );
+        dll->module = module;
+        dll->state = PREFETCH_DONE;
+        prefetch_busy--;
+        if (module) queue_prefetch_imports( module );
+        RtlWakeAllConditionVariable( &prefetch_cv );
+    }
+    prefetch_threads--;
+    RtlWakeAllConditionVariable( &prefetch_cv );
+    RtlLeaveCriticalSection( &prefetch_section );
+
+    HEAP_notify_thread_destroy( FALSE );
+    for (;;) NtTerminateThread( GetCurrentThread(), 0 );
+}
+
+/*************************************************************************
+ *		prefetch_imports
+ *
+ * Start mapping the import tree of the main exe on worker threads, if enabled
+ * with WINE_PARALLEL_LOADER=<number of threads>.
+ */
+static void prefetch_imports( WINE_MODREF *wm )
+{
+    WCHAR buffer[16];
+    SIZE_T len;
+    ULONG i, count;
+    HANDLE handle;
+
+    if (RtlQueryEnvironmentVariable( NULL, L"WINE_PARALLEL_LOADER", wcslen(L"WINE_PARALLEL_LOADER"),
+                                     buffer, ARRAY_SIZE(buffer) - 1, &len ))
+        return;
+    buffer[len] = 0;
+    if (!(count = min( wcstoul( buffer, NULL, 10 ), PREFETCH_MAX_THREADS ))) return;
+
+    if (!(prefetch_dlls = RtlAllocateHeap( GetProcessHeap(), 0, PREFETCH_MAX_DLLS * sizeof(*prefetch_dlls) )))
+        return;
+    prefetch_app_name = wm->ldr.BaseDllName.Buffer;
+
+    RtlEnterCriticalSection( &prefetch_section );
+    queue_prefetch_imports( wm->ldr.DllBase );
+    for (i = 0; i < count; i++)
+    {
+        if (RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                 prefetch_thread, NULL, &handle, NULL ))
+            break;
+        prefetch_threads++;
+        NtClose( handle );
+    }
+    RtlLeaveCriticalSection( &prefetch_section );
+    TRACE( "started %u workers for %s\n", i, debugstr_w(prefetch_app_name) );
+}
+
+/*************************************************************************
+ *		prefetch_wait
+ *
+ * Make sure no worker maps a dll while the main thread is loading it.
+ * Returns the module if it has already been mapped by a worker, the main
+ * thread owns it from then on.
+ */
+static void *prefetch_wait( const UNICODE_STRING *nt_name )
+{
+    struct prefetch_dll *dll;
+    const WCHAR *name = nt_name->Buffer;
+    SIZE_T i, len = nt_name->Length / sizeof(WCHAR);
+    void *module = NULL;
+
+    for (i = 0; i < nt_name->Length / sizeof(WCHAR); i++)
+    {
+        if (nt_name->Buffer[i] != '\\' && nt_name->Buffer[i] != '/') continue;
+        name = nt_name->Buffer + i + 1;
+        len = nt_name->Length / sizeof(WCHAR) - i - 1;
+    }
+
+    RtlEnterCriticalSection( &prefetch_section );
+    if (!(dll = find_prefetch_dll( name, len )))
+        add_prefetch_dll( name, len, PREFETCH_CANCELLED );
+    else if (dll->state == PREFETCH_QUEUED)
+        dll->state = PREFETCH_CANCELLED;
+    else
+    {
+        while (dll->state == PREFETCH_BUSY)
+            RtlSleepConditionVariableCS( &prefetch_cv, &prefetch_section, NULL );
+        if ((module = dll->module)) prefetch_used++;
+        dll->module = NULL;
+    }
+    RtlLeaveCriticalSection( &prefetch_section );
+    return module;
+}
+
+/*************************************************************************
+ *		prefetch_finish
+ *
+ * Stop the workers and release the dlls that were mapped but not used.
+ * The loader_section must be locked while calling this function.
+ */
+static void prefetch_finish(void)
+{
+    unsigned int i, unused = 0;
+
+    if (!prefetch_dlls) return;
+
+    RtlEnterCriticalSection( &prefetch_section );
+    prefetch_stopping = TRUE;
+    RtlWakeAllConditionVariable( &prefetch_cv );
+    while (prefetch_threads) RtlSleepConditionVariableCS( &prefetch_cv, &prefetch_section, NULL );
+    RtlLeaveCriticalSection( &prefetch_section );
+
+    for (i = 0; i < prefetch_count; i++)
+    {
+        void *module = prefetch_dlls[i].module;
+
+        if (!module) continue;
+        unused++;
+        unix_funcs->unload_builtin_dll( module );
+        NtUnmapViewOfSection( NtCurrentProcess(), module );
+    }
+    TRACE( "%u dlls mapped by the workers, %u of them unused\n", prefetch_used + unused, unused );
+
+    RtlFreeHeap( GetProcessHeap(), 0, prefetch_dlls );
+    prefetch_dlls = NULL;
+    prefetch_count = 0;
+}
+
+
 /*************************************************************************
  *		build_module
  *
@@ -1872,7 +2665,7 @@ static NTSTATUS perform_relocations( void *module, IMAGE_NT_HEADERS *nt, SIZE_T
  */
 static NTSTATUS build_module( LPCWSTR load_path, const UNICODE_STRING *nt_name, void **module,
                               const SECTION_IMAGE_INFORMATION *image_info, const struct file_id *id,
-                              DWORD flags, WINE_MODREF **pwm )
+                              DWORD flags, WINE_MODREF **pwm, BOOL relocated )
 {
     static HMODULE lsteamclient = NULL;
     UNICODE_STRING lsteamclient_us;
@@ -1886,7 +2679,7 @@ static NTSTATUS build_module( LPCWSTR load_path, const UNICODE_STRING *nt_name,
     if (!(nt = RtlImageNtHeader( *module ))) return STATUS_INVALID_IMAGE_FORMAT;
 
     map_size = (nt->OptionalHeader.SizeOfImage + page_size - 1) & ~(page_size - 1);
-    if ((status = perform_relocations( *module, nt, map_size ))) return status;
+    if (!relocated && (status = perform_relocations( *module, nt, map_size ))) return status;
 
     /* create the MODREF */
 
@@ -2349,7 +3142,7 @@ static NTSTATUS load_native_dll( LPCWSTR load_path, const UNICODE_STRING *nt_nam
 #ifdef _WIN64
     if (!status && !convert_to_pe64( module, image_info )) status = STATUS_INVALID_IMAGE_FORMAT;
 #endif
-    if (!status) status = build_module( load_path, nt_name, &module, image_info, id, flags, pwm );
+    if (!status) status = build_module( load_path, nt_name, &module, image_info, id, flags, pwm, FALSE );
     if (status && module) NtUnmapViewOfSection( NtCurrentProcess(), module );
     return status;
 }
@@ -2384,7 +3177,7 @@ static NTSTATUS load_so_dll( LPCWSTR load_path, const UNICODE_STRING *nt_name,
         SECTION_IMAGE_INFORMATION image_info = { 0 };
 
         image_info.u.s.WineBuiltin = 1;
-        if ((status = build_module( load_path, &win_name, &module, &image_info, NULL, flags, &wm )))
+        if ((status = build_module( load_path, &win_name, &module, &image_info, NULL, flags, &wm, FALSE )))
         {
             if (module) unix_funcs->unload_builtin_dll( module );
             return status;
@@ -2403,11 +3196,12 @@ static NTSTATUS load_builtin_dll( LPCWSTR load_path, UNICODE_STRING *nt_name,
                                   DWORD flags, WINE_MODREF** pwm, BOOL prefer_native )
 {
     NTSTATUS status;
-    void *module, *unix_entry = NULL;
+    void *module, *prefetched = NULL, *unix_entry = NULL;
     SECTION_IMAGE_INFORMATION image_info;
 
     TRACE("Trying built-in %s\n", debugstr_us(nt_name));
 
+    if (prefetch_dlls) prefetched = prefetch_wait( nt_name );
     status = unix_funcs->load_builtin_dll( nt_name, &module, &unix_entry, &image_info, prefer_native );
     if (status) return status;
 
@@ -2421,7 +3215,7 @@ static NTSTATUS load_builtin_dll( LPCWSTR load_path, UNICODE_STRING *nt_name,
     }
 
     TRACE( "loading %s\n", debugstr_us(nt_name) );
-    status = build_module( load_path, nt_name, &module, &image_info, NULL, flags, pwm );
+    status = build_module( load_path, nt_name, &module, &image_info, NULL, flags, pwm, module == prefetched );
     if (!status) (*pwm)->unix_entry = unix_entry;
     else if (module) unix_funcs->unload_builtin_dll( module );
     return status;
@@ -2726,9 +3520,12 @@ static NTSTATUS load_dll( const WCHAR *load_path, const WCHAR *libname, const WC
     SECTION_IMAGE_INFORMATION image_info;
     NTSTATUS nts;
     void *prev;
+    LONGLONG start = 0, nested = 0, time;
 
     TRACE( "looking for %s in %s\n", debugstr_w(libname), debugstr_w(load_path) );
 
+    if (TRACE_ON(startup)) start = startup_begin( &startup_nested_load, &nested );
+
     nts = find_dll_file( load_path, libname, default_ext, &nt_name, pwm, &mapping, &image_info, &id );
 
     if (*pwm)  /* found already loaded module */
@@ -2739,6 +3536,7 @@ static NTSTATUS load_dll( const WCHAR *load_path, const WCHAR *libname, const WC
               debugstr_w((*pwm)->ldr.FullDllName.Buffer), debugstr_w(libname),
               (*pwm)->ldr.DllBase, (*pwm)->ldr.LoadCount);
         RtlFreeUnicodeString( &nt_name );
+        if (start) startup_end( &startup_nested_load, nested, start );
         return STATUS_SUCCESS;
     }
 
@@ -2839,6 +3637,12 @@ static NTSTATUS load_dll( const WCHAR *load_path, const WCHAR *libname, const WC
     NtCurrentTeb()->Tib.ArbitraryUserPointer = prev;
 
 done:
+    if (start)
+    {
+        time = startup_end( &startup_nested_load, nested, start );
+        if (nts == STATUS_SUCCESS && !(*pwm)->load_time) (*pwm)->load_time = time;
+    }
+
     if (nts == STATUS_SUCCESS)
         TRACE("Loaded module %s at %p\n", debugstr_us(&nt_name), (*pwm)->ldr.DllBase);
     else
@@ -3274,6 +4078,7 @@ void WINAPI LdrShutdownProcess(void)
     BOOL detaching = process_detaching;
 
     TRACE("()\n");
+    if (TRACE_ON(relay)) RELAY_FlushThread();
 
     process_detaching = TRUE;
     if (!detaching)
@@ -3289,6 +4094,7 @@ void WINAPI LdrShutdownProcess(void)
 void WINAPI RtlExitUserProcess( DWORD status )
 {
     RtlEnterCriticalSection( &loader_section );
+    if (import_cache_enabled) save_import_cache();
     RtlAcquirePebLock();
     NtTerminateProcess( 0, status );
     LdrShutdownProcess();
@@ -3309,6 +4115,7 @@ void WINAPI LdrShutdownThread(void)
     void **pointers;
 
     TRACE("()\n");
+    if (TRACE_ON(relay)) RELAY_FlushThread();
 
     /* don't do any detach calls if process is exiting */
     if (process_detaching) return;
@@ -3378,6 +4185,7 @@ static void free_modref( WINE_MODREF *wm )
     if (cached_modref == wm) cached_modref = NULL;
     RtlFreeUnicodeString( &wm->ldr.FullDllName );
     RtlFreeHeap( GetProcessHeap(), 0, wm->deps );
+    RtlFreeHeap( GetProcessHeap(), 0, wm->export_hash );
     RtlFreeHeap( GetProcessHeap(), 0, wm );
 }
 
@@ -3540,6 +4348,39 @@ static void process_breakpoint(void)
 }
 
 
+/***********************************************************************
+ *           report_startup_times
+ *
+ * Report the time spent loading and attaching each dll before the entry point.
+ */
+static void report_startup_times(void)
+{
+    KERNEL_USER_TIMES times;
+    LDR_DATA_TABLE_ENTRY *mod;
+    PLIST_ENTRY mark, entry;
+    LARGE_INTEGER now;
+    WINE_MODREF *wm;
+    unsigned int count = 0;
+
+    NtQuerySystemTime( &now );
+    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
+    for (entry = mark->Flink; entry != mark; entry = entry->Flink)
+    {
+        mod = CONTAINING_RECORD( entry, LDR_DATA_TABLE_ENTRY, InLoadOrderLinks );
+        wm = CONTAINING_RECORD( mod, WINE_MODREF, ldr );
+        TRACE_(startup)( "%s: loaded in %u us, attached in %u us\n", debugstr_w(mod->BaseDllName.Buffer),
+                         (unsigned int)(wm->load_time / 10), (unsigned int)(wm->attach_time / 10) );
+        count++;
+    }
+    if (import_cache_enabled)
+        TRACE_(startup)( "%u import tables from the cache, %u resolved\n",
+                         import_cache_hits, import_cache_misses );
+    if (!NtQueryInformationProcess( GetCurrentProcess(), ProcessTimes, &times, sizeof(times), NULL ))
+        TRACE_(startup)( "entry point reached %u us after process creation, %u dlls\n",
+                         (unsigned int)((now.QuadPart - times.CreateTime.QuadPart) / 10), count );
+}
+
+
 /******************************************************************
  *		LdrInitializeThunk (NTDLL.@)
  *
@@ -3568,6 +4409,8 @@ void WINAPI LdrInitializeThunk( CONTEXT *context, ULONG_PTR unknown2, ULONG_PTR
 
     if (process_detaching) NtTerminateThread( GetCurrentThread(), 0 );
 
+    if (*entry == (void *)prefetch_thread) prefetch_thread( NULL );
+
     RtlEnterCriticalSection( &loader_section );
 
     wm = get_modref( NtCurrentTeb()->Peb->ImageBaseAddress );
@@ -3579,7 +4422,12 @@ void WINAPI LdrInitializeThunk( CONTEXT *context, ULONG_PTR unknown2, ULONG_PTR
         if (wm->ldr.Flags & LDR_COR_ILONLY)
             status = fixup_imports_ilonly( wm, load_path, entry );
         else
+        {
+            prefetch_imports( wm );
             status = fixup_imports( wm, load_path );
+            prefetch_finish();
+        }
+        if (import_cache_enabled) save_import_cache();
 
         if (status)
         {
@@ -3630,6 +4478,7 @@ void WINAPI LdrInitializeThunk( CONTEXT *context, ULONG_PTR unknown2, ULONG_PTR
         if (wm->ldr.TlsIndex != -1) call_tls_callbacks( wm->ldr.DllBase, DLL_PROCESS_ATTACH );
         if (wm->ldr.Flags & LDR_WINE_INTERNAL) unix_funcs->init_builtin_dll( wm->ldr.DllBase );
         if (wm->ldr.ActivationContext) RtlDeactivateActivationContext( 0, cookie );
+        if (TRACE_ON(startup)) report_startup_times();
         process_breakpoint();
     }
     else
@@ -4169,6 +5018,7 @@ static NTSTATUS process_init(void)
     RtlSetHeapInformation( GetProcessHeap(), HeapCompatibilityInformation, &hci, sizeof(hci) );
 
     build_ntdll_module();
+    init_import_cache();
 
     if ((status = load_dll( params->DllPath.Buffer, L"C:\\windows\\system32\\kernel32.dll",
                             NULL, 0, &wm )) != STATUS_SUCCESS)
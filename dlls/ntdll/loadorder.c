@@ -54,6 +54,16 @@ static const WCHAR separatorsW[] = L", \t";
 static BOOL init_done;
 static struct loadorder_list env_list;
 
+/* the loader worker threads look up load orders too, see prefetch_thread() in loader.c */
+static RTL_CRITICAL_SECTION loadorder_section;
+static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
+{
+    0, 0, &loadorder_section,
+    { &critsect_debug.ProcessLocksList, &critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": loadorder_section") }
+};
+static RTL_CRITICAL_SECTION loadorder_section = { &critsect_debug, -1, 0, 0, 0, 0 };
+
 
 /***************************************************************************
  *	cmp_sort_func	(internal, static)
@@ -421,9 +431,10 @@ enum loadorder get_load_order( const WCHAR *app_name, const UNICODE_STRING *nt_n
     enum loadorder ret = LO_INVALID;
     HANDLE std_key, app_key = 0;
     const WCHAR *path = nt_name->Buffer;
-    WCHAR *module, *basename;
+    WCHAR *module = NULL, *basename;
     int len;
 
+    RtlEnterCriticalSection( &loadorder_section );
     if (!init_done) init_load_order();
     std_key = get_standard_key();
     if (app_name) app_key = get_app_key( app_name );
@@ -440,8 +451,8 @@ enum loadorder get_load_order( const WCHAR *app_name, const UNICODE_STRING *nt_n
         if (!wcschr( p, '\\' ) && !wcschr( p, '/' )) path = p;
     }
 
-    if (!(len = wcslen(path))) return ret;
-    if (!(module = RtlAllocateHeap( GetProcessHeap(), 0, (len + 2) * sizeof(WCHAR) ))) return ret;
+    if (!(len = wcslen(path))) goto done;
+    if (!(module = RtlAllocateHeap( GetProcessHeap(), 0, (len + 2) * sizeof(WCHAR) ))) goto done;
     wcscpy( module+1, path );  /* reserve module[0] for the wildcard char */
     remove_dll_ext( module + 1 );
     basename = (WCHAR *)get_basename( module+1 );
@@ -473,5 +484,6 @@ enum loadorder get_load_order( const WCHAR *app_name, const UNICODE_STRING *nt_n
 
  done:
     RtlFreeHeap( GetProcessHeap(), 0, module );
+    RtlLeaveCriticalSection( &loadorder_section );
     return ret;
 }
@@ -29,6 +29,7 @@
 #include "windef.h"
 #include "winternl.h"
 #include "wine/exception.h"
+#include "wine/relay_record.h"
 #include "ntdll_misc.h"
 #include "wine/debug.h"
 
@@ -67,10 +68,219 @@ struct relay_private_data
 {
     HMODULE                  module;            /* module handle of this dll */
     unsigned int             base;              /* ordinal base */
+    unsigned int             record_id;         /* module id in the record file */
     char                     dllname[40];       /* dll name (without .dll extension) */
     struct relay_entry_point entry_points[1];   /* list of dll entry points */
 };
 
+/* binary recording of relay calls */
+
+#define RELAY_RECORD_DEPTH  64    /* max nesting of recorded calls */
+#define RELAY_RECORD_CALLS  1024  /* calls buffered per thread before writing them out */
+
+struct relay_record_frame
+{
+    const struct relay_descr *descr;
+    unsigned int              idx;
+    unsigned int              nb_args;
+    LONGLONG                  start;
+    ULONGLONG                 args[RELAY_RECORD_ARGS];
+};
+
+struct relay_thread_record
+{
+    unsigned int              depth;
+    struct relay_record_frame frames[RELAY_RECORD_DEPTH];
+    struct relay_record_calls calls;  /* must be last */
+};
+
+static HANDLE relay_record_file;
+static LONG relay_record_modules;
+
+static void write_record( const void *data, ULONG size )
+{
+    IO_STATUS_BLOCK io;
+
+    NtWriteFile( relay_record_file, 0, NULL, NULL, &io, data, size, NULL, NULL );
+}
+
+/***********************************************************************
+ *           open_record_file
+ *
+ * Open the file for binary recording of relay calls, if configured.
+ */
+static void open_record_file( HKEY hkey )
+{
+    char buffer[offsetof( KEY_VALUE_PARTIAL_INFORMATION, Data[MAX_PATH * sizeof(WCHAR)] )];
+    KEY_VALUE_PARTIAL_INFORMATION *info = (KEY_VALUE_PARTIAL_INFORMATION *)buffer;
+    struct relay_record_header header;
+    WCHAR path[MAX_PATH + 16];
+    UNICODE_STRING name, nt_name;
+    OBJECT_ATTRIBUTES attr;
+    IO_STATUS_BLOCK io;
+    LARGE_INTEGER counter, frequency;
+    DWORD count;
+
+    RtlInitUnicodeString( &name, L"RelayRecord" );
+    if (NtQueryValueKey( hkey, &name, KeyValuePartialInformation, buffer, sizeof(buffer) - sizeof(WCHAR), &count ))
+        return;
+    if (info->Type != REG_SZ) return;
+    ((WCHAR *)info->Data)[info->DataLength / sizeof(WCHAR)] = 0;
+
+    /* each process gets its own file */
+    swprintf( path, ARRAY_SIZE(path), L"%s.%u", (WCHAR *)info->Data, GetCurrentProcessId() );
+    if (!RtlDosPathNameToNtPathName_U( path, &nt_name, NULL, NULL )) return;
+    InitializeObjectAttributes( &attr, &nt_name, OBJ_CASE_INSENSITIVE, 0, NULL );
+    if (NtCreateFile( &relay_record_file, FILE_APPEND_DATA | SYNCHRONIZE, &attr, &io, NULL,
+                      FILE_ATTRIBUTE_NORMAL, FILE_SHARE_READ, FILE_OVERWRITE_IF,
+                      FILE_SYNCHRONOUS_IO_NONALERT | FILE_NON_DIRECTORY_FILE, NULL, 0 ))
+        relay_record_file = 0;
+    RtlFreeUnicodeString( &nt_name );
+    if (!relay_record_file) return;
+
+    TRACE( "recording relay calls to %s\n", debugstr_w(path) );
+    NtQueryPerformanceCounter( &counter, &frequency );
+    header.magic     = RELAY_RECORD_MAGIC;
+    header.version   = RELAY_RECORD_VERSION;
+    header.pid       = GetCurrentProcessId();
+    header.ptr_size  = sizeof(void *);
+    header.frequency = frequency.QuadPart;
+    write_record( &header, sizeof(header) );
+}
+
+/***********************************************************************
+ *           record_module
+ *
+ * Write the description of a relayed dll to the record file.
+ */
+static void record_module( struct relay_private_data *data, unsigned int count )
+{
+    struct relay_record_module *module;
+    unsigned int i;
+    DWORD size = sizeof(*module);
+    char *p;
+
+    for (i = 0; i < count; i++)
+        size += (data->entry_points[i].name ? strlen( data->entry_points[i].name ) : 0) + 1;
+    size = (size + 7) & ~7;
+    if (!(module = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, size ))) return;
+
+    data->record_id = InterlockedIncrement( &relay_record_modules );
+    module->hdr.type = RELAY_RECORD_MODULE;
+    module->hdr.size = size;
+    module->id = data->record_id;
+    module->base = data->base;
+    module->count = count;
+    memcpy( module->name, data->dllname, sizeof(module->name) );
+    for (i = 0, p = (char *)(module + 1); i < count; i++)
+    {
+        if (data->entry_points[i].name) strcpy( p, data->entry_points[i].name );
+        p += strlen( p ) + 1;
+    }
+    write_record( module, size );
+    RtlFreeHeap( GetProcessHeap(), 0, module );
+}
+
+static struct relay_thread_record *get_thread_record(void)
+{
+    struct relay_thread_record *record = NtCurrentTeb()->ReservedForPerf;
+
+    if (!record && (record = RtlAllocateHeap( GetProcessHeap(), 0,
+                                              offsetof( struct relay_thread_record,
+                                                        calls.calls[RELAY_RECORD_CALLS] ))))
+    {
+        record->depth = 0;
+        record->calls.hdr.type = RELAY_RECORD_CALLS;
+        record->calls.tid = HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+        record->calls.count = 0;
+        NtCurrentTeb()->ReservedForPerf = record;
+    }
+    return record;
+}
+
+static void flush_thread_record( struct relay_thread_record *record )
+{
+    if (!record->calls.count) return;
+    record->calls.hdr.size = offsetof( struct relay_record_calls, calls[record->calls.count] );
+    write_record( &record->calls, record->calls.hdr.size );
+    record->calls.count = 0;
+}
+
+/***********************************************************************
+ *           record_call_entry
+ */
+static void record_call_entry( const struct relay_descr *descr, unsigned int idx,
+                               const ULONG_PTR *stack, unsigned int nb_args )
+{
+    struct relay_thread_record *record = get_thread_record();
+    struct relay_record_frame *frame;
+    LARGE_INTEGER now;
+    unsigned int i;
+
+    if (!record) return;
+    if (record->depth++ >= RELAY_RECORD_DEPTH) return;
+
+    frame = &record->frames[record->depth - 1];
+    frame->descr = descr;
+    frame->idx = idx;
+    frame->nb_args = nb_args;
+    for (i = 0; i < RELAY_RECORD_ARGS; i++) frame->args[i] = i < nb_args ? stack[i] : 0;
+    NtQueryPerformanceCounter( &now, NULL );
+    frame->start = now.QuadPart;
+}
+
+/***********************************************************************
+ *           record_call_exit
+ */
+static void record_call_exit( const struct relay_descr *descr, unsigned int idx, LONGLONG retval )
+{
+    struct relay_thread_record *record = NtCurrentTeb()->ReservedForPerf;
+    struct relay_private_data *data = descr->private;
+    struct relay_record_frame *frame;
+    struct relay_record_call *call;
+    LARGE_INTEGER now;
+
+    NtQueryPerformanceCounter( &now, NULL );
+    if (!record || !record->depth) return;
+    if (record->depth > RELAY_RECORD_DEPTH)
+    {
+        record->depth--;
+        return;
+    }
+
+    /* skip the frames of calls that were unwound by an exception */
+    while (record->depth && (record->frames[record->depth - 1].descr != descr ||
+                             record->frames[record->depth - 1].idx != idx))
+        record->depth--;
+    if (!record->depth) return;
+    frame = &record->frames[--record->depth];
+
+    call = &record->calls.calls[record->calls.count++];
+    call->start    = frame->start;
+    call->duration = now.QuadPart - frame->start;
+    memcpy( call->args, frame->args, sizeof(call->args) );
+    call->retval   = retval;
+    call->module   = data->record_id;
+    call->ordinal  = LOWORD(idx);
+    call->nb_args  = frame->nb_args;
+    if (record->calls.count == RELAY_RECORD_CALLS) flush_thread_record( record );
+}
+
+/***********************************************************************
+ *           RELAY_FlushThread
+ *
+ * Write out the calls recorded by the current thread.
+ */
+void RELAY_FlushThread(void)
+{
+    struct relay_thread_record *record = NtCurrentTeb()->ReservedForPerf;
+
+    if (!record) return;
+    flush_thread_record( record );
+    NtCurrentTeb()->ReservedForPerf = NULL;
+    RtlFreeHeap( GetProcessHeap(), 0, record );
+}
+
 static const WCHAR **debug_relay_excludelist;
 static const WCHAR **debug_relay_includelist;
 static const WCHAR **debug_snoop_excludelist;
@@ -190,6 +400,7 @@ static DWORD WINAPI init_debug_lists( RTL_RUN_ONCE *once, void *param, void **co
     debug_from_relay_excludelist = load_list( hkey, L"RelayFromExclude" );
     debug_from_snoop_includelist = load_list( hkey, L"SnoopFromInclude" );
     debug_from_snoop_excludelist = load_list( hkey, L"SnoopFromExclude" );
+    open_record_file( hkey );
 
     NtClose( hkey );
     return TRUE;
@@ -276,6 +487,9 @@ static BOOL check_from_module( const WCHAR **includelist, const WCHAR **excludel
 }
 
 
+/* call details are only traced as text when they aren't being recorded */
+#define TRACE_CALL(...) do { if (!relay_record_file) TRACE( __VA_ARGS__ ); } while (0)
+
 static BOOL is_ret_val( char type )
 {
     return type >= 'A' && type <= 'Z';
@@ -293,14 +507,14 @@ static const char *func_name( struct relay_private_data *data, unsigned int ordi
 
 static void trace_string_a( INT_PTR ptr )
 {
-    if (!IS_INTARG( ptr )) TRACE( "%08Ix %s", ptr, debugstr_a( (char *)ptr ));
-    else TRACE( "%08Ix", ptr );
+    if (!IS_INTARG( ptr )) TRACE_CALL( "%08Ix %s", ptr, debugstr_a( (char *)ptr ));
+    else TRACE_CALL( "%08Ix", ptr );
 }
 
 static void trace_string_w( INT_PTR ptr )
 {
-    if (!IS_INTARG( ptr )) TRACE( "%08Ix %s", ptr, debugstr_w( (WCHAR *)ptr ));
-    else TRACE( "%08Ix", ptr );
+    if (!IS_INTARG( ptr )) TRACE_CALL( "%08Ix %s", ptr, debugstr_w( (WCHAR *)ptr ));
+    else TRACE_CALL( "%08Ix", ptr );
 }
 
 #ifdef __i386__
@@ -317,18 +531,18 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
     struct relay_entry_point *entry_point = data->entry_points + ordinal;
     unsigned int i, pos;
 
-    TRACE( "\1Call %s(", func_name( data, ordinal ));
+    TRACE_CALL( "\1Call %s(", func_name( data, ordinal ));
 
     for (i = pos = 0; !is_ret_val( arg_types[i] ); i++)
     {
         switch (arg_types[i])
         {
         case 'j': /* int64 */
-            TRACE( "%x%08x", stack[pos+1], stack[pos] );
+            TRACE_CALL( "%x%08x", stack[pos+1], stack[pos] );
             pos += 2;
             break;
         case 'k': /* int128 */
-            TRACE( "{%08x,%08x,%08x,%08x}", stack[pos], stack[pos+1], stack[pos+2], stack[pos+3] );
+            TRACE_CALL( "{%08x,%08x,%08x,%08x}", stack[pos], stack[pos+1], stack[pos+2], stack[pos+3] );
             pos += 4;
             break;
         case 's': /* str */
@@ -338,18 +552,18 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
             trace_string_w( stack[pos++] );
             break;
         case 'f': /* float */
-            TRACE( "%g", *(const float *)&stack[pos++] );
+            TRACE_CALL( "%g", *(const float *)&stack[pos++] );
             break;
         case 'd': /* double */
-            TRACE( "%g", *(const double *)&stack[pos] );
+            TRACE_CALL( "%g", *(const double *)&stack[pos] );
             pos += 2;
             break;
         case 'i': /* long */
         default:
-            TRACE( "%08x", stack[pos++] );
+            TRACE_CALL( "%08x", stack[pos++] );
             break;
         }
-        if (!is_ret_val( arg_types[i+1] )) TRACE( "," );
+        if (!is_ret_val( arg_types[i+1] )) TRACE_CALL( "," );
     }
     *nb_args = pos;
     if (arg_types[0] == 't')
@@ -357,7 +571,8 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
         *nb_args |= 0x80000000;  /* thiscall/fastcall */
         if (arg_types[1] == 't') *nb_args |= 0x40000000;  /* fastcall */
     }
-    TRACE( ") ret=%08x\n", stack[-1] );
+    TRACE_CALL( ") ret=%08x\n", stack[-1] );
+    if (relay_record_file) record_call_entry( descr, idx, (const ULONG_PTR *)stack, pos );
     return entry_point->orig_func;
 }
 
@@ -369,6 +584,12 @@ DECLSPEC_HIDDEN void WINAPI relay_trace_exit( struct relay_descr *descr, unsigne
 {
     const char *arg_types = descr->args_string + HIWORD(idx);
 
+    if (relay_record_file)
+    {
+        record_call_exit( descr, idx, retval );
+        return;
+    }
+
     TRACE( "\1Ret  %s()", func_name( descr->private, LOWORD(idx) ));
 
     while (!is_ret_val( *arg_types )) arg_types++;
@@ -454,13 +675,14 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
     const char *arg_types = descr->args_string + HIWORD(idx);
     struct relay_private_data *data = descr->private;
     struct relay_entry_point *entry_point = data->entry_points + ordinal;
+    const DWORD *args = stack;
     unsigned int i, pos;
 #ifndef __SOFTFP__
     unsigned int float_pos = 0, double_pos = 0;
     const union fpregs { float s[16]; double d[8]; } *fpstack = (const union fpregs *)stack - 1;
 #endif
 
-    TRACE( "\1Call %s(", func_name( data, ordinal ));
+    TRACE_CALL( "\1Call %s(", func_name( data, ordinal ));
 
     for (i = pos = 0; !is_ret_val( arg_types[i] ); i++)
     {
@@ -468,11 +690,11 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
         {
         case 'j': /* int64 */
             pos = (pos + 1) & ~1;
-            TRACE( "%x%08x", stack[pos+1], stack[pos] );
+            TRACE_CALL( "%x%08x", stack[pos+1], stack[pos] );
             pos += 2;
             break;
         case 'k': /* int128 */
-            TRACE( "{%08x,%08x,%08x,%08x}", stack[pos], stack[pos+1], stack[pos+2], stack[pos+3] );
+            TRACE_CALL( "{%08x,%08x,%08x,%08x}", stack[pos], stack[pos+1], stack[pos+2], stack[pos+3] );
             pos += 4;
             break;
         case 's': /* str */
@@ -486,31 +708,31 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
             if (!(float_pos % 2)) float_pos = max( float_pos, double_pos * 2 );
             if (float_pos < 16)
             {
-                TRACE( "%g", fpstack->s[float_pos++] );
+                TRACE_CALL( "%g", fpstack->s[float_pos++] );
                 break;
             }
 #endif
-            TRACE( "%g", *(const float *)&stack[pos++] );
+            TRACE_CALL( "%g", *(const float *)&stack[pos++] );
             break;
         case 'd': /* double */
 #ifndef __SOFTFP__
             double_pos = max( (float_pos + 1) / 2, double_pos );
             if (double_pos < 8)
             {
-                TRACE( "%g", fpstack->d[double_pos++] );
+                TRACE_CALL( "%g", fpstack->d[double_pos++] );
                 break;
             }
 #endif
             pos = (pos + 1) & ~1;
-            TRACE( "%g", *(const double *)&stack[pos] );
+            TRACE_CALL( "%g", *(const double *)&stack[pos] );
             pos += 2;
             break;
         case 'i': /* long */
         default:
-            TRACE( "%08x", stack[pos++] );
+            TRACE_CALL( "%08x", stack[pos++] );
             break;
         }
-        if (!is_ret_val( arg_types[i+1] )) TRACE( "," );
+        if (!is_ret_val( arg_types[i+1] )) TRACE_CALL( "," );
     }
 
 #ifndef __SOFTFP__
@@ -521,7 +743,8 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
     }
 #endif
     *nb_args = pos;
-    TRACE( ") ret=%08x\n", stack[-1] );
+    TRACE_CALL( ") ret=%08x\n", stack[-1] );
+    if (relay_record_file) record_call_entry( descr, idx, (const ULONG_PTR *)args, pos & ~0x80000000 );
     return entry_point->orig_func;
 }
 
@@ -533,6 +756,12 @@ DECLSPEC_HIDDEN void WINAPI relay_trace_exit( struct relay_descr *descr, unsigne
 {
     const char *arg_types = descr->args_string + HIWORD(idx);
 
+    if (relay_record_file)
+    {
+        record_call_exit( descr, idx, retval );
+        return;
+    }
+
     TRACE( "\1Ret  %s()", func_name( descr->private, LOWORD(idx) ));
 
     while (!is_ret_val( *arg_types )) arg_types++;
@@ -610,7 +839,7 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
     struct relay_entry_point *entry_point = data->entry_points + ordinal;
     unsigned int i;
 
-    TRACE( "\1Call %s(", func_name( data, ordinal ));
+    TRACE_CALL( "\1Call %s(", func_name( data, ordinal ));
 
     for (i = 0; !is_ret_val( arg_types[i] ); i++)
     {
@@ -624,13 +853,14 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
             break;
         case 'i': /* long */
         default:
-            TRACE( "%08zx", stack[i] );
+            TRACE_CALL( "%08zx", stack[i] );
             break;
         }
-        if (!is_ret_val( arg_types[i + 1] )) TRACE( "," );
+        if (!is_ret_val( arg_types[i + 1] )) TRACE_CALL( "," );
     }
     *nb_args = i;
-    TRACE( ") ret=%08zx\n", stack[-1] );
+    TRACE_CALL( ") ret=%08zx\n", stack[-1] );
+    if (relay_record_file) record_call_entry( descr, idx, (const ULONG_PTR *)stack, i );
     return entry_point->orig_func;
 }
 
@@ -640,6 +870,12 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
 DECLSPEC_HIDDEN void WINAPI relay_trace_exit( struct relay_descr *descr, unsigned int idx,
                                               INT_PTR retaddr, INT_PTR retval )
 {
+    if (relay_record_file)
+    {
+        record_call_exit( descr, idx, retval );
+        return;
+    }
+
     TRACE( "\1Ret  %s() retval=%08zx ret=%08zx\n",
            func_name( descr->private, LOWORD(idx) ), retval, retaddr );
 }
@@ -710,7 +946,7 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
     struct relay_entry_point *entry_point = data->entry_points + ordinal;
     unsigned int i;
 
-    TRACE( "\1Call %s(", func_name( data, ordinal ));
+    TRACE_CALL( "\1Call %s(", func_name( data, ordinal ));
 
     for (i = 0; !is_ret_val( arg_types[i] ); i++)
     {
@@ -723,20 +959,21 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
             trace_string_w( stack[i] );
             break;
         case 'f': /* float */
-            TRACE( "%g", *(const float *)&stack[i] );
+            TRACE_CALL( "%g", *(const float *)&stack[i] );
             break;
         case 'd': /* double */
-            TRACE( "%g", *(const double *)&stack[i] );
+            TRACE_CALL( "%g", *(const double *)&stack[i] );
             break;
         case 'i': /* long */
         default:
-            TRACE( "%08zx", stack[i] );
+            TRACE_CALL( "%08zx", stack[i] );
             break;
         }
-        if (!is_ret_val( arg_types[i+1] )) TRACE( "," );
+        if (!is_ret_val( arg_types[i+1] )) TRACE_CALL( "," );
     }
     *nb_args = i;
-    TRACE( ") ret=%08zx\n", stack[-1] );
+    TRACE_CALL( ") ret=%08zx\n", stack[-1] );
+    if (relay_record_file) record_call_entry( descr, idx, (const ULONG_PTR *)stack, i );
     return entry_point->orig_func;
 }
 
@@ -746,6 +983,12 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
 DECLSPEC_HIDDEN void WINAPI relay_trace_exit( struct relay_descr *descr, unsigned int idx,
                                               INT_PTR retaddr, INT_PTR retval )
 {
+    if (relay_record_file)
+    {
+        record_call_exit( descr, idx, retval );
+        return;
+    }
+
     TRACE( "\1Ret  %s() retval=%08zx ret=%08zx\n",
            func_name( descr->private, LOWORD(idx) ), retval, retaddr );
 }
@@ -910,6 +1153,7 @@ void RELAY_SetupDLL( HMODULE module )
         DWORD name_rva = ((DWORD*)((char *)module + exports->AddressOfNames))[i];
         data->entry_points[*ordptr].name = (const char *)module + name_rva;
     }
+    if (relay_record_file) record_module( data, exports->NumberOfFunctions );
 
     /* patch the functions in the export table to point to the relay thunks */
 
@@ -944,6 +1188,10 @@ void RELAY_SetupDLL( HMODULE module )
 {
 }
 
+void RELAY_FlushThread(void)
+{
+}
+
 #endif  /* __i386__ || __x86_64__ || __arm__ || __aarch64__ */
 
 
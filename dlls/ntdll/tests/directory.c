@@ -329,6 +329,216 @@ static void test_directory_sort( const WCHAR *testdir )
     pRtlFreeUnicodeString( &ntdirname );
 }
 
+static UINT count_directory_entries( const UNICODE_STRING *dirname, FILE_INFORMATION_CLASS class )
+{
+    OBJECT_ATTRIBUTES attr;
+    IO_STATUS_BLOCK io;
+    BYTE data[8192];
+    NTSTATUS status;
+    HANDLE handle;
+    UINT count = 0, pos;
+
+    InitializeObjectAttributes( &attr, (UNICODE_STRING *)dirname, OBJ_CASE_INSENSITIVE, 0, NULL );
+    status = pNtOpenFile( &handle, SYNCHRONIZE | FILE_LIST_DIRECTORY, &attr, &io, FILE_SHARE_READ,
+                          FILE_SYNCHRONOUS_IO_NONALERT | FILE_OPEN_FOR_BACKUP_INTENT | FILE_DIRECTORY_FILE );
+    ok( status == STATUS_SUCCESS, "failed to open dir, status %x\n", status );
+    if (status) return 0;
+
+    for (;;)
+    {
+        status = pNtQueryDirectoryFile( handle, NULL, NULL, NULL, &io, data, sizeof(data),
+                                        class, FALSE, NULL, !count );
+        if (status == STATUS_NO_MORE_FILES) break;
+        ok( status == STATUS_SUCCESS, "failed to query directory; status %x\n", status );
+        if (status) break;
+        for (pos = 0; ; count++)
+        {
+            FILE_DIRECTORY_INFORMATION *info = (FILE_DIRECTORY_INFORMATION *)(data + pos);
+            if (!info->NextEntryOffset) break;
+            pos += info->NextEntryOffset;
+        }
+        count++;
+    }
+    pNtClose( handle );
+    return count;
+}
+
+/* look up an entry with a new handle, and return its short name for FileBothDirectoryInformation */
+static BOOL find_directory_entry( const UNICODE_STRING *dirname, FILE_INFORMATION_CLASS class,
+                                  const WCHAR *name, WCHAR *short_name )
+{
+    OBJECT_ATTRIBUTES attr;
+    IO_STATUS_BLOCK io;
+    BYTE data[8192];
+    NTSTATUS status;
+    HANDLE handle;
+    BOOL found = FALSE, restart = TRUE;
+    UINT pos, len;
+
+    InitializeObjectAttributes( &attr, (UNICODE_STRING *)dirname, OBJ_CASE_INSENSITIVE, 0, NULL );
+    status = pNtOpenFile( &handle, SYNCHRONIZE | FILE_LIST_DIRECTORY, &attr, &io, FILE_SHARE_READ,
+                          FILE_SYNCHRONOUS_IO_NONALERT | FILE_OPEN_FOR_BACKUP_INTENT | FILE_DIRECTORY_FILE );
+    ok( status == STATUS_SUCCESS, "failed to open dir, status %x\n", status );
+    if (status) return FALSE;
+
+    while (!found)
+    {
+        status = pNtQueryDirectoryFile( handle, NULL, NULL, NULL, &io, data, sizeof(data),
+                                        class, FALSE, NULL, restart );
+        restart = FALSE;
+        if (status == STATUS_NO_MORE_FILES) break;
+        ok( status == STATUS_SUCCESS, "failed to query directory; status %x\n", status );
+        if (status) break;
+        for (pos = 0; ; )
+        {
+            if (class == FileBothDirectoryInformation)
+            {
+                FILE_BOTH_DIRECTORY_INFORMATION *info = (FILE_BOTH_DIRECTORY_INFORMATION *)(data + pos);
+                len = info->FileNameLength / sizeof(WCHAR);
+                if (len == lstrlenW( name ) && !memcmp( info->FileName, name, len * sizeof(WCHAR) ))
+                {
+                    memcpy( short_name, info->ShortName, info->ShortNameLength );
+                    short_name[info->ShortNameLength / sizeof(WCHAR)] = 0;
+                    found = TRUE;
+                    break;
+                }
+                if (!info->NextEntryOffset) break;
+                pos += info->NextEntryOffset;
+            }
+            else
+            {
+                FILE_DIRECTORY_INFORMATION *info = (FILE_DIRECTORY_INFORMATION *)(data + pos);
+                len = info->FileNameLength / sizeof(WCHAR);
+                if (len == lstrlenW( name ) && !memcmp( info->FileName, name, len * sizeof(WCHAR) ))
+                {
+                    found = TRUE;
+                    break;
+                }
+                if (!info->NextEntryOffset) break;
+                pos += info->NextEntryOffset;
+            }
+        }
+    }
+    pNtClose( handle );
+    return found;
+}
+
+/* set the directory modification time in the past, so that its listing can be shared */
+static void set_directory_time( const WCHAR *path, DWORD days )
+{
+    LARGE_INTEGER time;
+    FILETIME ft;
+    HANDLE handle;
+    BOOL ret;
+
+    handle = CreateFileW( path, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                          NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL );
+    ok( handle != INVALID_HANDLE_VALUE, "failed to open %s, error %u\n", wine_dbgstr_w(path), GetLastError() );
+    /* January 1st 2010, plus the given number of days */
+    time.QuadPart = 129067776000000000 + days * (LONGLONG)864000000000;
+    ft.dwLowDateTime = time.u.LowPart;
+    ft.dwHighDateTime = time.u.HighPart;
+    ret = SetFileTime( handle, NULL, NULL, &ft );
+    ok( ret, "SetFileTime failed, error %u\n", GetLastError() );
+    CloseHandle( handle );
+}
+
+static void get_test_path( WCHAR *path, const WCHAR *dir, const WCHAR *name )
+{
+    lstrcpyW( path, dir );
+    lstrcatW( path, L"\\" );
+    lstrcatW( path, name );
+}
+
+static void test_repeated_enumeration(void)
+{
+    static const WCHAR *names[] =
+    {
+        L"first long file name.txt", L"second long file name.txt", L"third long file name.txt",
+        L"longnamefile.extension", L"short.txt",
+    };
+    WCHAR testdir[MAX_PATH], path[MAX_PATH], short_names[ARRAY_SIZE(names)][13], short_name[13];
+    UNICODE_STRING ntdirname;
+    UINT i, count;
+    HANDLE file;
+    BOOL ret;
+
+    GetTempPathW( MAX_PATH, testdir );
+    lstrcatW( testdir, L"repenum.tmp" );
+    ret = CreateDirectoryW( testdir, NULL );
+    ok( ret, "CreateDirectory failed, error %u\n", GetLastError() );
+    for (i = 0; i < ARRAY_SIZE(names); i++)
+    {
+        get_test_path( path, testdir, names[i] );
+        file = CreateFileW( path, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, NULL );
+        ok( file != INVALID_HANDLE_VALUE, "failed to create %s, error %u\n", wine_dbgstr_w(path), GetLastError() );
+        CloseHandle( file );
+    }
+    set_directory_time( testdir, 0 );
+
+    if (!pRtlDosPathNameToNtPathName_U( testdir, &ntdirname, NULL, NULL ))
+    {
+        ok(0, "RtlDosPathNametoNtPathName_U failed\n");
+        goto done;
+    }
+
+    /* enumerations through different handles see the same entries */
+    count = count_directory_entries( &ntdirname, FileDirectoryInformation );
+    ok( count == ARRAY_SIZE(names) + 2, "got %u entries\n", count );
+    count = count_directory_entries( &ntdirname, FileBothDirectoryInformation );
+    ok( count == ARRAY_SIZE(names) + 2, "got %u entries\n", count );
+    for (i = 0; i < ARRAY_SIZE(names); i++)
+    {
+        ret = find_directory_entry( &ntdirname, FileBothDirectoryInformation, names[i], short_names[i] );
+        ok( ret, "%s not found\n", wine_dbgstr_w(names[i]) );
+    }
+
+    /* files created or deleted between enumerations show up or disappear */
+    get_test_path( path, testdir, L"new long file name.txt" );
+    file = CreateFileW( path, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, NULL );
+    ok( file != INVALID_HANDLE_VALUE, "failed to create %s, error %u\n", wine_dbgstr_w(path), GetLastError() );
+    CloseHandle( file );
+    count = count_directory_entries( &ntdirname, FileDirectoryInformation );
+    ok( count == ARRAY_SIZE(names) + 3, "got %u entries\n", count );
+    ret = find_directory_entry( &ntdirname, FileBothDirectoryInformation, L"new long file name.txt", short_name );
+    ok( ret, "new file not found\n" );
+
+    ret = DeleteFileW( path );
+    ok( ret, "DeleteFile failed, error %u\n", GetLastError() );
+    count = count_directory_entries( &ntdirname, FileDirectoryInformation );
+    ok( count == ARRAY_SIZE(names) + 2, "got %u entries\n", count );
+    ret = find_directory_entry( &ntdirname, FileDirectoryInformation, L"new long file name.txt", NULL );
+    ok( !ret, "deleted file found\n" );
+
+    get_test_path( path, testdir, names[0] );
+    ret = DeleteFileW( path );
+    ok( ret, "DeleteFile failed, error %u\n", GetLastError() );
+    set_directory_time( testdir, 2 );
+    count = count_directory_entries( &ntdirname, FileDirectoryInformation );
+    ok( count == ARRAY_SIZE(names) + 1, "got %u entries\n", count );
+    ret = find_directory_entry( &ntdirname, FileDirectoryInformation, names[0], NULL );
+    ok( !ret, "deleted file found\n" );
+
+    /* short names computed on demand match the ones from a fresh scan */
+    set_directory_time( testdir, 3 );
+    for (i = 1; i < ARRAY_SIZE(names); i++)
+    {
+        ret = find_directory_entry( &ntdirname, FileBothDirectoryInformation, names[i], short_name );
+        ok( ret, "%s not found\n", wine_dbgstr_w(names[i]) );
+        ok( !lstrcmpW( short_name, short_names[i] ), "%s: got short name %s, expected %s\n",
+            wine_dbgstr_w(names[i]), wine_dbgstr_w(short_name), wine_dbgstr_w(short_names[i]) );
+    }
+
+    pRtlFreeUnicodeString( &ntdirname );
+done:
+    for (i = 0; i < ARRAY_SIZE(names); i++)
+    {
+        get_test_path( path, testdir, names[i] );
+        DeleteFileW( path );
+    }
+    RemoveDirectoryW( testdir );
+}
+
 static void test_NtQueryDirectoryFile_classes( HANDLE handle, UNICODE_STRING *mask )
 {
     IO_STATUS_BLOCK io;
@@ -937,6 +1147,7 @@ START_TEST(directory)
 
     GetSystemDirectoryW( sysdir, MAX_PATH );
     test_directory_sort( sysdir );
+    test_repeated_enumeration();
     test_NtQueryDirectoryFile();
     test_NtQueryDirectoryFile_case();
     test_redirection();
@@ -4939,6 +4939,139 @@ static void test_read_write(void)
     CloseHandle(hfile);
 }
 
+static void test_overlapped_file_io(void)
+{
+    enum { count = 64, block_size = 4096, loops = 16 };
+    char path[MAX_PATH], name[MAX_PATH];
+    OVERLAPPED ovl[count], *povl;
+    HANDLE file, port, events[count];
+    DWORD size, i, j;
+    ULONG_PTR key;
+    char *buffer;
+    BOOL ret;
+
+    GetTempPathA( MAX_PATH, path );
+    GetTempFileNameA( path, "ovl", 0, name );
+    file = CreateFileA( name, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                        FILE_FLAG_OVERLAPPED | FILE_FLAG_DELETE_ON_CLOSE, 0 );
+    ok( file != INVALID_HANDLE_VALUE, "CreateFile failed, error %u\n", GetLastError() );
+    buffer = HeapAlloc( GetProcessHeap(), 0, count * block_size );
+
+    for (i = 0; i < count; i++) events[i] = CreateEventA( NULL, TRUE, TRUE, NULL );
+
+    for (j = 0; j < loops; j++)
+    {
+        for (i = 0; i < count; i++)
+        {
+            memset( buffer + i * block_size, 'a' + (i + j) % 26, block_size );
+            memset( &ovl[i], 0, sizeof(ovl[i]) );
+            ovl[i].Offset = i * block_size;
+            ovl[i].hEvent = events[i];
+            ret = WriteFile( file, buffer + i * block_size, block_size, NULL, &ovl[i] );
+            ok( ret || GetLastError() == ERROR_IO_PENDING, "WriteFile failed, error %u\n", GetLastError() );
+        }
+        for (i = 0; i < count; i++)
+        {
+            ret = GetOverlappedResult( file, &ovl[i], &size, TRUE );
+            ok( ret, "GetOverlappedResult failed, error %u\n", GetLastError() );
+            ok( size == block_size, "got size %u\n", size );
+        }
+
+        memset( buffer, 0, count * block_size );
+        for (i = 0; i < count; i++)
+        {
+            memset( &ovl[i], 0, sizeof(ovl[i]) );
+            ovl[i].Offset = i * block_size;
+            ovl[i].hEvent = events[i];
+            ret = ReadFile( file, buffer + i * block_size, block_size, NULL, &ovl[i] );
+            ok( ret || GetLastError() == ERROR_IO_PENDING, "ReadFile failed, error %u\n", GetLastError() );
+        }
+        for (i = 0; i < count; i++)
+        {
+            ret = GetOverlappedResult( file, &ovl[i], &size, TRUE );
+            ok( ret, "GetOverlappedResult failed, error %u\n", GetLastError() );
+            ok( size == block_size, "got size %u\n", size );
+            ok( buffer[i * block_size] == 'a' + (i + j) % 26 &&
+                buffer[(i + 1) * block_size - 1] == 'a' + (i + j) % 26,
+                "%u: got wrong data %#x\n", i, buffer[i * block_size] );
+        }
+    }
+
+    /* reads past the end of file complete with an error */
+    memset( &ovl[0], 0, sizeof(ovl[0]) );
+    ovl[0].Offset = count * block_size;
+    ovl[0].hEvent = events[0];
+    ret = ReadFile( file, buffer, block_size, NULL, &ovl[0] );
+    if (!ret) ok( GetLastError() == ERROR_IO_PENDING || GetLastError() == ERROR_HANDLE_EOF,
+                  "ReadFile failed, error %u\n", GetLastError() );
+    ret = GetOverlappedResult( file, &ovl[0], &size, TRUE );
+    ok( !ret && GetLastError() == ERROR_HANDLE_EOF, "got ret %d, error %u\n", ret, GetLastError() );
+    ok( !size, "got size %u\n", size );
+
+    /* completions are delivered to the completion port */
+    port = CreateIoCompletionPort( file, NULL, 0xdead, 0 );
+    ok( port != NULL, "CreateIoCompletionPort failed, error %u\n", GetLastError() );
+    for (i = 0; i < count; i++)
+    {
+        memset( &ovl[i], 0, sizeof(ovl[i]) );
+        ovl[i].Offset = i * block_size;
+        ovl[i].hEvent = events[i];
+        ret = ReadFile( file, buffer + i * block_size, block_size, NULL, &ovl[i] );
+        ok( ret || GetLastError() == ERROR_IO_PENDING, "ReadFile failed, error %u\n", GetLastError() );
+    }
+    for (i = 0; i < count; i++)
+    {
+        povl = NULL;
+        ret = GetQueuedCompletionStatus( port, &size, &key, &povl, 1000 );
+        ok( ret, "GetQueuedCompletionStatus failed, error %u\n", GetLastError() );
+        if (!ret) break;
+        ok( key == 0xdead, "got key %#lx\n", key );
+        ok( size == block_size, "got size %u\n", size );
+        ok( povl >= ovl && povl < ovl + count, "got overlapped %p\n", povl );
+    }
+    ret = GetQueuedCompletionStatus( port, &size, &key, &povl, 0 );
+    ok( !ret && GetLastError() == WAIT_TIMEOUT, "got ret %d, error %u\n", ret, GetLastError() );
+
+    /* the completion is still posted when the handle is closed before the request completes */
+    memset( &ovl[0], 0, sizeof(ovl[0]) );
+    ovl[0].hEvent = events[0];
+    ret = ReadFile( file, buffer, count * block_size, NULL, &ovl[0] );
+    ok( ret || GetLastError() == ERROR_IO_PENDING, "ReadFile failed, error %u\n", GetLastError() );
+    CloseHandle( file );
+    povl = NULL;
+    ret = GetQueuedCompletionStatus( port, &size, &key, &povl, 1000 );
+    ok( ret || GetLastError() == ERROR_OPERATION_ABORTED, "GetQueuedCompletionStatus failed, error %u\n",
+        GetLastError() );
+    ok( povl == &ovl[0], "got overlapped %p\n", povl );
+    ok( key == 0xdead, "got key %#lx\n", key );
+
+    for (i = 0; i < count; i++) CloseHandle( events[i] );
+    HeapFree( GetProcessHeap(), 0, buffer );
+    CloseHandle( port );
+}
+
+static void test_overlapped_file_io_uring(void)
+{
+    PROCESS_INFORMATION info;
+    STARTUPINFOA startup;
+    char cmdline[MAX_PATH + 16], **argv;
+    BOOL ret;
+
+    /* run the overlapped tests again with the io_uring backend, which is ignored on Windows */
+    winetest_get_mainargs( &argv );
+    memset( &startup, 0, sizeof(startup) );
+    startup.cb = sizeof(startup);
+    sprintf( cmdline, "%s file uring", argv[0] );
+    SetEnvironmentVariableA( "WINE_IO_URING", "1" );
+    ret = CreateProcessA( NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &info );
+    ok( ret, "CreateProcess failed, error %u\n", GetLastError() );
+    SetEnvironmentVariableA( "WINE_IO_URING", NULL );
+    if (!ret) return;
+    winetest_wait_child_process( info.hProcess );
+    CloseHandle( info.hProcess );
+    CloseHandle( info.hThread );
+}
+
 static void test_ioctl(void)
 {
     HANDLE event = CreateEventA(NULL, TRUE, FALSE, NULL);
@@ -5104,6 +5237,63 @@ static void test_file_readonly_access(void)
     DeleteFileW(path);
 }
 
+static void test_large_directory_lookup(void)
+{
+    static const int count = 200;
+    char dir[MAX_PATH], path[MAX_PATH];
+    DWORD ret;
+    HANDLE handle;
+    int i;
+
+    GetTempPathA( MAX_PATH, dir );
+    strcat( dir, "LargeDirTest" );
+    ret = CreateDirectoryA( dir, NULL );
+    ok( ret, "CreateDirectory failed %u\n", GetLastError() );
+
+    for (i = 0; i < count; i++)
+    {
+        sprintf( path, "%s\\MixedCase_%04d.Txt", dir, i );
+        handle = CreateFileA( path, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, 0 );
+        ok( handle != INVALID_HANDLE_VALUE, "failed to create %s, error %u\n", path, GetLastError() );
+        CloseHandle( handle );
+    }
+
+    /* the directory is large enough to be indexed, look up names in a different case */
+    for (i = 0; i < count; i++)
+    {
+        sprintf( path, "%s\\%s%04d.%s", dir, (i & 1) ? "MIXEDCASE_" : "mixedcase_", i, (i & 2) ? "TXT" : "txt" );
+        ret = GetFileAttributesA( path );
+        ok( ret != INVALID_FILE_ATTRIBUTES, "failed to find %s, error %u\n", path, GetLastError() );
+    }
+
+    /* files added or removed after the first lookups must be noticed */
+    sprintf( path, "%s\\NewFile.Dat", dir );
+    handle = CreateFileA( path, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, 0 );
+    ok( handle != INVALID_HANDLE_VALUE, "failed to create %s, error %u\n", path, GetLastError() );
+    CloseHandle( handle );
+    sprintf( path, "%s\\nEWfILE.dAT", dir );
+    ret = GetFileAttributesA( path );
+    ok( ret != INVALID_FILE_ATTRIBUTES, "failed to find %s, error %u\n", path, GetLastError() );
+
+    sprintf( path, "%s\\MixedCase_0005.Txt", dir );
+    ret = DeleteFileA( path );
+    ok( ret, "failed to delete %s, error %u\n", path, GetLastError() );
+    sprintf( path, "%s\\MIXEDCASE_0005.TXT", dir );
+    ret = GetFileAttributesA( path );
+    ok( ret == INVALID_FILE_ATTRIBUTES, "found deleted file %s\n", path );
+    ok( GetLastError() == ERROR_FILE_NOT_FOUND, "got error %u\n", GetLastError() );
+
+    for (i = 0; i < count; i++)
+    {
+        sprintf( path, "%s\\MixedCase_%04d.Txt", dir, i );
+        DeleteFileA( path );
+    }
+    sprintf( path, "%s\\NewFile.Dat", dir );
+    DeleteFileA( path );
+    ret = RemoveDirectoryA( dir );
+    ok( ret, "RemoveDirectory failed %u\n", GetLastError() );
+}
+
 static void test_mailslot_name(void)
 {
     char buffer[1024] = {0};
@@ -5556,6 +5746,8 @@ START_TEST(file)
 {
     HMODULE hkernel32 = GetModuleHandleA("kernel32.dll");
     HMODULE hntdll = GetModuleHandleA("ntdll.dll");
+    char **argv;
+    int argc;
     if (!hntdll)
     {
         skip("not running on NT, skipping test\n");
@@ -5593,6 +5785,13 @@ START_TEST(file)
     pNtQueryFullAttributesFile = (void *)GetProcAddress(hntdll, "NtQueryFullAttributesFile");
     pNtFlushBuffersFile = (void *)GetProcAddress(hntdll, "NtFlushBuffersFile");
 
+    argc = winetest_get_mainargs( &argv );
+    if (argc >= 3 && !strcmp( argv[2], "uring" ))
+    {
+        test_overlapped_file_io();
+        return;
+    }
+
     test_read_write();
     test_NtCreateFile();
     test_readonly();
@@ -5621,8 +5820,11 @@ START_TEST(file)
     test_file_readonly_access();
     test_query_volume_information_file();
     test_query_attribute_information_file();
+    test_overlapped_file_io();
+    test_overlapped_file_io_uring();
     test_ioctl();
     test_flush_buffers_file();
     test_reparse_points();
     test_mailslot_name();
+    test_large_directory_lookup();
 }
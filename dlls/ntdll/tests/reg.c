@@ -842,6 +842,86 @@ static void test_NtQueryValueKey(void)
     pNtClose(key);
 }
 
+static void test_NtQueryValueKey_cache(void)
+{
+    static const WCHAR subkeyW[] = {'c','a','c','h','e','s','u','b',0};
+    HANDLE key, key2, subkey;
+    NTSTATUS status;
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING ValName, str;
+    KEY_VALUE_PARTIAL_INFORMATION pi;
+    DWORD len, data, i;
+
+    pRtlCreateUnicodeStringFromAsciiz(&ValName, "cachetest");
+
+    InitializeObjectAttributes(&attr, &winetestpath, 0, 0, 0);
+    status = pNtOpenKey(&key, KEY_READ|KEY_SET_VALUE, &attr);
+    ok(status == STATUS_SUCCESS, "NtOpenKey Failed: 0x%08x\n", status);
+    status = pNtOpenKey(&key2, KEY_READ|KEY_SET_VALUE, &attr);
+    ok(status == STATUS_SUCCESS, "NtOpenKey Failed: 0x%08x\n", status);
+
+    data = 1;
+    status = pNtSetValueKey(key, &ValName, 0, REG_DWORD, &data, sizeof(data));
+    ok(status == STATUS_SUCCESS, "NtSetValueKey Failed: 0x%08x\n", status);
+
+    /* the second query can be answered from the cache */
+    for (i = 0; i < 2; i++)
+    {
+        status = pNtQueryValueKey(key, &ValName, KeyValuePartialInformation, &pi, sizeof(pi), &len);
+        ok(status == STATUS_SUCCESS, "%u: NtQueryValueKey Failed: 0x%08x\n", i, status);
+        ok(*(DWORD *)pi.Data == 1, "%u: got %u\n", i, *(DWORD *)pi.Data);
+    }
+
+    /* changes made through another handle are visible */
+    data = 2;
+    status = pNtSetValueKey(key2, &ValName, 0, REG_DWORD, &data, sizeof(data));
+    ok(status == STATUS_SUCCESS, "NtSetValueKey Failed: 0x%08x\n", status);
+    status = pNtQueryValueKey(key, &ValName, KeyValuePartialInformation, &pi, sizeof(pi), &len);
+    ok(status == STATUS_SUCCESS, "NtQueryValueKey Failed: 0x%08x\n", status);
+    ok(*(DWORD *)pi.Data == 2, "got %u\n", *(DWORD *)pi.Data);
+
+    status = pNtDeleteValueKey(key2, &ValName);
+    ok(status == STATUS_SUCCESS, "NtDeleteValueKey Failed: 0x%08x\n", status);
+    for (i = 0; i < 2; i++)
+    {
+        status = pNtQueryValueKey(key, &ValName, KeyValuePartialInformation, &pi, sizeof(pi), &len);
+        ok(status == STATUS_OBJECT_NAME_NOT_FOUND, "%u: NtQueryValueKey returned 0x%08x\n", i, status);
+    }
+
+    data = 3;
+    status = pNtSetValueKey(key2, &ValName, 0, REG_DWORD, &data, sizeof(data));
+    ok(status == STATUS_SUCCESS, "NtSetValueKey Failed: 0x%08x\n", status);
+    status = pNtQueryValueKey(key, &ValName, KeyValuePartialInformation, &pi, sizeof(pi), &len);
+    ok(status == STATUS_SUCCESS, "NtQueryValueKey Failed: 0x%08x\n", status);
+    ok(*(DWORD *)pi.Data == 3, "got %u\n", *(DWORD *)pi.Data);
+
+    /* the handle value may be reused for another key */
+    pNtClose(key);
+    pRtlInitUnicodeString(&str, subkeyW);
+    InitializeObjectAttributes(&attr, &str, 0, key2, 0);
+    status = pNtCreateKey(&subkey, KEY_ALL_ACCESS, &attr, 0, 0, 0, 0);
+    ok(status == STATUS_SUCCESS, "NtCreateKey Failed: 0x%08x\n", status);
+    status = pNtQueryValueKey(subkey, &ValName, KeyValuePartialInformation, &pi, sizeof(pi), &len);
+    ok(status == STATUS_OBJECT_NAME_NOT_FOUND, "NtQueryValueKey returned 0x%08x\n", status);
+
+    /* deleted keys can't be queried anymore */
+    data = 4;
+    status = pNtSetValueKey(subkey, &ValName, 0, REG_DWORD, &data, sizeof(data));
+    ok(status == STATUS_SUCCESS, "NtSetValueKey Failed: 0x%08x\n", status);
+    status = pNtQueryValueKey(subkey, &ValName, KeyValuePartialInformation, &pi, sizeof(pi), &len);
+    ok(status == STATUS_SUCCESS, "NtQueryValueKey Failed: 0x%08x\n", status);
+    status = pNtDeleteKey(subkey);
+    ok(status == STATUS_SUCCESS, "NtDeleteKey Failed: 0x%08x\n", status);
+    status = pNtQueryValueKey(subkey, &ValName, KeyValuePartialInformation, &pi, sizeof(pi), &len);
+    ok(status == STATUS_KEY_DELETED, "NtQueryValueKey returned 0x%08x\n", status);
+    pNtClose(subkey);
+
+    status = pNtDeleteValueKey(key2, &ValName);
+    ok(status == STATUS_SUCCESS, "NtDeleteValueKey Failed: 0x%08x\n", status);
+    pNtClose(key2);
+    pRtlFreeUnicodeString(&ValName);
+}
+
 static void test_NtDeleteKey(void)
 {
     NTSTATUS status;
@@ -2072,6 +2152,7 @@ START_TEST(reg)
     test_NtQueryKey();
     test_NtQueryLicenseKey();
     test_NtQueryValueKey();
+    test_NtQueryValueKey_cache();
     test_long_value_name();
     test_notify();
     test_RtlCreateRegistryKey();
@@ -843,6 +843,69 @@ static void CALLBACK wait_release_cb(TP_CALLBACK_INSTANCE *instance, void *userd
     pTpReleaseWait(wait);
 }
 
+static void CALLBACK many_work_items_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
+{
+    InterlockedIncrement((LONG *)userdata);
+}
+
+static void test_tp_many_work_items(void)
+{
+    static const int count = 10000, nb_works = 100;
+    TP_CALLBACK_ENVIRON environment;
+    TP_CLEANUP_GROUP *group;
+    TP_WORK *work, *works[100];
+    TP_POOL *pool;
+    NTSTATUS status;
+    LONG userdata;
+    int i;
+
+    pool = NULL;
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %x\n", status);
+    ok(pool != NULL, "expected pool != NULL\n");
+
+    group = NULL;
+    status = pTpAllocCleanupGroup(&group);
+    ok(!status, "TpAllocCleanupGroup failed with status %x\n", status);
+    ok(group != NULL, "expected group != NULL\n");
+
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+    environment.CleanupGroup = group;
+
+    /* post many tiny work items on the same object */
+    work = NULL;
+    status = pTpAllocWork(&work, many_work_items_cb, &userdata, &environment);
+    ok(!status, "TpAllocWork failed with status %x\n", status);
+    ok(work != NULL, "expected work != NULL\n");
+
+    userdata = 0;
+    for (i = 0; i < count; i++)
+        pTpPostWork(work);
+    pTpWaitForWork(work, FALSE);
+    ok(userdata == count, "expected userdata = %u, got %u\n", count, userdata);
+
+    /* spread them over many objects, and wait for them through the cleanup group */
+    for (i = 0; i < nb_works; i++)
+    {
+        works[i] = NULL;
+        status = pTpAllocWork(&works[i], many_work_items_cb, &userdata, &environment);
+        ok(!status, "TpAllocWork failed with status %x\n", status);
+        ok(works[i] != NULL, "expected works[%u] != NULL\n", i);
+    }
+
+    userdata = 0;
+    for (i = 0; i < count; i++)
+        pTpPostWork(works[i % nb_works]);
+    pTpReleaseCleanupGroupMembers(group, FALSE, NULL);
+    ok(userdata == count, "expected userdata = %u, got %u\n", count, userdata);
+
+    /* cleanup */
+    pTpReleaseCleanupGroup(group);
+    pTpReleasePool(pool);
+}
+
 static void test_tp_group_wait(void)
 {
     TP_CALLBACK_ENVIRON environment;
@@ -1606,6 +1669,84 @@ static void test_tp_window_length(void)
     CloseHandle(semaphore);
 }
 
+static void test_tp_many_timers(void)
+{
+    TP_CALLBACK_ENVIRON environment;
+    TP_TIMER **timers;
+    LARGE_INTEGER when;
+    HANDLE semaphore;
+    NTSTATUS status;
+    TP_POOL *pool;
+    DWORD result;
+    int i, count = 1000;
+
+    semaphore = CreateSemaphoreA(NULL, 0, 10, NULL);
+    ok(semaphore != NULL, "CreateSemaphoreA failed %u\n", GetLastError());
+
+    /* allocate new threadpool */
+    pool = NULL;
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %x\n", status);
+    ok(pool != NULL, "expected pool != NULL\n");
+
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+
+    timers = HeapAlloc(GetProcessHeap(), 0, count * sizeof(*timers));
+    for (i = 0; i < count; i++)
+    {
+        timers[i] = NULL;
+        status = pTpAllocTimer(&timers[i], timer_cb, semaphore, &environment);
+        if (status) break;
+    }
+    ok(!status, "TpAllocTimer failed with status %x\n", status);
+    if (status) count = i;
+
+    /* arm all timers with timeouts between one minute and about twenty minutes */
+    for (i = 0; i < count; i++)
+    {
+        when.QuadPart = (LONGLONG)(i + 60) * -10000000;
+        pTpSetTimer(timers[i], &when, 0, (i & 1) ? 1000 : 0);
+    }
+    for (i = 0; i < count; i++)
+        if (!pTpIsTimerSet(timers[i])) break;
+    ok(i == count, "timer %u is not set\n", i);
+
+    /* cancel them again */
+    for (i = 0; i < count; i++)
+        pTpSetTimer(timers[i], NULL, 0, 0);
+    for (i = 0; i < count; i++)
+        if (pTpIsTimerSet(timers[i])) break;
+    ok(i == count, "timer %u is still set\n", i);
+
+    /* short timeouts still have to fire among many pending timers */
+    for (i = 10; i < count; i++)
+    {
+        when.QuadPart = (LONGLONG)(i + 60) * -10000000;
+        pTpSetTimer(timers[i], &when, 0, 0);
+    }
+    for (i = 0; i < 10; i++)
+    {
+        when.QuadPart = (LONGLONG)(i + 1) * -200000;
+        pTpSetTimer(timers[i], &when, 0, 0);
+    }
+    for (i = 0; i < 10; i++)
+    {
+        result = WaitForSingleObject(semaphore, 1000);
+        ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    }
+    result = WaitForSingleObject(semaphore, 50);
+    ok(result == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", result);
+
+    /* cleanup */
+    for (i = 0; i < count; i++)
+        pTpReleaseTimer(timers[i]);
+    HeapFree(GetProcessHeap(), 0, timers);
+    pTpReleasePool(pool);
+    CloseHandle(semaphore);
+}
+
 struct wait_info
 {
     HANDLE semaphore;
@@ -2370,12 +2511,14 @@ START_TEST(threadpool)
     test_tp_simple();
     test_tp_work();
     test_tp_work_scheduler();
+    test_tp_many_work_items();
     test_tp_group_wait();
     test_tp_group_cancel();
     test_tp_instance();
     test_tp_disassociate();
     test_tp_timer();
     test_tp_window_length();
+    test_tp_many_timers();
     test_tp_wait();
     test_tp_multi_wait();
     test_tp_io();
@@ -753,6 +753,159 @@ static void test_syscalls(void)
     UnmapViewOfFile( ptr );
 }
 
+static void test_large_pages(void)
+{
+    SIZE_T (WINAPI *pGetLargePageMinimum)(void);
+    SIZE_T large_page_size, size;
+    NTSTATUS status;
+    void *addr;
+
+    pGetLargePageMinimum = (void *)GetProcAddress( GetModuleHandleA("kernel32.dll"), "GetLargePageMinimum" );
+    if (!pGetLargePageMinimum || !(large_page_size = pGetLargePageMinimum()))
+    {
+        win_skip( "large pages not supported\n" );
+        return;
+    }
+
+    addr = NULL;
+    size = large_page_size + page_size;
+    status = NtAllocateVirtualMemory( NtCurrentProcess(), &addr, 0, &size,
+                                      MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE );
+    if (status == STATUS_PRIVILEGE_NOT_HELD)
+    {
+        skip( "large pages require SeLockMemoryPrivilege\n" );
+        return;
+    }
+    ok( status == STATUS_INVALID_PARAMETER, "unexpected status %08x\n", status );
+
+    addr = NULL;
+    size = large_page_size;
+    status = NtAllocateVirtualMemory( NtCurrentProcess(), &addr, 0, &size,
+                                      MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE );
+    ok( status == STATUS_INVALID_PARAMETER, "unexpected status %08x\n", status );
+
+    addr = NULL;
+    size = 2 * large_page_size;
+    status = NtAllocateVirtualMemory( NtCurrentProcess(), &addr, 0, &size,
+                                      MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE );
+    if (status == STATUS_NO_MEMORY)
+    {
+        skip( "no large pages available\n" );
+        return;
+    }
+    ok( !status, "NtAllocateVirtualMemory failed %08x\n", status );
+    ok( !((UINT_PTR)addr & (large_page_size - 1)), "address %p is not aligned\n", addr );
+    ok( size == 2 * large_page_size, "got size %#lx\n", size );
+
+    memset( addr, 0x55, size );
+    ok( ((char *)addr)[size - 1] == 0x55, "memory not writable\n" );
+
+    size = 0;
+    status = NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
+    ok( !status, "NtFreeVirtualMemory failed %08x\n", status );
+}
+
+#define CONTENTION_THREADS 4
+#define CONTENTION_LOOPS   20000
+
+static LONG contention_errors;
+
+static DWORD WINAPI contention_thread( void *arg )
+{
+    MEMORY_BASIC_INFORMATION info;
+    void *addr = NULL, *base;
+    SIZE_T size = 16 * page_size, prot_size;
+    ULONG old_prot, prot;
+    NTSTATUS status;
+    unsigned int i;
+
+    status = NtAllocateVirtualMemory( NtCurrentProcess(), &addr, 0, &size, MEM_COMMIT, PAGE_READWRITE );
+    if (status) return InterlockedIncrement( &contention_errors );
+
+    for (i = 0; i < CONTENTION_LOOPS; i++)
+    {
+        prot = (i & 1) ? PAGE_READONLY : PAGE_READWRITE;
+        if (!(i % 16))
+        {
+            base = (char *)addr + (i / 16 % 16) * page_size;
+            prot_size = page_size;
+            status = NtProtectVirtualMemory( NtCurrentProcess(), &base, &prot_size, prot, &old_prot );
+            if (status) InterlockedIncrement( &contention_errors );
+        }
+        status = NtQueryVirtualMemory( NtCurrentProcess(), (char *)addr + (i % 16) * page_size,
+                                       MemoryBasicInformation, &info, sizeof(info), NULL );
+        if (status || info.AllocationBase != addr || info.State != MEM_COMMIT ||
+            (info.Protect != PAGE_READONLY && info.Protect != PAGE_READWRITE))
+            InterlockedIncrement( &contention_errors );
+    }
+
+    size = 0;
+    NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
+    return 0;
+}
+
+static void test_query_contention(void)
+{
+    HANDLE threads[CONTENTION_THREADS];
+    unsigned int i;
+
+    for (i = 0; i < CONTENTION_THREADS; i++)
+    {
+        threads[i] = CreateThread( NULL, 0, contention_thread, NULL, 0, NULL );
+        ok( threads[i] != NULL, "CreateThread failed %u\n", GetLastError() );
+    }
+    WaitForMultipleObjects( CONTENTION_THREADS, threads, TRUE, INFINITE );
+    for (i = 0; i < CONTENTION_THREADS; i++) CloseHandle( threads[i] );
+
+    ok( !contention_errors, "got %u errors\n", contention_errors );
+}
+
+static void test_write_watch_scan(void)
+{
+    static const SIZE_T pages = 4096;
+    void *addresses[64];
+    ULONG_PTR count;
+    ULONG granularity;
+    SIZE_T size = pages * page_size;
+    NTSTATUS status;
+    void *addr = NULL;
+    char *ptr;
+    unsigned int i, j;
+
+    status = NtAllocateVirtualMemory( NtCurrentProcess(), &addr, 0, &size,
+                                      MEM_RESERVE | MEM_COMMIT | MEM_WRITE_WATCH, PAGE_READWRITE );
+    ok( !status, "NtAllocateVirtualMemory failed %x\n", status );
+    if (status) return;
+    ptr = addr;
+
+    count = ARRAY_SIZE(addresses);
+    status = NtGetWriteWatch( NtCurrentProcess(), 0, addr, size, addresses, &count, &granularity );
+    ok( !status, "NtGetWriteWatch failed %x\n", status );
+    ok( !count, "got %lu pages\n", count );
+
+    for (i = 0; i < 200; i++)
+    {
+        /* write to a few scattered pages, as a garbage collector's mutator would */
+        for (j = 0; j < 16; j++) ptr[((i * 37 + j * 251) % pages) * page_size + j] = i;
+
+        count = ARRAY_SIZE(addresses);
+        status = NtGetWriteWatch( NtCurrentProcess(), WRITE_WATCH_FLAG_RESET, addr, size,
+                                  addresses, &count, &granularity );
+        ok( !status, "NtGetWriteWatch failed %x\n", status );
+        ok( count == 16, "%u: got %lu pages\n", i, count );
+        ok( granularity == page_size, "got granularity %u\n", granularity );
+        if (count != 16) break;
+    }
+
+    count = ARRAY_SIZE(addresses);
+    status = NtGetWriteWatch( NtCurrentProcess(), 0, addr, size, addresses, &count, &granularity );
+    ok( !status, "NtGetWriteWatch failed %x\n", status );
+    ok( !count, "got %lu pages\n", count );
+
+    size = 0;
+    NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
+}
+
 START_TEST(virtual)
 {
     HMODULE mod;
@@ -789,4 +942,7 @@ START_TEST(virtual)
     test_NtMapViewOfSection();
     test_user_shared_data();
     test_syscalls();
+    test_query_contention();
+    test_large_pages();
+    test_write_watch_scan();
 }
@@ -30,6 +30,7 @@
 
 #include "wine/debug.h"
 #include "wine/list.h"
+#include "wine/timer_wheel.h"
 
 #include "ntdll_misc.h"
 
@@ -73,6 +74,7 @@ struct queue_timer
 {
     struct timer_queue *q;
     struct list entry;
+    struct wine_timer_wheel_entry wheel_entry;
     ULONG runcount;             /* number of callbacks pending execution */
     RTL_WAITORTIMERCALLBACKFUNC callback;
     PVOID param;
@@ -87,7 +89,9 @@ struct timer_queue
 {
     DWORD magic;
     RTL_CRITICAL_SECTION cs;
-    struct list timers;         /* sorted by expiration time */
+    struct list timers;         /* all timers of the queue */
+    struct wine_timer_wheel wheel; /* timers that have not expired yet */
+    ULONGLONG next_expire;      /* time the queue thread wakes up at */
     BOOL quit;                  /* queue should be deleted; once set, never unset */
     HANDLE event;
     HANDLE thread;
@@ -98,6 +102,7 @@ struct timer_queue
  */
 
 #define THREADPOOL_WORKER_TIMEOUT 5000
+#define THREADPOOL_WORKER_SPIN_COUNT 1000
 #define MAXIMUM_WAITQUEUE_OBJECTS (MAXIMUM_WAIT_OBJECTS - 1)
 
 /* internal threadpool representation */
@@ -110,6 +115,9 @@ struct threadpool
     /* Pools of work items, locked via .cs, order matches TP_CALLBACK_PRIORITY - high, normal, low. */
     struct list             pools[3];
     RTL_CONDITION_VARIABLE  update_event;
+    /* Objects submitted without holding .cs, linked via .submitted_next */
+    struct threadpool_object *submitted;
+    LONG                    num_spinning_workers;
     /* information about worker threads, locked via .cs */
     int                     max_workers;
     int                     min_workers;
@@ -161,6 +169,9 @@ struct threadpool_object
     LONG                    num_pending_callbacks;
     LONG                    num_running_callbacks;
     LONG                    num_associated_callbacks;
+    /* submissions not yet moved to the pool, modified with interlocked operations */
+    struct threadpool_object *submitted_next;
+    LONG                    num_submitted_callbacks;
     /* arguments for callback */
     union
     {
@@ -178,7 +189,7 @@ struct threadpool_object
             /* information about the timer, locked via timerqueue.cs */
             BOOL            timer_initialized;
             BOOL            timer_pending;
-            struct list     timer_entry;
+            struct wine_timer_wheel_entry timer_entry;
             BOOL            timer_set;
             ULONGLONG       timeout;
             LONG            period;
@@ -244,15 +255,17 @@ static struct
     CRITICAL_SECTION        cs;
     LONG                    objcount;
     BOOL                    thread_running;
-    struct list             pending_timers;
+    ULONGLONG               next_timeout;
     RTL_CONDITION_VARIABLE  update_event;
+    /* pending timers, initialized when the thread is started */
+    struct wine_timer_wheel pending_timers;
 }
 timerqueue =
 {
     { &timerqueue_debug, -1, 0, 0, 0, 0 },      /* cs */
     0,                                          /* objcount */
     FALSE,                                      /* thread_running */
-    LIST_INIT( timerqueue.pending_timers ),     /* pending_timers */
+    MAXLONGLONG,                                /* next_timeout */
     RTL_CONDITION_VARIABLE_INIT                 /* update_event */
 };
 
@@ -559,6 +572,8 @@ static void queue_remove_timer(struct queue_timer *t)
     assert(t->runcount == 0);
     assert(t->destroy);
 
+    if (t->expire != EXPIRE_NEVER)
+        wine_timer_wheel_remove(&q->wheel, &t->wheel_entry);
     list_remove(&t->entry);
     if (t->event)
         NtSetEvent(t->event, NULL);
@@ -602,24 +617,17 @@ static void queue_add_timer(struct queue_timer *t, ULONGLONG time,
 {
     /* We MUST hold the queue cs while calling this function.  */
     struct timer_queue *q = t->q;
-    struct list *ptr = &q->timers;
 
     assert(!q->quit || (t->destroy && time == EXPIRE_NEVER));
 
     if (time != EXPIRE_NEVER)
-        LIST_FOR_EACH(ptr, &q->timers)
-        {
-            struct queue_timer *cur = LIST_ENTRY(ptr, struct queue_timer, entry);
-            if (time < cur->expire)
-                break;
-        }
-    list_add_before(ptr, &t->entry);
+        wine_timer_wheel_add(&q->wheel, &t->wheel_entry, time, time);
 
     t->expire = time;
 
-    /* If we insert at the head of the list, we need to expire sooner
-       than expected.  */
-    if (set_event && &t->entry == list_head(&q->timers))
+    /* If the timer expires before the queue thread wakes up, we need to
+       expire sooner than expected.  */
+    if (set_event && time < q->next_expire)
         NtSetEvent(q->event, NULL);
 }
 
@@ -627,35 +635,34 @@ static inline void queue_move_timer(struct queue_timer *t, ULONGLONG time,
                                     BOOL set_event)
 {
     /* We MUST hold the queue cs while calling this function.  */
-    list_remove(&t->entry);
+    if (t->expire != EXPIRE_NEVER)
+        wine_timer_wheel_remove(&t->q->wheel, &t->wheel_entry);
     queue_add_timer(t, time, set_event);
 }
 
 static void queue_timer_expire(struct timer_queue *q)
 {
+    struct wine_timer_wheel_entry *entry;
     struct queue_timer *t = NULL;
+    ULONGLONG now, next;
 
     RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
+    if ((entry = wine_timer_wheel_pop(&q->wheel, (now = queue_current_time()))))
     {
-        ULONGLONG now, next;
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
-        if (!t->destroy && t->expire <= ((now = queue_current_time())))
+        t = WINE_TIMER_WHEEL_ENTRY_VALUE(entry, struct queue_timer, wheel_entry);
+        assert(!t->destroy);
+        ++t->runcount;
+        if (t->period)
         {
-            ++t->runcount;
-            if (t->period)
-            {
-                next = t->expire + t->period;
-                /* avoid trigger cascade if overloaded / hibernated */
-                if (next < now)
-                    next = now + t->period;
-            }
-            else
-                next = EXPIRE_NEVER;
-            queue_move_timer(t, next, FALSE);
+            next = t->expire + t->period;
+            /* avoid trigger cascade if overloaded / hibernated */
+            if (next < now)
+                next = now + t->period;
         }
         else
-            t = NULL;
+            next = EXPIRE_NEVER;
+        /* The timer was removed from the wheel already.  */
+        queue_add_timer(t, next, FALSE);
     }
     RtlLeaveCriticalSection(&q->cs);
 
@@ -678,21 +685,16 @@ static void queue_timer_expire(struct timer_queue *q)
 
 static ULONG queue_get_timeout(struct timer_queue *q)
 {
-    struct queue_timer *t;
     ULONG timeout = INFINITE;
 
     RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
+    if (wine_timer_wheel_next(&q->wheel, &q->next_expire))
     {
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
-        assert(!t->destroy || t->expire == EXPIRE_NEVER);
-
-        if (t->expire != EXPIRE_NEVER)
-        {
-            ULONGLONG time = queue_current_time();
-            timeout = t->expire < time ? 0 : t->expire - time;
-        }
+        ULONGLONG time = queue_current_time();
+        timeout = q->next_expire < time ? 0 : q->next_expire - time;
     }
+    else
+        q->next_expire = EXPIRE_NEVER;
     RtlLeaveCriticalSection(&q->cs);
 
     return timeout;
@@ -750,8 +752,7 @@ static void queue_destroy_timer(struct queue_timer *t)
            cleanup wrapper.  */
         queue_remove_timer(t);
     else
-        /* Make sure no destroyed timer masks an active timer at the head
-           of the sorted list.  */
+        /* Make sure a destroyed timer doesn't expire anymore.  */
         queue_move_timer(t, EXPIRE_NEVER, FALSE);
 }
 
@@ -776,6 +777,8 @@ NTSTATUS WINAPI RtlCreateTimerQueue(PHANDLE NewTimerQueue)
 
     RtlInitializeCriticalSection(&q->cs);
     list_init(&q->timers);
+    wine_timer_wheel_init(&q->wheel, 0, queue_current_time());
+    q->next_expire = EXPIRE_NEVER;
     q->quit = FALSE;
     q->magic = TIMER_QUEUE_MAGIC;
     status = NtCreateEvent(&q->event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
@@ -936,7 +939,10 @@ NTSTATUS WINAPI RtlCreateTimer(PHANDLE NewTimer, HANDLE TimerQueue,
     if (q->quit)
         status = STATUS_INVALID_HANDLE;
     else
+    {
+        list_add_tail(&q->timers, &t->entry);
         queue_add_timer(t, queue_current_time() + DueTime, TRUE);
+    }
     RtlLeaveCriticalSection(&q->cs);
 
     if (status == STATUS_SUCCESS)
@@ -1041,15 +1047,26 @@ NTSTATUS WINAPI RtlDeleteTimer(HANDLE TimerQueue, HANDLE Timer,
     return status;
 }
 
+/***********************************************************************
+ *           tp_timerqueue_add    (internal)
+ *
+ * Inserts a timer into the pending timers, timerqueue.cs has to be held.
+ */
+static void tp_timerqueue_add( struct threadpool_object *timer )
+{
+    wine_timer_wheel_add( &timerqueue.pending_timers, &timer->u.timer.timer_entry, timer->u.timer.timeout,
+                          timer->u.timer.timeout + (ULONGLONG)timer->u.timer.window_length * 10000 );
+    timer->u.timer.timer_pending = TRUE;
+}
+
 /***********************************************************************
  *           timerqueue_thread_proc    (internal)
  */
 static void CALLBACK timerqueue_thread_proc( void *param )
 {
-    ULONGLONG timeout_lower, timeout_upper, new_timeout;
-    struct threadpool_object *other_timer;
+    struct wine_timer_wheel_entry *entry;
     LARGE_INTEGER now, timeout;
-    struct list *ptr;
+    ULONGLONG timeout_lower;
 
     TRACE( "starting timer queue thread\n" );
 
@@ -1059,16 +1076,14 @@ static void CALLBACK timerqueue_thread_proc( void *param )
         NtQuerySystemTime( &now );
 
         /* Check for expired timers. */
-        while ((ptr = list_head( &timerqueue.pending_timers )))
+        while ((entry = wine_timer_wheel_pop( &timerqueue.pending_timers, now.QuadPart )))
         {
-            struct threadpool_object *timer = LIST_ENTRY( ptr, struct threadpool_object, u.timer.timer_entry );
+            struct threadpool_object *timer = WINE_TIMER_WHEEL_ENTRY_VALUE( entry, struct threadpool_object,
+                                                                            u.timer.timer_entry );
             assert( timer->type == TP_OBJECT_TYPE_TIMER );
             assert( timer->u.timer.timer_pending );
-            if (timer->u.timer.timeout > now.QuadPart)
-                break;
 
             /* Queue a new callback in one of the worker threads. */
-            list_remove( &timer->u.timer.timer_entry );
             timer->u.timer.timer_pending = FALSE;
             tp_object_submit( timer, FALSE );
 
@@ -1079,33 +1094,14 @@ static void CALLBACK timerqueue_thread_proc( void *param )
                 if (timer->u.timer.timeout <= now.QuadPart)
                     timer->u.timer.timeout = now.QuadPart + 1;
 
-                LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                                     struct threadpool_object, u.timer.timer_entry )
-                {
-                    assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-                    if (timer->u.timer.timeout < other_timer->u.timer.timeout)
-                        break;
-                }
-                list_add_before( &other_timer->u.timer.timer_entry, &timer->u.timer.timer_entry );
-                timer->u.timer.timer_pending = TRUE;
+                tp_timerqueue_add( timer );
             }
         }
 
-        timeout_lower = timeout_upper = MAXLONGLONG;
-
         /* Determine next timeout and use the window length to optimize wakeup times. */
-        LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                             struct threadpool_object, u.timer.timer_entry )
-        {
-            assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-            if (other_timer->u.timer.timeout >= timeout_upper)
-                break;
-
-            timeout_lower = other_timer->u.timer.timeout;
-            new_timeout   = timeout_lower + (ULONGLONG)other_timer->u.timer.window_length * 10000;
-            if (new_timeout < timeout_upper)
-                timeout_upper = new_timeout;
-        }
+        if (!wine_timer_wheel_next( &timerqueue.pending_timers, &timeout_lower ))
+            timeout_lower = MAXLONGLONG;
+        timerqueue.next_timeout = timeout_lower;
 
         /* Wait for timer update events or until the next timer expires. */
         if (timerqueue.objcount)
@@ -1126,6 +1122,7 @@ static void CALLBACK timerqueue_thread_proc( void *param )
     }
 
     timerqueue.thread_running = FALSE;
+    timerqueue.next_timeout = MAXLONGLONG;
     RtlLeaveCriticalSection( &timerqueue.cs );
 
     TRACE( "terminating timer queue thread\n" );
@@ -1177,6 +1174,12 @@ static NTSTATUS tp_timerqueue_lock( struct threadpool_object *timer )
     if (!timerqueue.thread_running)
     {
         HANDLE thread;
+        LARGE_INTEGER now;
+
+        /* There are no pending timers when the thread isn't running. */
+        NtQuerySystemTime( &now );
+        wine_timer_wheel_init( &timerqueue.pending_timers, 14, now.QuadPart );
+
         status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
                                       timerqueue_thread_proc, NULL, &thread, NULL );
         if (status == STATUS_SUCCESS)
@@ -1211,14 +1214,14 @@ static void tp_timerqueue_unlock( struct threadpool_object *timer )
         /* If timer was pending, remove it. */
         if (timer->u.timer.timer_pending)
         {
-            list_remove( &timer->u.timer.timer_entry );
+            wine_timer_wheel_remove( &timerqueue.pending_timers, &timer->u.timer.timer_entry );
             timer->u.timer.timer_pending = FALSE;
         }
 
         /* If the last timer object was destroyed, then wake up the thread. */
         if (!--timerqueue.objcount)
         {
-            assert( list_empty( &timerqueue.pending_timers ) );
+            assert( wine_timer_wheel_empty( &timerqueue.pending_timers ) );
             RtlWakeAllConditionVariable( &timerqueue.update_event );
         }
 
@@ -1669,6 +1672,8 @@ static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
     for (i = 0; i < ARRAY_SIZE(pool->pools); ++i)
         list_init( &pool->pools[i] );
     RtlInitializeConditionVariable( &pool->update_event );
+    pool->submitted               = NULL;
+    pool->num_spinning_workers    = 0;
 
     pool->max_workers             = 500;
     pool->min_workers             = 0;
@@ -1716,6 +1721,7 @@ static BOOL tp_threadpool_release( struct threadpool *pool )
     assert( !pool->objcount );
     for (i = 0; i < ARRAY_SIZE(pool->pools); ++i)
         assert( list_empty( &pool->pools[i] ) );
+    assert( !pool->submitted );
 
     pool->cs.DebugInfo->Spare[0] = 0;
     RtlDeleteCriticalSection( &pool->cs );
@@ -1902,6 +1908,8 @@ static void tp_object_initialize( struct threadpool_object *object, struct threa
     object->num_pending_callbacks   = 0;
     object->num_running_callbacks   = 0;
     object->num_associated_callbacks = 0;
+    object->submitted_next          = NULL;
+    object->num_submitted_callbacks = 0;
 
     if (environment)
     {
@@ -1962,41 +1970,111 @@ static void tp_object_prio_queue( struct threadpool_object *object )
 }
 
 /***********************************************************************
- *           tp_object_submit    (internal)
+ *           tp_object_queue    (internal)
  *
- * Submits a threadpool object to the associated threadpool. This
- * function has to be VOID because TpPostWork can never fail on Windows.
+ * Queues a single callback of a threadpool object, pool->cs has to be
+ * held.
  */
-static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
+static void tp_object_queue( struct threadpool_object *object )
 {
     struct threadpool *pool = object->pool;
     NTSTATUS status = STATUS_UNSUCCESSFUL;
 
-    assert( !object->shutdown );
-    assert( !pool->shutdown );
-
-    RtlEnterCriticalSection( &pool->cs );
-
     /* Start new worker threads if required. */
     if (pool->num_busy_workers >= pool->num_workers &&
         pool->num_workers < pool->max_workers)
         status = tp_new_worker_thread( pool );
 
-    /* Queue work item and increment refcount. */
-    InterlockedIncrement( &object->refcount );
     if (!object->num_pending_callbacks++)
         tp_object_prio_queue( object );
 
-    /* Count how often the object was signaled. */
-    if (object->type == TP_OBJECT_TYPE_WAIT && signaled)
-        object->u.wait.signaled++;
-
     /* No new thread started - wake up one existing thread. */
     if (status != STATUS_SUCCESS)
     {
         assert( pool->num_workers > 0 );
         RtlWakeConditionVariable( &pool->update_event );
     }
+}
+
+/***********************************************************************
+ *           tp_threadpool_flush_submitted    (internal)
+ *
+ * Queues the callbacks of all objects submitted without holding the
+ * lock, pool->cs has to be held.
+ */
+static void tp_threadpool_flush_submitted( struct threadpool *pool )
+{
+    struct threadpool_object *object, *next, *list = NULL;
+    LONG count;
+
+    if (!pool->submitted) return;
+
+    /* The list is built in reverse order, restore the submission order. */
+    object = InterlockedExchangePointer( (void **)&pool->submitted, NULL );
+    while (object)
+    {
+        next = object->submitted_next;
+        object->submitted_next = list;
+        list = object;
+        object = next;
+    }
+
+    for (object = list; object; object = next)
+    {
+        /* The object can be submitted again as soon as the count is reset. */
+        next = object->submitted_next;
+        count = InterlockedExchange( &object->num_submitted_callbacks, 0 );
+        while (count--) tp_object_queue( object );
+    }
+}
+
+/***********************************************************************
+ *           tp_object_submit    (internal)
+ *
+ * Submits a threadpool object to the associated threadpool. This
+ * function has to be VOID because TpPostWork can never fail on Windows.
+ */
+static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
+{
+    struct threadpool *pool = object->pool;
+    struct threadpool_object *head;
+
+    assert( !object->shutdown );
+    assert( !pool->shutdown );
+
+    /* Keep a reference for each pending callback. */
+    InterlockedIncrement( &object->refcount );
+
+    /* Work items and simple callbacks are published without taking the lock,
+     * and only the first pending submission links the object. If a worker is
+     * spinning it is guaranteed to see the object, otherwise queue it now. */
+    if (object->type == TP_OBJECT_TYPE_SIMPLE || object->type == TP_OBJECT_TYPE_WORK)
+    {
+        if (InterlockedIncrement( &object->num_submitted_callbacks ) == 1)
+        {
+            do
+            {
+                head = *(struct threadpool_object * volatile *)&pool->submitted;
+                object->submitted_next = head;
+            }
+            while (InterlockedCompareExchangePointer( (void **)&pool->submitted, object, head ) != head);
+        }
+
+        if (*(volatile LONG *)&pool->num_spinning_workers) return;
+
+        RtlEnterCriticalSection( &pool->cs );
+        tp_threadpool_flush_submitted( pool );
+        RtlLeaveCriticalSection( &pool->cs );
+        return;
+    }
+
+    RtlEnterCriticalSection( &pool->cs );
+
+    /* Count how often the object was signaled. */
+    if (object->type == TP_OBJECT_TYPE_WAIT && signaled)
+        object->u.wait.signaled++;
+
+    tp_object_queue( object );
 
     RtlLeaveCriticalSection( &pool->cs );
 }
@@ -2012,6 +2090,7 @@ static void tp_object_cancel( struct threadpool_object *object )
     LONG pending_callbacks = 0;
 
     RtlEnterCriticalSection( &pool->cs );
+    tp_threadpool_flush_submitted( pool );
     if (object->num_pending_callbacks)
     {
         pending_callbacks = object->num_pending_callbacks;
@@ -2034,7 +2113,7 @@ static void tp_object_cancel( struct threadpool_object *object )
 
 static BOOL object_is_finished( struct threadpool_object *object, BOOL group )
 {
-    if (object->num_pending_callbacks)
+    if (object->num_pending_callbacks || object->num_submitted_callbacks)
         return FALSE;
     if (object->type == TP_OBJECT_TYPE_IO && object->u.io.pending_count)
         return FALSE;
@@ -2109,6 +2188,7 @@ static BOOL tp_object_release( struct threadpool_object *object )
 
     assert( object->shutdown );
     assert( !object->num_pending_callbacks );
+    assert( !object->num_submitted_callbacks );
     assert( !object->num_running_callbacks );
     assert( !object->num_associated_callbacks );
 
@@ -2313,6 +2393,39 @@ skip_cleanup:
     }
 }
 
+/***********************************************************************
+ *           threadpool_worker_spin    (internal)
+ *
+ * Spins for a short while before a worker goes to sleep, to pick up work
+ * items submitted without taking the lock. pool->cs has to be held, and
+ * is released while spinning. Returns TRUE if new work is available or
+ * the pool is shutting down.
+ */
+static BOOL threadpool_worker_spin( struct threadpool *pool )
+{
+    unsigned int i;
+
+    if (NtCurrentTeb()->Peb->NumberOfProcessors <= 1)
+        return FALSE;
+
+    InterlockedIncrement( &pool->num_spinning_workers );
+    RtlLeaveCriticalSection( &pool->cs );
+
+    for (i = 0; i < THREADPOOL_WORKER_SPIN_COUNT; i++)
+    {
+        if (*(struct threadpool_object * volatile *)&pool->submitted) break;
+        YieldProcessor();
+    }
+
+    RtlEnterCriticalSection( &pool->cs );
+
+    /* Objects published before this point are flushed below, later ones are
+     * queued by their submitter as it doesn't see this thread spinning. */
+    InterlockedDecrement( &pool->num_spinning_workers );
+    tp_threadpool_flush_submitted( pool );
+    return threadpool_get_next_item( pool ) || pool->shutdown;
+}
+
 /***********************************************************************
  *           threadpool_worker_proc    (internal)
  */
@@ -2327,6 +2440,7 @@ static void CALLBACK threadpool_worker_proc( void *param )
     RtlEnterCriticalSection( &pool->cs );
     for (;;)
     {
+        tp_threadpool_flush_submitted( pool );
         while ((ptr = threadpool_get_next_item( pool )))
         {
             struct threadpool_object *object = LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
@@ -2350,6 +2464,9 @@ static void CALLBACK threadpool_worker_proc( void *param )
         if (pool->shutdown)
             break;
 
+        if (threadpool_worker_spin( pool ))
+            continue;
+
         /* Wait for new tasks or until the timeout expires. A thread only terminates
          * when no new tasks are available, and the number of threads can be
          * decreased without violating the min_workers limit. An exception is when
@@ -2956,7 +3073,6 @@ BOOL WINAPI TpSetPoolMinThreads( TP_POOL *pool, DWORD minimum )
 VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LONG window_length )
 {
     struct threadpool_object *this = impl_from_TP_TIMER( timer );
-    struct threadpool_object *other_timer;
     BOOL submit_timer = FALSE;
     ULONGLONG timestamp;
 
@@ -2995,7 +3111,7 @@ VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LO
     /* First remove existing timeout. */
     if (this->u.timer.timer_pending)
     {
-        list_remove( &this->u.timer.timer_entry );
+        wine_timer_wheel_remove( &timerqueue.pending_timers, &this->u.timer.timer_entry );
         this->u.timer.timer_pending = FALSE;
     }
 
@@ -3006,20 +3122,11 @@ VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LO
         this->u.timer.period        = period;
         this->u.timer.window_length = window_length;
 
-        LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                             struct threadpool_object, u.timer.timer_entry )
-        {
-            assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-            if (this->u.timer.timeout < other_timer->u.timer.timeout)
-                break;
-        }
-        list_add_before( &other_timer->u.timer.timer_entry, &this->u.timer.timer_entry );
+        tp_timerqueue_add( this );
 
         /* Wake up the timer thread when the timeout has to be updated. */
-        if (list_head( &timerqueue.pending_timers ) == &this->u.timer.timer_entry )
+        if (this->u.timer.timer_entry.latest < timerqueue.next_timeout)
             RtlWakeAllConditionVariable( &timerqueue.update_event );
-
-        this->u.timer.timer_pending = TRUE;
     }
 
     RtlLeaveCriticalSection( &timerqueue.cs );
@@ -151,60 +151,40 @@ static void *get_shm( unsigned int idx )
     return ret;
 }
 
-/* We'd like lookup to be fast. To that end, we use a static list indexed by handle.
- * This is copied and adapted from the fd cache code. */
+/* We'd like lookup to be fast. To that end, objects are stored in the handle
+ * cache shared with the fd cache, so that a single lookup finds them. */
 
-#define ESYNC_LIST_BLOCK_SIZE  (65536 / sizeof(struct esync))
-#define ESYNC_LIST_ENTRIES     256
-
-static struct esync *esync_list[ESYNC_LIST_ENTRIES];
-static struct esync esync_list_initial_block[ESYNC_LIST_BLOCK_SIZE];
-
-static inline UINT_PTR handle_to_index( HANDLE handle, UINT_PTR *entry )
-{
-    UINT_PTR idx = (((UINT_PTR)handle) >> 2) - 1;
-    *entry = idx / ESYNC_LIST_BLOCK_SIZE;
-    return idx % ESYNC_LIST_BLOCK_SIZE;
-}
+C_ASSERT( sizeof(struct esync) == sizeof(((struct handle_cache_entry *)0)->sync) );
+C_ASSERT( offsetof( struct esync, fd ) == offsetof( struct handle_cache_entry, sync.fd ) - offsetof( struct handle_cache_entry, sync ) );
+C_ASSERT( offsetof( struct esync, shm ) == offsetof( struct handle_cache_entry, sync.shm ) - offsetof( struct handle_cache_entry, sync ) );
 
 static struct esync *add_to_list( HANDLE handle, enum esync_type type, int fd, void *shm )
 {
-    UINT_PTR entry, idx = handle_to_index( handle, &entry );
+    struct handle_cache_entry *entry = get_handle_cache_entry( handle, TRUE );
+    struct esync *obj;
 
-    if (entry >= ESYNC_LIST_ENTRIES)
+    if (!entry)
     {
         FIXME( "too many allocated handles, not caching %p\n", handle );
-        return FALSE;
-    }
-
-    if (!esync_list[entry])  /* do we need to allocate a new block of entries? */
-    {
-        if (!entry) esync_list[0] = esync_list_initial_block;
-        else
-        {
-            void *ptr = anon_mmap_alloc( ESYNC_LIST_BLOCK_SIZE * sizeof(struct esync),
-                                         PROT_READ | PROT_WRITE );
-            if (ptr == MAP_FAILED) return FALSE;
-            esync_list[entry] = ptr;
-        }
+        return NULL;
     }
 
-    if (!InterlockedCompareExchange( (int *)&esync_list[entry][idx].type, type, 0 ))
+    obj = (struct esync *)&entry->sync;
+    if (!InterlockedCompareExchange( (int *)&obj->type, type, 0 ))
     {
-        esync_list[entry][idx].fd = fd;
-        esync_list[entry][idx].shm = shm;
+        obj->fd = fd;
+        obj->shm = shm;
     }
-    return &esync_list[entry][idx];
+    return obj;
 }
 
 static struct esync *get_cached_object( HANDLE handle )
 {
-    UINT_PTR entry, idx = handle_to_index( handle, &entry );
+    struct handle_cache_entry *entry = get_handle_cache_entry( handle, FALSE );
 
-    if (entry >= ESYNC_LIST_ENTRIES || !esync_list[entry]) return NULL;
-    if (!esync_list[entry][idx].type) return NULL;
+    if (!entry || !entry->sync.type) return NULL;
 
-    return &esync_list[entry][idx];
+    return (struct esync *)&entry->sync;
 }
 
 /* Gets an object. This is either a proper esync object (i.e. an event,
@@ -275,17 +255,14 @@ static NTSTATUS get_object( HANDLE handle, struct esync **obj )
 
 NTSTATUS esync_close( HANDLE handle )
 {
-    UINT_PTR entry, idx = handle_to_index( handle, &entry );
+    struct handle_cache_entry *entry = get_handle_cache_entry( handle, FALSE );
 
     TRACE("%p.\n", handle);
 
-    if (entry < ESYNC_LIST_ENTRIES && esync_list[entry])
+    if (entry && InterlockedExchange( &entry->sync.type, 0 ))
     {
-        if (InterlockedExchange((int *)&esync_list[entry][idx].type, 0))
-        {
-            close( esync_list[entry][idx].fd );
-            return STATUS_SUCCESS;
-        }
+        close( entry->sync.fd );
+        return STATUS_SUCCESS;
     }
 
     return STATUS_INVALID_HANDLE;
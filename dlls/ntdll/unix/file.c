@@ -94,6 +94,11 @@
 #ifdef HAVE_LINUX_IOCTL_H
 #include <linux/ioctl.h>
 #endif
+#ifdef HAVE_LINUX_IO_URING_H
+# include <linux/io_uring.h>
+# include <sys/mman.h>
+# include <sys/uio.h>
+#endif
 #ifdef HAVE_LINUX_MAJOR_H
 # include <linux/major.h>
 #endif
@@ -220,7 +225,7 @@ struct dir_data_buffer
 struct dir_data_names
 {
     const WCHAR *long_name;          /* long file name in Unicode */
-    const WCHAR *short_name;         /* short file name in Unicode */
+    const WCHAR *short_name;         /* short file name in Unicode, NULL if not generated yet */
     const char  *unix_name;          /* Unix file name in host encoding */
 };
 
@@ -228,19 +233,36 @@ struct dir_data
 {
     unsigned int            size;    /* size of the names array */
     unsigned int            count;   /* count of used entries in the names array */
-    unsigned int            pos;     /* current reading position in the names array */
+    unsigned int            refcount; /* number of handles and shared list references */
     struct file_identity    id;      /* directory file identity */
     struct dir_data_names  *names;   /* directory file names */
     struct dir_data_buffer *buffer;  /* head of data buffers list */
+    struct list             entry;   /* entry in the shared list, most recently used first */
+    LONGLONG                mtime;   /* directory modification time when it was read */
+    LARGE_INTEGER           scan_time; /* time the directory was read */
+    WCHAR                  *mask;    /* mask used to select the names */
+    unsigned int            mask_len; /* length of the mask in bytes */
+};
+
+struct dir_cache_entry
+{
+    struct dir_data        *data;    /* directory data, possibly shared with other handles */
+    unsigned int            pos;     /* current reading position in the names array */
 };
 
 static const unsigned int dir_data_buffer_initial_size = 4096;
 static const unsigned int dir_data_cache_initial_size  = 256;
 static const unsigned int dir_data_names_initial_size  = 64;
+static const unsigned int dir_data_max_shared          = 32;
 
-static struct dir_data **dir_data_cache;
+static struct dir_cache_entry *dir_data_cache;
 static unsigned int dir_data_cache_size;
 
+/* directory contents kept across handles, so that enumerating the same
+ * directory again doesn't require reading and sorting it again */
+static struct list dir_data_shared = LIST_INIT( dir_data_shared );
+static unsigned int dir_data_shared_count;
+
 static BOOL show_dot_files;
 static mode_t start_umask;
 
@@ -458,7 +480,8 @@ static BOOL add_dir_data_names( struct dir_data *data, const WCHAR *long_name,
         data->names = names;
     }
 
-    if (short_name[0])
+    if (!short_name) names[data->count].short_name = NULL;
+    else if (short_name[0])
     {
         if (!(names[data->count].short_name = add_dir_data_nameW( data, short_name ))) return FALSE;
     }
@@ -483,9 +506,16 @@ static void free_dir_data( struct dir_data *data )
         free( buffer );
     }
     free( data->names );
+    free( data->mask );
     free( data );
 }
 
+/* release a reference to the directory data */
+static void release_dir_data( struct dir_data *data )
+{
+    if (data && !--data->refcount) free_dir_data( data );
+}
+
 
 /* support for a directory queue for filesystem searches */
 
@@ -1467,6 +1497,12 @@ static BOOL append_entry( struct dir_data *data, const char *long_name,
         short_len = ntdll_umbstowcs( short_name, strlen(short_name),
                                      short_nameW, ARRAY_SIZE( short_nameW ) - 1 );
     }
+    else if (!mask || match_filename( long_nameW, long_len, mask ))
+    {
+        /* the short name is only generated when it's needed */
+        TRACE( "long %s mask %s\n", debugstr_w( long_nameW ), debugstr_us( mask ));
+        return add_dir_data_names( data, long_nameW, NULL, long_name );
+    }
     else  /* generate a short name if necessary */
     {
         short_len = 0;
@@ -2046,17 +2082,57 @@ static NTSTATUS get_mountmgr_fs_info( HANDLE handle, int fd, struct mountmgr_uni
 }
 
 
+static LONGLONG get_dir_mtime( const struct stat *st )
+{
+    LARGE_INTEGER mtime, ctime, atime, creation;
+
+    get_file_times( st, &mtime, &ctime, &atime, &creation );
+    return mtime.QuadPart;
+}
+
+/* check whether a directory that was read at scan_time with the given mtime is unchanged */
+static BOOL is_dir_unchanged( const struct stat *st, dev_t dev, ino_t ino, LONGLONG mtime,
+                              LARGE_INTEGER scan_time )
+{
+    if (st->st_dev != dev || st->st_ino != ino) return FALSE;
+    if (get_dir_mtime( st ) != mtime) return FALSE;
+    /* a change in the same second as the scan may not have updated the mtime */
+    return scan_time.QuadPart - mtime > 2 * TICKSPERSEC;
+}
+
+
+/* get the short name of a directory entry, generating it if necessary */
+static const WCHAR *get_dir_data_short_name( struct dir_data *data, struct dir_data_names *names )
+{
+    static const WCHAR empty[1];
+    WCHAR short_nameW[13];
+    int len;
+
+    if (names->short_name) return names->short_name;
+
+    len = wcslen( names->long_name );
+    if (is_legal_8dot3_name( names->long_name, len )) return names->short_name = empty;
+
+    len = hash_short_file_name( names->long_name, len, short_nameW );
+    short_nameW[len] = 0;
+    wcsupr( short_nameW );
+    if (!(names->short_name = add_dir_data_nameW( data, short_nameW ))) return empty;
+    return names->short_name;
+}
+
+
 /***********************************************************************
  *           get_dir_data_entry
  *
  * Return a directory entry from the cached data.
  */
-static NTSTATUS get_dir_data_entry( struct dir_data *dir_data, void *info_ptr, IO_STATUS_BLOCK *io,
-                                    ULONG max_length, FILE_INFORMATION_CLASS class,
+static NTSTATUS get_dir_data_entry( struct dir_data *dir_data, unsigned int pos, void *info_ptr,
+                                    IO_STATUS_BLOCK *io, ULONG max_length, FILE_INFORMATION_CLASS class,
                                     union file_directory_info **last_info )
 {
-    const struct dir_data_names *names = &dir_data->names[dir_data->pos];
+    struct dir_data_names *names = &dir_data->names[pos];
     union file_directory_info *info;
+    const WCHAR *short_name;
     struct stat st;
     ULONG name_len, start, dir_size, attributes;
 
@@ -2113,15 +2189,17 @@ static NTSTATUS get_dir_data_entry( struct dir_data *dir_data, void *info_ptr, I
 
     case FileBothDirectoryInformation:
         info->both.EaSize = 0; /* FIXME */
-        info->both.ShortNameLength = wcslen( names->short_name ) * sizeof(WCHAR);
-        memcpy( info->both.ShortName, names->short_name, info->both.ShortNameLength );
+        short_name = get_dir_data_short_name( dir_data, names );
+        info->both.ShortNameLength = wcslen( short_name ) * sizeof(WCHAR);
+        memcpy( info->both.ShortName, short_name, info->both.ShortNameLength );
         info->both.FileNameLength = name_len;
         break;
 
     case FileIdBothDirectoryInformation:
         info->id_both.EaSize = 0; /* FIXME */
-        info->id_both.ShortNameLength = wcslen( names->short_name ) * sizeof(WCHAR);
-        memcpy( info->id_both.ShortName, names->short_name, info->id_both.ShortNameLength );
+        short_name = get_dir_data_short_name( dir_data, names );
+        info->id_both.ShortNameLength = wcslen( short_name ) * sizeof(WCHAR);
+        memcpy( info->id_both.ShortName, short_name, info->id_both.ShortNameLength );
         info->id_both.FileNameLength = name_len;
         break;
 
@@ -2339,6 +2417,58 @@ static int name_compare( const void *a, const void *b )
 }
 
 
+/* find directory data read with the same mask that is still valid */
+static struct dir_data *find_shared_dir_data( const struct stat *st, const UNICODE_STRING *mask )
+{
+    struct dir_data *data, *next;
+    unsigned int mask_len = mask ? mask->Length : 0;
+
+    LIST_FOR_EACH_ENTRY_SAFE( data, next, &dir_data_shared, struct dir_data, entry )
+    {
+        if (data->id.dev != st->st_dev || data->id.ino != st->st_ino) continue;
+        if (data->mask_len != mask_len || (mask_len && memcmp( data->mask, mask->Buffer, mask_len )))
+            continue;
+
+        list_remove( &data->entry );
+        if (!is_dir_unchanged( st, data->id.dev, data->id.ino, data->mtime, data->scan_time ))
+        {
+            TRACE( "directory changed, dropping %p\n", data );
+            dir_data_shared_count--;
+            release_dir_data( data );
+            return NULL;
+        }
+        list_add_head( &dir_data_shared, &data->entry );
+        return data;
+    }
+    return NULL;
+}
+
+/* add directory data to the shared list, evicting the least recently used one if necessary */
+static void add_shared_dir_data( struct dir_data *data, const UNICODE_STRING *mask )
+{
+    struct dir_data *old;
+
+    if (mask && mask->Length)
+    {
+        if (!(data->mask = malloc( mask->Length ))) return;
+        memcpy( data->mask, mask->Buffer, mask->Length );
+        data->mask_len = mask->Length;
+    }
+
+    if (dir_data_shared_count >= dir_data_max_shared)
+    {
+        old = LIST_ENTRY( list_tail( &dir_data_shared ), struct dir_data, entry );
+        list_remove( &old->entry );
+        dir_data_shared_count--;
+        release_dir_data( old );
+    }
+
+    data->refcount++;
+    list_add_head( &dir_data_shared, &data->entry );
+    dir_data_shared_count++;
+}
+
+
 /***********************************************************************
  *           init_cached_dir_data
  *
@@ -2350,8 +2480,19 @@ static NTSTATUS init_cached_dir_data( struct dir_data **data_ret, int fd, const
     struct stat st;
     NTSTATUS status;
     unsigned int i;
+    BOOL shareable = (!mask || has_wildcard( mask )) && !fstat( fd, &st );
+
+    if (shareable && (data = find_shared_dir_data( &st, mask )))
+    {
+        TRACE( "mask %s reusing %u files\n", debugstr_us( mask ), data->count );
+        data->refcount++;
+        *data_ret = data;
+        return data->count ? STATUS_SUCCESS : STATUS_NO_SUCH_FILE;
+    }
 
     if (!(data = calloc( 1, sizeof(*data) ))) return STATUS_NO_MEMORY;
+    data->refcount = 1;
+    NtQuerySystemTime( &data->scan_time );
 
     if ((status = read_directory_data( data, fd, mask )))
     {
@@ -2365,7 +2506,15 @@ static NTSTATUS init_cached_dir_data( struct dir_data **data_ret, int fd, const
     if (i < data->count && !strcmp( data->names[i].unix_name, ".." )) i++;
     if (i < data->count) qsort( data->names + i, data->count - i, sizeof(*data->names), name_compare );
 
-    if (data->count)
+    if (shareable)
+    {
+        data->id.dev = st.st_dev;
+        data->id.ino = st.st_ino;
+        data->mtime = get_dir_mtime( &st );
+        if (is_dir_unchanged( &st, data->id.dev, data->id.ino, data->mtime, data->scan_time ))
+            add_shared_dir_data( data, mask );
+    }
+    else if (data->count)
     {
         fstat( fd, &st );
         data->id.dev = st.st_dev;
@@ -2386,7 +2535,7 @@ static NTSTATUS init_cached_dir_data( struct dir_data **data_ret, int fd, const
  *
  * Retrieve the cached directory data, or initialize it if necessary.
  */
-static NTSTATUS get_cached_dir_data( HANDLE handle, struct dir_data **data_ret, int fd,
+static NTSTATUS get_cached_dir_data( HANDLE handle, struct dir_cache_entry **entry_ret, int fd,
                                      const UNICODE_STRING *mask )
 {
     unsigned int i;
@@ -2404,8 +2553,8 @@ static NTSTATUS get_cached_dir_data( HANDLE handle, struct dir_data **data_ret,
             int free_idx = free_entries[i];
             if (free_idx < dir_data_cache_size)
             {
-                free_dir_data( dir_data_cache[free_idx] );
-                dir_data_cache[free_idx] = NULL;
+                release_dir_data( dir_data_cache[free_idx].data );
+                dir_data_cache[free_idx].data = NULL;
             }
         }
     }
@@ -2420,7 +2569,7 @@ static NTSTATUS get_cached_dir_data( HANDLE handle, struct dir_data **data_ret,
     if (entry >= dir_data_cache_size)
     {
         unsigned int size = max( dir_data_cache_initial_size, max( dir_data_cache_size * 2, entry + 1 ) );
-        struct dir_data **new_cache = realloc( dir_data_cache, size * sizeof(*new_cache) );
+        struct dir_cache_entry *new_cache = realloc( dir_data_cache, size * sizeof(*new_cache) );
 
         if (!new_cache) return STATUS_NO_MEMORY;
         memset( new_cache + dir_data_cache_size, 0, (size - dir_data_cache_size) * sizeof(*new_cache) );
@@ -2428,9 +2577,13 @@ static NTSTATUS get_cached_dir_data( HANDLE handle, struct dir_data **data_ret,
         dir_data_cache_size = size;
     }
 
-    if (!dir_data_cache[entry]) status = init_cached_dir_data( &dir_data_cache[entry], fd, mask );
+    if (!dir_data_cache[entry].data)
+    {
+        dir_data_cache[entry].pos = 0;
+        status = init_cached_dir_data( &dir_data_cache[entry].data, fd, mask );
+    }
 
-    *data_ret = dir_data_cache[entry];
+    *entry_ret = &dir_data_cache[entry];
     return status;
 }
 
@@ -2445,7 +2598,7 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event, PIO_APC_ROUTI
 {
     int cwd, fd, needs_close;
     enum server_fd_type type;
-    struct dir_data *data;
+    struct dir_cache_entry *entry;
     NTSTATUS status;
 
     TRACE("(%p %p %p %p %p %p 0x%08x 0x%08x 0x%08x %s 0x%08x\n",
@@ -2499,16 +2652,16 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event, PIO_APC_ROUTI
     cwd = open( ".", O_RDONLY );
     if (fchdir( fd ) != -1)
     {
-        if (!(status = get_cached_dir_data( handle, &data, fd, mask )))
+        if (!(status = get_cached_dir_data( handle, &entry, fd, mask )))
         {
             union file_directory_info *last_info = NULL;
 
-            if (restart_scan) data->pos = 0;
+            if (restart_scan) entry->pos = 0;
 
-            while (!status && data->pos < data->count)
+            while (!status && entry->pos < entry->data->count)
             {
-                status = get_dir_data_entry( data, buffer, io, length, info_class, &last_info );
-                if (!status || status == STATUS_BUFFER_OVERFLOW) data->pos++;
+                status = get_dir_data_entry( entry->data, entry->pos, buffer, io, length, info_class, &last_info );
+                if (!status || status == STATUS_BUFFER_OVERFLOW) entry->pos++;
                 if (single_entry && last_info) break;
             }
 
@@ -2530,6 +2683,270 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event, PIO_APC_ROUTI
 }
 
 
+/* Case-insensitive indexes of the directories scanned by find_file_in_dir,
+ * so that looking up many names whose case doesn't match the file system
+ * doesn't require a full directory scan for each of them. Directories are
+ * scanned linearly until a scan shows that they are large; their indexes are
+ * then kept in a small LRU cache and validated against the directory
+ * modification time. Names found in an index are checked with
+ * lstat, and names not found in it are only trusted if the directory was last
+ * modified well before the index was built, since a change within the same
+ * timestamp granularity wouldn't be noticed. */
+
+#define DIR_INDEX_MIN_ENTRIES 128  /* min. number of entries to cache the index of a directory */
+#define DIR_INDEX_MAX_DIRS    16   /* max. number of cached directory indexes */
+
+struct dir_index_entry
+{
+    unsigned int  hash;        /* case-insensitive hash of the long or short name */
+    unsigned int  next;        /* index of the next entry in the bucket + 1 */
+    unsigned int  name;        /* offset of the unix name in the names buffer */
+    BOOL          short_name;  /* entry for the short name of the file */
+};
+
+struct dir_index
+{
+    struct list   entry;       /* entry in cache list, most recently used first */
+    dev_t         dev;         /* directory device */
+    ino_t         ino;         /* directory inode */
+    LONGLONG      mtime;       /* directory modification time */
+    LARGE_INTEGER scan_time;   /* time of the directory scan */
+    BOOL          short_names; /* short names of the entries are indexed */
+    unsigned int  count;       /* number of entries */
+    unsigned int  size;        /* number of hash buckets, a power of 2 */
+    unsigned int *buckets;     /* index of the first entry of each bucket + 1 */
+    struct dir_index_entry *entries;  /* entries array */
+    char         *names;       /* unix names buffer */
+    size_t        names_len;   /* length of the names buffer */
+};
+
+static struct list dir_index_cache = LIST_INIT( dir_index_cache );
+static unsigned int dir_index_count;
+static pthread_mutex_t dir_index_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int hash_dir_entry_name( const WCHAR *name, int length )
+{
+    unsigned int i, hash = 0;
+
+    for (i = 0; i < length; i++) hash = hash * 65599 + towupper( name[i] );
+    return hash;
+}
+
+static void free_dir_index( struct dir_index *index )
+{
+    free( index->buckets );
+    free( index->entries );
+    free( index->names );
+    free( index );
+}
+
+static BOOL add_dir_index_entry( struct dir_index *index, unsigned int *max_entries, unsigned int hash,
+                                 unsigned int name, BOOL short_name )
+{
+    if (index->count == *max_entries)
+    {
+        unsigned int new_max = max( 256, *max_entries * 2 );
+        struct dir_index_entry *new_entries;
+
+        if (!(new_entries = realloc( index->entries, new_max * sizeof(*new_entries) ))) return FALSE;
+        index->entries = new_entries;
+        *max_entries = new_max;
+    }
+    index->entries[index->count].hash = hash;
+    index->entries[index->count].name = name;
+    index->entries[index->count].short_name = short_name;
+    index->count++;
+    return TRUE;
+}
+
+/* scan a directory and build its index */
+static struct dir_index *build_dir_index( const char *unix_name, BOOL short_names, NTSTATUS *status )
+{
+    WCHAR buffer[MAX_DIR_ENTRY_LEN], short_nameW[12];
+    struct dir_index *index;
+    unsigned int i, hash, max_entries = 0;
+    size_t len, max_names = 0;
+    struct dirent *de;
+    struct stat st;
+    DIR *dir;
+    int ret;
+
+    *status = STATUS_NO_MEMORY;
+    if (!(index = calloc( 1, sizeof(*index) ))) return NULL;
+    index->short_names = short_names;
+    NtQuerySystemTime( &index->scan_time );
+
+    if (!(dir = opendir( unix_name )))
+    {
+        *status = errno_to_status( errno );
+        free( index );
+        return NULL;
+    }
+    if (!fstat( dirfd( dir ), &st ))
+    {
+        index->dev = st.st_dev;
+        index->ino = st.st_ino;
+        index->mtime = get_dir_mtime( &st );
+    }
+
+    while ((de = readdir( dir )))
+    {
+        len = strlen( de->d_name ) + 1;
+        if (index->names_len + len > max_names)
+        {
+            size_t new_max = max( 4096, max( max_names * 2, index->names_len + len ));
+            char *new_names;
+
+            if (!(new_names = realloc( index->names, new_max ))) goto error;
+            index->names = new_names;
+            max_names = new_max;
+        }
+        memcpy( index->names + index->names_len, de->d_name, len );
+
+        ret = ntdll_umbstowcs( de->d_name, len - 1, buffer, MAX_DIR_ENTRY_LEN );
+        hash = hash_dir_entry_name( buffer, ret );
+        if (!add_dir_index_entry( index, &max_entries, hash, index->names_len, FALSE )) goto error;
+        if (short_names && !is_legal_8dot3_name( buffer, ret ))
+        {
+            ret = hash_short_file_name( buffer, ret, short_nameW );
+            hash = hash_dir_entry_name( short_nameW, ret );
+            if (!add_dir_index_entry( index, &max_entries, hash, index->names_len, TRUE )) goto error;
+        }
+        index->names_len += len;
+    }
+    closedir( dir );
+
+    for (index->size = 16; index->size < index->count; index->size *= 2) ;
+    if (!(index->buckets = calloc( index->size, sizeof(*index->buckets) ))) goto error_free;
+
+    /* insert in reverse order so that each bucket lists the entries in directory order */
+    for (i = index->count; i > 0; i--)
+    {
+        struct dir_index_entry *entry = &index->entries[i - 1];
+        unsigned int *bucket = &index->buckets[entry->hash & (index->size - 1)];
+
+        entry->next = *bucket;
+        *bucket = i;
+    }
+    *status = STATUS_SUCCESS;
+    return index;
+
+error:
+    closedir( dir );
+error_free:
+    free_dir_index( index );
+    return NULL;
+}
+
+/* look up a name in a directory index, long names first */
+static const char *lookup_dir_index( const struct dir_index *index, const WCHAR *name, int length,
+                                     BOOLEAN check_short_names )
+{
+    WCHAR buffer[MAX_DIR_ENTRY_LEN], short_nameW[12];
+    unsigned int i, hash = hash_dir_entry_name( name, length );
+    const struct dir_index_entry *entry;
+    const char *unix_name;
+    int pass, ret;
+
+    for (pass = 0; pass < (check_short_names ? 2 : 1); pass++)
+    {
+        for (i = index->buckets[hash & (index->size - 1)]; i; i = entry->next)
+        {
+            entry = &index->entries[i - 1];
+            if (entry->hash != hash || entry->short_name != pass) continue;
+            unix_name = index->names + entry->name;
+            ret = ntdll_umbstowcs( unix_name, strlen(unix_name), buffer, MAX_DIR_ENTRY_LEN );
+            if (entry->short_name)
+            {
+                ret = hash_short_file_name( buffer, ret, short_nameW );
+                if (ret == length && !wcsnicmp( short_nameW, name, length )) return unix_name;
+            }
+            else if (ret == length && !wcsnicmp( buffer, name, length )) return unix_name;
+        }
+    }
+    return NULL;
+}
+
+/* check whether a name missing from an index is really missing from the directory */
+static BOOL is_dir_index_current( const struct dir_index *index, const struct stat *st )
+{
+    return is_dir_unchanged( st, index->dev, index->ino, index->mtime, index->scan_time );
+}
+
+/* find a name in a directory through its cached index; unix_name contains the directory name.
+ * Returns STATUS_NOT_FOUND if there is no usable index and the directory has to be scanned. */
+static NTSTATUS find_file_in_dir_index( char *unix_name, int pos, const WCHAR *name, int length,
+                                        BOOLEAN check_short_names )
+{
+    struct dir_index *index;
+    const char *found;
+    struct stat st;
+
+    if (stat( unix_name, &st ) == -1) return errno_to_status( errno );
+
+    mutex_lock( &dir_index_mutex );
+    LIST_FOR_EACH_ENTRY( index, &dir_index_cache, struct dir_index, entry )
+    {
+        if (index->dev != st.st_dev || index->ino != st.st_ino) continue;
+        list_remove( &index->entry );
+        if ((check_short_names && !index->short_names) ||
+            !(found = lookup_dir_index( index, name, length, check_short_names )))
+        {
+            /* a missing name means that the directory has to be scanned again if the index may be stale */
+            if (is_dir_index_current( index, &st ) && (!check_short_names || index->short_names))
+            {
+                list_add_head( &dir_index_cache, &index->entry );
+                mutex_unlock( &dir_index_mutex );
+                return STATUS_OBJECT_PATH_NOT_FOUND;
+            }
+        }
+        else
+        {
+            unix_name[pos - 1] = '/';
+            strcpy( unix_name + pos, found );
+            if (!lstat( unix_name, &st ))
+            {
+                list_add_head( &dir_index_cache, &index->entry );
+                mutex_unlock( &dir_index_mutex );
+                return STATUS_SUCCESS;
+            }
+            if (pos > 1) unix_name[pos - 1] = 0;
+            else unix_name[1] = 0;  /* keep the initial slash */
+        }
+        free_dir_index( index );
+        dir_index_count--;
+        break;
+    }
+    mutex_unlock( &dir_index_mutex );
+    return STATUS_NOT_FOUND;
+}
+
+/* build and cache the index of a directory that was found to be large */
+static void cache_dir_index( const char *unix_name, BOOLEAN short_names )
+{
+    struct dir_index *index, *old, *next;
+    NTSTATUS status;
+
+    if (!(index = build_dir_index( unix_name, short_names, &status ))) return;
+
+    mutex_lock( &dir_index_mutex );
+    LIST_FOR_EACH_ENTRY_SAFE( old, next, &dir_index_cache, struct dir_index, entry )
+    {
+        /* replace the index built by another thread, or drop the least recently used one */
+        if ((old->dev == index->dev && old->ino == index->ino) ||
+            (dir_index_count == DIR_INDEX_MAX_DIRS && !list_next( &dir_index_cache, &old->entry )))
+        {
+            list_remove( &old->entry );
+            free_dir_index( old );
+            dir_index_count--;
+        }
+    }
+    list_add_head( &dir_index_cache, &index->entry );
+    dir_index_count++;
+    mutex_unlock( &dir_index_mutex );
+}
+
+
 /***********************************************************************
  *           find_file_in_dir
  *
@@ -2545,6 +2962,8 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
     DIR *dir;
     struct dirent *de;
     struct stat st;
+    unsigned int count = 0;
+    NTSTATUS status;
     int ret;
 
     /* try a shortcut for this directory */
@@ -2624,18 +3043,18 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
     }
 #endif /* VFAT_IOCTL_READDIR_BOTH */
 
+    status = find_file_in_dir_index( unix_name, pos, name, length, is_name_8_dot_3 );
+    if (!status) goto success;
+    if (status == STATUS_OBJECT_PATH_NOT_FOUND) goto not_found;
+    if (status != STATUS_NOT_FOUND) return status;
+
     if (!(dir = opendir( unix_name ))) return errno_to_status( errno );
 
-    unix_name[pos - 1] = '/';
     while ((de = readdir( dir )))
     {
+        count++;
         ret = ntdll_umbstowcs( de->d_name, strlen(de->d_name), buffer, MAX_DIR_ENTRY_LEN );
-        if (ret == length && !wcsnicmp( buffer, name, ret ))
-        {
-            strcpy( unix_name + pos, de->d_name );
-            closedir( dir );
-            goto success;
-        }
+        if (ret == length && !wcsnicmp( buffer, name, ret )) break;
 
         if (!is_name_8_dot_3) continue;
 
@@ -2643,14 +3062,20 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
         {
             WCHAR short_nameW[12];
             ret = hash_short_file_name( buffer, ret, short_nameW );
-            if (ret == length && !wcsnicmp( short_nameW, name, length ))
-            {
-                strcpy( unix_name + pos, de->d_name );
-                closedir( dir );
-                goto success;
-            }
+            if (ret == length && !wcsnicmp( short_nameW, name, length )) break;
         }
     }
+
+    /* index large directories so that the next lookups don't need to scan them */
+    if (count >= DIR_INDEX_MIN_ENTRIES) cache_dir_index( unix_name, is_name_8_dot_3 );
+
+    if (de)
+    {
+        unix_name[pos - 1] = '/';
+        strcpy( unix_name + pos, de->d_name );
+        closedir( dir );
+        goto success;
+    }
     closedir( dir );
 
 not_found:
@@ -5483,6 +5908,372 @@ static NTSTATUS cancel_async_file_read( HANDLE handle, IO_STATUS_BLOCK *io )
     return count ? STATUS_SUCCESS : STATUS_NOT_FOUND;
 }
 
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup)
+
+/* optional io_uring backend for overlapped reads and writes on regular files, enabled
+ * with WINE_IO_URING=1; requests are submitted directly from the calling thread and
+ * completed by a dedicated reaper thread, without creating server async objects */
+
+#define URING_ENTRIES 256
+#define URING_CANCEL_TAG 1  /* set in the user data of cancellation requests */
+
+struct uring_job
+{
+    HANDLE        handle;       /* handle the request was queued on, only used to match cancellations */
+    HANDLE        completion;   /* duplicate of the handle to post the completion through */
+    int           unix_handle;  /* fd owned by the job */
+    HANDLE        event;
+    IO_STATUS_BLOCK *io;
+    struct iovec  iov;
+    ULONG_PTR     cvalue;
+    off_t         offset;
+    DWORD         thread_id;
+    BOOL          write;
+    LONG          cancelled;
+    unsigned int  refs;         /* request and pending cancellations, protected by uring_mutex */
+    struct list   entry;
+};
+
+static struct
+{
+    int                  fd;
+    unsigned int        *sq_head;
+    unsigned int        *sq_tail;
+    unsigned int        *sq_mask;
+    unsigned int        *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned int        *cq_head;
+    unsigned int        *cq_tail;
+    unsigned int        *cq_mask;
+    struct io_uring_cqe *cqes;
+    unsigned int         cq_entries;
+    unsigned int         inflight;
+} uring = { -1 };
+
+static pthread_mutex_t uring_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t uring_once = PTHREAD_ONCE_INIT;
+static struct list uring_jobs = LIST_INIT( uring_jobs );
+
+static int uring_enter( unsigned int to_submit, unsigned int min_complete, unsigned int flags )
+{
+    return syscall( __NR_io_uring_enter, uring.fd, to_submit, min_complete, flags, NULL, 0 );
+}
+
+/* get a free submission entry; must be called with uring_mutex held */
+static struct io_uring_sqe *uring_get_sqe(void)
+{
+    unsigned int tail = *uring.sq_tail;
+    struct io_uring_sqe *sqe;
+
+    if (tail - __atomic_load_n( uring.sq_head, __ATOMIC_ACQUIRE ) > *uring.sq_mask) return NULL;
+    sqe = &uring.sqes[tail & *uring.sq_mask];
+    memset( sqe, 0, sizeof(*sqe) );
+    return sqe;
+}
+
+/* publish and submit the entry returned by uring_get_sqe; must be called with uring_mutex held */
+static BOOL uring_submit_sqe(void)
+{
+    unsigned int tail = *uring.sq_tail;
+    int ret;
+
+    uring.sq_array[tail & *uring.sq_mask] = tail & *uring.sq_mask;
+    __atomic_store_n( uring.sq_tail, tail + 1, __ATOMIC_RELEASE );
+
+    while ((ret = uring_enter( 1, 0, 0 )) == -1 && errno == EINTR);
+    if (ret == 1) return TRUE;
+
+    WARN( "io_uring_enter failed: %d %s\n", ret, strerror( errno ));
+    __atomic_store_n( uring.sq_tail, tail, __ATOMIC_RELEASE );
+    return FALSE;
+}
+
+/* release a reference to a job; must be called with uring_mutex held */
+static void uring_release_job( struct uring_job *job )
+{
+    if (!--job->refs) free( job );
+}
+
+static void uring_complete_job( struct uring_job *job, int res )
+{
+    NTSTATUS status;
+    ULONG total = 0;
+
+    if (res == -EFAULT && !job->write && !job->cancelled)
+    {
+        /* the kernel can't write to pages with write watches or guard pages, fall back to
+         * the locked read path, the same way the synchronous code does */
+        while ((res = virtual_locked_pread( job->unix_handle, job->iov.iov_base, job->iov.iov_len,
+                                            job->offset )) == -1 && errno == EINTR);
+        if (res == -1) res = -errno;
+    }
+
+    if (res == -ECANCELED || (res == -EINTR && job->cancelled))
+        status = STATUS_CANCELLED;
+    else if (res == -EFAULT && job->write)
+        status = STATUS_INVALID_USER_BUFFER;
+    else if (res < 0)
+        status = errno_to_status( -res );
+    else
+    {
+        total = res;
+        status = (total || !job->iov.iov_len || job->write) ? STATUS_SUCCESS : STATUS_END_OF_FILE;
+    }
+
+    TRACE( "handle %p, io %p, status %#x, total %u.\n", job->handle, job->io, status, total );
+
+    close( job->unix_handle );
+
+    job->io->Information = total;
+    __atomic_store_n( &job->io->u.Status, status, __ATOMIC_RELEASE );
+    if (job->event) NtSetEvent( job->event, NULL );
+    if (job->completion)
+    {
+        add_completion( job->completion, job->cvalue, status, total, TRUE );
+        NtClose( job->completion );
+    }
+
+    /* the job stays allocated until the kernel is done with the cancellations that refer to it */
+    pthread_mutex_lock( &uring_mutex );
+    list_remove( &job->entry );
+    uring.inflight--;
+    uring_release_job( job );
+    pthread_mutex_unlock( &uring_mutex );
+}
+
+static void CALLBACK uring_thread( void *arg )
+{
+    struct io_uring_cqe *cqe;
+    unsigned int head;
+    struct uring_job *job;
+    ULONG_PTR user_data;
+    int res;
+
+    for (;;)
+    {
+        head = *uring.cq_head;
+        if (head == __atomic_load_n( uring.cq_tail, __ATOMIC_ACQUIRE ))
+        {
+            if (uring_enter( 0, 1, IORING_ENTER_GETEVENTS ) == -1 && errno != EINTR)
+                ERR( "io_uring_enter failed: %s\n", strerror( errno ));
+            continue;
+        }
+
+        cqe = &uring.cqes[head & *uring.cq_mask];
+        user_data = cqe->user_data;
+        res = cqe->res;
+        __atomic_store_n( uring.cq_head, head + 1, __ATOMIC_RELEASE );
+
+        job = (struct uring_job *)(user_data & ~(ULONG_PTR)URING_CANCEL_TAG);
+        if (user_data & URING_CANCEL_TAG)
+        {
+            pthread_mutex_lock( &uring_mutex );
+            uring.inflight--;
+            uring_release_job( job );
+            pthread_mutex_unlock( &uring_mutex );
+        }
+        else uring_complete_job( job, res );
+    }
+}
+
+static void uring_init(void)
+{
+    struct io_uring_params params;
+    const char *env = getenv( "WINE_IO_URING" );
+    size_t sq_size, cq_size, sqes_size;
+    char *sq_ptr = MAP_FAILED, *cq_ptr = MAP_FAILED;
+    void *sqes = MAP_FAILED;
+    HANDLE thread;
+    int fd;
+
+    if (!env || !atoi( env )) return;
+
+    memset( &params, 0, sizeof(params) );
+    if ((fd = syscall( __NR_io_uring_setup, URING_ENTRIES, &params )) == -1)
+    {
+        WARN( "io_uring not available: %s\n", strerror( errno ));
+        return;
+    }
+
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) sq_size = cq_size = max( sq_size, cq_size );
+
+    sq_ptr = mmap( NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING );
+    if (sq_ptr == MAP_FAILED) goto failed;
+    if (params.features & IORING_FEAT_SINGLE_MMAP) cq_ptr = sq_ptr;
+    else cq_ptr = mmap( NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING );
+    if (cq_ptr == MAP_FAILED) goto failed;
+    sqes = mmap( NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES );
+    if (sqes == MAP_FAILED) goto failed;
+
+    uring.fd         = fd;
+    uring.sq_head    = (unsigned int *)(sq_ptr + params.sq_off.head);
+    uring.sq_tail    = (unsigned int *)(sq_ptr + params.sq_off.tail);
+    uring.sq_mask    = (unsigned int *)(sq_ptr + params.sq_off.ring_mask);
+    uring.sq_array   = (unsigned int *)(sq_ptr + params.sq_off.array);
+    uring.sqes       = sqes;
+    uring.cq_head    = (unsigned int *)(cq_ptr + params.cq_off.head);
+    uring.cq_tail    = (unsigned int *)(cq_ptr + params.cq_off.tail);
+    uring.cq_mask    = (unsigned int *)(cq_ptr + params.cq_off.ring_mask);
+    uring.cqes       = (struct io_uring_cqe *)(cq_ptr + params.cq_off.cqes);
+    uring.cq_entries = params.cq_entries;
+
+    if (NtCreateThreadEx( &thread, THREAD_ALL_ACCESS, NULL, GetCurrentProcess(),
+                          uring_thread, NULL, 0, 0, 0, 0, NULL ))
+    {
+        uring.fd = -1;
+        goto failed;
+    }
+    NtClose( thread );
+
+    TRACE( "using io_uring, %u submission and %u completion entries.\n", params.sq_entries, params.cq_entries );
+    return;
+
+failed:
+    WARN( "failed to set up io_uring: %s\n", strerror( errno ));
+    if (sqes != MAP_FAILED) munmap( sqes, sqes_size );
+    if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) munmap( cq_ptr, cq_size );
+    if (sq_ptr != MAP_FAILED) munmap( sq_ptr, sq_size );
+    close( fd );
+}
+
+/* queue an overlapped read or write on a regular file; returns STATUS_PENDING
+ * if the request was submitted, STATUS_NOT_SUPPORTED if the caller should
+ * perform it synchronously */
+static NTSTATUS uring_queue_file_io( HANDLE handle, int unix_handle, int needs_close, HANDLE event,
+                                     IO_STATUS_BLOCK *io, void *buffer, ULONG length, off_t offset,
+                                     ULONG_PTR cvalue, BOOL write )
+{
+    struct io_uring_sqe *sqe;
+    struct uring_job *job;
+
+    pthread_once( &uring_once, uring_init );
+    if (uring.fd == -1) return STATUS_NOT_SUPPORTED;
+
+    if (!(job = malloc( sizeof(*job) ))) return STATUS_NOT_SUPPORTED;
+    /* the handle may be closed or reused before the request completes, so the job keeps
+     * its own fd and its own handle to the file for posting the completion */
+    job->completion = 0;
+    if (cvalue && NtDuplicateObject( NtCurrentProcess(), handle, NtCurrentProcess(), &job->completion,
+                                     0, 0, DUPLICATE_SAME_ACCESS ))
+    {
+        free( job );
+        return STATUS_NOT_SUPPORTED;
+    }
+    if (!needs_close && (unix_handle = dup( unix_handle )) == -1)
+    {
+        if (job->completion) NtClose( job->completion );
+        free( job );
+        return STATUS_NOT_SUPPORTED;
+    }
+    job->handle       = handle;
+    job->unix_handle  = unix_handle;
+    job->event        = event;
+    job->io           = io;
+    job->iov.iov_base = buffer;
+    job->iov.iov_len  = length;
+    job->cvalue       = cvalue;
+    job->offset       = offset;
+    job->thread_id    = GetCurrentThreadId();
+    job->write        = write;
+    job->cancelled    = 0;
+    job->refs         = 1;
+
+    io->u.Status = STATUS_PENDING;
+    io->Information = 0;
+    NtResetEvent( event, NULL );
+
+    pthread_mutex_lock( &uring_mutex );
+    if (uring.inflight >= uring.cq_entries || !(sqe = uring_get_sqe()))
+    {
+        pthread_mutex_unlock( &uring_mutex );
+        goto failed;
+    }
+    /* vectored variants are supported since the first io_uring release */
+    sqe->opcode    = write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->fd        = unix_handle;
+    sqe->addr      = (ULONG_PTR)&job->iov;
+    sqe->len       = 1;
+    sqe->off       = offset;
+    sqe->user_data = (ULONG_PTR)job;
+
+    list_add_tail( &uring_jobs, &job->entry );
+    uring.inflight++;
+    if (!uring_submit_sqe())
+    {
+        list_remove( &job->entry );
+        uring.inflight--;
+        pthread_mutex_unlock( &uring_mutex );
+        goto failed;
+    }
+    pthread_mutex_unlock( &uring_mutex );
+
+    TRACE( "handle %p, io %p, %s %u bytes at %s.\n", handle, io, write ? "write" : "read",
+           length, wine_dbgstr_longlong( offset ));
+    return STATUS_PENDING;
+
+failed:
+    if (!needs_close) close( job->unix_handle );
+    if (job->completion) NtClose( job->completion );
+    free( job );
+    return STATUS_NOT_SUPPORTED;
+}
+
+static NTSTATUS uring_cancel_file_io( HANDLE handle, IO_STATUS_BLOCK *io )
+{
+    DWORD thread_id = GetCurrentThreadId();
+    struct io_uring_sqe *sqe;
+    struct uring_job *job;
+    unsigned int count = 0;
+
+    if (uring.fd == -1) return STATUS_NOT_FOUND;
+
+    TRACE( "handle %p, io %p.\n", handle, io );
+
+    pthread_mutex_lock( &uring_mutex );
+    LIST_FOR_EACH_ENTRY( job, &uring_jobs, struct uring_job, entry )
+    {
+        if (io ? job->io != io : (job->handle != handle || job->thread_id != thread_id)) continue;
+        if (InterlockedCompareExchange( &job->cancelled, 1, 0 )) continue;
+        ++count;
+
+        /* the job is completed by the reaper thread once the kernel reports it, and
+         * released when the cancellation completes, so that its address isn't reused */
+        if (uring.inflight >= uring.cq_entries || !(sqe = uring_get_sqe())) continue;
+        sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+        sqe->fd        = -1;
+        sqe->addr      = (ULONG_PTR)job;
+        sqe->user_data = (ULONG_PTR)job | URING_CANCEL_TAG;
+        job->refs++;
+        uring.inflight++;
+        if (!uring_submit_sqe())
+        {
+            job->refs--;
+            uring.inflight--;
+        }
+    }
+    pthread_mutex_unlock( &uring_mutex );
+    return count ? STATUS_SUCCESS : STATUS_NOT_FOUND;
+}
+
+#else
+
+static NTSTATUS uring_queue_file_io( HANDLE handle, int unix_handle, int needs_close, HANDLE event,
+                                     IO_STATUS_BLOCK *io, void *buffer, ULONG length, off_t offset,
+                                     ULONG_PTR cvalue, BOOL write )
+{
+    return STATUS_NOT_SUPPORTED;
+}
+
+static NTSTATUS uring_cancel_file_io( HANDLE handle, IO_STATUS_BLOCK *io )
+{
+    return STATUS_NOT_FOUND;
+}
+
+#endif  /* HAVE_LINUX_IO_URING_H */
+
 /******************************************************************************
  *              NtReadFile   (NTDLL.@)
  */
@@ -5529,6 +6320,15 @@ NTSTATUS WINAPI NtReadFile( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, vo
             goto err;
         }
 
+        if (async_read && length && event && !apc &&
+            uring_queue_file_io( handle, unix_handle, needs_close, event, io, buffer, length,
+                                 offset->QuadPart, cvalue, FALSE ) == STATUS_PENDING)
+        {
+            status = STATUS_PENDING;
+            needs_close = 0;
+            goto err;
+        }
+
         if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
         {
             /* async I/O doesn't make sense on regular files */
@@ -5842,6 +6642,15 @@ NTSTATUS WINAPI NtWriteFile( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, v
                 goto done;
             }
 
+            if (async_write && length && event && !apc &&
+                uring_queue_file_io( handle, unix_handle, needs_close, event, io, (void *)buffer,
+                                     length, off, cvalue, TRUE ) == STATUS_PENDING)
+            {
+                status = STATUS_PENDING;
+                needs_close = 0;
+                goto err;
+            }
+
             /* async I/O doesn't make sense on regular files */
             while ((result = pwrite( unix_handle, buffer, length, off )) == -1)
             {
@@ -6876,6 +7685,8 @@ NTSTATUS WINAPI NtCancelIoFile( HANDLE handle, IO_STATUS_BLOCK *io_status )
 {
     if (ac_odyssey && !cancel_async_file_read( handle, NULL ))
         return (io_status->u.Status = STATUS_SUCCESS);
+    if (!uring_cancel_file_io( handle, NULL ))
+        return (io_status->u.Status = STATUS_SUCCESS);
 
     SERVER_START_REQ( cancel_async )
     {
@@ -6895,6 +7706,8 @@ NTSTATUS WINAPI NtCancelIoFileEx( HANDLE handle, IO_STATUS_BLOCK *io, IO_STATUS_
 {
     if (ac_odyssey && !cancel_async_file_read( handle, io ))
         return (io_status->u.Status = STATUS_SUCCESS);
+    if (!uring_cancel_file_io( handle, io ))
+        return (io_status->u.Status = STATUS_SUCCESS);
 
     SERVER_START_REQ( cancel_async )
     {
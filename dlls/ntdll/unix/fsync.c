@@ -55,6 +55,7 @@
 #include "fsync.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(fsync);
+WINE_DECLARE_DEBUG_CHANNEL(fsyncstat);
 
 #include "pshpack4.h"
 #include "poppack.h"
@@ -155,7 +156,9 @@ static inline int futex_wait( int *addr, int val, const ULONGLONG *end )
     }
 }
 
-static unsigned int spincount = 100;
+static unsigned int spincount = 100;      /* initial spin count for new objects */
+static unsigned int max_spincount = 800;  /* upper bound for adaptive spinning */
+static int use_shm_reply = 1;
 
 int do_fsync(void)
 {
@@ -175,7 +178,14 @@ int do_fsync(void)
         syscall( __NR_futex_waitv, NULL, 0, 0, NULL, 0 );
         do_fsync_cached = getenv("WINEFSYNC") && atoi(getenv("WINEFSYNC")) && errno != ENOSYS;
         if (getenv("WINEFSYNC_SPINCOUNT"))
+        {
             spincount = atoi(getenv("WINEFSYNC_SPINCOUNT"));
+            max_spincount = spincount * 8;
+        }
+        if (getenv("WINEFSYNC_MAX_SPINCOUNT"))
+            max_spincount = max( spincount, atoi(getenv("WINEFSYNC_MAX_SPINCOUNT")) );
+        if (getenv("WINEFSYNC_SHM_REPLY"))
+            use_shm_reply = atoi(getenv("WINEFSYNC_SHM_REPLY"));
     }
 
     return do_fsync_cached;
@@ -190,9 +200,106 @@ int do_fsync(void)
 struct fsync
 {
     enum fsync_type type;
+    int spin;               /* adaptive spin count, in the esync eventfd slot */
     void *shm;              /* pointer to shm section */
 };
 
+/* Per-object wait statistics, collected when the fsyncstat debug channel is
+ * enabled, and dumped when the process exits. */
+
+enum fsync_stat
+{
+    FSYNC_STAT_FAST,        /* acquired without spinning */
+    FSYNC_STAT_SPIN,        /* acquired while spinning */
+    FSYNC_STAT_SLEEP,       /* had to wait on the futex */
+    FSYNC_STAT_WAKE,        /* futex wakes issued */
+    FSYNC_STAT_COUNT
+};
+
+struct fsync_stats
+{
+    void *shm;
+    LONG  counts[FSYNC_STAT_COUNT];
+    LONG  spin;             /* last adaptive spin count */
+};
+
+#define FSYNC_STATS_SIZE 4096
+
+static struct fsync_stats *fsync_stats;
+
+static struct fsync_stats *get_stats( void *shm )
+{
+    struct fsync_stats *table = fsync_stats, *stats;
+    unsigned int i, hash = ((ULONG_PTR)shm >> 3) % FSYNC_STATS_SIZE;
+
+    if (!table)
+    {
+        if (!(table = calloc( FSYNC_STATS_SIZE, sizeof(*table) ))) return NULL;
+        if (InterlockedCompareExchangePointer( (void **)&fsync_stats, table, NULL ))
+        {
+            free( table );
+            table = fsync_stats;
+        }
+    }
+
+    for (i = 0; i < FSYNC_STATS_SIZE; i++)
+    {
+        stats = &table[(hash + i) % FSYNC_STATS_SIZE];
+        if (stats->shm == shm) return stats;
+        if (!stats->shm && !InterlockedCompareExchangePointer( &stats->shm, shm, NULL )) return stats;
+        if (stats->shm == shm) return stats;
+    }
+    return NULL;  /* table is full */
+}
+
+static inline void update_stats( struct fsync *obj, enum fsync_stat stat )
+{
+    struct fsync_stats *stats;
+
+    if (!TRACE_ON(fsyncstat)) return;
+    if (!(stats = get_stats( obj->shm ))) return;
+    InterlockedIncrement( &stats->counts[stat] );
+    stats->spin = obj->spin;
+}
+
+void fsync_dump_stats(void)
+{
+    struct fsync_stats *stats;
+    unsigned int i;
+
+    if (!TRACE_ON(fsyncstat) || !fsync_stats) return;
+
+    for (i = 0; i < FSYNC_STATS_SIZE; i++)
+    {
+        stats = &fsync_stats[i];
+        if (!stats->shm) continue;
+        TRACE_(fsyncstat)( "object %p: fast %d, spin %d, sleep %d, wake %d, spin count %d\n", stats->shm,
+                           stats->counts[FSYNC_STAT_FAST], stats->counts[FSYNC_STAT_SPIN],
+                           stats->counts[FSYNC_STAT_SLEEP], stats->counts[FSYNC_STAT_WAKE], stats->spin );
+    }
+}
+
+/* Adapt the spin count of an object to its contention history: move towards
+ * twice the number of spins it took to acquire it when spinning paid off, and
+ * back off when the wait had to sleep anyway. */
+static void update_spin( struct fsync *obj, unsigned int spins, BOOL acquired )
+{
+    int spin = obj->spin;
+
+    if (acquired)
+    {
+        update_stats( obj, spins ? FSYNC_STAT_SPIN : FSYNC_STAT_FAST );
+        if (!spins) return;
+        spin += ((int)min( spins * 2, max_spincount ) - spin) / 8;
+    }
+    else
+    {
+        update_stats( obj, FSYNC_STAT_SLEEP );
+        spin -= spin / 8;
+    }
+    obj->spin = max( spin, spincount / 8 );
+}
+
 struct semaphore
 {
     int count;
@@ -259,58 +366,40 @@ static void *get_shm( unsigned int idx )
     return ret;
 }
 
-/* We'd like lookup to be fast. To that end, we use a static list indexed by handle.
- * This is copied and adapted from the fd cache code. */
+/* We'd like lookup to be fast. To that end, objects are stored in the handle
+ * cache shared with the fd cache, so that a single lookup finds them. */
 
-#define FSYNC_LIST_BLOCK_SIZE  (65536 / sizeof(struct fsync))
-#define FSYNC_LIST_ENTRIES     256
-
-static struct fsync *fsync_list[FSYNC_LIST_ENTRIES];
-static struct fsync fsync_list_initial_block[FSYNC_LIST_BLOCK_SIZE];
-
-static inline UINT_PTR handle_to_index( HANDLE handle, UINT_PTR *entry )
-{
-    UINT_PTR idx = (((UINT_PTR)handle) >> 2) - 1;
-    *entry = idx / FSYNC_LIST_BLOCK_SIZE;
-    return idx % FSYNC_LIST_BLOCK_SIZE;
-}
+C_ASSERT( sizeof(struct fsync) == sizeof(((struct handle_cache_entry *)0)->sync) );
+C_ASSERT( offsetof( struct fsync, shm ) == offsetof( struct handle_cache_entry, sync.shm ) - offsetof( struct handle_cache_entry, sync ) );
 
 static struct fsync *add_to_list( HANDLE handle, enum fsync_type type, void *shm )
 {
-    UINT_PTR entry, idx = handle_to_index( handle, &entry );
+    struct handle_cache_entry *entry = get_handle_cache_entry( handle, TRUE );
+    struct fsync *obj;
 
-    if (entry >= FSYNC_LIST_ENTRIES)
+    if (!entry)
     {
         FIXME( "too many allocated handles, not caching %p\n", handle );
-        return FALSE;
+        return NULL;
     }
 
-    if (!fsync_list[entry])  /* do we need to allocate a new block of entries? */
+    obj = (struct fsync *)&entry->sync;
+    if (!__sync_val_compare_and_swap((int *)&obj->type, 0, type ))
     {
-        if (!entry) fsync_list[0] = fsync_list_initial_block;
-        else
-        {
-            void *ptr = anon_mmap_alloc( FSYNC_LIST_BLOCK_SIZE * sizeof(struct fsync),
-                                         PROT_READ | PROT_WRITE );
-            if (ptr == MAP_FAILED) return FALSE;
-            fsync_list[entry] = ptr;
-        }
+        obj->spin = spincount;
+        obj->shm = shm;
     }
 
-    if (!__sync_val_compare_and_swap((int *)&fsync_list[entry][idx].type, 0, type ))
-        fsync_list[entry][idx].shm = shm;
-
-    return &fsync_list[entry][idx];
+    return obj;
 }
 
 static struct fsync *get_cached_object( HANDLE handle )
 {
-    UINT_PTR entry, idx = handle_to_index( handle, &entry );
+    struct handle_cache_entry *entry = get_handle_cache_entry( handle, FALSE );
 
-    if (entry >= FSYNC_LIST_ENTRIES || !fsync_list[entry]) return NULL;
-    if (!fsync_list[entry][idx].type) return NULL;
+    if (!entry || !entry->sync.type) return NULL;
 
-    return &fsync_list[entry][idx];
+    return (struct fsync *)&entry->sync;
 }
 
 /* Gets an object. This is either a proper fsync object (i.e. an event,
@@ -356,17 +445,47 @@ static NTSTATUS get_object( HANDLE handle, struct fsync **obj )
     return ret;
 }
 
-NTSTATUS fsync_close( HANDLE handle )
+/* Retrieve the objects for all the uncached handles of a wait at once,
+ * instead of doing a server round trip for each of them. */
+static void prefetch_objects( DWORD count, const HANDLE *handles )
 {
-    UINT_PTR entry, idx = handle_to_index( handle, &entry );
+    struct __server_request_info reqs[SERVER_MAX_BATCH], *ptrs[SERVER_MAX_BATCH];
+    HANDLE batch[SERVER_MAX_BATCH];
+    unsigned int i, nb = 0;
 
-    TRACE("%p.\n", handle);
+    for (i = 0; i < count && nb < SERVER_MAX_BATCH; i++)
+    {
+        if ((INT_PTR)handles[i] < 0 || get_cached_object( handles[i] )) continue;
+
+        memset( &reqs[nb].u.req, 0, sizeof(reqs[nb].u.req) );
+        reqs[nb].u.req.request_header.req = REQ_get_fsync_idx;
+        reqs[nb].u.req.get_fsync_idx_request.handle = wine_server_obj_handle( handles[i] );
+        reqs[nb].data_count = 0;
+        ptrs[nb] = &reqs[nb];
+        batch[nb++] = handles[i];
+    }
+
+    /* a single request will be done by get_object anyway */
+    if (nb < 2 || server_call_batch( ptrs, nb )) return;
 
-    if (entry < FSYNC_LIST_ENTRIES && fsync_list[entry])
+    for (i = 0; i < nb; i++)
     {
-        if (__atomic_exchange_n( &fsync_list[entry][idx].type, 0, __ATOMIC_SEQ_CST ))
-            return STATUS_SUCCESS;
+        const struct get_fsync_idx_reply *reply = &reqs[i].u.reply.get_fsync_idx_reply;
+
+        if (reply->__header.error) continue;
+        TRACE("Got shm index %d for handle %p.\n", reply->shm_idx, batch[i]);
+        add_to_list( batch[i], reply->type, get_shm( reply->shm_idx ) );
     }
+}
+
+NTSTATUS fsync_close( HANDLE handle )
+{
+    struct handle_cache_entry *entry = get_handle_cache_entry( handle, FALSE );
+
+    TRACE("%p.\n", handle);
+
+    if (entry && __atomic_exchange_n( &entry->sync.type, 0, __ATOMIC_SEQ_CST ))
+        return STATUS_SUCCESS;
 
     return STATUS_INVALID_HANDLE;
 }
@@ -482,6 +601,58 @@ void fsync_init(void)
 
     shm_addrs = calloc( 128, sizeof(shm_addrs[0]) );
     shm_addrs_size = 128;
+
+    fsync_init_thread();
+}
+
+/* Ask the server to write our replies to a shm block instead of the reply
+ * pipe, so that waiting for them can usually be done without a syscall. */
+void fsync_init_thread(void)
+{
+    unsigned int idx = 0;
+
+    if (!use_shm_reply) return;
+
+    SERVER_START_REQ( get_fsync_reply_idx )
+    {
+        if (!wine_server_call( req ))
+            idx = reply->shm_idx;
+    }
+    SERVER_END_REQ;
+
+    if (idx) ntdll_get_thread_data()->fsync_reply = get_shm( idx );
+}
+
+/* Wait for the reply to the current request; called with server signals blocked. */
+unsigned int fsync_wait_reply( struct __server_request_info *req )
+{
+    char *block = ntdll_get_thread_data()->fsync_reply;
+    int *state = (int *)block;
+    unsigned int spin;
+    int value;
+
+    for (spin = 0; spin < spincount; spin++)
+    {
+        if (__atomic_load_n( state, __ATOMIC_ACQUIRE ) != SHM_REPLY_PENDING) break;
+        small_pause();
+    }
+
+    for (;;)
+    {
+        value = SHM_REPLY_PENDING;
+        if (__atomic_compare_exchange_n( state, &value, SHM_REPLY_WAITING, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ))
+            value = SHM_REPLY_WAITING;
+
+        if (value == SHM_REPLY_READY) break;
+        if (value == SHM_REPLY_CLOSED) abort_thread(0);
+        futex_wait( state, SHM_REPLY_WAITING, NULL );
+    }
+
+    memcpy( &req->u.reply, block + SHM_REPLY_HEADER_SIZE, sizeof(req->u.reply) );
+    if (req->u.reply.reply_header.reply_size)
+        memcpy( req->reply_data, block + SHM_REPLY_HEADER_SIZE + sizeof(req->u.reply),
+                req->u.reply.reply_header.reply_size );
+    return req->u.reply.reply_header.error;
 }
 
 NTSTATUS fsync_create_semaphore( HANDLE *handle, ACCESS_MASK access,
@@ -523,6 +694,7 @@ NTSTATUS fsync_release_semaphore( HANDLE handle, ULONG count, ULONG *prev )
     if (prev) *prev = current;
 
     futex_wake( &semaphore->count, INT_MAX );
+    update_stats( obj, FSYNC_STAT_WAKE );
 
     return STATUS_SUCCESS;
 }
@@ -579,7 +751,10 @@ NTSTATUS fsync_set_event( HANDLE handle, LONG *prev )
     event = obj->shm;
 
     if (!(current = __atomic_exchange_n( &event->signaled, 1, __ATOMIC_SEQ_CST )))
+    {
         futex_wake( &event->signaled, INT_MAX );
+        update_stats( obj, FSYNC_STAT_WAKE );
+    }
 
     if (prev) *prev = current;
 
@@ -621,7 +796,10 @@ NTSTATUS fsync_pulse_event( HANDLE handle, LONG *prev )
      * Unfortunately we can't really do much better. Fortunately this is rarely
      * used (and publicly deprecated). */
     if (!(current = __atomic_exchange_n( &event->signaled, 1, __ATOMIC_SEQ_CST )))
+    {
         futex_wake( &event->signaled, INT_MAX );
+        update_stats( obj, FSYNC_STAT_WAKE );
+    }
 
     /* Try to give other threads a chance to wake up. Hopefully erring on this
      * side is the better thing to do... */
@@ -690,6 +868,7 @@ NTSTATUS fsync_release_mutex( HANDLE handle, LONG *prev )
     {
         __atomic_store_n( &mutex->tid, 0, __ATOMIC_SEQ_CST );
         futex_wake( &mutex->tid, INT_MAX );
+        update_stats( obj, FSYNC_STAT_WAKE );
     }
 
     return STATUS_SUCCESS;
@@ -763,6 +942,7 @@ static NTSTATUS __fsync_wait_objects( DWORD count, const HANDLE *handles,
     LARGE_INTEGER now;
     DWORD waitcount;
     ULONGLONG end;
+    BOOL poll;
     int i, ret;
 
     /* Grab the APC futex if we don't already have it. */
@@ -794,6 +974,11 @@ static NTSTATUS __fsync_wait_objects( DWORD count, const HANDLE *handles,
             end = now.QuadPart - timeout->QuadPart;
     }
 
+    /* a failed poll says nothing about how long the object stays contended */
+    poll = timeout && !timeout->QuadPart;
+
+    if (count > 1) prefetch_objects( count, handles );
+
     for (i = 0; i < count; i++)
     {
         ret = get_object( handles[i], &objs[i] );
@@ -872,17 +1057,19 @@ static NTSTATUS __fsync_wait_objects( DWORD count, const HANDLE *handles,
                          * to use a dedicated interlocked_dec_if_nonzero()
                          * helper, but nesting loops like that is probably not
                          * great for performance... */
-                        for (spin = 0; spin <= spincount || current; ++spin)
+                        for (spin = 0; spin <= obj->spin || current; ++spin)
                         {
                             if ((current = __atomic_load_n( &semaphore->count, __ATOMIC_SEQ_CST ))
                                     && __sync_val_compare_and_swap( &semaphore->count, current, current - 1 ) == current)
                             {
                                 TRACE("Woken up by handle %p [%d].\n", handles[i], i);
+                                update_spin( obj, spin, TRUE );
                                 return i;
                             }
                             small_pause();
                         }
 
+                        if (!poll) update_spin( obj, spin, FALSE );
                         futex_vector_set( &futexes[i], &semaphore->count, 0 );
                         break;
                     }
@@ -898,11 +1085,12 @@ static NTSTATUS __fsync_wait_objects( DWORD count, const HANDLE *handles,
                             return i;
                         }
 
-                        for (spin = 0; spin <= spincount; ++spin)
+                        for (spin = 0; spin <= obj->spin; ++spin)
                         {
                             if (!(tid = __sync_val_compare_and_swap( &mutex->tid, 0, GetCurrentThreadId() )))
                             {
                                 TRACE("Woken up by handle %p [%d].\n", handles[i], i);
+                                update_spin( obj, spin, TRUE );
                                 mutex->count = 1;
                                 return i;
                             }
@@ -915,6 +1103,7 @@ static NTSTATUS __fsync_wait_objects( DWORD count, const HANDLE *handles,
                             small_pause();
                         }
 
+                        if (!poll) update_spin( obj, spin, FALSE );
                         futex_vector_set( &futexes[i], &mutex->tid, tid );
                         break;
                     }
@@ -923,7 +1112,7 @@ static NTSTATUS __fsync_wait_objects( DWORD count, const HANDLE *handles,
                     {
                         struct event *event = obj->shm;
 
-                        for (spin = 0; spin <= spincount; ++spin)
+                        for (spin = 0; spin <= obj->spin; ++spin)
                         {
                             if (__sync_val_compare_and_swap( &event->signaled, 1, 0 ))
                             {
@@ -931,11 +1120,13 @@ static NTSTATUS __fsync_wait_objects( DWORD count, const HANDLE *handles,
                                     usleep( 0 );
 
                                 TRACE("Woken up by handle %p [%d].\n", handles[i], i);
+                                update_spin( obj, spin, TRUE );
                                 return i;
                             }
                             small_pause();
                         }
 
+                        if (!poll) update_spin( obj, spin, FALSE );
                         futex_vector_set( &futexes[i], &event->signaled, 0 );
                         break;
                     }
@@ -945,7 +1136,7 @@ static NTSTATUS __fsync_wait_objects( DWORD count, const HANDLE *handles,
                     {
                         struct event *event = obj->shm;
 
-                        for (spin = 0; spin <= spincount; ++spin)
+                        for (spin = 0; spin <= obj->spin; ++spin)
                         {
                             if (__atomic_load_n( &event->signaled, __ATOMIC_SEQ_CST ))
                             {
@@ -953,11 +1144,13 @@ static NTSTATUS __fsync_wait_objects( DWORD count, const HANDLE *handles,
                                     usleep( 0 );
 
                                 TRACE("Woken up by handle %p [%d].\n", handles[i], i);
+                                update_spin( obj, spin, TRUE );
                                 return i;
                             }
                             small_pause();
                         }
 
+                        if (!poll) update_spin( obj, spin, FALSE );
                         futex_vector_set( &futexes[i], &event->signaled, 0 );
                         break;
                     }
@@ -20,7 +20,10 @@
 
 extern int do_fsync(void) DECLSPEC_HIDDEN;
 extern void fsync_init(void) DECLSPEC_HIDDEN;
+extern void fsync_init_thread(void) DECLSPEC_HIDDEN;
+extern unsigned int fsync_wait_reply( struct __server_request_info *req ) DECLSPEC_HIDDEN;
 extern NTSTATUS fsync_close( HANDLE handle ) DECLSPEC_HIDDEN;
+extern void fsync_dump_stats(void) DECLSPEC_HIDDEN;
 
 extern NTSTATUS fsync_create_semaphore(HANDLE *handle, ACCESS_MASK access,
     const OBJECT_ATTRIBUTES *attr, LONG initial, LONG max) DECLSPEC_HIDDEN;
@@ -104,6 +104,9 @@ void     (WINAPI *pKiUserApcDispatcher)(CONTEXT*,ULONG_PTR,ULONG_PTR,ULONG_PTR,P
 NTSTATUS (WINAPI *pKiUserExceptionDispatcher)(EXCEPTION_RECORD*,CONTEXT*) = NULL;
 void     (WINAPI *pLdrInitializeThunk)(CONTEXT*,void**,ULONG_PTR,ULONG_PTR) = NULL;
 void     (WINAPI *pRtlUserThreadStart)( PRTL_THREAD_START_ROUTINE entry, void *arg ) = NULL;
+#ifdef __x86_64__
+PVOID    (WINAPI *pRtlVirtualUnwind)(ULONG,ULONG64,ULONG64,RUNTIME_FUNCTION*,CONTEXT*,PVOID*,ULONG64*,KNONVOLATILE_CONTEXT_POINTERS*) = NULL;
+#endif
 
 static NTSTATUS (CDECL *p__wine_set_unix_funcs)( int version, const struct unix_funcs *funcs );
 static void *syscall_dispatcher;
@@ -144,13 +147,18 @@ struct builtin_module
 {
     struct list    entry;
     struct file_id id;
+    time_t         mtime;
+    off_t          size;
     void          *handle;
     void          *module;
     void          *unix_handle;
 };
 
 static struct list builtin_modules = LIST_INIT( builtin_modules );
+/* protects builtin_modules, the PE loader maps dlls from several threads at startup */
+static pthread_mutex_t builtin_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/* the builtin_mutex must be held while calling this function */
 static NTSTATUS add_builtin_module( void *module, void *handle, const struct stat *st )
 {
     struct builtin_module *builtin;
@@ -162,8 +170,15 @@ static NTSTATUS add_builtin_module( void *module, void *handle, const struct sta
     {
         builtin->id.dev = st->st_dev;
         builtin->id.ino = st->st_ino;
+        builtin->mtime  = st->st_mtime;
+        builtin->size   = st->st_size;
+    }
+    else
+    {
+        memset( &builtin->id, 0, sizeof(builtin->id) );
+        builtin->mtime = 0;
+        builtin->size  = 0;
     }
-    else memset( &builtin->id, 0, sizeof(builtin->id) );
     list_add_tail( &builtin_modules, &builtin->entry );
     return STATUS_SUCCESS;
 }
@@ -901,6 +916,9 @@ static void load_ntdll_functions( HMODULE module )
     GET_FUNC( KiUserApcDispatcher );
     GET_FUNC( LdrInitializeThunk );
     GET_FUNC( RtlUserThreadStart );
+#ifdef __x86_64__
+    GET_FUNC( RtlVirtualUnwind );
+#endif
     GET_FUNC( __wine_set_unix_funcs );
 #undef GET_FUNC
 #define SET_PTR(name,val) \
@@ -1108,6 +1126,7 @@ static NTSTATUS dlopen_dll( const char *so_name, UNICODE_STRING *nt_name, void *
     void *module, *handle;
     const IMAGE_NT_HEADERS *nt;
     BOOL mapped = FALSE;
+    struct stat st;
 
     callback_module = (void *)1;
     if ((handle = dlopen( so_name, RTLD_NOW | RTLD_NOLOAD ))) mapped = TRUE;
@@ -1152,7 +1171,7 @@ static NTSTATUS dlopen_dll( const char *so_name, UNICODE_STRING *nt_name, void *
         return STATUS_IMAGE_ALREADY_LOADED;
     }
 
-    if (add_builtin_module( module, handle, NULL ))
+    if (add_builtin_module( module, handle, stat( so_name, &st ) ? NULL : &st ))
     {
         dlclose( handle );
         return STATUS_NO_MEMORY;
@@ -1236,7 +1255,9 @@ static NTSTATUS CDECL load_so_dll( UNICODE_STRING *nt_name, void **module )
     len = nt_name->Length / sizeof(WCHAR);
     if (len > 3 && !wcsicmp( nt_name->Buffer + len - 3, soW )) nt_name->Length -= 3 * sizeof(WCHAR);
 
+    mutex_lock( &builtin_mutex );
     status = dlopen_dll( unix_name, nt_name, module, &info, FALSE );
+    mutex_unlock( &builtin_mutex );
     free( unix_name );
     return status;
 }
@@ -1329,17 +1350,20 @@ static NTSTATUS open_dll_file( const char *name, OBJECT_ATTRIBUTES *attr, HANDLE
 
     if (!stat( name, st ))
     {
+        mutex_lock( &builtin_mutex );
         LIST_FOR_EACH_ENTRY( builtin, &builtin_modules, struct builtin_module, entry )
         {
             if (builtin->id.dev == st->st_dev && builtin->id.ino == st->st_ino)
             {
                 TRACE( "%s is the same file as existing module %p\n", debugstr_a(name),
                        builtin->module );
+                mutex_unlock( &builtin_mutex );
                 NtClose( handle );
                 *module = builtin->module;
                 return STATUS_SUCCESS;
             }
         }
+        mutex_unlock( &builtin_mutex );
     }
     else memset( st, 0, sizeof(*st) );
 
@@ -1380,13 +1404,13 @@ static NTSTATUS open_dll_file( const char *name, OBJECT_ATTRIBUTES *attr, HANDLE
  */
 static NTSTATUS open_builtin_file( char *name, OBJECT_ATTRIBUTES *attr, HANDLE *mapping, void **module,
                                    SECTION_IMAGE_INFORMATION *image_info, struct stat *st,
-                                   BOOL prefer_native )
+                                   BOOL prefer_native, BOOL pe_only )
 {
     NTSTATUS status;
     int fd;
 
     status = open_dll_file( name, attr, mapping, module, image_info, st, prefer_native );
-    if (status != STATUS_DLL_NOT_FOUND) return status;
+    if (status != STATUS_DLL_NOT_FOUND || pe_only) return status;
 
     /* try .so file */
 
@@ -1397,7 +1421,9 @@ static NTSTATUS open_builtin_file( char *name, OBJECT_ATTRIBUTES *attr, HANDLE *
         {
             pe_image_info_t info;
 
+            mutex_lock( &builtin_mutex );
             status = dlopen_dll( name, attr->ObjectName, module, &info, prefer_native );
+            mutex_unlock( &builtin_mutex );
             if (!status) virtual_fill_image_information( &info, image_info );
             else if (status != STATUS_IMAGE_ALREADY_LOADED)
             {
@@ -1427,7 +1453,22 @@ static NTSTATUS map_builtin_module( HANDLE mapping, void **module, struct stat *
 
     if (!status)
     {
+        struct builtin_module *builtin;
+
+        mutex_lock( &builtin_mutex );
+        /* another thread may have mapped the same file in the meantime */
+        LIST_FOR_EACH_ENTRY( builtin, &builtin_modules, struct builtin_module, entry )
+        {
+            void *existing = builtin->module;
+
+            if (!st->st_ino || builtin->id.dev != st->st_dev || builtin->id.ino != st->st_ino) continue;
+            mutex_unlock( &builtin_mutex );
+            NtUnmapViewOfSection( NtCurrentProcess(), *module );
+            *module = existing;
+            return STATUS_IMAGE_ALREADY_LOADED;
+        }
         status = add_builtin_module( *module, NULL, st );
+        mutex_unlock( &builtin_mutex );
         if (status) NtUnmapViewOfSection( NtCurrentProcess(), *module );
     }
     return status;
@@ -1435,10 +1476,13 @@ static NTSTATUS map_builtin_module( HANDLE mapping, void **module, struct stat *
 
 
 /***********************************************************************
- *           load_builtin_dll
+ *           find_builtin_dll
+ *
+ * Find and map a builtin dll. When prefetching, only PE builtins are mapped, and
+ * STATUS_IMAGE_ALREADY_LOADED is returned for a module that is already mapped.
  */
-static NTSTATUS CDECL load_builtin_dll( UNICODE_STRING *nt_name, void **module, void **unix_entry,
-                                        SECTION_IMAGE_INFORMATION *image_info, BOOL prefer_native )
+static NTSTATUS find_builtin_dll( UNICODE_STRING *nt_name, void **module, void **unix_entry,
+                                  SECTION_IMAGE_INFORMATION *image_info, BOOL prefer_native, BOOL prefetch )
 {
     unsigned int i, pos, namepos, namelen, maxlen = 0;
     unsigned int len = nt_name->Length / sizeof(WCHAR);
@@ -1481,7 +1525,7 @@ static NTSTATUS CDECL load_builtin_dll( UNICODE_STRING *nt_name, void **module,
         ptr = prepend( ptr, ptr, namelen );
         ptr = prepend( ptr, "/dlls", sizeof("/dlls") - 1 );
         ptr = prepend( ptr, build_dir, strlen(build_dir) );
-        status = open_builtin_file( ptr, &attr, &mapping, module, image_info, &st, prefer_native );
+        status = open_builtin_file( ptr, &attr, &mapping, module, image_info, &st, prefer_native, prefetch );
         if (status != STATUS_DLL_NOT_FOUND) goto done;
 
         /* now as a program */
@@ -1492,7 +1536,7 @@ static NTSTATUS CDECL load_builtin_dll( UNICODE_STRING *nt_name, void **module,
         ptr = prepend( ptr, ptr, namelen );
         ptr = prepend( ptr, "/programs", sizeof("/programs") - 1 );
         ptr = prepend( ptr, build_dir, strlen(build_dir) );
-        status = open_builtin_file( ptr, &attr, &mapping, module, image_info, &st, prefer_native );
+        status = open_builtin_file( ptr, &attr, &mapping, module, image_info, &st, prefer_native, prefetch );
         if (status != STATUS_DLL_NOT_FOUND) goto done;
     }
 
@@ -1500,7 +1544,7 @@ static NTSTATUS CDECL load_builtin_dll( UNICODE_STRING *nt_name, void **module,
     {
         file[pos + len + 1] = 0;
         ptr = prepend( file + pos, dll_paths[i], strlen(dll_paths[i]) );
-        status = open_builtin_file( ptr, &attr, &mapping, module, image_info, &st, prefer_native );
+        status = open_builtin_file( ptr, &attr, &mapping, module, image_info, &st, prefer_native, prefetch );
         if (status == STATUS_IMAGE_MACHINE_TYPE_MISMATCH) found_image = TRUE;
         else if (status != STATUS_DLL_NOT_FOUND) goto done;
     }
@@ -1513,17 +1557,46 @@ done:
     {
         status = map_builtin_module( mapping, module, &st );
         NtClose( mapping );
+        if (status == STATUS_IMAGE_ALREADY_LOADED && !prefetch) status = STATUS_SUCCESS;
     }
-    if (!status && ext)
+    else if (!status && prefetch) status = STATUS_IMAGE_ALREADY_LOADED;
+
+    if (!status && ext && !prefetch)
     {
         strcpy( ext, ".so" );
+        mutex_lock( &builtin_mutex );
         dlopen_unix_dll( *module, ptr, unix_entry );
+        mutex_unlock( &builtin_mutex );
     }
     free( file );
     return status;
 }
 
 
+/***********************************************************************
+ *           load_builtin_dll
+ */
+static NTSTATUS CDECL load_builtin_dll( UNICODE_STRING *nt_name, void **module, void **unix_entry,
+                                        SECTION_IMAGE_INFORMATION *image_info, BOOL prefer_native )
+{
+    return find_builtin_dll( nt_name, module, unix_entry, image_info, prefer_native, FALSE );
+}
+
+
+/***********************************************************************
+ *           prefetch_builtin_dll
+ *
+ * Map a PE builtin dll ahead of its load from a loader worker thread.
+ */
+static NTSTATUS CDECL prefetch_builtin_dll( UNICODE_STRING *nt_name, void **module,
+                                            SECTION_IMAGE_INFORMATION *image_info )
+{
+    void *unix_entry = NULL;
+
+    return find_builtin_dll( nt_name, module, &unix_entry, image_info, TRUE, TRUE );
+}
+
+
 /***********************************************************************
  *           unload_builtin_dll
  */
@@ -1531,19 +1604,117 @@ static NTSTATUS CDECL unload_builtin_dll( void *module )
 {
     struct builtin_module *builtin;
 
+    mutex_lock( &builtin_mutex );
     LIST_FOR_EACH_ENTRY( builtin, &builtin_modules, struct builtin_module, entry )
     {
         if (builtin->module != module) continue;
         list_remove( &builtin->entry );
+        mutex_unlock( &builtin_mutex );
         if (builtin->handle) dlclose( builtin->handle );
         if (builtin->unix_handle) dlclose( builtin->unix_handle );
         free( builtin );
         return STATUS_SUCCESS;
     }
+    mutex_unlock( &builtin_mutex );
     return STATUS_INVALID_PARAMETER;
 }
 
 
+/***********************************************************************
+ *           get_builtin_file_id
+ *
+ * Identify the file a builtin module was loaded from, for the import cache.
+ */
+static NTSTATUS CDECL get_builtin_file_id( void *module, struct builtin_file_id *id )
+{
+    struct builtin_module *builtin;
+    NTSTATUS status = STATUS_INVALID_PARAMETER;
+
+    mutex_lock( &builtin_mutex );
+    LIST_FOR_EACH_ENTRY( builtin, &builtin_modules, struct builtin_module, entry )
+    {
+        if (builtin->module != module) continue;
+        if (!builtin->id.dev && !builtin->id.ino) break;
+        id->dev   = builtin->id.dev;
+        id->ino   = builtin->id.ino;
+        id->mtime = builtin->mtime;
+        id->size  = builtin->size;
+        status = STATUS_SUCCESS;
+        break;
+    }
+    mutex_unlock( &builtin_mutex );
+    return status;
+}
+
+
+static char *get_import_cache_path(void)
+{
+    char *path = malloc( strlen(config_dir) + sizeof("/importcache-64") );
+
+    if (path) sprintf( path, "%s/importcache-%u", config_dir, (unsigned int)sizeof(void *) * 8 );
+    return path;
+}
+
+/***********************************************************************
+ *           read_import_cache
+ *
+ * Read the import cache file of the prefix.
+ */
+static NTSTATUS CDECL read_import_cache( void *data, SIZE_T *size )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    struct stat st;
+    char *path;
+    int fd;
+
+    if (!(path = get_import_cache_path())) return STATUS_NO_MEMORY;
+    fd = open( path, O_RDONLY );
+    free( path );
+    if (fd == -1) return STATUS_NOT_FOUND;
+
+    if (fstat( fd, &st ) == -1) status = errno_to_status( errno );
+    else if (st.st_size > *size) status = STATUS_BUFFER_TOO_SMALL;
+    else if (pread( fd, data, st.st_size, 0 ) != st.st_size) status = STATUS_END_OF_FILE;
+    if (!status || status == STATUS_BUFFER_TOO_SMALL) *size = st.st_size;
+    close( fd );
+    return status;
+}
+
+
+/***********************************************************************
+ *           write_import_cache
+ *
+ * Replace the import cache file of the prefix. The file is renamed into
+ * place, so that concurrent processes never read a partial cache.
+ */
+static NTSTATUS CDECL write_import_cache( const void *data, SIZE_T size )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    char *path, *tmp;
+    int fd;
+
+    if (!(path = get_import_cache_path())) return STATUS_NO_MEMORY;
+    if (!(tmp = malloc( strlen(path) + 10 )))
+    {
+        free( path );
+        return STATUS_NO_MEMORY;
+    }
+    sprintf( tmp, "%s.%x", path, (unsigned int)getpid() );
+
+    if ((fd = open( tmp, O_WRONLY | O_CREAT | O_TRUNC, 0666 )) == -1) status = errno_to_status( errno );
+    else
+    {
+        if (write( fd, data, size ) != size) status = STATUS_DISK_FULL;
+        close( fd );
+        if (!status && rename( tmp, path ) == -1) status = errno_to_status( errno );
+        if (status) unlink( tmp );
+    }
+    free( tmp );
+    free( path );
+    return status;
+}
+
+
 #ifdef __FreeBSD__
 /* The PT_LOAD segments are sorted in increasing order, and the first
  * starts at the beginning of the ELF file. By parsing the file, we can
@@ -1591,13 +1762,19 @@ static void CDECL init_builtin_dll( void *module )
     const Elf32_Dyn *dyn;
 #endif
 
+    mutex_lock( &builtin_mutex );
     LIST_FOR_EACH_ENTRY( builtin, &builtin_modules, struct builtin_module, entry )
     {
         if (builtin->module != module) continue;
         if (!builtin->handle) break;
-        if (!dlinfo( builtin->handle, RTLD_DI_LINKMAP, &map )) goto found;
+        if (!dlinfo( builtin->handle, RTLD_DI_LINKMAP, &map ))
+        {
+            mutex_unlock( &builtin_mutex );
+            goto found;
+        }
         break;
     }
+    mutex_unlock( &builtin_mutex );
     return;
 
 found:
@@ -1650,14 +1827,16 @@ static void load_ntdll(void)
     str.MaximumLength = sizeof(path);
     InitializeObjectAttributes( &attr, &str, 0, 0, NULL );
     name[strlen(name) - 3] = 0;  /* remove .so */
-    status = open_builtin_file( name, &attr, &mapping, &module, &info, &st, FALSE );
+    status = open_builtin_file( name, &attr, &mapping, &module, &info, &st, FALSE, FALSE );
     if (!status && !module)
     {
         SIZE_T len = 0;
         status = NtMapViewOfSection( mapping, NtCurrentProcess(), &module, 0, 0, NULL, &len,
                                      ViewShare, 0, PAGE_EXECUTE_READ );
         if (status == STATUS_IMAGE_NOT_AT_BASE) relocate_ntdll( module );
+        mutex_lock( &builtin_mutex );
         status = add_builtin_module( module, NULL, &st );
+        mutex_unlock( &builtin_mutex );
     }
     if (status) fatal_error( "failed to load %s error %x\n", name, status );
     free( name );
@@ -1833,7 +2012,11 @@ static struct unix_funcs unix_funcs =
     virtual_release_address_space,
     load_so_dll,
     load_builtin_dll,
+    prefetch_builtin_dll,
     unload_builtin_dll,
+    get_builtin_file_id,
+    read_import_cache,
+    write_import_cache,
     init_builtin_dll,
     unwind_builtin_dll,
     __wine_dbg_get_channel_flags,
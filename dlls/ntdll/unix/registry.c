@@ -25,16 +25,27 @@
 #pragma makedep unix
 #endif
 
+#include "config.h"
+
 #include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/types.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+#include <unistd.h>
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
 #include "winternl.h"
 #include "unix_private.h"
+#include "esync.h"
+#include "wine/list.h"
 #include "wine/debug.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(reg);
+WINE_DECLARE_DEBUG_CHANNEL(regcache);
 
 /* maximum length of a value name in bytes (without terminating null) */
 #define MAX_VALUE_LENGTH (16383 * sizeof(WCHAR))
@@ -423,6 +434,249 @@ NTSTATUS WINAPI NtEnumerateValueKey( HANDLE handle, ULONG index, KEY_VALUE_INFOR
 }
 
 
+/* Client-side cache of the values read with NtQueryValueKey. The server
+ * gives each key a slot in a shared array of generations, which it bumps
+ * whenever the key is modified or deleted, so a cached value is valid as long
+ * as the generation of its key hasn't changed. Entries are looked up by
+ * handle and exact value name, and dropped when the handle is closed. */
+
+#define VALUE_CACHE_HASH_SIZE   256   /* number of handle hash buckets */
+#define VALUE_CACHE_MAX_DATA    1024  /* max. size of cached value data */
+#define VALUE_CACHE_MAX_VALUES  64    /* max. number of cached values per key */
+#define VALUE_CACHE_MAX_KEYS    1024  /* max. number of cached keys */
+
+struct cached_value
+{
+    struct list  entry;       /* entry in key values list */
+    NTSTATUS     status;      /* STATUS_SUCCESS or STATUS_OBJECT_NAME_NOT_FOUND */
+    ULONG        type;        /* value type */
+    USHORT       name_len;    /* length of value name */
+    DWORD        data_len;    /* length of value data */
+    WCHAR        name[1];     /* value name, followed by the data */
+};
+
+struct cached_key
+{
+    struct list  entry;       /* entry in hash bucket */
+    HANDLE       handle;      /* key handle */
+    unsigned int gen_slot;    /* index of the key generation */
+    unsigned int generation;  /* generation of the cached values */
+    unsigned int count;       /* number of cached values */
+    struct list  values;      /* cached values, most recently used first */
+};
+
+static pthread_mutex_t value_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct list value_cache[VALUE_CACHE_HASH_SIZE];
+static unsigned int value_cache_keys;
+static const volatile unsigned int *key_generations;
+static unsigned int key_generation_count;
+static int value_cache_state;  /* 1 if the cache is enabled, -1 if disabled, 0 if not initialized */
+static LONG value_cache_hits, value_cache_misses;
+
+static BOOL init_value_cache(void)
+{
+    const char *env;
+    obj_handle_t fd_handle;
+    data_size_t size = 0;
+    sigset_t sigset;
+    void *ptr;
+    int i, fd = -1;
+
+    if (value_cache_state) return value_cache_state > 0;
+
+    server_enter_uninterrupted_section( &fd_cache_mutex, &sigset );
+    if (!value_cache_state)
+    {
+        if ((env = getenv( "WINE_REGISTRY_CACHE" )) && !atoi( env )) value_cache_state = -1;
+        else
+        {
+            SERVER_START_REQ( get_registry_cache )
+            {
+                if (!wine_server_call( req ))
+                {
+                    size = reply->size;
+                    fd = receive_fd( &fd_handle );
+                }
+            }
+            SERVER_END_REQ;
+
+            value_cache_state = -1;
+            if (fd != -1)
+            {
+                ptr = mmap( NULL, size, PROT_READ, MAP_SHARED, fd, 0 );
+                close( fd );
+                if (ptr != MAP_FAILED)
+                {
+                    for (i = 0; i < VALUE_CACHE_HASH_SIZE; i++) list_init( &value_cache[i] );
+                    key_generations = ptr;
+                    key_generation_count = size / sizeof(*key_generations);
+                    value_cache_state = 1;
+                }
+            }
+        }
+    }
+    server_leave_uninterrupted_section( &fd_cache_mutex, &sigset );
+    return value_cache_state > 0;
+}
+
+static inline struct list *get_value_cache_bucket( HANDLE handle )
+{
+    return &value_cache[((ULONG_PTR)handle >> 2) % VALUE_CACHE_HASH_SIZE];
+}
+
+static struct cached_key *find_cached_key( HANDLE handle )
+{
+    struct cached_key *key;
+
+    LIST_FOR_EACH_ENTRY( key, get_value_cache_bucket( handle ), struct cached_key, entry )
+        if (key->handle == handle) return key;
+    return NULL;
+}
+
+static void free_cached_values( struct cached_key *key )
+{
+    struct cached_value *value, *next;
+
+    LIST_FOR_EACH_ENTRY_SAFE( value, next, &key->values, struct cached_value, entry ) free( value );
+    list_init( &key->values );
+    key->count = 0;
+}
+
+static void free_cached_key( struct cached_key *key )
+{
+    free_cached_values( key );
+    list_remove( &key->entry );
+    free( key );
+    value_cache_keys--;
+}
+
+static void flush_value_cache(void)
+{
+    struct cached_key *key, *next;
+    int i;
+
+    for (i = 0; i < VALUE_CACHE_HASH_SIZE; i++)
+        LIST_FOR_EACH_ENTRY_SAFE( key, next, &value_cache[i], struct cached_key, entry )
+            free_cached_key( key );
+}
+
+/* fill the information of a cached value, or return FALSE if not found */
+static BOOL get_cached_value( HANDLE handle, const UNICODE_STRING *name, KEY_VALUE_INFORMATION_CLASS info_class,
+                              void *info, DWORD length, unsigned int fixed_size, unsigned int min_size,
+                              UCHAR *data_ptr, DWORD *result_len, NTSTATUS *ret )
+{
+    struct cached_key *key;
+    struct cached_value *value;
+    BOOL found = FALSE;
+
+    mutex_lock( &value_cache_mutex );
+    if ((key = find_cached_key( handle )))
+    {
+        if (key->generation != key_generations[key->gen_slot]) free_cached_values( key );
+        LIST_FOR_EACH_ENTRY( value, &key->values, struct cached_value, entry )
+        {
+            if (value->name_len != name->Length || memcmp( value->name, name->Buffer, name->Length )) continue;
+            list_remove( &value->entry );
+            list_add_head( &key->values, &value->entry );
+            if (!(*ret = value->status))
+            {
+                copy_key_value_info( info_class, info, length, value->type, name->Length, value->data_len );
+                if (data_ptr && length > fixed_size)
+                    memcpy( data_ptr, (char *)value->name + value->name_len,
+                            min( length - fixed_size, value->data_len ));
+                *result_len = fixed_size + (info_class == KeyValueBasicInformation ? 0 : value->data_len);
+                if (length < min_size) *ret = STATUS_BUFFER_TOO_SMALL;
+                else if (length < *result_len) *ret = STATUS_BUFFER_OVERFLOW;
+            }
+            found = TRUE;
+            break;
+        }
+    }
+    mutex_unlock( &value_cache_mutex );
+
+    InterlockedIncrement( found ? &value_cache_hits : &value_cache_misses );
+    return found;
+}
+
+/* add a value returned by the server to the cache */
+static void cache_value( HANDLE handle, const UNICODE_STRING *name, unsigned int gen_slot,
+                         unsigned int generation, NTSTATUS status, ULONG type, const void *data,
+                         DWORD data_len )
+{
+    struct cached_key *key;
+    struct cached_value *value;
+
+    if (gen_slot >= key_generation_count) return;
+
+    mutex_lock( &value_cache_mutex );
+    if (!(key = find_cached_key( handle )))
+    {
+        if (value_cache_keys >= VALUE_CACHE_MAX_KEYS) flush_value_cache();
+        if (!(key = malloc( sizeof(*key) ))) goto done;
+        key->handle     = handle;
+        key->gen_slot   = gen_slot;
+        key->generation = generation;
+        key->count      = 0;
+        list_init( &key->values );
+        list_add_head( get_value_cache_bucket( handle ), &key->entry );
+        value_cache_keys++;
+    }
+    else if (key->gen_slot != gen_slot)  /* the handle has been reused behind our back */
+    {
+        free_cached_values( key );
+        key->gen_slot   = gen_slot;
+        key->generation = generation;
+    }
+
+    if (key->generation != generation)
+    {
+        /* don't store a value older than the ones already cached */
+        if (generation != key_generations[gen_slot]) goto done;
+        free_cached_values( key );
+        key->generation = generation;
+    }
+    if (key->count >= VALUE_CACHE_MAX_VALUES)
+    {
+        value = LIST_ENTRY( list_tail( &key->values ), struct cached_value, entry );
+        list_remove( &value->entry );
+        free( value );
+        key->count--;
+    }
+
+    if (!(value = malloc( FIELD_OFFSET( struct cached_value, name[name->Length / sizeof(WCHAR)] ) + data_len )))
+        goto done;
+    value->status   = status;
+    value->type     = type;
+    value->name_len = name->Length;
+    value->data_len = data_len;
+    memcpy( value->name, name->Buffer, name->Length );
+    if (data_len) memcpy( (char *)value->name + name->Length, data, data_len );
+    list_add_head( &key->values, &value->entry );
+    key->count++;
+
+done:
+    mutex_unlock( &value_cache_mutex );
+}
+
+/* drop the cached values of a key handle when it is closed */
+void registry_cache_close( HANDLE handle )
+{
+    struct cached_key *key;
+
+    if (value_cache_state <= 0 || list_empty( get_value_cache_bucket( handle ))) return;
+
+    mutex_lock( &value_cache_mutex );
+    if ((key = find_cached_key( handle ))) free_cached_key( key );
+    mutex_unlock( &value_cache_mutex );
+}
+
+void registry_cache_dump_stats(void)
+{
+    if (!TRACE_ON(regcache) || value_cache_state <= 0) return;
+    TRACE_(regcache)( "hits %d, misses %d\n", value_cache_hits, value_cache_misses );
+}
+
+
 /******************************************************************************
  *              NtQueryValueKey  (NTDLL.@)
  */
@@ -473,6 +727,10 @@ NTSTATUS WINAPI NtQueryValueKey( HANDLE handle, const UNICODE_STRING *name,
         return STATUS_INVALID_PARAMETER;
     }
 
+    if (init_value_cache() && get_cached_value( handle, name, info_class, info, length, fixed_size,
+                                                min_size, data_ptr, result_len, &ret ))
+        return ret;
+
     SERVER_START_REQ( get_key_value )
     {
         req->hkey = wine_server_obj_handle( handle );
@@ -485,7 +743,15 @@ NTSTATUS WINAPI NtQueryValueKey( HANDLE handle, const UNICODE_STRING *name,
             *result_len = fixed_size + (info_class == KeyValueBasicInformation ? 0 : reply->total);
             if (length < min_size) ret = STATUS_BUFFER_TOO_SMALL;
             else if (length < *result_len) ret = STATUS_BUFFER_OVERFLOW;
+
+            /* only cache the values that have been entirely retrieved */
+            if (value_cache_state > 0 && data_ptr && reply->total <= VALUE_CACHE_MAX_DATA &&
+                wine_server_reply_size( reply ) == reply->total)
+                cache_value( handle, name, reply->gen_slot, reply->generation, STATUS_SUCCESS,
+                             reply->type, data_ptr, reply->total );
         }
+        else if (ret == STATUS_OBJECT_NAME_NOT_FOUND && value_cache_state > 0)
+            cache_value( handle, name, reply->gen_slot, reply->generation, ret, 0, NULL, 0 );
     }
     SERVER_END_REQ;
     return ret;
@@ -104,6 +104,8 @@ WINE_DEFAULT_DEBUG_CHANNEL(server);
 #define SOCKETNAME "socket"        /* name of the socket file */
 #define LOCKNAME   "lock"          /* name of the lock file */
 
+#define SERVER_MAX_BATCH_SIZE 4096  /* max size of batched requests and replies, fits in pipe buffers */
+
 static const BOOL is_win64 = (sizeof(void *) > sizeof(int));
 
 static const char *server_dir;
@@ -275,11 +277,99 @@ unsigned int server_call_unlocked( void *req_ptr )
     struct __server_request_info * const req = req_ptr;
     unsigned int ret;
 
+    if (ntdll_get_thread_data()->fsync_reply)
+        *(int *)ntdll_get_thread_data()->fsync_reply = SHM_REPLY_PENDING;
     if ((ret = send_request( req ))) return ret;
+    if (ntdll_get_thread_data()->fsync_reply &&
+        req->u.req.request_header.reply_size <= SHM_REPLY_MAX_DATA)
+        return fsync_wait_reply( req );
     return wait_reply( req );
 }
 
 
+/***********************************************************************
+ *           server_call_batch
+ *
+ * Perform several independent server calls with a single write. The
+ * server handles them in order, and the status of each call is stored
+ * in its reply header.
+ */
+unsigned int server_call_batch( struct __server_request_info **reqs, unsigned int count )
+{
+    struct iovec vec[(SERVER_MAX_BATCH + 2) * (__SERVER_MAX_DATA + 1)];
+    struct __server_request_info shm_off, shm_on;
+    size_t size = 0, reply_size = 0;
+    unsigned int i, j, nb_vec = 0, ret = STATUS_SUCCESS;
+    BOOL shm_reply = ntdll_get_thread_data()->fsync_reply != NULL;
+    sigset_t old_set;
+    int res;
+
+    /* the fsync reply block only holds a single reply, so the server is told
+     * to send the replies of the batch through the pipe; the replies to these
+     * two requests go through the pipe too */
+    if (shm_reply)
+    {
+        memset( &shm_off.u.req, 0, sizeof(shm_off.u.req) );
+        shm_off.u.req.request_header.req = REQ_set_fsync_reply;
+        shm_off.u.req.set_fsync_reply_request.enable = 0;
+        shm_on = shm_off;
+        shm_on.u.req.set_fsync_reply_request.enable = 1;
+        size += 2 * sizeof(shm_off.u.req);
+        reply_size += 2 * sizeof(shm_off.u.reply);
+        vec[nb_vec].iov_base = (void *)&shm_off.u.req;
+        vec[nb_vec++].iov_len = sizeof(shm_off.u.req);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        size += sizeof(reqs[i]->u.req) + reqs[i]->u.req.request_header.request_size;
+        reply_size += sizeof(reqs[i]->u.reply) + reqs[i]->u.req.request_header.reply_size;
+    }
+
+    /* both the requests and the replies have to fit in the pipes, so that
+     * the server never blocks on writing while we are still writing */
+    if (count > SERVER_MAX_BATCH || size > SERVER_MAX_BATCH_SIZE || reply_size > SERVER_MAX_BATCH_SIZE)
+    {
+        for (i = 0; i < count; i++) wine_server_call( reqs[i] );
+        return STATUS_SUCCESS;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        vec[nb_vec].iov_base = (void *)&reqs[i]->u.req;
+        vec[nb_vec++].iov_len = sizeof(reqs[i]->u.req);
+        for (j = 0; j < reqs[i]->data_count; j++)
+        {
+            vec[nb_vec].iov_base = (void *)reqs[i]->data[j].ptr;
+            vec[nb_vec++].iov_len = reqs[i]->data[j].size;
+        }
+    }
+
+    if (shm_reply)
+    {
+        vec[nb_vec].iov_base = (void *)&shm_on.u.req;
+        vec[nb_vec++].iov_len = sizeof(shm_on.u.req);
+    }
+
+    pthread_sigmask( SIG_BLOCK, &server_block_set, &old_set );
+    if ((res = writev( ntdll_get_thread_data()->request_fd, vec, nb_vec )) == size)
+    {
+        if (shm_reply) wait_reply( &shm_off );
+        for (i = 0; i < count; i++) wait_reply( reqs[i] );
+        if (shm_reply) wait_reply( &shm_on );
+    }
+    else
+    {
+        if (res >= 0) server_protocol_error( "partial write %d\n", res );
+        if (errno == EPIPE) abort_thread(0);
+        if (errno != EFAULT) server_protocol_perror( "writev" );
+        ret = STATUS_ACCESS_VIOLATION;
+    }
+    pthread_sigmask( SIG_SETMASK, &old_set, NULL );
+    return ret;
+}
+
+
 /***********************************************************************
  *           wine_server_call
  *
@@ -896,7 +986,90 @@ int receive_fd( obj_handle_t *handle )
 
 
 /***********************************************************************/
-/* fd cache support */
+/* handle cache support */
+
+#define HANDLE_CACHE_BLOCK_SHIFT    11
+#define HANDLE_CACHE_BLOCK_SIZE     (1 << HANDLE_CACHE_BLOCK_SHIFT)
+#define HANDLE_CACHE_INITIAL_BLOCKS 64
+#define HANDLE_CACHE_MAX_BLOCKS     ((1 << 30) >> HANDLE_CACHE_BLOCK_SHIFT)
+
+/* The block directory is looked up without locking, and replaced by a larger
+ * copy when a handle doesn't fit in it anymore. Replaced directories are never
+ * freed since readers may still be using them; they are small and there are
+ * only a few of them over the lifetime of a process. */
+struct handle_cache_dir
+{
+    unsigned int               count;
+    struct handle_cache_entry *blocks[HANDLE_CACHE_INITIAL_BLOCKS];
+};
+
+static pthread_mutex_t handle_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct handle_cache_dir handle_cache_initial_dir = { HANDLE_CACHE_INITIAL_BLOCKS };
+static struct handle_cache_dir *handle_cache_dir = &handle_cache_initial_dir;
+static struct handle_cache_entry handle_cache_initial_block[HANDLE_CACHE_BLOCK_SIZE];
+
+
+/***********************************************************************
+ *           alloc_handle_cache_block
+ *
+ * Caller must hold handle_cache_mutex.
+ */
+static struct handle_cache_entry *alloc_handle_cache_block( unsigned int block )
+{
+    struct handle_cache_dir *dir = handle_cache_dir, *new_dir;
+    struct handle_cache_entry *entries;
+    unsigned int count;
+
+    if (block >= dir->count)  /* do we need a larger directory? */
+    {
+        for (count = dir->count * 2; count <= block; count *= 2) ;
+        new_dir = anon_mmap_alloc( offsetof( struct handle_cache_dir, blocks[count] ),
+                                   PROT_READ | PROT_WRITE );
+        if (new_dir == MAP_FAILED) return NULL;
+        new_dir->count = count;
+        memcpy( new_dir->blocks, dir->blocks, dir->count * sizeof(dir->blocks[0]) );
+        __atomic_store_n( &handle_cache_dir, new_dir, __ATOMIC_RELEASE );
+        dir = new_dir;
+    }
+
+    if (!(entries = dir->blocks[block]))  /* do we need to allocate a new block of entries? */
+    {
+        if (!block) entries = handle_cache_initial_block;
+        else
+        {
+            entries = anon_mmap_alloc( HANDLE_CACHE_BLOCK_SIZE * sizeof(*entries), PROT_READ | PROT_WRITE );
+            if (entries == MAP_FAILED) return NULL;
+        }
+        __atomic_store_n( &dir->blocks[block], entries, __ATOMIC_RELEASE );
+    }
+    return entries;
+}
+
+
+/***********************************************************************
+ *           get_handle_cache_entry
+ *
+ * Return the cache entry for a handle, optionally allocating its block.
+ */
+struct handle_cache_entry *get_handle_cache_entry( HANDLE handle, BOOL alloc )
+{
+    unsigned int idx = (wine_server_obj_handle(handle) >> 2) - 1;
+    unsigned int block = idx >> HANDLE_CACHE_BLOCK_SHIFT;
+    struct handle_cache_dir *dir = __atomic_load_n( &handle_cache_dir, __ATOMIC_ACQUIRE );
+    struct handle_cache_entry *entries = NULL;
+    sigset_t sigset;
+
+    if (block < dir->count && (entries = __atomic_load_n( &dir->blocks[block], __ATOMIC_ACQUIRE )))
+        return &entries[idx % HANDLE_CACHE_BLOCK_SIZE];
+
+    if (!alloc || block >= HANDLE_CACHE_MAX_BLOCKS) return NULL;
+
+    server_enter_uninterrupted_section( &handle_cache_mutex, &sigset );
+    entries = alloc_handle_cache_block( block );
+    server_leave_uninterrupted_section( &handle_cache_mutex, &sigset );
+    return entries ? &entries[idx % HANDLE_CACHE_BLOCK_SIZE] : NULL;
+}
+
 
 union fd_cache_entry
 {
@@ -912,19 +1085,6 @@ union fd_cache_entry
 
 C_ASSERT( sizeof(union fd_cache_entry) == sizeof(LONG64) );
 
-#define FD_CACHE_BLOCK_SIZE  (65536 / sizeof(union fd_cache_entry))
-#define FD_CACHE_ENTRIES     128
-
-static union fd_cache_entry *fd_cache[FD_CACHE_ENTRIES];
-static union fd_cache_entry fd_cache_initial_block[FD_CACHE_BLOCK_SIZE];
-
-static inline unsigned int handle_to_index( HANDLE handle, unsigned int *entry )
-{
-    unsigned int idx = (wine_server_obj_handle(handle) >> 2) - 1;
-    *entry = idx / FD_CACHE_BLOCK_SIZE;
-    return idx % FD_CACHE_BLOCK_SIZE;
-}
-
 
 /***********************************************************************
  *           add_fd_to_cache
@@ -934,33 +1094,21 @@ static inline unsigned int handle_to_index( HANDLE handle, unsigned int *entry )
 static BOOL add_fd_to_cache( HANDLE handle, int fd, enum server_fd_type type,
                             unsigned int access, unsigned int options )
 {
-    unsigned int entry, idx = handle_to_index( handle, &entry );
+    struct handle_cache_entry *entry = get_handle_cache_entry( handle, TRUE );
     union fd_cache_entry cache;
 
-    if (entry >= FD_CACHE_ENTRIES)
+    if (!entry)
     {
         FIXME( "too many allocated handles, not caching %p\n", handle );
         return FALSE;
     }
 
-    if (!fd_cache[entry])  /* do we need to allocate a new block of entries? */
-    {
-        if (!entry) fd_cache[0] = fd_cache_initial_block;
-        else
-        {
-            void *ptr = anon_mmap_alloc( FD_CACHE_BLOCK_SIZE * sizeof(union fd_cache_entry),
-                                         PROT_READ | PROT_WRITE );
-            if (ptr == MAP_FAILED) return FALSE;
-            fd_cache[entry] = ptr;
-        }
-    }
-
     /* store fd+1 so that 0 can be used as the unset value */
     cache.s.fd = fd + 1;
     cache.s.type = type;
     cache.s.access = access;
     cache.s.options = options;
-    cache.data = interlocked_xchg64( &fd_cache[entry][idx].data, cache.data );
+    cache.data = interlocked_xchg64( &entry->fd, cache.data );
     assert( !cache.s.fd );
     return TRUE;
 }
@@ -972,12 +1120,12 @@ static BOOL add_fd_to_cache( HANDLE handle, int fd, enum server_fd_type type,
 static inline NTSTATUS get_cached_fd( HANDLE handle, int *fd, enum server_fd_type *type,
                                       unsigned int *access, unsigned int *options )
 {
-    unsigned int entry, idx = handle_to_index( handle, &entry );
+    struct handle_cache_entry *entry = get_handle_cache_entry( handle, FALSE );
     union fd_cache_entry cache;
 
-    if (entry >= FD_CACHE_ENTRIES || !fd_cache[entry]) return STATUS_INVALID_HANDLE;
+    if (!entry) return STATUS_INVALID_HANDLE;
 
-    cache.data = InterlockedCompareExchange64( &fd_cache[entry][idx].data, 0, 0 );
+    cache.data = InterlockedCompareExchange64( &entry->fd, 0, 0 );
     if (!cache.data) return STATUS_INVALID_HANDLE;
 
     /* if fd type is invalid, fd stores an error value */
@@ -996,13 +1144,13 @@ static inline NTSTATUS get_cached_fd( HANDLE handle, int *fd, enum server_fd_typ
  */
 static int remove_fd_from_cache( HANDLE handle )
 {
-    unsigned int entry, idx = handle_to_index( handle, &entry );
+    struct handle_cache_entry *entry = get_handle_cache_entry( handle, FALSE );
     int fd = -1;
 
-    if (entry < FD_CACHE_ENTRIES && fd_cache[entry])
+    if (entry)
     {
         union fd_cache_entry cache;
-        cache.data = interlocked_xchg64( &fd_cache[entry][idx].data, 0 );
+        cache.data = interlocked_xchg64( &entry->fd, 0 );
         if (cache.s.type != FD_TYPE_INVALID) fd = cache.s.fd - 1;
     }
 
@@ -1469,6 +1617,8 @@ static void init_teb64( TEB *teb )
  */
 void process_exit_wrapper( int status )
 {
+    if (do_fsync()) fsync_dump_stats();
+    registry_cache_dump_stats();
     close( fd_socket );
     exit( status );
 }
@@ -1687,6 +1837,7 @@ void server_init_thread( void *entry_point, BOOL *suspend )
     SERVER_END_REQ;
     close( reply_pipe );
     init_teb64( NtCurrentTeb() );
+    if (do_fsync()) fsync_init_thread();
 }
 
 
@@ -1730,6 +1881,7 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source, HANDLE
             {
                 int fd = remove_fd_from_cache( source );
                 if (fd != -1) close( fd );
+                registry_cache_close( source );
             }
         }
     }
@@ -1753,6 +1905,8 @@ NTSTATUS WINAPI NtClose( HANDLE handle )
     if (do_esync())
         esync_close( handle );
 
+    registry_cache_close( handle );
+
     SERVER_START_REQ( close_handle )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -29,11 +29,14 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <pthread.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/mman.h>
 #ifdef HAVE_UNISTD_H
@@ -84,6 +87,7 @@
 #include "wine/exception.h"
 #include "wine/list.h"
 #include "wine/asm.h"
+#include "wine/profile_record.h"
 #include "unix_private.h"
 #include "wine/debug.h"
 
@@ -325,6 +329,7 @@ struct amd64_thread_data
     DWORD_PTR             dr7;           /* 0318 */
     void                 *exit_frame;    /* 0320 exit frame pointer */
     struct syscall_frame *syscall_frame; /* 0328 syscall frame pointer */
+    ULONG_PTR             profile_timer; /* 0330 sampling timer id + 1 */
 };
 
 C_ASSERT( sizeof(struct amd64_thread_data) <= sizeof(((struct ntdll_thread_data *)0)->cpu_data) );
@@ -2921,6 +2926,357 @@ static void usr1_handler( int signal, siginfo_t *siginfo, void *ucontext )
 }
 
 
+/***********************************************************************
+ * Sampling profiler
+ *
+ * Enabled by setting WINE_PROFILE to an output file name. Each thread gets a
+ * timer raising SIGPROF every WINE_PROFILE_INTERVAL microseconds of thread cpu
+ * time, and the handler appends the PE stack of the thread to <name>.<pid>.
+ */
+
+#define PROFILE_MAX_MODULES 512
+#define PROFILE_MAX_FRAMES  64
+
+struct profile_module
+{
+    ULONG_PTR               base;   /* image base, 0 if the slot is free */
+    ULONG_PTR               end;    /* end of the image */
+    const RUNTIME_FUNCTION *funcs;  /* exception directory, sorted by address */
+    DWORD                   count;  /* number of entries in the exception directory */
+    DWORD                   id;     /* module id used in the sample records */
+};
+
+static int profile_fd = -1;
+static unsigned int profile_interval = 1000;
+static struct profile_module profile_modules[PROFILE_MAX_MODULES];
+static unsigned int profile_nb_modules;  /* highest slot in use + 1 */
+static LONG profile_module_id;
+static LONG profile_readers;
+static pthread_mutex_t profile_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const struct profile_module *find_profile_module( ULONG_PTR addr )
+{
+    unsigned int i;
+
+    for (i = 0; i < profile_nb_modules; i++)
+    {
+        ULONG_PTR base = *(volatile ULONG_PTR *)&profile_modules[i].base;
+        if (base && addr >= base && addr < profile_modules[i].end) return &profile_modules[i];
+    }
+    return NULL;
+}
+
+static const RUNTIME_FUNCTION *find_profile_function( const struct profile_module *module, DWORD rva )
+{
+    int min = 0, max = module->count - 1;
+
+    while (min <= max)
+    {
+        int pos = (min + max) / 2;
+        if (rva < module->funcs[pos].BeginAddress) max = pos - 1;
+        else if (rva >= module->funcs[pos].EndAddress) min = pos + 1;
+        else return &module->funcs[pos];
+    }
+    return NULL;
+}
+
+/***********************************************************************
+ *           profile_add_image
+ *
+ * Register a mapped PE image and write its description to the profile.
+ */
+void profile_add_image( void *module )
+{
+    const IMAGE_DOS_HEADER *dos = module;
+    const IMAGE_NT_HEADERS *nt = (const IMAGE_NT_HEADERS *)((const char *)dos + dos->e_lfanew);
+    const IMAGE_DATA_DIRECTORY *dir;
+    const IMAGE_EXPORT_DIRECTORY *exports = NULL;
+    const DWORD *functions = NULL, *names = NULL;
+    const WORD *ordinals = NULL;
+    struct profile_record_module *record;
+    struct profile_module *slot;
+    char buffer[sizeof(MEMORY_SECTION_NAME) + MAX_PATH * sizeof(WCHAR)];
+    MEMORY_SECTION_NAME *section_name = (MEMORY_SECTION_NAME *)buffer;
+    const WCHAR *name = NULL;
+    DWORD i, size, name_len = 0, nb_exports = 0, *rvas;
+    char *p;
+
+    if (profile_fd == -1) return;
+    if (nt->OptionalHeader.Magic != IMAGE_NT_OPTIONAL_HDR64_MAGIC) return;
+
+    if (!NtQueryVirtualMemory( NtCurrentProcess(), module, MemorySectionName,
+                               section_name, sizeof(buffer), NULL ))
+    {
+        name = section_name->SectionFileName.Buffer;
+        name_len = section_name->SectionFileName.Length / sizeof(WCHAR);
+        for (i = 0; i < name_len; i++)
+            if (section_name->SectionFileName.Buffer[i] == '\\') name = section_name->SectionFileName.Buffer + i + 1;
+        name_len -= name - section_name->SectionFileName.Buffer;
+    }
+
+    size = sizeof(*record) + name_len * 3 + 1;
+    dir = &nt->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT];
+    if (dir->VirtualAddress && dir->Size)
+    {
+        exports = (const IMAGE_EXPORT_DIRECTORY *)((const char *)module + dir->VirtualAddress);
+        functions = (const DWORD *)((const char *)module + exports->AddressOfFunctions);
+        names = (const DWORD *)((const char *)module + exports->AddressOfNames);
+        ordinals = (const WORD *)((const char *)module + exports->AddressOfNameOrdinals);
+        for (i = 0; i < exports->NumberOfNames; i++)
+            size += sizeof(DWORD) + strlen( (const char *)module + names[i] ) + 1;
+    }
+    size = (size + 7) & ~7;
+    if (!(record = calloc( 1, size ))) return;
+
+    rvas = (DWORD *)(record + 1);
+    for (i = 0; exports && i < exports->NumberOfNames; i++)
+    {
+        DWORD rva = ordinals[i] < exports->NumberOfFunctions ? functions[ordinals[i]] : 0;
+        /* skip forwarded entry points */
+        if (!rva || (rva >= dir->VirtualAddress && rva < dir->VirtualAddress + dir->Size)) continue;
+        rvas[nb_exports++] = rva;
+    }
+    p = (char *)(rvas + nb_exports);
+    if (name_len) p += ntdll_wcstoumbs( name, name_len, p, name_len * 3, FALSE );
+    *p++ = 0;
+    for (i = 0; exports && i < exports->NumberOfNames; i++)
+    {
+        DWORD rva = ordinals[i] < exports->NumberOfFunctions ? functions[ordinals[i]] : 0;
+        if (!rva || (rva >= dir->VirtualAddress && rva < dir->VirtualAddress + dir->Size)) continue;
+        strcpy( p, (const char *)module + names[i] );
+        p += strlen( p ) + 1;
+    }
+
+    record->hdr.type = PROFILE_RECORD_MODULE;
+    record->hdr.size = size;
+    record->id = InterlockedIncrement( &profile_module_id );
+    record->size = nt->OptionalHeader.SizeOfImage;
+    record->base = (ULONG_PTR)module;
+    record->nb_exports = nb_exports;
+
+    mutex_lock( &profile_mutex );
+    for (i = 0; i < PROFILE_MAX_MODULES; i++) if (!profile_modules[i].base) break;
+    if (i < PROFILE_MAX_MODULES && write( profile_fd, record, size ) == size)
+    {
+        slot = &profile_modules[i];
+        dir = &nt->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXCEPTION];
+        slot->funcs = (const RUNTIME_FUNCTION *)((const char *)module + dir->VirtualAddress);
+        slot->count = dir->VirtualAddress ? dir->Size / sizeof(RUNTIME_FUNCTION) : 0;
+        slot->id = record->id;
+        slot->end = (ULONG_PTR)module + nt->OptionalHeader.SizeOfImage;
+        InterlockedExchangePointer( (void **)&slot->base, module );
+        if (i >= profile_nb_modules) profile_nb_modules = i + 1;
+    }
+    mutex_unlock( &profile_mutex );
+    free( record );
+}
+
+/***********************************************************************
+ *           profile_remove_image
+ *
+ * Unregister a PE image before it gets unmapped.
+ */
+void profile_remove_image( void *module )
+{
+    unsigned int i;
+
+    if (profile_fd == -1) return;
+
+    mutex_lock( &profile_mutex );
+    for (i = 0; i < profile_nb_modules; i++)
+        if (profile_modules[i].base == (ULONG_PTR)module)
+            InterlockedExchangePointer( (void **)&profile_modules[i].base, NULL );
+    mutex_unlock( &profile_mutex );
+
+    /* wait for the samples that may still be reading the unwind data */
+    while (*(volatile LONG *)&profile_readers) YieldProcessor();
+}
+
+/***********************************************************************
+ *           add_profile_frame
+ */
+static void add_profile_frame( struct profile_record_frame *frame, const struct profile_module *module,
+                               const RUNTIME_FUNCTION *func, ULONG_PTR pc )
+{
+    frame->module = module ? module->id : 0;
+    frame->address = module ? pc - module->base : pc;
+    frame->function = func ? func->BeginAddress : 0;
+}
+
+/**********************************************************************
+ *		prof_handler
+ *
+ * Handler for SIGPROF, used to sample the stack of the current thread.
+ */
+static void prof_handler( int signal, siginfo_t *siginfo, void *sigcontext )
+{
+    ucontext_t *ucontext = sigcontext;
+    struct syscall_frame *frame = amd64_thread_data()->syscall_frame;
+    ULONG_PTR stack_base = (ULONG_PTR)NtCurrentTeb()->Tib.StackBase;
+    ULONG_PTR stack_limit = (ULONG_PTR)NtCurrentTeb()->Tib.StackLimit;
+    struct
+    {
+        struct profile_record_sample sample;
+        struct profile_record_frame  frames[PROFILE_MAX_FRAMES];
+    } record;
+    const struct profile_module *module;
+    const RUNTIME_FUNCTION *func;
+    CONTEXT context;
+    ULONG64 establisher;
+    void *data;
+    unsigned int count = 0;
+    int err = errno;
+
+    context.Rax = RAX_sig(ucontext);
+    context.Rbx = RBX_sig(ucontext);
+    context.Rcx = RCX_sig(ucontext);
+    context.Rdx = RDX_sig(ucontext);
+    context.Rsi = RSI_sig(ucontext);
+    context.Rdi = RDI_sig(ucontext);
+    context.Rbp = RBP_sig(ucontext);
+    context.Rsp = RSP_sig(ucontext);
+    context.Rip = RIP_sig(ucontext);
+    context.R8  = R8_sig(ucontext);
+    context.R9  = R9_sig(ucontext);
+    context.R10 = R10_sig(ucontext);
+    context.R11 = R11_sig(ucontext);
+    context.R12 = R12_sig(ucontext);
+    context.R13 = R13_sig(ucontext);
+    context.R14 = R14_sig(ucontext);
+    context.R15 = R15_sig(ucontext);
+
+    InterlockedIncrement( &profile_readers );
+
+    if (!(module = find_profile_module( context.Rip )))
+    {
+        /* unix code, continue from the PE caller if inside a syscall */
+        add_profile_frame( &record.frames[count++], NULL, NULL, context.Rip );
+        if (!frame) goto done;
+        context.Rbx = frame->rbx;
+        context.Rsi = frame->rsi;
+        context.Rdi = frame->rdi;
+        context.Rbp = frame->rbp;
+        context.Rsp = frame->rsp;
+        context.Rip = frame->rip;
+        context.R12 = frame->r12;
+        context.R13 = frame->r13;
+        context.R14 = frame->r14;
+        context.R15 = frame->r15;
+    }
+
+    while (count < PROFILE_MAX_FRAMES && pRtlVirtualUnwind)
+    {
+        if (context.Rsp < stack_limit || context.Rsp >= stack_base) break;
+        if (!(module = find_profile_module( context.Rip )))
+        {
+            add_profile_frame( &record.frames[count++], NULL, NULL, context.Rip );
+            break;
+        }
+        func = find_profile_function( module, context.Rip - module->base );
+        add_profile_frame( &record.frames[count++], module, func, context.Rip );
+        if (func)
+            pRtlVirtualUnwind( UNW_FLAG_NHANDLER, module->base, context.Rip, (RUNTIME_FUNCTION *)func,
+                               &context, &data, &establisher, NULL );
+        else  /* leaf function */
+        {
+            context.Rip = *(ULONG64 *)context.Rsp;
+            context.Rsp += sizeof(ULONG64);
+        }
+        if (!context.Rip) break;
+    }
+
+done:
+    InterlockedDecrement( &profile_readers );
+
+    record.sample.hdr.type = PROFILE_RECORD_SAMPLE;
+    record.sample.hdr.size = sizeof(record.sample) + count * sizeof(record.frames[0]);
+    record.sample.tid = HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+    record.sample.count = count;
+    write( profile_fd, &record, record.sample.hdr.size );
+    errno = err;
+}
+
+/***********************************************************************
+ *           profile_start_thread
+ *
+ * Start the sampling timer of the current thread.
+ */
+static void profile_start_thread(void)
+{
+#if defined(__linux__) && defined(__NR_timer_create)
+    struct itimerspec its;
+    struct sigevent sev;
+    int timer;
+
+    memset( &sev, 0, sizeof(sev) );
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = SIGPROF;
+    sev._sigev_un._tid = syscall( __NR_gettid );
+    if (syscall( __NR_timer_create, CLOCK_THREAD_CPUTIME_ID, &sev, &timer ) == -1)
+    {
+        WARN( "failed to create profiling timer: %s\n", strerror(errno) );
+        return;
+    }
+    its.it_interval.tv_sec = profile_interval / 1000000;
+    its.it_interval.tv_nsec = (profile_interval % 1000000) * 1000;
+    its.it_value = its.it_interval;
+    syscall( __NR_timer_settime, timer, 0, &its, NULL );
+    amd64_thread_data()->profile_timer = timer + 1;
+#endif
+}
+
+/***********************************************************************
+ *           profile_init
+ */
+static void profile_init( struct sigaction *sig_act )
+{
+#if defined(__linux__) && defined(__NR_timer_create)
+    struct profile_record_header header;
+    const char *name = getenv( "WINE_PROFILE" );
+    const char *interval = getenv( "WINE_PROFILE_INTERVAL" );
+    MEMORY_BASIC_INFORMATION info;
+    char *addr, *path;
+
+    if (!name || !*name) return;
+    if (interval && atoi( interval ) > 0) profile_interval = atoi( interval );
+
+    if (!(path = malloc( strlen( name ) + 12 ))) return;
+    sprintf( path, "%s.%u", name, HandleToULong( NtCurrentTeb()->ClientId.UniqueProcess ));
+    profile_fd = open( path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0666 );
+    if (profile_fd == -1)
+    {
+        ERR( "failed to create %s: %s\n", path, strerror(errno) );
+        free( path );
+        return;
+    }
+    free( path );
+
+    header.magic = PROFILE_RECORD_MAGIC;
+    header.version = PROFILE_RECORD_VERSION;
+    header.pid = HandleToULong( NtCurrentTeb()->ClientId.UniqueProcess );
+    header.interval = profile_interval;
+    write( profile_fd, &header, sizeof(header) );
+
+    /* register the images that got mapped before the profiler was started */
+    for (addr = NULL; !NtQueryVirtualMemory( NtCurrentProcess(), addr, MemoryBasicInformation,
+                                             &info, sizeof(info), NULL );
+         addr = (char *)info.BaseAddress + info.RegionSize)
+    {
+        if (info.Type == MEM_IMAGE && info.BaseAddress == info.AllocationBase)
+            profile_add_image( info.BaseAddress );
+    }
+
+    sig_act->sa_sigaction = prof_handler;
+    if (sigaction( SIGPROF, sig_act, NULL ) == -1)
+    {
+        perror( "sigaction" );
+        return;
+    }
+    profile_start_thread();
+#endif
+}
+
+
 /**********************************************************************
  *           get_thread_ldt_entry
  */
@@ -2962,6 +3318,11 @@ NTSTATUS signal_alloc_thread( TEB *teb )
  */
 void signal_free_thread( TEB *teb )
 {
+#if defined(__linux__) && defined(__NR_timer_create)
+    struct amd64_thread_data *data = (struct amd64_thread_data *)((struct ntdll_thread_data *)&teb->GdiTebBatch)->cpu_data;
+
+    if (data->profile_timer) syscall( __NR_timer_delete, (int)(data->profile_timer - 1) );
+#endif
 }
 
 #ifdef __APPLE__
@@ -3052,6 +3413,8 @@ void signal_init_thread( TEB *teb )
 #else
     FIXME("FPU setup not implemented for this platform.\n");
 #endif
+
+    if (profile_fd != -1) profile_start_thread();
 }
 
 
@@ -3082,6 +3445,7 @@ void signal_init_process(void)
     if (sigaction( SIGILL, &sig_act, NULL ) == -1) goto error;
     if (sigaction( SIGBUS, &sig_act, NULL ) == -1) goto error;
     install_bpf(&sig_act);
+    profile_init( &sig_act );
     return;
 
  error:
@@ -53,6 +53,7 @@ struct ntdll_thread_data
     void              *start_stack;   /* stack for thread startup */
     int                esync_apc_fd;  /* fd to wait on for user APCs */
     int               *fsync_apc_futex;
+    void              *fsync_reply;   /* fsync shm block receiving server replies */
     int                request_fd;    /* fd for sending server requests */
     int                reply_fd;      /* fd for receiving server replies */
     int                wait_fd[2];    /* fd for sleeping server requests */
@@ -88,6 +89,9 @@ extern NTSTATUS (WINAPI *pKiRaiseUserExceptionDispatcher)(void) DECLSPEC_HIDDEN;
 extern void     (WINAPI *pKiUserApcDispatcher)(CONTEXT*,ULONG_PTR,ULONG_PTR,ULONG_PTR,PNTAPCFUNC) DECLSPEC_HIDDEN;
 extern NTSTATUS (WINAPI *pKiUserExceptionDispatcher)(EXCEPTION_RECORD*,CONTEXT*) DECLSPEC_HIDDEN;
 extern void     (WINAPI *pLdrInitializeThunk)(CONTEXT*,void**,ULONG_PTR,ULONG_PTR) DECLSPEC_HIDDEN;
+#ifdef __x86_64__
+extern PVOID    (WINAPI *pRtlVirtualUnwind)(ULONG,ULONG64,ULONG64,RUNTIME_FUNCTION*,CONTEXT*,PVOID*,ULONG64*,KNONVOLATILE_CONTEXT_POINTERS*) DECLSPEC_HIDDEN;
+#endif
 extern void     (WINAPI *pRtlUserThreadStart)( PRTL_THREAD_START_ROUTINE entry, void *arg ) DECLSPEC_HIDDEN;
 extern NTSTATUS CDECL fast_RtlpWaitForCriticalSection( RTL_CRITICAL_SECTION *crit, int timeout ) DECLSPEC_HIDDEN;
 extern NTSTATUS CDECL fast_RtlpUnWaitCriticalSection( RTL_CRITICAL_SECTION *crit ) DECLSPEC_HIDDEN;
@@ -148,7 +152,26 @@ extern NTSTATUS exec_wineloader( char **argv, int socketfd, const pe_image_info_
 extern void start_server( BOOL debug ) DECLSPEC_HIDDEN;
 extern ULONG_PTR get_image_address(void) DECLSPEC_HIDDEN;
 
+#define SERVER_MAX_BATCH 16  /* max number of requests for server_call_batch */
+
+/* per-handle attributes, shared by the fd cache and the esync/fsync object caches */
+struct handle_cache_entry
+{
+    LONG64 DECLSPEC_ALIGN(8) fd;  /* packed fd cache data, 0 if not cached */
+    struct
+    {
+        int   type;               /* esync or fsync object type, 0 if not cached */
+        int   fd;                 /* eventfd for esync objects */
+        void *shm;                /* shared memory for esync and fsync objects */
+    } sync;
+};
+
+extern struct handle_cache_entry *get_handle_cache_entry( HANDLE handle, BOOL alloc ) DECLSPEC_HIDDEN;
+extern void registry_cache_close( HANDLE handle ) DECLSPEC_HIDDEN;
+extern void registry_cache_dump_stats(void) DECLSPEC_HIDDEN;
+
 extern unsigned int server_call_unlocked( void *req_ptr ) DECLSPEC_HIDDEN;
+extern unsigned int server_call_batch( struct __server_request_info **reqs, unsigned int count ) DECLSPEC_HIDDEN;
 extern void server_enter_uninterrupted_section( pthread_mutex_t *mutex, sigset_t *sigset ) DECLSPEC_HIDDEN;
 extern void server_leave_uninterrupted_section( pthread_mutex_t *mutex, sigset_t *sigset ) DECLSPEC_HIDDEN;
 extern unsigned int server_select( const select_op_t *select_op, data_size_t size, UINT flags,
@@ -225,6 +248,10 @@ extern void DECLSPEC_NORETURN signal_exit_thread( int status, void (*func)(int)
 extern void DECLSPEC_NORETURN exec_process( NTSTATUS status ) DECLSPEC_HIDDEN;
 extern void __wine_syscall_dispatcher(void) DECLSPEC_HIDDEN;
 extern void signal_restore_full_cpu_context(void) DECLSPEC_HIDDEN;
+#ifdef __x86_64__
+extern void profile_add_image( void *module ) DECLSPEC_HIDDEN;
+extern void profile_remove_image( void *module ) DECLSPEC_HIDDEN;
+#endif
 extern void fill_vm_counters( VM_COUNTERS_EX *pvmi, int unix_pid ) DECLSPEC_HIDDEN;
 
 extern NTSTATUS cdrom_DeviceIoControl( HANDLE device, HANDLE event, PIO_APC_ROUTINE apc, void *apc_user,
@@ -49,6 +49,11 @@
 #ifdef HAVE_VALGRIND_VALGRIND_H
 # include <valgrind/valgrind.h>
 #endif
+#ifdef HAVE_LINUX_USERFAULTFD_H
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+# include <linux/userfaultfd.h>
+#endif
 #if defined(__APPLE__)
 # include <mach/mach_init.h>
 # include <mach/mach_vm.h>
@@ -133,6 +138,13 @@ static const BYTE VIRTUAL_Win32Flags[16] =
 static struct wine_rb_tree views_tree;
 static pthread_mutex_t virtual_mutex;
 
+/* Sequence counter for the views tree and the page protection bytes, odd while virtual_mutex
+ * is held. Some queries read them without taking the mutex, and only use the result if the
+ * counter didn't change meanwhile. This relies on views and page protection arrays never
+ * being freed, only recycled, so that a stale pointer is always safe to dereference. */
+static unsigned int views_seq;
+static unsigned int views_lock_depth;
+
 static const BOOL is_win64 = (sizeof(void *) > sizeof(int));
 static const UINT page_shift = 12;
 static const UINT_PTR page_mask = 0xfff;
@@ -174,6 +186,38 @@ static struct list teb_list = LIST_INIT( teb_list );
 
 #define VIRTUAL_DEBUG_DUMP_VIEW(view) do { if (TRACE_ON(virtual)) dump_view(view); } while (0)
 
+/* lock the views; signals are blocked unless sigset is NULL */
+static void lock_views( sigset_t *sigset )
+{
+    if (sigset) server_enter_uninterrupted_section( &virtual_mutex, sigset );
+    else mutex_lock( &virtual_mutex );
+    if (!views_lock_depth++)
+    {
+        __atomic_store_n( &views_seq, views_seq + 1, __ATOMIC_RELAXED );
+        __atomic_thread_fence( __ATOMIC_RELEASE );
+    }
+}
+
+static void unlock_views( sigset_t *sigset )
+{
+    if (!--views_lock_depth) __atomic_store_n( &views_seq, views_seq + 1, __ATOMIC_RELEASE );
+    if (sigset) server_leave_uninterrupted_section( &virtual_mutex, sigset );
+    else mutex_unlock( &virtual_mutex );
+}
+
+/* start a lockless read of the views; the read has to be retried if the result is odd */
+static inline unsigned int read_views_begin(void)
+{
+    return __atomic_load_n( &views_seq, __ATOMIC_ACQUIRE );
+}
+
+/* check whether the data read since read_views_begin() is consistent */
+static inline BOOL read_views_valid( unsigned int seq )
+{
+    __atomic_thread_fence( __ATOMIC_ACQUIRE );
+    return !(seq & 1) && __atomic_load_n( &views_seq, __ATOMIC_RELAXED ) == seq;
+}
+
 #ifndef MAP_NORESERVE
 #define MAP_NORESERVE 0
 #endif
@@ -196,6 +240,9 @@ static const size_t view_block_size = 0x100000;
 static void *preload_reserve_start;
 static void *preload_reserve_end;
 static BOOL force_exec_prot;  /* whether to force PROT_EXEC on all PROT_READ mmaps */
+static BOOL use_kernel_writewatch;  /* whether write watches are tracked by the kernel */
+static size_t large_page_size = 2 * 1024 * 1024;  /* size of transparent huge pages */
+static BOOL large_pages_for_all;  /* whether to use huge pages for all large reservations */
 
 struct range_entry
 {
@@ -913,7 +960,7 @@ static int get_unix_prot( BYTE vprot )
         if (vprot & VPROT_WRITE) prot |= PROT_WRITE | PROT_READ;
         if (vprot & VPROT_WRITECOPY) prot |= PROT_WRITE | PROT_READ;
         if (vprot & VPROT_EXEC) prot |= PROT_EXEC | PROT_READ;
-        if (vprot & VPROT_WRITEWATCH) prot &= ~PROT_WRITE;
+        if ((vprot & VPROT_WRITEWATCH) && !use_kernel_writewatch) prot &= ~PROT_WRITE;
     }
     if (!prot) prot = PROT_NONE;
     return prot;
@@ -969,12 +1016,12 @@ static void VIRTUAL_Dump(void)
     struct file_view *view;
 
     TRACE( "Dump of all virtual memory views:\n" );
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     WINE_RB_FOR_EACH_ENTRY( view, &views_tree, struct file_view, entry )
     {
         dump_view( view );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
 }
 #endif
 
@@ -1010,6 +1057,46 @@ static struct file_view *find_view( const void *addr, size_t size )
 }
 
 
+/***********************************************************************
+ *           find_view_lockless
+ *
+ * Find the view containing a given address without holding virtual_mutex,
+ * and return a copy of it. Fails if there is no such view, or if the views
+ * were modified concurrently, in which case the caller has to fall back to
+ * the locked path.
+ */
+static BOOL find_view_lockless( const void *addr, size_t size, struct file_view *copy, unsigned int *seq )
+{
+    struct wine_rb_entry *ptr;
+    unsigned int depth = 0;
+
+    if ((const char *)addr + size < (const char *)addr) return FALSE; /* overflow */
+
+    *seq = read_views_begin();
+    if (*seq & 1) return FALSE;
+
+    /* the tree may be rebalanced under us, so don't walk more than its maximum depth */
+    for (ptr = views_tree.root; ptr && depth < 2 * 8 * sizeof(void *); depth++)
+    {
+        struct file_view *view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, entry );
+        const char *base = view->base;
+        size_t view_size = view->size;
+
+        if (base > (const char *)addr) ptr = ptr->left;
+        else if (base + view_size <= (const char *)addr) ptr = ptr->right;
+        else if (base + view_size < (const char *)addr + size) break;  /* size too large */
+        else
+        {
+            copy->base = view->base;
+            copy->size = view->size;
+            copy->protect = view->protect;
+            return read_views_valid( *seq );
+        }
+    }
+    return FALSE;
+}
+
+
 /***********************************************************************
  *           zero_bits_win_to_64
  *
@@ -1278,6 +1365,9 @@ static struct file_view *alloc_view(void)
  */
 static void delete_view( struct file_view *view ) /* [in] View */
 {
+#ifdef __x86_64__
+    if (view->protect & SEC_IMAGE) profile_remove_image( view->base );
+#endif
     if (!(view->protect & VPROT_SYSTEM)) unmap_area( view->base, view->size );
     set_page_vprot( view->base, view->size, 0 );
     free_ranges_remove_view( view );
@@ -1513,6 +1603,183 @@ static NTSTATUS set_protection( struct file_view *view, void *base, SIZE_T size,
 }
 
 
+#if defined(HAVE_LINUX_USERFAULTFD_H) && defined(__NR_userfaultfd)
+
+/* Write watches tracked through asynchronous userfaultfd write protection: the kernel
+ * resolves the write faults itself, and the written pages are retrieved and protected
+ * again with the PAGEMAP_SCAN ioctl, so writes don't raise any signal. */
+
+#ifndef UFFD_USER_MODE_ONLY
+#define UFFD_USER_MODE_ONLY 1
+#endif
+#ifndef UFFD_FEATURE_WP_UNPOPULATED
+#define UFFD_FEATURE_WP_UNPOPULATED (1 << 13)
+#endif
+#ifndef UFFD_FEATURE_WP_ASYNC
+#define UFFD_FEATURE_WP_ASYNC (1 << 15)
+#endif
+
+#ifndef PAGEMAP_SCAN
+struct page_region
+{
+    __u64 start;
+    __u64 end;
+    __u64 categories;
+};
+
+struct pm_scan_arg
+{
+    __u64 size;
+    __u64 flags;
+    __u64 start;
+    __u64 end;
+    __u64 walk_end;
+    __u64 vec;
+    __u64 vec_len;
+    __u64 max_pages;
+    __u64 category_inverted;
+    __u64 category_mask;
+    __u64 category_anyof_mask;
+    __u64 return_mask;
+};
+
+#define PAGEMAP_SCAN          _IOWR('f', 16, struct pm_scan_arg)
+#define PAGE_IS_WRITTEN       (1 << 1)
+#define PM_SCAN_WP_MATCHING   (1 << 0)
+#define PM_SCAN_CHECK_WPASYNC (1 << 1)
+#endif
+
+static int uffd_fd = -1;
+static int pagemap_fd = -1;
+
+/* start tracking writes to a range, and write protect it */
+static BOOL kernel_watch_range( void *base, size_t size )
+{
+    struct uffdio_register reg;
+    struct uffdio_writeprotect wp;
+
+    reg.range.start = (UINT_PTR)base;
+    reg.range.len = size;
+    reg.mode = UFFDIO_REGISTER_MODE_WP;
+    wp.range = reg.range;
+    wp.mode = UFFDIO_WRITEPROTECT_MODE_WP;
+    if (!ioctl( uffd_fd, UFFDIO_REGISTER, &reg ) && !ioctl( uffd_fd, UFFDIO_WRITEPROTECT, &wp )) return TRUE;
+    WARN( "failed to watch %p-%p: %s\n", base, (char *)base + size, strerror(errno) );
+    return FALSE;
+}
+
+/* write protect a range again, so that the next writes are tracked */
+static void kernel_reset_write_watches( void *base, size_t size )
+{
+    struct uffdio_writeprotect wp;
+
+    wp.range.start = (UINT_PTR)base;
+    wp.range.len = size;
+    wp.mode = UFFDIO_WRITEPROTECT_MODE_WP;
+    if (ioctl( uffd_fd, UFFDIO_WRITEPROTECT, &wp ))
+        ERR( "failed to reset %p-%p: %s\n", base, (char *)base + size, strerror(errno) );
+}
+
+/* retrieve the pages written since the last reset, optionally resetting the scanned range */
+static char *kernel_get_write_watches( char *base, size_t size, void **addresses,
+                                       ULONG_PTR *count, BOOL reset )
+{
+    struct page_region regions[64];
+    struct pm_scan_arg arg;
+    char *addr = base, *end = base + size, *page;
+    ULONG_PTR pos = 0;
+    int i, ret;
+
+    while (pos < *count && addr < end)
+    {
+        memset( &arg, 0, sizeof(arg) );
+        arg.size = sizeof(arg);
+        arg.flags = reset ? PM_SCAN_WP_MATCHING | PM_SCAN_CHECK_WPASYNC : 0;
+        arg.start = (UINT_PTR)addr;
+        arg.end = (UINT_PTR)end;
+        arg.vec = (UINT_PTR)regions;
+        arg.vec_len = ARRAY_SIZE(regions);
+        arg.max_pages = *count - pos;
+        arg.category_mask = arg.return_mask = PAGE_IS_WRITTEN;
+
+        if ((ret = ioctl( pagemap_fd, PAGEMAP_SCAN, &arg )) == -1)
+        {
+            /* report everything as written rather than miss any write */
+            ERR( "scan of %p-%p failed: %s\n", addr, end, strerror(errno) );
+            for ( ; pos < *count && addr < end; addr += page_size) addresses[pos++] = addr;
+            break;
+        }
+        for (i = 0; i < ret; i++)
+            for (page = (char *)(UINT_PTR)regions[i].start;
+                 page < (char *)(UINT_PTR)regions[i].end && pos < *count; page += page_size)
+                addresses[pos++] = page;
+        addr = (char *)(UINT_PTR)arg.walk_end;
+    }
+    *count = pos;
+    return addr;
+}
+
+static void init_kernel_writewatch(void)
+{
+    struct uffdio_api api;
+    const char *env;
+    void *addrs[2];
+    char *ptr;
+    ULONG_PTR count = ARRAY_SIZE(addrs);
+
+    if ((env = getenv( "WINE_DISABLE_KERNEL_WRITEWATCH" )) && atoi( env )) return;
+
+    if ((uffd_fd = syscall( __NR_userfaultfd, O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY )) == -1)
+    {
+        TRACE( "userfaultfd not available: %s\n", strerror(errno) );
+        return;
+    }
+    api.api = UFFD_API;
+    api.features = UFFD_FEATURE_WP_ASYNC | UFFD_FEATURE_WP_UNPOPULATED;
+    if (ioctl( uffd_fd, UFFDIO_API, &api ) ||
+        (api.features & (UFFD_FEATURE_WP_ASYNC | UFFD_FEATURE_WP_UNPOPULATED)) !=
+        (UFFD_FEATURE_WP_ASYNC | UFFD_FEATURE_WP_UNPOPULATED) ||
+        (pagemap_fd = open( "/proc/self/pagemap", O_RDONLY | O_CLOEXEC )) == -1)
+        goto failed;
+
+    /* check that the whole thing works on a test page */
+    if ((ptr = anon_mmap_alloc( 2 * page_size, PROT_READ | PROT_WRITE )) == MAP_FAILED) goto failed;
+    if (kernel_watch_range( ptr, 2 * page_size ))
+    {
+        ptr[page_size] = 1;
+        if (kernel_get_write_watches( ptr, 2 * page_size, addrs, &count, TRUE ) &&
+            count == 1 && addrs[0] == ptr + page_size)
+            use_kernel_writewatch = TRUE;
+    }
+    munmap( ptr, 2 * page_size );
+    if (use_kernel_writewatch)
+    {
+        TRACE( "using kernel write watches\n" );
+        return;
+    }
+
+failed:
+    TRACE( "kernel write watches not supported\n" );
+    if (pagemap_fd != -1) close( pagemap_fd );
+    close( uffd_fd );
+    pagemap_fd = uffd_fd = -1;
+}
+
+#else
+
+static BOOL kernel_watch_range( void *base, size_t size ) { return FALSE; }
+static void kernel_reset_write_watches( void *base, size_t size ) { }
+static char *kernel_get_write_watches( char *base, size_t size, void **addresses,
+                                       ULONG_PTR *count, BOOL reset )
+{
+    *count = 0;
+    return base;
+}
+static void init_kernel_writewatch(void) { }
+
+#endif
+
+
 /***********************************************************************
  *           update_write_watches
  */
@@ -1533,6 +1800,11 @@ static void update_write_watches( void *base, size_t size, size_t accessed_size
  */
 static void reset_write_watches( void *base, SIZE_T size )
 {
+    if (use_kernel_writewatch)
+    {
+        kernel_reset_write_watches( base, size );
+        return;
+    }
     set_page_vprot_bits( base, size, VPROT_WRITEWATCH, 0 );
     mprotect_range( base, size, 0, 0 );
 }
@@ -1881,10 +2153,11 @@ static void clear_native_views(void)
  * virtual_mutex must be held by caller.
  */
 static NTSTATUS map_view( struct file_view **view_ret, void *base, size_t size,
-                          int top_down, unsigned int vprot, unsigned short zero_bits_64 )
+                          int top_down, unsigned int vprot, unsigned short zero_bits_64, size_t align_mask )
 {
     void *ptr;
     NTSTATUS status;
+    size_t extra = align_mask > granularity_mask ? align_mask - granularity_mask : 0;
 
     if (base)
     {
@@ -1895,15 +2168,24 @@ static NTSTATUS map_view( struct file_view **view_ret, void *base, size_t size,
         ptr = base;
     }
     else if (!(ptr = alloc_free_area( (void*)(get_zero_bits_64_mask( zero_bits_64 )
-            & (UINT_PTR)user_space_limit), size, top_down, get_unix_prot( vprot ) )))
+            & (UINT_PTR)user_space_limit), size + extra, top_down, get_unix_prot( vprot ) )))
     {
         WARN("Allocation failed, clearing native views.\n");
 
         clear_native_views();
         if (!(ptr = alloc_free_area( (void*)(get_zero_bits_64_mask( zero_bits_64 )
-                & (UINT_PTR)user_space_limit), size, top_down, get_unix_prot( vprot ) )))
+                & (UINT_PTR)user_space_limit), size + extra, top_down, get_unix_prot( vprot ) )))
             return STATUS_NO_MEMORY;
     }
+    if (!base && extra)  /* release the unaligned parts of the area */
+    {
+        char *start = ROUND_ADDR( (char *)ptr + align_mask, align_mask );
+        char *end = (char *)ptr + size + extra;
+
+        if (start > (char *)ptr) unmap_area( ptr, start - (char *)ptr );
+        if (start + size < end) unmap_area( start + size, end - (start + size) );
+        ptr = start;
+    }
     status = create_view( view_ret, ptr, size, vprot );
     if (status != STATUS_SUCCESS) unmap_area( ptr, size );
     return status;
@@ -2031,6 +2313,9 @@ static NTSTATUS decommit_pages( struct file_view *view, size_t start, size_t siz
 {
     if (anon_mmap_fixed( (char *)view->base + start, size, PROT_NONE, 0 ) != MAP_FAILED)
     {
+        /* the new mapping has to be watched again */
+        if ((view->protect & VPROT_WRITEWATCH) && use_kernel_writewatch)
+            kernel_watch_range( (char *)view->base + start, size );
         set_page_vprot_bits( (char *)view->base + start, size, 0, VPROT_COMMITTED );
         return STATUS_SUCCESS;
     }
@@ -2060,7 +2345,7 @@ static NTSTATUS allocate_dos_memory( struct file_view **view, unsigned int vprot
     if (mmap_is_in_reserved_area( low_64k, dosmem_size - 0x10000 ) != 1)
     {
         addr = anon_mmap_tryfixed( low_64k, dosmem_size - 0x10000, unix_prot, 0 );
-        if (addr == MAP_FAILED) return map_view( view, NULL, dosmem_size, FALSE, vprot, 0 );
+        if (addr == MAP_FAILED) return map_view( view, NULL, dosmem_size, FALSE, vprot, 0, granularity_mask );
     }
 
     /* now try to allocate the low 64K too */
@@ -2399,7 +2684,7 @@ static NTSTATUS virtual_map_section( HANDLE handle, PVOID *addr_ptr, unsigned sh
     }
 
     res = STATUS_INVALID_PARAMETER;
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
 
     if (sec_flags & SEC_IMAGE)
     {
@@ -2409,9 +2694,11 @@ static NTSTATUS virtual_map_section( HANDLE handle, PVOID *addr_ptr, unsigned sh
         vprot = SEC_IMAGE | SEC_FILE | VPROT_COMMITTED | VPROT_READ | VPROT_EXEC | VPROT_WRITECOPY;
 
         if ((char *)base >= (char *)address_space_start)  /* make sure the DOS area remains free */
-            res = map_view( &view, base, size, alloc_type & MEM_TOP_DOWN, vprot, zero_bits_64 );
+            res = map_view( &view, base, size, alloc_type & MEM_TOP_DOWN, vprot, zero_bits_64,
+                            granularity_mask );
 
-        if (res) res = map_view( &view, NULL, size, alloc_type & MEM_TOP_DOWN, vprot, zero_bits_64 );
+        if (res) res = map_view( &view, NULL, size, alloc_type & MEM_TOP_DOWN, vprot, zero_bits_64,
+                                 granularity_mask );
         if (res) goto done;
 
         res = map_image_into_view( view, unix_handle, base, image_info->header_size,
@@ -2445,7 +2732,8 @@ static NTSTATUS virtual_map_section( HANDLE handle, PVOID *addr_ptr, unsigned sh
         get_vprot_flags( protect, &vprot, FALSE );
         vprot |= sec_flags;
         if (!(sec_flags & SEC_RESERVE)) vprot |= VPROT_COMMITTED;
-        res = map_view( &view, base, size, alloc_type & MEM_TOP_DOWN, vprot, zero_bits_64 );
+        res = map_view( &view, base, size, alloc_type & MEM_TOP_DOWN, vprot, zero_bits_64,
+                        granularity_mask );
         if (res) goto done;
 
         TRACE( "handle=%p size=%lx offset=%x%08x\n", handle, size, offset.u.HighPart, offset.u.LowPart );
@@ -2477,14 +2765,44 @@ static NTSTATUS virtual_map_section( HANDLE handle, PVOID *addr_ptr, unsigned sh
     else delete_view( view );
 
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     if (needs_close) close( unix_handle );
     if (shared_needs_close) close( shared_fd );
     if (shared_file) NtClose( shared_file );
+#ifdef __x86_64__
+    if (res >= 0 && (sec_flags & SEC_IMAGE)) profile_add_image( *addr_ptr );
+#endif
     return res;
 }
 
 
+/***********************************************************************
+ *           init_large_pages
+ *
+ * Get whether huge pages should be used for all large allocations.
+ */
+static void init_large_pages(void)
+{
+    const char *env;
+
+    if ((env = getenv( "WINE_LARGE_PAGES" ))) large_pages_for_all = atoi( env );
+}
+
+
+/***********************************************************************
+ *           use_large_pages
+ *
+ * Ask the kernel to back a range with huge pages.
+ */
+static void use_large_pages( void *base, size_t size )
+{
+#ifdef MADV_HUGEPAGE
+    if (madvise( base, size, MADV_HUGEPAGE ) == -1)
+        WARN( "madvise failed for %p-%p: %s\n", base, (char *)base + size, strerror(errno) );
+#endif
+}
+
+
 struct alloc_virtual_heap
 {
     void  *base;
@@ -2567,6 +2885,9 @@ void virtual_init(void)
     size = (char *)address_space_start - (char *)0x10000;
     if (size && mmap_is_in_reserved_area( (void*)0x10000, size ) == 1)
         anon_mmap_fixed( (void *)0x10000, size, PROT_READ | PROT_WRITE, 0 );
+
+    init_large_pages();
+    init_kernel_writewatch();
 }
 
 
@@ -2629,7 +2950,7 @@ NTSTATUS virtual_create_builtin_view( void *module, const UNICODE_STRING *nt_nam
     void *base = wine_server_get_ptr( info->base );
     int i;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     status = create_view( &view, base, size, SEC_IMAGE | SEC_FILE | VPROT_SYSTEM |
                           VPROT_COMMITTED | VPROT_READ | VPROT_WRITECOPY | VPROT_EXEC );
     if (!status)
@@ -2667,7 +2988,10 @@ NTSTATUS virtual_create_builtin_view( void *module, const UNICODE_STRING *nt_nam
         }
         else delete_view( view );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
+#ifdef __x86_64__
+    if (status >= 0) profile_add_image( base );
+#endif
 
     return status;
 }
@@ -2701,6 +3025,7 @@ static void init_teb( TEB *teb, PEB *peb )
     teb->StaticUnicodeString.MaximumLength = sizeof(teb->StaticUnicodeBuffer);
     thread_data->esync_apc_fd = -1;
     thread_data->fsync_apc_futex = NULL;
+    thread_data->fsync_reply = NULL;
     thread_data->request_fd = -1;
     thread_data->reply_fd   = -1;
     thread_data->wait_fd[0] = -1;
@@ -2757,7 +3082,7 @@ NTSTATUS virtual_alloc_teb( TEB **ret_teb )
     NTSTATUS status = STATUS_SUCCESS;
     SIZE_T block_size = signal_stack_mask + 1;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     if (next_free_teb)
     {
         ptr = next_free_teb;
@@ -2773,7 +3098,7 @@ NTSTATUS virtual_alloc_teb( TEB **ret_teb )
             if ((status = NtAllocateVirtualMemory( NtCurrentProcess(), &ptr, 0, &total,
                                                    MEM_RESERVE, PAGE_READWRITE )))
             {
-                server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+                unlock_views( &sigset );
                 return status;
             }
             teb_block = ptr;
@@ -2785,14 +3110,14 @@ NTSTATUS virtual_alloc_teb( TEB **ret_teb )
     }
     *ret_teb = teb = (TEB *)((char *)ptr + teb_offset);
     init_teb( teb, NtCurrentTeb()->Peb );
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
 
     if ((status = signal_alloc_thread( teb )))
     {
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        lock_views( &sigset );
         *(void **)ptr = next_free_teb;
         next_free_teb = ptr;
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        unlock_views( &sigset );
     }
     return status;
 }
@@ -2820,12 +3145,12 @@ void virtual_free_teb( TEB *teb )
         NtFreeVirtualMemory( GetCurrentProcess(), &thread_data->start_stack, &size, MEM_RELEASE );
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     list_remove( &thread_data->entry );
     ptr = (char *)teb - teb_offset;
     *(void **)ptr = next_free_teb;
     next_free_teb = ptr;
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
 }
 
 
@@ -2839,13 +3164,13 @@ NTSTATUS virtual_clear_tls_index( ULONG index )
 
     if (index < TLS_MINIMUM_AVAILABLE)
     {
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        lock_views( &sigset );
         LIST_FOR_EACH_ENTRY( thread_data, &teb_list, struct ntdll_thread_data, entry )
         {
             TEB *teb = CONTAINING_RECORD( thread_data, TEB, GdiTebBatch );
             teb->TlsSlots[index] = 0;
         }
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        unlock_views( &sigset );
     }
     else
     {
@@ -2853,13 +3178,13 @@ NTSTATUS virtual_clear_tls_index( ULONG index )
         if (index >= 8 * sizeof(NtCurrentTeb()->Peb->TlsExpansionBitmapBits))
             return STATUS_INVALID_PARAMETER;
 
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        lock_views( &sigset );
         LIST_FOR_EACH_ENTRY( thread_data, &teb_list, struct ntdll_thread_data, entry )
         {
             TEB *teb = CONTAINING_RECORD( thread_data, TEB, GdiTebBatch );
             if (teb->TlsExpansionSlots) teb->TlsExpansionSlots[index] = 0;
         }
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        unlock_views( &sigset );
     }
     return STATUS_SUCCESS;
 }
@@ -2888,10 +3213,10 @@ NTSTATUS virtual_alloc_thread_stack( INITIAL_TEB *stack, SIZE_T reserve_size, SI
     size = (size + 0xffff) & ~0xffff;  /* round to 64K boundary */
     if (pthread_size) *pthread_size = extra_size = max( page_size, ROUND_SIZE( 0, *pthread_size ));
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
 
     if ((status = map_view( &view, NULL, size + extra_size, FALSE,
-                            VPROT_READ | VPROT_WRITE | VPROT_COMMITTED, 0 )) != STATUS_SUCCESS)
+                            VPROT_READ | VPROT_WRITE | VPROT_COMMITTED, 0, granularity_mask )) != STATUS_SUCCESS)
         goto done;
 
 #ifdef VALGRIND_STACK_REGISTER
@@ -2929,7 +3254,7 @@ NTSTATUS virtual_alloc_thread_stack( INITIAL_TEB *stack, SIZE_T reserve_size, SI
     stack->StackBase = (char *)view->base + view->size;
     stack->StackLimit = (char *)view->base + 2 * page_size;
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     return status;
 }
 
@@ -2960,6 +3285,12 @@ void virtual_map_user_shared_data(void)
     }
     if (needs_close) close( fd );
     NtClose( section );
+
+    /* the server publishes the huge page size of the host */
+    if (user_shared_data->LargePageMinimum > page_size)
+        large_page_size = user_shared_data->LargePageMinimum;
+    TRACE( "large page size %#lx%s\n", (unsigned long)large_page_size,
+           large_pages_for_all ? ", used for all large allocations" : "" );
 }
 
 
@@ -3007,9 +3338,25 @@ NTSTATUS virtual_handle_fault( void *addr, DWORD err, void *stack )
 {
     NTSTATUS ret = STATUS_ACCESS_VIOLATION;
     char *page = ROUND_ADDR( addr, page_mask );
+    unsigned int seq;
     BYTE vprot;
 
-    mutex_lock( &virtual_mutex );  /* no need for signal masking inside signal handler */
+    /* plain access violations don't need the lock, only guard pages, write watches
+     * and faults on pages that are accessible now do */
+    seq = read_views_begin();
+    vprot = get_page_vprot( page );
+    if (!(vprot & VPROT_GUARD))
+    {
+        BOOL handled;
+
+        if (err & EXCEPTION_WRITE_FAULT)
+            handled = (vprot & VPROT_WRITEWATCH) || (get_unix_prot( vprot ) & PROT_WRITE);
+        else
+            handled = !err && (get_unix_prot( vprot ) & PROT_READ);
+        if (!handled && read_views_valid( seq )) return ret;
+    }
+
+    lock_views( NULL );  /* no need for signal masking inside signal handler */
     vprot = get_page_vprot( page );
     if (!is_inside_signal_stack( stack ) && (vprot & VPROT_GUARD))
     {
@@ -3051,7 +3398,7 @@ NTSTATUS virtual_handle_fault( void *addr, DWORD err, void *stack )
         else
             set_page_vprot_bits( page, page_size, 0, VPROT_READ | VPROT_EXEC );
     }
-    mutex_unlock( &virtual_mutex );
+    unlock_views( NULL );
     return ret;
 }
 
@@ -3094,13 +3441,13 @@ void *virtual_setup_exception( void *stack_ptr, size_t size, EXCEPTION_RECORD *r
     }
     else if (stack < (char *)NtCurrentTeb()->Tib.StackLimit)
     {
-        mutex_lock( &virtual_mutex );  /* no need for signal masking inside signal handler */
+        lock_views( NULL );  /* no need for signal masking inside signal handler */
         if ((get_page_vprot( stack ) & VPROT_GUARD) && grow_thread_stack( ROUND_ADDR( stack, page_mask )))
         {
             rec->ExceptionCode = STATUS_STACK_OVERFLOW;
             rec->NumberParameters = 0;
         }
-        mutex_unlock( &virtual_mutex );
+        unlock_views( NULL );
     }
 #if defined(VALGRIND_MAKE_MEM_UNDEFINED)
     VALGRIND_MAKE_MEM_UNDEFINED( stack, size );
@@ -3125,7 +3472,7 @@ static NTSTATUS check_write_access( void *base, size_t size, BOOL *has_write_wat
     for (i = 0; i < size; i += page_size)
     {
         BYTE vprot = get_page_vprot( addr + i );
-        if (vprot & VPROT_WRITEWATCH) *has_write_watch = TRUE;
+        if ((vprot & VPROT_WRITEWATCH) && !use_kernel_writewatch) *has_write_watch = TRUE;
         if (!(get_unix_prot( vprot & ~VPROT_WRITEWATCH ) & PROT_WRITE))
             return STATUS_INVALID_USER_BUFFER;
     }
@@ -3149,14 +3496,14 @@ unsigned int virtual_locked_server_call( void *req_ptr )
 
     if (!size) return wine_server_call( req_ptr );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     if (!(ret = check_write_access( addr, size, &has_write_watch )))
     {
         ret = server_call_unlocked( req );
         if (has_write_watch) update_write_watches( addr, size, wine_server_reply_size( req ));
     }
     else memset( &req->u.reply, 0, sizeof(req->u.reply) );
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     return ret;
 }
 
@@ -3173,14 +3520,14 @@ ssize_t virtual_locked_read( int fd, void *addr, size_t size )
     ssize_t ret = read( fd, addr, size );
     if (ret != -1 || errno != EFAULT) return ret;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     if (!check_write_access( addr, size, &has_write_watch ))
     {
         ret = read( fd, addr, size );
         err = errno;
         if (has_write_watch) update_write_watches( addr, size, max( 0, ret ));
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     errno = err;
     return ret;
 }
@@ -3198,14 +3545,14 @@ ssize_t virtual_locked_pread( int fd, void *addr, size_t size, off_t offset )
     ssize_t ret = pread( fd, addr, size, offset );
     if (ret != -1 || errno != EFAULT) return ret;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     if (!check_write_access( addr, size, &has_write_watch ))
     {
         ret = pread( fd, addr, size, offset );
         err = errno;
         if (has_write_watch) update_write_watches( addr, size, max( 0, ret ));
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     errno = err;
     return ret;
 }
@@ -3224,7 +3571,7 @@ ssize_t CDECL __wine_locked_recvmsg( int fd, struct msghdr *hdr, int flags )
     ssize_t ret = recvmsg( fd, hdr, flags );
     if (ret != -1 || errno != EFAULT) return ret;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     for (i = 0; i < hdr->msg_iovlen; i++)
         if (check_write_access( hdr->msg_iov[i].iov_base, hdr->msg_iov[i].iov_len, &has_write_watch ))
             break;
@@ -3236,7 +3583,7 @@ ssize_t CDECL __wine_locked_recvmsg( int fd, struct msghdr *hdr, int flags )
     if (has_write_watch)
         while (i--) update_write_watches( hdr->msg_iov[i].iov_base, hdr->msg_iov[i].iov_len, 0 );
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     errno = err;
     return ret;
 }
@@ -3247,14 +3594,18 @@ ssize_t CDECL __wine_locked_recvmsg( int fd, struct msghdr *hdr, int flags )
  */
 BOOL virtual_is_valid_code_address( const void *addr, SIZE_T size )
 {
-    struct file_view *view;
+    struct file_view *view, copy;
+    unsigned int seq;
     BOOL ret = FALSE;
     sigset_t sigset;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    if (find_view_lockless( addr, size, &copy, &seq ))
+        return !(copy.protect & VPROT_SYSTEM);  /* system views are not visible to the app */
+
+    lock_views( &sigset );
     if ((view = find_view( addr, size )))
         ret = !(view->protect & VPROT_SYSTEM);  /* system views are not visible to the app */
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     return ret;
 }
 
@@ -3341,7 +3692,7 @@ SIZE_T virtual_uninterrupted_read_memory( const void *addr, void *buffer, SIZE_T
 
     if (!size) return 0;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     if ((view = find_view( addr, size )))
     {
         if (!(view->protect & VPROT_SYSTEM))
@@ -3357,7 +3708,7 @@ SIZE_T virtual_uninterrupted_read_memory( const void *addr, void *buffer, SIZE_T
             }
         }
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     return bytes_read;
 }
 
@@ -3377,13 +3728,13 @@ NTSTATUS virtual_uninterrupted_write_memory( void *addr, const void *buffer, SIZ
 
     if (!size) return STATUS_SUCCESS;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     if (!(ret = check_write_access( addr, size, &has_write_watch )))
     {
         memcpy( addr, buffer, size );
         if (has_write_watch) update_write_watches( addr, size, size );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     return ret;
 }
 
@@ -3398,7 +3749,7 @@ void virtual_set_force_exec( BOOL enable )
     struct file_view *view;
     sigset_t sigset;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     if (!force_exec_prot != !enable)  /* change all existing views */
     {
         force_exec_prot = enable;
@@ -3416,7 +3767,7 @@ void virtual_set_force_exec( BOOL enable )
             mprotect_range( view->base, view->size, commit, 0 );
         }
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
 }
 
 struct free_range
@@ -3454,7 +3805,7 @@ void CDECL virtual_release_address_space(void)
 
     if (is_win64) return;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
 
     range.base  = (char *)0x82000000;
     range.limit = user_space_limit;
@@ -3478,7 +3829,7 @@ void CDECL virtual_release_address_space(void)
         while (mmap_enum_reserved_areas( free_reserved_memory, &range, 0 )) /* nothing */;
     }
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
 }
 
 
@@ -3505,10 +3856,11 @@ NTSTATUS WINAPI NtAllocateVirtualMemory( HANDLE process, PVOID *ret, ULONG_PTR z
 {
     void *base;
     unsigned int vprot;
-    BOOL is_dos_memory = FALSE;
+    BOOL is_dos_memory = FALSE, large_pages;
     struct file_view *view;
     sigset_t sigset;
     SIZE_T size = *size_ptr;
+    size_t align_mask = granularity_mask;
     NTSTATUS status = STATUS_SUCCESS;
     unsigned short zero_bits_64 = zero_bits_win_to_64( zero_bits );
 
@@ -3589,15 +3941,32 @@ NTSTATUS WINAPI NtAllocateVirtualMemory( HANDLE process, PVOID *ret, ULONG_PTR z
     /* Compute the alloc type flags */
 
     if (!(type & (MEM_COMMIT | MEM_RESERVE | MEM_RESET)) ||
-        (type & ~(MEM_COMMIT | MEM_RESERVE | MEM_TOP_DOWN | MEM_WRITE_WATCH | MEM_RESET)))
+        (type & ~(MEM_COMMIT | MEM_RESERVE | MEM_TOP_DOWN | MEM_WRITE_WATCH | MEM_RESET | MEM_LARGE_PAGES)))
     {
         WARN("called with wrong alloc type flags (%08x) !\n", type);
         return STATUS_INVALID_PARAMETER;
     }
 
+    /* large pages have to be reserved and committed at once, in multiples of the large page size */
+
+    if (type & MEM_LARGE_PAGES)
+    {
+        if ((type & (MEM_COMMIT | MEM_RESERVE)) != (MEM_COMMIT | MEM_RESERVE) ||
+            (type & MEM_WRITE_WATCH) || is_dos_memory ||
+            (*size_ptr & (large_page_size - 1)) || ((UINT_PTR)*ret & (large_page_size - 1)))
+        {
+            WARN("invalid large page allocation %p %08lx %08x\n", *ret, *size_ptr, type);
+            return STATUS_INVALID_PARAMETER;
+        }
+        large_pages = TRUE;
+    }
+    else large_pages = large_pages_for_all && (type & MEM_RESERVE) && !is_dos_memory &&
+                       size >= large_page_size;
+    if (large_pages && !base) align_mask = large_page_size - 1;
+
     /* Reserve the memory */
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
 
     if ((type & MEM_RESERVE) || !base)
     {
@@ -3609,9 +3978,19 @@ NTSTATUS WINAPI NtAllocateVirtualMemory( HANDLE process, PVOID *ret, ULONG_PTR z
 
             if (vprot & VPROT_WRITECOPY) status = STATUS_INVALID_PAGE_PROTECTION;
             else if (is_dos_memory) status = allocate_dos_memory( &view, vprot );
-            else status = map_view( &view, base, size, type & MEM_TOP_DOWN, vprot, zero_bits_64 );
+            else status = map_view( &view, base, size, type & MEM_TOP_DOWN, vprot, zero_bits_64, align_mask );
 
-            if (status == STATUS_SUCCESS) base = view->base;
+            if (status == STATUS_SUCCESS && (vprot & VPROT_WRITEWATCH) && use_kernel_writewatch &&
+                !kernel_watch_range( view->base, view->size ))
+            {
+                delete_view( view );
+                status = STATUS_NOT_SUPPORTED;
+            }
+            if (status == STATUS_SUCCESS)
+            {
+                base = view->base;
+                if (large_pages) use_large_pages( base, size );
+            }
         }
     }
     else if (type & MEM_RESET)
@@ -3638,7 +4017,7 @@ NTSTATUS WINAPI NtAllocateVirtualMemory( HANDLE process, PVOID *ret, ULONG_PTR z
 
     if (!status) VIRTUAL_DEBUG_DUMP_VIEW( view );
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
 
     if (status == STATUS_SUCCESS)
     {
@@ -3709,7 +4088,7 @@ NTSTATUS WINAPI NtFreeVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T *si
     /* avoid freeing the DOS area when a broken app passes a NULL pointer */
     if (!base) return STATUS_INVALID_PARAMETER;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
 
     if (!(view = find_view( base, size )) || !is_view_valloc( view ))
     {
@@ -3742,7 +4121,7 @@ NTSTATUS WINAPI NtFreeVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T *si
         status = STATUS_INVALID_PARAMETER;
     }
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     return status;
 }
 
@@ -3796,7 +4175,7 @@ NTSTATUS WINAPI NtProtectVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T
     size = ROUND_SIZE( addr, size );
     base = ROUND_ADDR( addr, page_mask );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
 
     if ((view = find_view( base, size )))
     {
@@ -3830,7 +4209,7 @@ NTSTATUS WINAPI NtProtectVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T
 
     if (!status) VIRTUAL_DEBUG_DUMP_VIEW( view );
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
 
     if (status == STATUS_SUCCESS)
     {
@@ -3879,6 +4258,36 @@ static int CDECL get_free_mem_state_callback( void *start, SIZE_T size, void *ar
 }
 
 /* get basic information about a memory block */
+static void fill_basic_memory_info( const struct file_view *view, BYTE vprot, MEMORY_BASIC_INFORMATION *info )
+{
+    info->State = (vprot & VPROT_COMMITTED) ? MEM_COMMIT : MEM_RESERVE;
+    info->Protect = (vprot & VPROT_COMMITTED) ? get_win32_prot( vprot, view->protect ) : 0;
+    info->AllocationProtect = get_win32_prot( view->protect, view->protect );
+    if (view->protect & SEC_IMAGE) info->Type = MEM_IMAGE;
+    else if (view->protect & (SEC_FILE | SEC_RESERVE | SEC_COMMIT)) info->Type = MEM_MAPPED;
+    else info->Type = MEM_PRIVATE;
+}
+
+/* query an address inside a view without taking virtual_mutex; fails if the caller needs the locked path */
+static BOOL get_basic_memory_info_lockless( char *base, MEMORY_BASIC_INFORMATION *info )
+{
+    struct file_view view;
+    unsigned int seq;
+    BYTE vprot;
+
+    if (!find_view_lockless( base, 0, &view, &seq )) return FALSE;
+    /* the committed state of SEC_RESERVE views has to be fetched from the server */
+    if (view.protect & SEC_RESERVE) return FALSE;
+
+    info->RegionSize = get_committed_size( &view, base, &vprot, ~VPROT_WRITEWATCH );
+    if (!read_views_valid( seq )) return FALSE;
+
+    info->AllocationBase = view.base;
+    info->BaseAddress    = base;
+    fill_basic_memory_info( &view, vprot, info );
+    return TRUE;
+}
+
 static NTSTATUS get_basic_memory_info( HANDLE process, LPCVOID addr,
                                        MEMORY_BASIC_INFORMATION *info,
                                        SIZE_T len, SIZE_T *res_len )
@@ -3924,9 +4333,15 @@ static NTSTATUS get_basic_memory_info( HANDLE process, LPCVOID addr,
 
     if (is_beyond_limit( base, 1, working_set_limit )) return STATUS_INVALID_PARAMETER;
 
+    if (get_basic_memory_info_lockless( base, info ))
+    {
+        if (res_len) *res_len = sizeof(*info);
+        return STATUS_SUCCESS;
+    }
+
     /* Find the view containing the address */
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     ptr = views_tree.root;
     while (ptr)
     {
@@ -3984,14 +4399,9 @@ static NTSTATUS get_basic_memory_info( HANDLE process, LPCVOID addr,
         BYTE vprot;
 
         info->RegionSize = get_committed_size( view, base, &vprot, ~VPROT_WRITEWATCH );
-        info->State = (vprot & VPROT_COMMITTED) ? MEM_COMMIT : MEM_RESERVE;
-        info->Protect = (vprot & VPROT_COMMITTED) ? get_win32_prot( vprot, view->protect ) : 0;
-        info->AllocationProtect = get_win32_prot( view->protect, view->protect );
-        if (view->protect & SEC_IMAGE) info->Type = MEM_IMAGE;
-        else if (view->protect & (SEC_FILE | SEC_RESERVE | SEC_COMMIT)) info->Type = MEM_MAPPED;
-        else info->Type = MEM_PRIVATE;
+        fill_basic_memory_info( view, vprot, info );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
 
     if (res_len) *res_len = sizeof(*info);
     return STATUS_SUCCESS;
@@ -4018,7 +4428,7 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
         if (!once++) WARN( "unable to open /proc/self/pagemap\n" );
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     for (p = info; (UINT_PTR)(p + 1) <= (UINT_PTR)info + len; p++)
     {
         BYTE vprot;
@@ -4046,7 +4456,7 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
                 p->VirtualAttributes.Win32Protection = get_win32_prot( vprot, view->protect );
         }
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
 
     if (f)
         fclose( f );
@@ -4375,7 +4785,7 @@ NTSTATUS WINAPI NtUnmapViewOfSection( HANDLE process, PVOID addr )
         return status;
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     if ((view = find_view( addr, 0 )) && !is_view_valloc( view ))
     {
         SERVER_START_REQ( unmap_view )
@@ -4387,7 +4797,7 @@ NTSTATUS WINAPI NtUnmapViewOfSection( HANDLE process, PVOID addr )
         if (!status) delete_view( view );
         else FIXME( "failed to unmap %p %x\n", view->base, status );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     return status;
 }
 
@@ -4513,7 +4923,7 @@ NTSTATUS WINAPI NtFlushVirtualMemory( HANDLE process, LPCVOID *addr_ptr,
         return result.virtual_flush.status;
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
     if (!(view = find_view( addr, *size_ptr ))) status = STATUS_INVALID_PARAMETER;
     else
     {
@@ -4523,7 +4933,7 @@ NTSTATUS WINAPI NtFlushVirtualMemory( HANDLE process, LPCVOID *addr_ptr,
         if (msync( addr, *size_ptr, MS_ASYNC )) status = STATUS_NOT_MAPPED_DATA;
 #endif
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     return status;
 }
 
@@ -4550,9 +4960,15 @@ NTSTATUS WINAPI NtGetWriteWatch( HANDLE process, ULONG flags, PVOID base, SIZE_T
     TRACE( "%p %x %p-%p %p %lu\n", process, flags, base, (char *)base + size,
            addresses, *count );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
 
-    if (is_write_watch_range( base, size ))
+    if (!is_write_watch_range( base, size )) status = STATUS_INVALID_PARAMETER;
+    else if (use_kernel_writewatch)
+    {
+        kernel_get_write_watches( base, size, addresses, count, flags & WRITE_WATCH_FLAG_RESET );
+        *granularity = page_size;
+    }
+    else
     {
         ULONG_PTR pos = 0;
         char *addr = base;
@@ -4567,9 +4983,8 @@ NTSTATUS WINAPI NtGetWriteWatch( HANDLE process, ULONG flags, PVOID base, SIZE_T
         *count = pos;
         *granularity = page_size;
     }
-    else status = STATUS_INVALID_PARAMETER;
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     return status;
 }
 
@@ -4590,14 +5005,14 @@ NTSTATUS WINAPI NtResetWriteWatch( HANDLE process, PVOID base, SIZE_T size )
 
     if (!size) return STATUS_INVALID_PARAMETER;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
 
     if (is_write_watch_range( base, size ))
         reset_write_watches( base, size );
     else
         status = STATUS_INVALID_PARAMETER;
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     return status;
 }
 
@@ -4718,7 +5133,7 @@ NTSTATUS WINAPI NtAreMappedFilesTheSame(PVOID addr1, PVOID addr2)
 
     TRACE("%p %p\n", addr1, addr2);
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_views( &sigset );
 
     view1 = find_view( addr1, 0 );
     view2 = find_view( addr2, 0 );
@@ -4742,7 +5157,7 @@ NTSTATUS WINAPI NtAreMappedFilesTheSame(PVOID addr1, PVOID addr2)
         SERVER_END_REQ;
     }
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_views( &sigset );
     return status;
 }
 
@@ -26,7 +26,16 @@
 struct _DISPATCHER_CONTEXT;
 
 /* increment this when you change the function table */
-#define NTDLL_UNIXLIB_VERSION 113
+#define NTDLL_UNIXLIB_VERSION 115
+
+/* file a builtin module was loaded from */
+struct builtin_file_id
+{
+    ULONG64 dev;
+    ULONG64 ino;
+    ULONG64 mtime;
+    ULONG64 size;
+};
 
 struct unix_funcs
 {
@@ -80,7 +89,12 @@ struct unix_funcs
     NTSTATUS      (CDECL *load_so_dll)( UNICODE_STRING *nt_name, void **module );
     NTSTATUS      (CDECL *load_builtin_dll)( UNICODE_STRING *name, void **module, void **unix_entry,
                                              SECTION_IMAGE_INFORMATION *image_info, BOOL prefer_native );
+    NTSTATUS      (CDECL *prefetch_builtin_dll)( UNICODE_STRING *name, void **module,
+                                                 SECTION_IMAGE_INFORMATION *image_info );
     NTSTATUS      (CDECL *unload_builtin_dll)( void *module );
+    NTSTATUS      (CDECL *get_builtin_file_id)( void *module, struct builtin_file_id *id );
+    NTSTATUS      (CDECL *read_import_cache)( void *data, SIZE_T *size );
+    NTSTATUS      (CDECL *write_import_cache)( const void *data, SIZE_T size );
     void          (CDECL *init_builtin_dll)( void *module );
     NTSTATUS      (CDECL *unwind_builtin_dll)( ULONG type, struct _DISPATCHER_CONTEXT *dispatch,
                                                CONTEXT *context );
@@ -241,27 +241,53 @@ void WINAPI mouse_event( DWORD dwFlags, DWORD dx, DWORD dy,
 }
 
 
+/***********************************************************************
+ *		get_shared_cursor_pos
+ *
+ * Read the cursor position from the desktop state shared with the server.
+ */
+static void get_shared_cursor_pos( const struct desktop_shared_memory *shared, POINT *pt, DWORD *last_change )
+{
+    unsigned int seq;
+
+    do
+    {
+        while ((seq = *(volatile const unsigned int *)&shared->seq) & 1) YieldProcessor();
+        MemoryBarrier();
+        pt->x = shared->cursor_x;
+        pt->y = shared->cursor_y;
+        *last_change = shared->cursor_last_change;
+        MemoryBarrier();
+    } while (*(volatile const unsigned int *)&shared->seq != seq);
+}
+
+
 /***********************************************************************
  *		GetCursorPos (USER32.@)
  */
 BOOL WINAPI DECLSPEC_HOTPATCH GetCursorPos( POINT *pt )
 {
-    BOOL ret;
+    const struct desktop_shared_memory *shared;
+    BOOL ret = TRUE;
     DWORD last_change;
     UINT dpi;
 
     if (!pt) return FALSE;
 
-    SERVER_START_REQ( set_cursor )
+    if ((shared = get_desktop_shared_memory())) get_shared_cursor_pos( shared, pt, &last_change );
+    else
     {
-        if ((ret = !wine_server_call( req )))
+        SERVER_START_REQ( set_cursor )
         {
-            pt->x = reply->new_x;
-            pt->y = reply->new_y;
-            last_change = reply->last_change;
+            if ((ret = !wine_server_call( req )))
+            {
+                pt->x = reply->new_x;
+                pt->y = reply->new_y;
+                last_change = reply->last_change;
+            }
         }
+        SERVER_END_REQ;
     }
-    SERVER_END_REQ;
 
     /* query new position from graphics driver if we haven't updated recently */
     if (ret && GetTickCount() - last_change > 100) ret = USER_Driver->pGetCursorPos( pt );
@@ -390,6 +416,7 @@ static void check_for_events( UINT flags )
 SHORT WINAPI DECLSPEC_HOTPATCH GetAsyncKeyState( INT key )
 {
     struct user_key_state_info *key_state_info = get_user_thread_info()->key_state;
+    const struct desktop_shared_memory *shared;
     INT counter = global_key_state_counter;
     BYTE prev_key_state;
     SHORT ret;
@@ -398,6 +425,13 @@ SHORT WINAPI DECLSPEC_HOTPATCH GetAsyncKeyState( INT key )
 
     check_for_events( QS_INPUT );
 
+    /* the server only needs to be called to clear the pressed since last call bit */
+    if ((shared = get_desktop_shared_memory()))
+    {
+        BYTE state = *(volatile const BYTE *)&shared->keystate[key];
+        if (!(state & 0x40)) return (state & 0x80) ? 0x8000 : 0;
+    }
+
     if (key_state_info && !(key_state_info->state[key] & 0xc0) &&
         key_state_info->counter == counter && GetTickCount() - key_state_info->time < 50)
     {
@@ -448,6 +482,7 @@ SHORT WINAPI DECLSPEC_HOTPATCH GetAsyncKeyState( INT key )
  */
 DWORD WINAPI GetQueueStatus( UINT flags )
 {
+    const struct queue_shared_memory *shared;
     DWORD ret;
 
     if (flags & ~(QS_ALLINPUT | QS_ALLPOSTMESSAGE | QS_SMRESULT))
@@ -458,6 +493,10 @@ DWORD WINAPI GetQueueStatus( UINT flags )
 
     check_for_events( flags );
 
+    /* nothing to clear, the shared state is enough */
+    if ((shared = get_queue_shared_memory()) && !(shared->changed_bits & flags))
+        return MAKELONG( 0, shared->wake_bits & flags );
+
     SERVER_START_REQ( get_queue_status )
     {
         req->clear_bits = flags;
@@ -474,10 +513,13 @@ DWORD WINAPI GetQueueStatus( UINT flags )
  */
 BOOL WINAPI GetInputState(void)
 {
+    const struct queue_shared_memory *shared;
     DWORD ret;
 
     check_for_events( QS_INPUT );
 
+    if ((shared = get_queue_shared_memory())) return shared->wake_bits & (QS_KEY | QS_MOUSEBUTTON);
+
     SERVER_START_REQ( get_queue_status )
     {
         req->clear_bits = 0;
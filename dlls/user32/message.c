@@ -52,6 +52,9 @@ WINE_DECLARE_DEBUG_CHANNEL(key);
 
 #define MAX_PACK_COUNT 4
 
+/* maximum time in ms between server get_message calls while polling an empty queue */
+#define GET_MSG_MIN_INTERVAL 50
+
 /* the various structures that can be sent in messages, in platform-independent layout */
 struct packed_CREATESTRUCTW
 {
@@ -2688,6 +2691,26 @@ static inline void call_sendmsg_callback( SENDASYNCPROC callback, HWND hwnd, UIN
 }
 
 
+/***********************************************************************
+ *           is_queue_empty
+ *
+ * Check through the shared queue state if peek_message can return without a server call.
+ */
+static BOOL is_queue_empty( HWND hwnd, UINT changed_mask )
+{
+    struct user_thread_info *thread_info = get_user_thread_info();
+    const struct queue_shared_memory *shared = get_queue_shared_memory();
+
+    if (!shared || hwnd == HWND_TOPMOST) return FALSE;
+    /* get_message also updates the hung state and the active hooks, so call it regularly */
+    if (GetTickCount() - thread_info->get_msg_time >= GET_MSG_MIN_INTERVAL) return FALSE;
+    /* changing the wake masks needs a server call */
+    if (thread_info->wake_mask != (changed_mask & (QS_SENDMESSAGE | QS_SMRESULT)) ||
+        thread_info->changed_mask != changed_mask) return FALSE;
+    return !*(volatile const unsigned int *)&shared->wake_bits;
+}
+
+
 /***********************************************************************
  *           peek_message
  *
@@ -2710,6 +2733,12 @@ static int peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags,
     if (!first && !last) last = ~0;
     if (hwnd == HWND_BROADCAST) hwnd = HWND_TOPMOST;
 
+    if (is_queue_empty( hwnd, changed_mask ))
+    {
+        HeapFree( GetProcessHeap(), 0, buffer );
+        return 0;
+    }
+
     for (;;)
     {
         NTSTATUS res;
@@ -2745,6 +2774,7 @@ static int peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags,
             else buffer_size = reply->total;
         }
         SERVER_END_REQ;
+        thread_info->get_msg_time = GetTickCount();
 
         if (res)
         {
@@ -2951,6 +2981,43 @@ static inline void process_sent_messages(void)
 }
 
 
+/***********************************************************************
+ *           map_shared_memory
+ *
+ * Map a section of server state shared with the clients, caching the result in *cache.
+ */
+const void *map_shared_memory( const WCHAR *name, void **cache )
+{
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING str;
+    SIZE_T size = 0;
+    HANDLE handle;
+    void *ptr = NULL, *prev;
+
+    if (*cache) return *cache != INVALID_HANDLE_VALUE ? *cache : NULL;
+
+    RtlInitUnicodeString( &str, name );
+    InitializeObjectAttributes( &attr, &str, 0, NULL, NULL );
+    if (!NtOpenSection( &handle, SECTION_MAP_READ, &attr ))
+    {
+        if (NtMapViewOfSection( handle, GetCurrentProcess(), &ptr, 0, 0, NULL, &size,
+                                ViewShare, 0, PAGE_READONLY )) ptr = NULL;
+        NtClose( handle );
+    }
+    if (!ptr)
+    {
+        WARN( "%s not available, using server calls\n", debugstr_w(name) );
+        ptr = INVALID_HANDLE_VALUE;
+    }
+    if ((prev = InterlockedCompareExchangePointer( cache, ptr, NULL )))
+    {
+        if (ptr != INVALID_HANDLE_VALUE) NtUnmapViewOfSection( GetCurrentProcess(), ptr );
+        ptr = prev;
+    }
+    return ptr != INVALID_HANDLE_VALUE ? ptr : NULL;
+}
+
+
 /***********************************************************************
  *           get_server_queue_handle
  *
@@ -2958,7 +3025,10 @@ static inline void process_sent_messages(void)
  */
 static HANDLE get_server_queue_handle(void)
 {
+    static void *queue_shared_data;
     struct user_thread_info *thread_info = get_user_thread_info();
+    const struct queue_shared_memory *shared_data;
+    unsigned int shared = ~0u;
     HANDLE ret;
 
     if (!(ret = thread_info->server_queue))
@@ -2967,15 +3037,32 @@ static HANDLE get_server_queue_handle(void)
         {
             wine_server_call( req );
             ret = wine_server_ptr_handle( reply->handle );
+            shared = reply->shared;
         }
         SERVER_END_REQ;
         thread_info->server_queue = ret;
         if (!ret) ERR( "Cannot get server thread queue\n" );
+        else if (shared < QUEUE_SHARED_MAX_QUEUES &&
+                 (shared_data = map_shared_memory( L"\\KernelObjects\\__wine_queue_shared_data",
+                                                   &queue_shared_data )))
+            thread_info->queue_shared = shared_data + shared;
     }
     return ret;
 }
 
 
+/***********************************************************************
+ *           get_queue_shared_memory
+ *
+ * Get the queue state shared with the server, or NULL if not available.
+ */
+const struct queue_shared_memory *get_queue_shared_memory(void)
+{
+    get_server_queue_handle();
+    return get_user_thread_info()->queue_shared;
+}
+
+
 /***********************************************************************
  *           wait_message_reply
  *
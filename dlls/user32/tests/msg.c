@@ -12747,6 +12747,39 @@ static void test_PeekMessage3(void)
     flush_events();
 }
 
+static void test_PeekMessage_empty(void)
+{
+    DWORD status, i;
+    BOOL ret;
+    MSG msg;
+
+    flush_events();
+    flush_sequence();
+
+    ret = PeekMessageA(&msg, NULL, 0, 0, PM_REMOVE);
+    ok(!ret, "expected PeekMessage to return FALSE, got %u\n", ret);
+    status = GetQueueStatus(QS_ALLINPUT);
+    ok(!status, "GetQueueStatus returned %#x\n", status);
+
+    /* the queue bits must be up to date right after posting */
+    for (i = 0; i < 100; i++)
+    {
+        PostThreadMessageA(GetCurrentThreadId(), WM_USER, i, 0);
+        status = GetQueueStatus(QS_ALLINPUT);
+        ok(status == MAKELONG(QS_POSTMESSAGE, QS_POSTMESSAGE), "%u: GetQueueStatus returned %#x\n", i, status);
+        status = GetQueueStatus(QS_ALLINPUT);
+        ok(status == MAKELONG(0, QS_POSTMESSAGE), "%u: GetQueueStatus returned %#x\n", i, status);
+        ok(!GetInputState(), "%u: GetInputState returned TRUE\n", i);
+        ret = PeekMessageA(&msg, NULL, 0, 0, PM_REMOVE);
+        ok(ret && msg.message == WM_USER && msg.wParam == i, "%u: got ret %u msg %04x wparam %lu\n",
+           i, ret, msg.message, msg.wParam);
+        ret = PeekMessageA(&msg, NULL, 0, 0, PM_REMOVE);
+        ok(!ret, "%u: expected PeekMessage to return FALSE, got %u\n", i, ret);
+        status = GetQueueStatus(QS_ALLINPUT);
+        ok(!status, "%u: GetQueueStatus returned %#x\n", i, status);
+    }
+}
+
 static INT_PTR CALLBACK wm_quit_dlg_proc(HWND hwnd, UINT message, WPARAM wp, LPARAM lp)
 {
     struct recvd_message msg;
@@ -18303,6 +18336,7 @@ START_TEST(msg)
     test_PeekMessage();
     test_PeekMessage2();
     test_PeekMessage3();
+    test_PeekMessage_empty();
     test_WaitForInputIdle( test_argv[0] );
     test_scrollwindowex();
     test_messages();
@@ -11858,7 +11858,8 @@ static void other_process_proc(HWND hwnd)
 {
     HANDLE window_ready_event, test_done_event;
     WINDOWPLACEMENT wp;
-    DWORD ret;
+    DWORD ret, tid, pid;
+    RECT rect;
 
     window_ready_event = OpenEventA(EVENT_ALL_ACCESS, FALSE, "test_opw_window");
     ok(!!window_ready_event, "OpenEvent failed.\n");
@@ -11872,6 +11873,15 @@ static void other_process_proc(HWND hwnd)
     ok(ret, "Unexpected ret %#x.\n", ret);
     ok(wp.showCmd == SW_SHOWNORMAL, "Unexpected showCmd %#x.\n", wp.showCmd);
     ok(!wp.flags, "Unexpected flags %#x.\n", wp.flags);
+    ok(IsWindowVisible(hwnd), "Window should be visible.\n");
+    ok(GetWindowLongA(hwnd, GWL_STYLE) & WS_VISIBLE, "Unexpected style %#x.\n", GetWindowLongA(hwnd, GWL_STYLE));
+    ok(!GetParent(hwnd), "Unexpected parent %p.\n", GetParent(hwnd));
+    GetWindowRect(hwnd, &rect);
+    ok(rect.left == 100 && rect.top == 100 && rect.right == 200 && rect.bottom == 200,
+       "Unexpected rect %s.\n", wine_dbgstr_rect(&rect));
+    tid = GetWindowThreadProcessId(hwnd, &pid);
+    ok(tid && tid != GetCurrentThreadId(), "Unexpected tid %#x.\n", tid);
+    ok(pid && pid != GetCurrentProcessId(), "Unexpected pid %#x.\n", pid);
     SetEvent(test_done_event);
 
     /* SW_SHOWMAXIMIZED */
@@ -11890,6 +11900,7 @@ static void other_process_proc(HWND hwnd)
     ok(ret, "Unexpected ret %#x.\n", ret);
     ok(wp.showCmd == SW_SHOWMINIMIZED, "Unexpected showCmd %#x.\n", wp.showCmd);
     todo_wine ok(wp.flags == WPF_RESTORETOMAXIMIZED, "Unexpected flags %#x.\n", wp.flags);
+    ok(IsIconic(hwnd), "Window should be minimized.\n");
     SetEvent(test_done_event);
 
     /* SW_RESTORE */
@@ -202,11 +202,20 @@ struct user_thread_info
     HWND                          top_window;             /* Desktop window */
     HWND                          msg_window;             /* HWND_MESSAGE parent window */
     struct rawinput_thread_data  *rawinput;               /* RawInput thread local data / buffer */
+    const struct queue_shared_memory *queue_shared;       /* Queue state shared with the server */
+    DWORD                         get_msg_time;           /* Time of the last get_message server call */
+    const struct desktop_shared_memory *desktop_shared;   /* Desktop state shared with the server */
 };
 
 C_ASSERT( sizeof(struct user_thread_info) <= sizeof(((TEB *)0)->Win32ClientInfo) );
 
 extern INT global_key_state_counter DECLSPEC_HIDDEN;
+struct window_shared_memory;
+
+extern const void *map_shared_memory( const WCHAR *name, void **cache ) DECLSPEC_HIDDEN;
+extern const struct queue_shared_memory *get_queue_shared_memory(void) DECLSPEC_HIDDEN;
+extern const struct desktop_shared_memory *get_desktop_shared_memory(void) DECLSPEC_HIDDEN;
+extern BOOL get_window_shared_info( HWND hwnd, struct window_shared_memory *info ) DECLSPEC_HIDDEN;
 extern BOOL (WINAPI *imm_register_window)(HWND) DECLSPEC_HIDDEN;
 extern void (WINAPI *imm_unregister_window)(HWND) DECLSPEC_HIDDEN;
 extern void (WINAPI *imm_activate_window)(HWND) DECLSPEC_HIDDEN;
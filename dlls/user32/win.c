@@ -658,6 +658,37 @@ WND *WIN_GetPtr( HWND hwnd )
 }
 
 
+/***********************************************************************
+ *           get_window_shared_info
+ *
+ * Read the state of a window from the memory shared with the server.
+ * Return FALSE if it's not available or if the handle is not valid.
+ */
+BOOL get_window_shared_info( HWND hwnd, struct window_shared_memory *info )
+{
+    static void *window_shared_data;
+    const struct window_shared_memory *data, *shared;
+    WORD index = USER_HANDLE_TO_INDEX( hwnd );
+    unsigned int seq;
+
+    if (index >= NB_USER_HANDLES) return FALSE;
+    if (!(data = map_shared_memory( L"\\KernelObjects\\__wine_window_shared_data", &window_shared_data )))
+        return FALSE;
+
+    shared = &data[index];
+    do
+    {
+        while ((seq = *(volatile const unsigned int *)&shared->seq) & 1) YieldProcessor();
+        MemoryBarrier();
+        *info = *shared;
+        MemoryBarrier();
+    } while (*(volatile const unsigned int *)&shared->seq != seq);
+
+    if (!info->handle) return FALSE;
+    return (info->handle == (UINT)(UINT_PTR)hwnd || !HIWORD(hwnd) || HIWORD(hwnd) == 0xffff);
+}
+
+
 /***********************************************************************
  *           WIN_IsCurrentProcess
  *
@@ -837,6 +868,66 @@ ULONG WIN_SetStyle( HWND hwnd, ULONG set_bits, ULONG clear_bits )
 }
 
 
+/***********************************************************************
+ *           get_shared_rectangles
+ *
+ * Get the window rectangles from the state shared with the server, if possible without a server call.
+ */
+static BOOL get_shared_rectangles( HWND hwnd, enum coords_relative relative, RECT *rectWindow, RECT *rectClient )
+{
+    struct window_shared_memory info, parent;
+    RECT window_rect, client_rect, rect;
+    HWND next;
+
+    if (!get_window_shared_info( hwnd, &info )) return FALSE;
+    /* mapping to the thread DPI is left to the server */
+    if (info.dpi != get_thread_dpi()) return FALSE;
+
+    SetRect( &window_rect, info.window.left, info.window.top, info.window.right, info.window.bottom );
+    SetRect( &client_rect, info.client.left, info.client.top, info.client.right, info.client.bottom );
+
+    switch (relative)
+    {
+    case COORDS_CLIENT:
+        rect = client_rect;
+        OffsetRect( &window_rect, -rect.left, -rect.top );
+        OffsetRect( &client_rect, -rect.left, -rect.top );
+        if (info.ex_style & WS_EX_LAYOUTRTL) mirror_rect( &rect, &window_rect );
+        break;
+    case COORDS_WINDOW:
+        rect = window_rect;
+        OffsetRect( &window_rect, -rect.left, -rect.top );
+        OffsetRect( &client_rect, -rect.left, -rect.top );
+        if (info.ex_style & WS_EX_LAYOUTRTL) mirror_rect( &rect, &client_rect );
+        break;
+    case COORDS_PARENT:
+        if (!info.parent) break;
+        if (!get_window_shared_info( wine_server_ptr_handle( info.parent ), &parent )) return FALSE;
+        if (parent.ex_style & WS_EX_LAYOUTRTL)
+        {
+            SetRect( &rect, parent.client.left, parent.client.top, parent.client.right, parent.client.bottom );
+            mirror_rect( &rect, &window_rect );
+            mirror_rect( &rect, &client_rect );
+        }
+        break;
+    case COORDS_SCREEN:
+        for (next = wine_server_ptr_handle( info.parent ); next; next = wine_server_ptr_handle( parent.parent ))
+        {
+            if (!get_window_shared_info( next, &parent )) return FALSE;
+            if (!parent.parent) break;  /* desktop window */
+            OffsetRect( &window_rect, parent.client.left, parent.client.top );
+            OffsetRect( &client_rect, parent.client.left, parent.client.top );
+        }
+        break;
+    default:
+        return FALSE;
+    }
+    if (rectWindow) *rectWindow = window_rect;
+    if (rectClient) *rectClient = client_rect;
+    return TRUE;
+}
+
+
 /***********************************************************************
  *           WIN_GetRectangles
  *
@@ -945,6 +1036,8 @@ BOOL WIN_GetRectangles( HWND hwnd, enum coords_relative relative, RECT *rectWind
     }
 
 other_process:
+    if (get_shared_rectangles( hwnd, relative, rectWindow, rectClient )) return TRUE;
+
     SERVER_START_REQ( get_window_rectangles )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -2412,11 +2505,23 @@ static LONG_PTR WIN_GetWindowLong( HWND hwnd, INT offset, UINT size, BOOL unicod
 
     if (wndPtr == WND_OTHER_PROCESS)
     {
+        struct window_shared_memory info;
+
         if (offset == GWLP_WNDPROC)
         {
             SetLastError( ERROR_ACCESS_DENIED );
             return 0;
         }
+        if (offset < 0 && offset != GWLP_USERDATA && get_window_shared_info( hwnd, &info ))
+        {
+            switch(offset)
+            {
+            case GWL_STYLE:      return info.style;
+            case GWL_EXSTYLE:    return info.ex_style;
+            case GWLP_ID:        return info.id;
+            case GWLP_HINSTANCE: return (ULONG_PTR)wine_server_get_ptr( info.instance );
+            }
+        }
         SERVER_START_REQ( set_window_info )
         {
             req->handle = wine_server_user_handle( hwnd );
@@ -3094,6 +3199,7 @@ BOOL WINAPI IsWindow( HWND hwnd )
  */
 DWORD WINAPI GetWindowThreadProcessId( HWND hwnd, LPDWORD process )
 {
+    struct window_shared_memory info;
     WND *ptr;
     DWORD tid = 0;
 
@@ -3113,6 +3219,11 @@ DWORD WINAPI GetWindowThreadProcessId( HWND hwnd, LPDWORD process )
     }
 
     /* check other processes */
+    if (get_window_shared_info( hwnd, &info ))
+    {
+        if (process) *process = info.pid;
+        return info.tid;
+    }
     SERVER_START_REQ( get_window_info )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -3143,7 +3254,16 @@ HWND WINAPI GetParent( HWND hwnd )
     if (wndPtr == WND_DESKTOP) return 0;
     if (wndPtr == WND_OTHER_PROCESS)
     {
-        LONG style = GetWindowLongW( hwnd, GWL_STYLE );
+        struct window_shared_memory info;
+        LONG style;
+
+        if (get_window_shared_info( hwnd, &info ))
+        {
+            if (info.style & WS_POPUP) return wine_server_ptr_handle( info.owner );
+            if (info.style & WS_CHILD) return wine_server_ptr_handle( info.parent );
+            return 0;
+        }
+        style = GetWindowLongW( hwnd, GWL_STYLE );
         if (style & (WS_POPUP | WS_CHILD))
         {
             SERVER_START_REQ( get_window_tree )
@@ -3362,10 +3482,25 @@ BOOL WINAPI IsChild( HWND parent, HWND child )
  */
 BOOL WINAPI IsWindowVisible( HWND hwnd )
 {
-    HWND *list;
+    struct window_shared_memory info;
+    HWND *list, parent;
     BOOL retval = TRUE;
     int i;
 
+    /* walk up the parents through the shared state if possible */
+    if (get_window_shared_info( hwnd, &info ))
+    {
+        if (!(info.style & WS_VISIBLE)) return FALSE;
+        for (parent = wine_server_ptr_handle( info.parent ); parent; parent = wine_server_ptr_handle( info.parent ))
+        {
+            if (!get_window_shared_info( parent, &info )) goto server;
+            if (!info.parent) return parent == GetDesktopWindow();  /* top message window isn't visible */
+            if (!(info.style & WS_VISIBLE)) return FALSE;
+        }
+        return TRUE;
+    }
+
+server:
     if (!(GetWindowLongW( hwnd, GWL_STYLE ) & WS_VISIBLE)) return FALSE;
     if (!(list = list_window_parents( hwnd ))) return TRUE;
     if (list[0])
@@ -440,6 +440,33 @@ HDESK WINAPI GetThreadDesktop( DWORD thread )
 }
 
 
+/***********************************************************************
+ *           get_desktop_shared_memory
+ *
+ * Get the state of the thread desktop shared with the server, or NULL if not available.
+ */
+const struct desktop_shared_memory *get_desktop_shared_memory(void)
+{
+    static void *desktop_shared_data;
+    struct user_thread_info *thread_info = get_user_thread_info();
+    const struct desktop_shared_memory *data;
+    unsigned int shared = ~0u;
+
+    if (thread_info->desktop_shared) return thread_info->desktop_shared;
+    if (!(data = map_shared_memory( L"\\KernelObjects\\__wine_desktop_shared_data", &desktop_shared_data )))
+        return NULL;
+
+    SERVER_START_REQ( get_thread_desktop )
+    {
+        req->tid = GetCurrentThreadId();
+        if (!wine_server_call( req )) shared = reply->shared;
+    }
+    SERVER_END_REQ;
+    if (shared < DESKTOP_SHARED_MAX_DESKTOPS) thread_info->desktop_shared = data + shared;
+    return thread_info->desktop_shared;
+}
+
+
 /******************************************************************************
  *              SetThreadDesktop   (USER32.@)
  */
@@ -459,6 +486,7 @@ BOOL WINAPI SetThreadDesktop( HDESK handle )
         struct user_key_state_info *key_state_info = thread_info->key_state;
         thread_info->top_window = 0;
         thread_info->msg_window = 0;
+        thread_info->desktop_shared = NULL;
         if (key_state_info) key_state_info->time = 0;
     }
     return ret;
@@ -0,0 +1,79 @@
+/*
+ * Sampling profiler file format
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef __WINE_WINE_PROFILE_RECORD_H
+#define __WINE_WINE_PROFILE_RECORD_H
+
+#include <windef.h>
+
+/* A profile file starts with a profile_record_header, followed by blocks that
+ * each start with a profile_record_block. Module blocks describe a mapped PE
+ * image and come before any sample referencing it; sample blocks hold the
+ * stack of a single sample, innermost frame first. */
+
+#define PROFILE_RECORD_MAGIC    0x46525057  /* "WPRF" */
+#define PROFILE_RECORD_VERSION  1
+
+struct profile_record_header
+{
+    DWORD     magic;       /* PROFILE_RECORD_MAGIC */
+    DWORD     version;     /* PROFILE_RECORD_VERSION */
+    DWORD     pid;         /* process id */
+    DWORD     interval;    /* sampling interval in microseconds of thread cpu time */
+};
+
+enum profile_record_type
+{
+    PROFILE_RECORD_MODULE,
+    PROFILE_RECORD_SAMPLE
+};
+
+struct profile_record_block
+{
+    DWORD     type;        /* enum profile_record_type */
+    DWORD     size;        /* size of the block, including this header */
+};
+
+struct profile_record_module
+{
+    struct profile_record_block hdr;
+    DWORD     id;          /* module id used by the samples */
+    DWORD     size;        /* size of the image */
+    ULONGLONG base;        /* address the image is mapped at */
+    DWORD     nb_exports;  /* number of named exports */
+    DWORD     reserved;
+    /* followed by nb_exports export rvas, the null-terminated module name,
+     * and nb_exports null-terminated export names, all in UTF-8 */
+};
+
+struct profile_record_frame
+{
+    ULONGLONG address;     /* rva in the module, absolute address if outside of any module */
+    DWORD     module;      /* module id, 0 if outside of any module */
+    DWORD     function;    /* rva of the start of the function, 0 if unknown */
+};
+
+struct profile_record_sample
+{
+    struct profile_record_block hdr;
+    DWORD     tid;         /* thread id */
+    DWORD     count;       /* number of frames */
+    /* followed by count profile_record_frame structures */
+};
+
+#endif  /* __WINE_WINE_PROFILE_RECORD_H */
@@ -0,0 +1,83 @@
+/*
+ * Binary relay trace file format
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef __WINE_WINE_RELAY_RECORD_H
+#define __WINE_WINE_RELAY_RECORD_H
+
+#include <windef.h>
+
+/* A relay record file starts with a relay_record_header, followed by blocks that
+ * each start with a relay_record_block. Module blocks describe a relayed dll and
+ * come before any call referencing it; call blocks hold a batch of completed calls
+ * of a single thread, in the order the calls returned. */
+
+#define RELAY_RECORD_MAGIC    0x4c52454e  /* "NERL" */
+#define RELAY_RECORD_VERSION  1
+#define RELAY_RECORD_ARGS     4           /* number of arguments recorded per call */
+
+struct relay_record_header
+{
+    DWORD     magic;       /* RELAY_RECORD_MAGIC */
+    DWORD     version;     /* RELAY_RECORD_VERSION */
+    DWORD     pid;         /* process id */
+    DWORD     ptr_size;    /* size of a pointer in the recording process */
+    ULONGLONG frequency;   /* frequency of the timestamps */
+};
+
+enum relay_record_type
+{
+    RELAY_RECORD_MODULE,
+    RELAY_RECORD_CALLS
+};
+
+struct relay_record_block
+{
+    DWORD     type;        /* enum relay_record_type */
+    DWORD     size;        /* size of the block, including this header */
+};
+
+struct relay_record_module
+{
+    struct relay_record_block hdr;
+    DWORD     id;          /* module id used by the call records */
+    DWORD     base;        /* ordinal base */
+    DWORD     count;       /* number of entry points */
+    char      name[40];    /* dll name without extension */
+    /* followed by count null-terminated entry point names, empty if exported by ordinal */
+};
+
+struct relay_record_call
+{
+    ULONGLONG start;       /* timestamp at entry */
+    ULONGLONG duration;    /* time spent in the call */
+    ULONGLONG args[RELAY_RECORD_ARGS];  /* first arguments */
+    ULONGLONG retval;      /* return value */
+    DWORD     module;      /* module id */
+    WORD      ordinal;     /* entry point index, without the ordinal base */
+    WORD      nb_args;     /* total number of arguments */
+};
+
+struct relay_record_calls
+{
+    struct relay_record_block hdr;
+    DWORD     tid;         /* thread id */
+    DWORD     count;       /* number of calls */
+    struct relay_record_call calls[1];
+};
+
+#endif  /* __WINE_WINE_RELAY_RECORD_H */
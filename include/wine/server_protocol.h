@@ -836,51 +836,62 @@ struct cpu_topology_override
     unsigned char host_cpu_id[64];
 };
 
-struct shared_cursor
+/* fsync shared memory block receiving the replies of a thread: a state futex,
+ * followed by the reply structure and the variable size reply data */
+#define SHM_REPLY_BLOCK_SIZE  512
+#define SHM_REPLY_HEADER_SIZE 8
+#define SHM_REPLY_MAX_DATA    (SHM_REPLY_BLOCK_SIZE - SHM_REPLY_HEADER_SIZE - sizeof(union generic_reply))
+
+enum shm_reply_state
 {
-    int                  x;
-    int                  y;
-    unsigned int         last_change;
-    rectangle_t          clip;
+    SHM_REPLY_PENDING,
+    SHM_REPLY_WAITING,
+    SHM_REPLY_READY,
+    SHM_REPLY_CLOSED
 };
 
-struct desktop_shared_memory
+/* message queue state mirrored in the shared queue mapping, so that the client
+ * can check for an empty queue without a server call */
+struct queue_shared_memory
 {
-    unsigned int         seq;
-    struct shared_cursor cursor;
-    unsigned char        keystate[256];
-    thread_id_t          foreground_tid;
+    unsigned int wake_bits;
+    unsigned int changed_bits;
 };
 
-struct queue_shared_memory
+#define QUEUE_SHARED_MAX_QUEUES 65536
+
+/* desktop state mirrored in the shared desktop mapping; the cursor fields are
+ * only consistent while seq is even and unchanged across the read */
+struct desktop_shared_memory
 {
     unsigned int         seq;
-    unsigned int         wake_bits;
-    unsigned int         changed_bits;
-    unsigned int         wake_mask;
-    unsigned int         changed_mask;
-    thread_id_t          input_tid;
+    int                  cursor_x;
+    int                  cursor_y;
+    unsigned int         cursor_last_change;
+    unsigned char        keystate[256];
 };
 
-struct input_shared_memory
+#define DESKTOP_SHARED_MAX_DESKTOPS 256
+
+
+struct window_shared_memory
 {
     unsigned int         seq;
+    user_handle_t        handle;
+    user_handle_t        parent;
+    user_handle_t        owner;
     thread_id_t          tid;
-    user_handle_t        focus;
-    user_handle_t        capture;
-    user_handle_t        active;
-    user_handle_t        menu_owner;
-    user_handle_t        move_size;
-    user_handle_t        caret;
-    user_handle_t        cursor;
-    rectangle_t          caret_rect;
-    int                  cursor_count;
-    unsigned char        keystate[256];
+    process_id_t         pid;
+    unsigned int         style;
+    unsigned int         ex_style;
+    unsigned int         id;
+    unsigned int         dpi;
+    mod_handle_t         instance;
+    rectangle_t          window;
+    rectangle_t          client;
 };
 
-
-#define SEQUENCE_MASK_BITS  4
-#define SEQUENCE_MASK ((1UL << SEQUENCE_MASK_BITS) - 1)
+#define WINDOW_SHARED_MAX_WINDOWS ((LAST_USER_HANDLE - FIRST_USER_HANDLE + 1) >> 1)
 
 
 
@@ -2379,11 +2390,27 @@ struct get_key_value_reply
     struct reply_header __header;
     int          type;
     data_size_t  total;
+    unsigned int gen_slot;
+    unsigned int generation;
     /* VARARG(data,bytes); */
 };
 
 
 
+struct get_registry_cache_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_registry_cache_reply
+{
+    struct reply_header __header;
+    data_size_t  size;
+    char __pad_12[4];
+};
+
+
+
 struct enum_key_value_request
 {
     struct request_header __header;
@@ -2672,7 +2699,7 @@ struct get_msg_queue_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    unsigned int shared;
 };
 
 
@@ -2795,6 +2822,7 @@ struct send_hardware_message_reply
     int             prev_y;
     int             new_x;
     int             new_y;
+    /* VARARG(keystate,bytes); */
     char __pad_28[4];
 };
 #define SEND_HWMSG_INJECTED    0x01
@@ -2825,9 +2853,9 @@ struct get_message_reply
     int             x;
     int             y;
     unsigned int    time;
+    unsigned int    active_hooks;
     data_size_t     total;
     /* VARARG(data,message_data); */
-    char __pad_52[4];
 };
 
 
@@ -3765,7 +3793,7 @@ struct get_thread_desktop_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    unsigned int shared;
 };
 
 
@@ -3879,10 +3907,14 @@ struct get_thread_input_reply
     user_handle_t  focus;
     user_handle_t  capture;
     user_handle_t  active;
+    user_handle_t  foreground;
     user_handle_t  menu_owner;
     user_handle_t  move_size;
     user_handle_t  caret;
+    user_handle_t  cursor;
+    int            show_count;
     rectangle_t    rect;
+    char __pad_60[4];
 };
 
 
@@ -4040,20 +4072,6 @@ enum caret_state
 
 
 
-struct get_active_hooks_request
-{
-    struct request_header __header;
-    char __pad_12[4];
-};
-struct get_active_hooks_reply
-{
-    struct reply_header __header;
-    unsigned int   active_hooks;
-    char __pad_12[4];
-};
-
-
-
 struct set_hook_request
 {
     struct request_header __header;
@@ -5646,6 +5664,30 @@ struct get_fsync_apc_idx_reply
 };
 
 
+struct get_fsync_reply_idx_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_fsync_reply_idx_reply
+{
+    struct reply_header __header;
+    unsigned int shm_idx;
+    char __pad_12[4];
+};
+
+
+struct set_fsync_reply_request
+{
+    struct request_header __header;
+    int          enable;
+};
+struct set_fsync_reply_reply
+{
+    struct reply_header __header;
+};
+
+
 
 struct get_next_thread_request
 {
@@ -5764,6 +5806,7 @@ enum request
     REQ_enum_key,
     REQ_set_key_value,
     REQ_get_key_value,
+    REQ_get_registry_cache,
     REQ_enum_key_value,
     REQ_delete_key_value,
     REQ_load_registry,
@@ -5862,7 +5905,6 @@ enum request
     REQ_set_capture_window,
     REQ_set_caret_window,
     REQ_set_caret_info,
-    REQ_get_active_hooks,
     REQ_set_hook,
     REQ_remove_hook,
     REQ_start_hook_chain,
@@ -5961,6 +6003,8 @@ enum request
     REQ_get_fsync_idx,
     REQ_fsync_msgwait,
     REQ_get_fsync_apc_idx,
+    REQ_get_fsync_reply_idx,
+    REQ_set_fsync_reply,
     REQ_get_next_thread,
     REQ_prevent_kill,
     REQ_NB_REQUESTS
@@ -6058,6 +6102,7 @@ union generic_request
     struct enum_key_request enum_key_request;
     struct set_key_value_request set_key_value_request;
     struct get_key_value_request get_key_value_request;
+    struct get_registry_cache_request get_registry_cache_request;
     struct enum_key_value_request enum_key_value_request;
     struct delete_key_value_request delete_key_value_request;
     struct load_registry_request load_registry_request;
@@ -6156,7 +6201,6 @@ union generic_request
     struct set_capture_window_request set_capture_window_request;
     struct set_caret_window_request set_caret_window_request;
     struct set_caret_info_request set_caret_info_request;
-    struct get_active_hooks_request get_active_hooks_request;
     struct set_hook_request set_hook_request;
     struct remove_hook_request remove_hook_request;
     struct start_hook_chain_request start_hook_chain_request;
@@ -6255,6 +6299,8 @@ union generic_request
     struct get_fsync_idx_request get_fsync_idx_request;
     struct fsync_msgwait_request fsync_msgwait_request;
     struct get_fsync_apc_idx_request get_fsync_apc_idx_request;
+    struct get_fsync_reply_idx_request get_fsync_reply_idx_request;
+    struct set_fsync_reply_request set_fsync_reply_request;
     struct get_next_thread_request get_next_thread_request;
     struct prevent_kill_request prevent_kill_request;
 };
@@ -6350,6 +6396,7 @@ union generic_reply
     struct enum_key_reply enum_key_reply;
     struct set_key_value_reply set_key_value_reply;
     struct get_key_value_reply get_key_value_reply;
+    struct get_registry_cache_reply get_registry_cache_reply;
     struct enum_key_value_reply enum_key_value_reply;
     struct delete_key_value_reply delete_key_value_reply;
     struct load_registry_reply load_registry_reply;
@@ -6448,7 +6495,6 @@ union generic_reply
     struct set_capture_window_reply set_capture_window_reply;
     struct set_caret_window_reply set_caret_window_reply;
     struct set_caret_info_reply set_caret_info_reply;
-    struct get_active_hooks_reply get_active_hooks_reply;
     struct set_hook_reply set_hook_reply;
     struct remove_hook_reply remove_hook_reply;
     struct start_hook_chain_reply start_hook_chain_reply;
@@ -6547,13 +6593,15 @@ union generic_reply
     struct get_fsync_idx_reply get_fsync_idx_reply;
     struct fsync_msgwait_reply fsync_msgwait_reply;
     struct get_fsync_apc_idx_reply get_fsync_apc_idx_reply;
+    struct get_fsync_reply_idx_reply get_fsync_reply_idx_reply;
+    struct set_fsync_reply_reply set_fsync_reply_reply;
     struct get_next_thread_reply get_next_thread_reply;
     struct prevent_kill_reply prevent_kill_reply;
 };
 
 /* ### protocol_version begin ### */
 
-#define SERVER_PROTOCOL_VERSION 693
+#define SERVER_PROTOCOL_VERSION 698
 
 /* ### protocol_version end ### */
 
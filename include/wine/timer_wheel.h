@@ -0,0 +1,222 @@
+/*
+ * Hierarchical timer wheel support
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef __WINE_WINE_TIMER_WHEEL_H
+#define __WINE_WINE_TIMER_WHEEL_H
+
+#include <wine/list.h>
+
+/* Timers are kept in WINE_TIMER_WHEEL_LEVELS levels of slots, each slot of a
+ * level spanning WINE_TIMER_WHEEL_SLOTS slots of the level below, and the slots
+ * of the first level spanning a single tick of (1 << shift) time units. Timers
+ * are moved down one level when the wheel reaches their slot, so insertion and
+ * removal take constant time, and expiration is exact. Timers further away
+ * than the last level are kept in an overflow list.
+ *
+ * Each timer also has a latest expiration time, used to coalesce the wakeups
+ * of timers that tolerate some delay. */
+
+#define WINE_TIMER_WHEEL_BITS   6
+#define WINE_TIMER_WHEEL_SLOTS  (1 << WINE_TIMER_WHEEL_BITS)
+#define WINE_TIMER_WHEEL_MASK   (WINE_TIMER_WHEEL_SLOTS - 1)
+#define WINE_TIMER_WHEEL_LEVELS 4
+
+#define WINE_TIMER_WHEEL_ENTRY_VALUE(element, type, field) \
+    ((type *)((char *)(element) - offsetof(type, field)))
+
+struct wine_timer_wheel_entry
+{
+    struct list  entry;
+    ULONGLONG    expire;    /* expiration time */
+    ULONGLONG    latest;    /* latest acceptable expiration time */
+    unsigned int level;     /* level of the slot holding the timer */
+};
+
+struct wine_timer_wheel
+{
+    unsigned int shift;     /* log2 of the length of a tick, in time units */
+    ULONGLONG    base;      /* tick of the current slot of the first level */
+    unsigned int count[WINE_TIMER_WHEEL_LEVELS + 1];
+    struct list  slots[WINE_TIMER_WHEEL_LEVELS][WINE_TIMER_WHEEL_SLOTS];
+    struct list  overflow;
+};
+
+static inline void wine_timer_wheel_init(struct wine_timer_wheel *wheel, unsigned int shift, ULONGLONG now)
+{
+    unsigned int level, i;
+
+    wheel->shift = shift;
+    wheel->base = now >> shift;
+    for (level = 0; level <= WINE_TIMER_WHEEL_LEVELS; level++) wheel->count[level] = 0;
+    for (level = 0; level < WINE_TIMER_WHEEL_LEVELS; level++)
+        for (i = 0; i < WINE_TIMER_WHEEL_SLOTS; i++) list_init(&wheel->slots[level][i]);
+    list_init(&wheel->overflow);
+}
+
+static inline int wine_timer_wheel_empty(const struct wine_timer_wheel *wheel)
+{
+    unsigned int level;
+
+    for (level = 0; level <= WINE_TIMER_WHEEL_LEVELS; level++)
+        if (wheel->count[level]) return 0;
+    return 1;
+}
+
+static inline void wine_timer_wheel_place(struct wine_timer_wheel *wheel, struct wine_timer_wheel_entry *entry)
+{
+    ULONGLONG tick = entry->expire >> wheel->shift;
+    unsigned int level;
+
+    /* timers that are already expired go in the current slot */
+    if (tick < wheel->base) tick = wheel->base;
+
+    for (level = 0; level < WINE_TIMER_WHEEL_LEVELS; level++)
+    {
+        if (tick - wheel->base >= (ULONGLONG)1 << ((level + 1) * WINE_TIMER_WHEEL_BITS)) continue;
+        list_add_tail(&wheel->slots[level][(tick >> (level * WINE_TIMER_WHEEL_BITS)) & WINE_TIMER_WHEEL_MASK],
+                      &entry->entry);
+        break;
+    }
+    if (level == WINE_TIMER_WHEEL_LEVELS) list_add_tail(&wheel->overflow, &entry->entry);
+    entry->level = level;
+    wheel->count[level]++;
+}
+
+static inline void wine_timer_wheel_add(struct wine_timer_wheel *wheel, struct wine_timer_wheel_entry *entry,
+                                        ULONGLONG expire, ULONGLONG latest)
+{
+    entry->expire = expire;
+    entry->latest = latest < expire ? expire : latest;
+    wine_timer_wheel_place(wheel, entry);
+}
+
+static inline void wine_timer_wheel_remove(struct wine_timer_wheel *wheel, struct wine_timer_wheel_entry *entry)
+{
+    list_remove(&entry->entry);
+    wheel->count[entry->level]--;
+}
+
+/* move the timers of the higher level slots reached by the current tick down the wheel */
+static inline void wine_timer_wheel_cascade(struct wine_timer_wheel *wheel)
+{
+    struct wine_timer_wheel_entry *entry;
+    struct list list, *ptr;
+    unsigned int level;
+
+    for (level = 1; level <= WINE_TIMER_WHEEL_LEVELS; level++)
+    {
+        if (wheel->base & (((ULONGLONG)1 << (level * WINE_TIMER_WHEEL_BITS)) - 1)) break;
+        if (!wheel->count[level]) continue;
+
+        list_init(&list);
+        if (level == WINE_TIMER_WHEEL_LEVELS)
+            list_move_tail(&list, &wheel->overflow);
+        else
+            list_move_tail(&list, &wheel->slots[level][(wheel->base >> (level * WINE_TIMER_WHEEL_BITS))
+                                                       & WINE_TIMER_WHEEL_MASK]);
+        while ((ptr = list_head(&list)))
+        {
+            entry = LIST_ENTRY(ptr, struct wine_timer_wheel_entry, entry);
+            list_remove(&entry->entry);
+            wheel->count[level]--;
+            wine_timer_wheel_place(wheel, entry);
+        }
+    }
+}
+
+/* remove and return a timer expired at time now, in expiration tick order */
+static inline struct wine_timer_wheel_entry *wine_timer_wheel_pop(struct wine_timer_wheel *wheel, ULONGLONG now)
+{
+    ULONGLONG tick = now >> wheel->shift, step, next;
+    struct wine_timer_wheel_entry *entry;
+    unsigned int level;
+
+    for (;;)
+    {
+        LIST_FOR_EACH_ENTRY(entry, &wheel->slots[0][wheel->base & WINE_TIMER_WHEEL_MASK],
+                            struct wine_timer_wheel_entry, entry)
+        {
+            if (entry->expire > now) continue;
+            wine_timer_wheel_remove(wheel, entry);
+            return entry;
+        }
+        if (wheel->base >= tick) return NULL;
+
+        /* the current slot is empty, skip the ticks without timers in the lower levels */
+        for (level = 0; level < WINE_TIMER_WHEEL_LEVELS; level++) if (wheel->count[level]) break;
+        if (level == WINE_TIMER_WHEEL_LEVELS && !wheel->count[level])
+        {
+            wheel->base = tick;
+            return NULL;
+        }
+        step = (ULONGLONG)1 << (level * WINE_TIMER_WHEEL_BITS);
+        next = (wheel->base | (step - 1)) + 1;
+        wheel->base = next < tick ? next : tick;
+        wine_timer_wheel_cascade(wheel);
+    }
+}
+
+/* get the time the next timers should be expired at; the earliest timer is
+ * delayed as long as it and all the timers expiring before are still within
+ * their latest expiration time */
+static inline int wine_timer_wheel_next(struct wine_timer_wheel *wheel, ULONGLONG *ret)
+{
+    ULONGLONG lower = 0, upper = ~(ULONGLONG)0, start;
+    struct wine_timer_wheel_entry *entry;
+    struct list *slot;
+    unsigned int level, i, shift;
+    int found = 0;
+
+    for (level = 0; level <= WINE_TIMER_WHEEL_LEVELS; level++)
+    {
+        if (!wheel->count[level]) continue;
+        shift = level * WINE_TIMER_WHEEL_BITS;
+
+        for (i = 0; i < WINE_TIMER_WHEEL_SLOTS; i++)
+        {
+            /* the slots of a level are visited in time order, start is the first tick a slot can
+             * hold; the levels overlap, as timers are only moved down when their slot is reached */
+            if (level == WINE_TIMER_WHEEL_LEVELS)
+            {
+                start = ((wheel->base >> shift) + 1) << shift;
+                slot = &wheel->overflow;
+                i = WINE_TIMER_WHEEL_SLOTS;
+            }
+            else
+            {
+                start = level ? ((wheel->base >> shift) + i + 1) << shift : wheel->base + i;
+                slot = &wheel->slots[level][(start >> shift) & WINE_TIMER_WHEEL_MASK];
+            }
+            if ((start << wheel->shift) >= upper) break;
+
+            LIST_FOR_EACH_ENTRY(entry, slot, struct wine_timer_wheel_entry, entry)
+            {
+                if (entry->expire >= upper) continue;
+                if (entry->expire > lower) lower = entry->expire;
+                if (entry->latest < upper) upper = entry->latest;
+                found = 1;
+            }
+        }
+    }
+
+    if (!found) return 0;
+    *ret = lower < upper ? lower : upper;
+    return 1;
+}
+
+#endif  /* __WINE_WINE_TIMER_WHEEL_H */
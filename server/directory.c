@@ -443,7 +443,13 @@ void init_directories( struct fd *intl_fd )
     static const WCHAR intlW[] = {'N','l','s','S','e','c','t','i','o','n','L','A','N','G','_','I','N','T','L'};
     static const WCHAR user_dataW[] = {'_','_','w','i','n','e','_','u','s','e','r','_','s','h','a','r','e','d','_','d','a','t','a'};
     static const struct unicode_str intl_str = {intlW, sizeof(intlW)};
+    static const WCHAR queue_dataW[] = {'_','_','w','i','n','e','_','q','u','e','u','e','_','s','h','a','r','e','d','_','d','a','t','a'};
+    static const WCHAR desktop_dataW[] = {'_','_','w','i','n','e','_','d','e','s','k','t','o','p','_','s','h','a','r','e','d','_','d','a','t','a'};
+    static const WCHAR window_dataW[] = {'_','_','w','i','n','e','_','w','i','n','d','o','w','_','s','h','a','r','e','d','_','d','a','t','a'};
     static const struct unicode_str user_data_str = {user_dataW, sizeof(user_dataW)};
+    static const struct unicode_str queue_data_str = {queue_dataW, sizeof(queue_dataW)};
+    static const struct unicode_str desktop_data_str = {desktop_dataW, sizeof(desktop_dataW)};
+    static const struct unicode_str window_data_str = {window_dataW, sizeof(window_dataW)};
 
     struct directory *dir_driver, *dir_device, *dir_global, *dir_kernel, *dir_nls;
     struct object *named_pipe_device, *mailslot_device, *null_device;
@@ -491,6 +497,15 @@ void init_directories( struct fd *intl_fd )
     /* mappings */
     release_object( create_fd_mapping( &dir_nls->obj, &intl_str, intl_fd, OBJ_PERMANENT, NULL ));
     release_object( create_user_data_mapping( &dir_kernel->obj, &user_data_str, OBJ_PERMANENT, NULL ));
+    release_object( create_shared_memory_mapping( &dir_kernel->obj, &queue_data_str,
+                                                  QUEUE_SHARED_MAX_QUEUES * sizeof(*queue_shared_data),
+                                                  OBJ_PERMANENT, NULL, (void **)&queue_shared_data ));
+    release_object( create_shared_memory_mapping( &dir_kernel->obj, &desktop_data_str,
+                                                  DESKTOP_SHARED_MAX_DESKTOPS * sizeof(*desktop_shared_data),
+                                                  OBJ_PERMANENT, NULL, (void **)&desktop_shared_data ));
+    release_object( create_shared_memory_mapping( &dir_kernel->obj, &window_data_str,
+                                                  WINDOW_SHARED_MAX_WINDOWS * sizeof(*window_shared_data),
+                                                  OBJ_PERMANENT, NULL, (void **)&window_shared_data ));
     release_object( intl_fd );
 
     release_object( named_pipe_device );
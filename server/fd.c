@@ -107,6 +107,7 @@
 
 #include "winternl.h"
 #include "winioctl.h"
+#include "wine/timer_wheel.h"
 #include "ddk/wdm.h"
 
 #if !defined(O_SYMLINK) && defined(O_PATH)
@@ -201,6 +202,8 @@ struct fd
     unsigned int         signaled :1; /* is the fd signaled? */
     unsigned int         fs_locks :1; /* can we use filesystem locks for this fd? */
     int                  poll_index;  /* index of fd in poll array */
+    int                  epoll_events;/* events currently registered with epoll, -1 if none */
+    int                  epoll_dirty; /* index + 1 in the pending epoll changes, 0 if none */
     struct async_queue   read_q;      /* async readers of this fd */
     struct async_queue   write_q;     /* async writers of this fd */
     struct async_queue   wait_q;      /* other async waiters of this fd */
@@ -389,17 +392,29 @@ static file_pos_t max_unix_offset = OFF_T_MAX;
 
 struct timeout_user
 {
-    struct list           entry;      /* entry in sorted timeout list */
+    struct wine_timer_wheel_entry entry;  /* entry in the timeout wheel */
+    struct wine_timer_wheel *wheel;       /* wheel holding the timeout, NULL once expired */
     abstime_t             when;       /* timeout expiry */
     timeout_callback      callback;   /* callback function */
     void                 *private;    /* callback private data */
 };
 
-static struct list abs_timeout_list = LIST_INIT(abs_timeout_list); /* sorted absolute timeouts list */
-static struct list rel_timeout_list = LIST_INIT(rel_timeout_list); /* sorted relative timeouts list */
+/* timeouts may expire late by a fraction of their delay, up to a limit, so that close
+ * timeouts can be processed in the same main loop iteration */
+#define TIMEOUT_WHEEL_SHIFT 14                  /* 1.6 ms ticks */
+#define TIMEOUT_SLACK_SHIFT 6                   /* 1/64th of the delay */
+#define TIMEOUT_MAX_SLACK   (10 * 10000)        /* 10 ms */
+
+static struct wine_timer_wheel abs_timeouts;    /* absolute timeouts, by current_time */
+static struct wine_timer_wheel rel_timeouts;    /* relative timeouts, by monotonic_time */
+static unsigned int nb_timeouts;
 timeout_t current_time;
 timeout_t monotonic_time;
 
+static timeout_t timeout_stat_start;
+static unsigned int timeout_stat_armed;
+static unsigned int timeout_stat_expired;
+
 struct _KUSER_SHARED_DATA *user_shared_data = NULL;
 static const int user_shared_data_timeout = 16;
 
@@ -450,43 +465,56 @@ void set_current_time(void)
     if (user_shared_data) set_user_shared_data_time();
 }
 
+static void init_timeouts(void)
+{
+    static int initialized;
+
+    if (initialized) return;
+    wine_timer_wheel_init( &abs_timeouts, TIMEOUT_WHEEL_SHIFT, current_time );
+    wine_timer_wheel_init( &rel_timeouts, TIMEOUT_WHEEL_SHIFT, monotonic_time );
+    timeout_stat_start = monotonic_time;
+    initialized = 1;
+}
+
 /* add a timeout user */
 struct timeout_user *add_timeout_user( timeout_t when, timeout_callback func, void *private )
 {
     struct timeout_user *user;
-    struct list *ptr;
+    timeout_t expire, delay;
 
     if (!(user = mem_alloc( sizeof(*user) ))) return NULL;
     user->when     = timeout_to_abstime( when );
     user->callback = func;
     user->private  = private;
 
-    /* Now insert it in the linked list */
+    /* Now insert it in the wheel */
 
+    init_timeouts();
     if (user->when > 0)
     {
-        LIST_FOR_EACH( ptr, &abs_timeout_list )
-        {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-            if (timeout->when >= user->when) break;
-        }
+        user->wheel = &abs_timeouts;
+        expire = user->when;
+        delay = expire - current_time;
     }
     else
     {
-        LIST_FOR_EACH( ptr, &rel_timeout_list )
-        {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-            if (timeout->when <= user->when) break;
-        }
+        user->wheel = &rel_timeouts;
+        expire = -user->when;
+        delay = expire - monotonic_time;
     }
-    list_add_before( ptr, &user->entry );
+    delay = delay > 0 ? min( delay >> TIMEOUT_SLACK_SHIFT, TIMEOUT_MAX_SLACK ) : 0;
+    wine_timer_wheel_add( user->wheel, &user->entry, expire, expire + delay );
+    nb_timeouts++;
+    timeout_stat_armed++;
     return user;
 }
 
 /* remove a timeout user */
 void remove_timeout_user( struct timeout_user *user )
 {
-    list_remove( &user->entry );
+    if (user->wheel) wine_timer_wheel_remove( user->wheel, &user->entry );
+    else list_remove( &user->entry.entry );  /* in the expired list */
+    nb_timeouts--;
     free( user );
 }
 
@@ -547,39 +575,32 @@ static inline void fd_poll_event( struct fd *fd, int event )
 
 static int epoll_fd = -1;
 
+/* fds whose events changed since the last epoll_wait; the changes are coalesced
+ * so that an fd toggled several times during a loop iteration costs at most one epoll_ctl */
+static struct fd **epoll_changes;
+static int nb_epoll_changes;
+static int allocated_epoll_changes;
+
+/* statistics, dumped periodically with debug level > 1 */
+static unsigned int epoll_stat_loops;
+static unsigned int epoll_stat_ctls;
+static unsigned int epoll_stat_coalesced;
+static unsigned int epoll_stat_events;
+
 static inline void init_epoll(void)
 {
     epoll_fd = epoll_create( 128 );
 }
 
-/* set the events that epoll waits for on this fd; helper for set_fd_events */
-static inline void set_fd_epoll_events( struct fd *fd, int user, int events )
+static void do_epoll_ctl( struct fd *fd, int ctl, int events )
 {
     struct epoll_event ev;
-    int ctl;
-
-    if (epoll_fd == -1) return;
-
-    if (events == -1)  /* stop waiting on this fd completely */
-    {
-        if (pollfd[user].fd == -1) return;  /* already removed */
-        ctl = EPOLL_CTL_DEL;
-    }
-    else if (pollfd[user].fd == -1)
-    {
-        if (pollfd[user].events) return;  /* stopped waiting on it, don't restart */
-        ctl = EPOLL_CTL_ADD;
-    }
-    else
-    {
-        if (pollfd[user].events == events) return;  /* nothing to do */
-        ctl = EPOLL_CTL_MOD;
-    }
 
     ev.events = events;
     memset(&ev.data, 0, sizeof(ev.data));
-    ev.data.u32 = user;
+    ev.data.u32 = fd->poll_index;
 
+    epoll_stat_ctls++;
     if (epoll_ctl( epoll_fd, ctl, fd->unix_fd, &ev ) == -1)
     {
         if (errno == ENOMEM)  /* not enough memory, give up on epoll */
@@ -589,17 +610,99 @@ static inline void set_fd_epoll_events( struct fd *fd, int user, int events )
         }
         else perror( "epoll_ctl" );  /* should not happen */
     }
+    fd->epoll_events = (ctl == EPOLL_CTL_DEL) ? -1 : events;
 }
 
-static inline void remove_epoll_user( struct fd *fd, int user )
+static void remove_epoll_change( struct fd *fd )
+{
+    if (!fd->epoll_dirty) return;
+    epoll_changes[fd->epoll_dirty - 1] = NULL;
+    fd->epoll_dirty = 0;
+}
+
+/* make epoll wait for the given events on this fd, if they changed */
+static void update_epoll_events( struct fd *fd, int events )
+{
+    if (events == fd->epoll_events)
+    {
+        epoll_stat_coalesced++;
+        return;
+    }
+    do_epoll_ctl( fd, fd->epoll_events == -1 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, events );
+}
+
+/* set the events that epoll waits for on this fd; helper for set_fd_events */
+static inline void set_fd_epoll_events( struct fd *fd, int user, int events )
 {
     if (epoll_fd == -1) return;
 
-    if (pollfd[user].fd != -1)
+    if (events == -1)  /* stop waiting on this fd completely, right away since it may get closed */
     {
-        struct epoll_event dummy;
-        epoll_ctl( epoll_fd, EPOLL_CTL_DEL, fd->unix_fd, &dummy );
+        remove_epoll_change( fd );
+        if (fd->epoll_events == -1) return;  /* already removed */
+        do_epoll_ctl( fd, EPOLL_CTL_DEL, 0 );
+        return;
     }
+
+    if (pollfd[user].fd == -1 && pollfd[user].events) return;  /* stopped waiting on it, don't restart */
+    if (fd->epoll_dirty) return;  /* already pending */
+
+    if (nb_epoll_changes == allocated_epoll_changes)
+    {
+        int new_count = allocated_epoll_changes ? allocated_epoll_changes * 2 : 64;
+        struct fd **new_changes = realloc( epoll_changes, new_count * sizeof(*epoll_changes) );
+
+        if (!new_changes)  /* apply the change right away */
+        {
+            update_epoll_events( fd, events );
+            return;
+        }
+        epoll_changes = new_changes;
+        allocated_epoll_changes = new_count;
+    }
+    epoll_changes[nb_epoll_changes++] = fd;
+    fd->epoll_dirty = nb_epoll_changes;
+}
+
+/* apply the pending fd events changes before waiting */
+static void flush_epoll_changes(void)
+{
+    int i;
+
+    for (i = 0; i < nb_epoll_changes && epoll_fd != -1; i++)
+    {
+        struct fd *fd = epoll_changes[i];
+        int user;
+
+        if (!fd) continue;  /* removed meanwhile */
+        fd->epoll_dirty = 0;
+
+        user = fd->poll_index;
+        if (pollfd[user].fd == -1)  /* stopped waiting on it */
+        {
+            epoll_stat_coalesced++;
+            continue;
+        }
+        update_epoll_events( fd, pollfd[user].events );
+    }
+    for (; i < nb_epoll_changes; i++) if (epoll_changes[i]) epoll_changes[i]->epoll_dirty = 0;
+    nb_epoll_changes = 0;
+}
+
+static void dump_epoll_stats(void)
+{
+    fprintf( stderr, "epoll: %u loops, %u events, %u epoll_ctl (%u.%02u per loop), %u changes coalesced\n",
+             epoll_stat_loops, epoll_stat_events, epoll_stat_ctls, epoll_stat_ctls / epoll_stat_loops,
+             epoll_stat_ctls % epoll_stat_loops * 100 / epoll_stat_loops, epoll_stat_coalesced );
+    epoll_stat_loops = epoll_stat_ctls = epoll_stat_coalesced = epoll_stat_events = 0;
+}
+
+static inline void remove_epoll_user( struct fd *fd, int user )
+{
+    if (epoll_fd == -1) return;
+
+    remove_epoll_change( fd );
+    if (fd->epoll_events != -1) do_epoll_ctl( fd, EPOLL_CTL_DEL, 0 );
 }
 
 static inline void main_loop_epoll(void)
@@ -619,11 +722,17 @@ static inline void main_loop_epoll(void)
         timeout = get_next_timeout();
 
         if (!active_users) break;  /* last user removed by a timeout */
+
+        flush_epoll_changes();
         if (epoll_fd == -1) break;  /* an error occurred with epoll */
 
         ret = epoll_wait( epoll_fd, events, ARRAY_SIZE( events ), timeout );
         set_current_time();
 
+        epoll_stat_loops++;
+        if (ret > 0) epoll_stat_events += ret;
+        if (debug_level > 1 && epoll_stat_loops == 65536) dump_epoll_stats();
+
         /* put the events into the pollfd array first, like poll does */
         for (i = 0; i < ret; i++)
         {
@@ -910,6 +1019,8 @@ static int add_poll_user( struct fd *fd )
     pollfd[ret].events = 0;
     pollfd[ret].revents = 0;
     poll_users[ret] = fd;
+    fd->epoll_events = -1;
+    fd->epoll_dirty = 0;
     active_users++;
     return ret;
 }
@@ -929,68 +1040,74 @@ static void remove_poll_user( struct fd *fd, int user )
     active_users--;
 }
 
+static void dump_timeout_stats(void)
+{
+    timeout_t elapsed = monotonic_time - timeout_stat_start;
+
+    fprintf( stderr, "timeouts: %u armed/s, %u expired/s, %u pending\n",
+             (unsigned int)(timeout_stat_armed * (timeout_t)TICKS_PER_SEC / elapsed),
+             (unsigned int)(timeout_stat_expired * (timeout_t)TICKS_PER_SEC / elapsed), nb_timeouts );
+    timeout_stat_armed = timeout_stat_expired = 0;
+    timeout_stat_start = monotonic_time;
+}
+
+/* return the smaller of two timeouts in milliseconds, -1 being infinite */
+static int min_timeout( int ret, timeout_t diff )
+{
+    diff = (diff + 9999) / 10000;
+    if (diff > INT_MAX) diff = INT_MAX;
+    else if (diff < 0) diff = 0;
+    if (ret == -1 || diff < ret) ret = diff;
+    return ret;
+}
+
 /* process pending timeouts and return the time until the next timeout, in milliseconds */
 static int get_next_timeout(void)
 {
     int ret = user_shared_data ? user_shared_data_timeout : -1;
+    struct wine_timer_wheel_entry *entry;
+    struct timeout_user *timeout;
+    struct list expired_list, *ptr;
+    ULONGLONG next;
 
-    if (!list_empty( &abs_timeout_list ) || !list_empty( &rel_timeout_list ))
-    {
-        struct list expired_list, *ptr;
+    if (debug_level > 1 && monotonic_time - timeout_stat_start >= TICKS_PER_SEC) dump_timeout_stats();
 
-        /* first remove all expired timers from the list */
+    if (nb_timeouts)
+    {
+        /* first remove all expired timers from the wheels */
 
         list_init( &expired_list );
-        while ((ptr = list_head( &abs_timeout_list )) != NULL)
+        while ((entry = wine_timer_wheel_pop( &abs_timeouts, current_time )))
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-
-            if (timeout->when <= current_time)
-            {
-                list_remove( &timeout->entry );
-                list_add_tail( &expired_list, &timeout->entry );
-            }
-            else break;
+            timeout = WINE_TIMER_WHEEL_ENTRY_VALUE( entry, struct timeout_user, entry );
+            timeout->wheel = NULL;
+            list_add_tail( &expired_list, &timeout->entry.entry );
         }
-        while ((ptr = list_head( &rel_timeout_list )) != NULL)
+        while ((entry = wine_timer_wheel_pop( &rel_timeouts, monotonic_time )))
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-
-            if (-timeout->when <= monotonic_time)
-            {
-                list_remove( &timeout->entry );
-                list_add_tail( &expired_list, &timeout->entry );
-            }
-            else break;
+            timeout = WINE_TIMER_WHEEL_ENTRY_VALUE( entry, struct timeout_user, entry );
+            timeout->wheel = NULL;
+            list_add_tail( &expired_list, &timeout->entry.entry );
         }
 
         /* now call the callback for all the removed timers */
 
         while ((ptr = list_head( &expired_list )) != NULL)
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-            list_remove( &timeout->entry );
+            timeout = LIST_ENTRY( ptr, struct timeout_user, entry.entry );
+            list_remove( &timeout->entry.entry );
+            nb_timeouts--;
+            timeout_stat_expired++;
             timeout->callback( timeout->private );
             free( timeout );
         }
 
-        if ((ptr = list_head( &abs_timeout_list )) != NULL)
-        {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-            timeout_t diff = (timeout->when - current_time + 9999) / 10000;
-            if (diff > INT_MAX) diff = INT_MAX;
-            else if (diff < 0) diff = 0;
-            if (ret == -1 || diff < ret) ret = diff;
-        }
+        /* the next wakeup is delayed as long as all the timeouts until then are within their slack */
 
-        if ((ptr = list_head( &rel_timeout_list )) != NULL)
-        {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-            timeout_t diff = (-timeout->when - monotonic_time + 9999) / 10000;
-            if (diff > INT_MAX) diff = INT_MAX;
-            else if (diff < 0) diff = 0;
-            if (ret == -1 || diff < ret) ret = diff;
-        }
+        if (wine_timer_wheel_next( &abs_timeouts, &next ))
+            ret = min_timeout( ret, (timeout_t)next - current_time );
+        if (wine_timer_wheel_next( &rel_timeouts, &next ))
+            ret = min_timeout( ret, (timeout_t)next - monotonic_time );
     }
     return ret;
 }
@@ -1002,6 +1119,7 @@ void main_loop(void)
 
     set_current_time();
     server_start_time = current_time;
+    init_timeouts();
 
     main_loop_epoll();
     /* fall through to normal poll loop */
@@ -135,6 +135,9 @@ struct timeout_user;
 extern timeout_t current_time;
 extern timeout_t monotonic_time;
 extern struct _KUSER_SHARED_DATA *user_shared_data;
+extern struct queue_shared_memory *queue_shared_data;
+extern struct desktop_shared_memory *desktop_shared_data;
+extern struct window_shared_memory *window_shared_data;
 
 #define TICKS_PER_SEC 10000000
 
@@ -179,10 +182,14 @@ extern const pe_image_info_t *get_view_image_info( const struct memory_view *vie
 extern int get_view_nt_name( const struct memory_view *view, struct unicode_str *name );
 extern void free_mapped_views( struct process *process );
 extern int get_page_size(void);
+extern int create_temp_file( file_pos_t size );
 extern struct mapping *create_fd_mapping( struct object *root, const struct unicode_str *name, struct fd *fd,
                                           unsigned int attr, const struct security_descriptor *sd );
 extern struct object *create_user_data_mapping( struct object *root, const struct unicode_str *name,
                                                 unsigned int attr, const struct security_descriptor *sd );
+extern struct object *create_shared_memory_mapping( struct object *root, const struct unicode_str *name,
+                                                    mem_size_t size, unsigned int attr,
+                                                    const struct security_descriptor *sd, void **ptr );
 
 /* device functions */
 
@@ -24,6 +24,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdarg.h>
 #ifdef HAVE_SYS_MMAN_H
@@ -277,6 +278,120 @@ unsigned int fsync_alloc_shm( int low, int high )
 #endif
 }
 
+/* freed blocks, linked through their first int */
+static unsigned int free_block_idx;
+
+/* blocks of destroyed threads, which may still be accessed until the Unix thread is gone */
+struct retired_block
+{
+    unsigned int shm_idx;
+    int          unix_pid;
+    int          unix_tid;
+};
+
+static struct retired_block *retired_blocks;
+static unsigned int retired_count, retired_size;
+
+#ifdef __linux__
+static int is_unix_thread_gone( int unix_pid, int unix_tid )
+{
+    int ret;
+
+    if (unix_tid == -1) ret = kill( unix_pid, 0 );
+    else if ((ret = syscall( __NR_tgkill, unix_pid, unix_tid, 0 )) == -1 && errno == ENOSYS)
+        ret = kill( unix_pid, 0 );
+    return ret == -1 && errno == ESRCH;
+}
+
+/* move the retired blocks whose thread is gone to the free list */
+static void reclaim_retired_blocks(void)
+{
+    unsigned int i = 0;
+
+    while (i < retired_count)
+    {
+        if (!is_unix_thread_gone( retired_blocks[i].unix_pid, retired_blocks[i].unix_tid ))
+        {
+            i++;
+            continue;
+        }
+        *(unsigned int *)get_shm( retired_blocks[i].shm_idx ) = free_block_idx;
+        free_block_idx = retired_blocks[i].shm_idx;
+        retired_blocks[i] = retired_blocks[--retired_count];
+    }
+}
+#endif
+
+/* allocate a SHM_REPLY_BLOCK_SIZE block, which doesn't cross a page boundary */
+unsigned int fsync_alloc_shm_block(void)
+{
+#ifdef __linux__
+    const unsigned int count = SHM_REPLY_BLOCK_SIZE / 8;
+    unsigned int shm_idx;
+    void *block;
+
+    if (!is_fsync_initialized)
+        return 0;
+
+    if (!free_block_idx && retired_count) reclaim_retired_blocks();
+    if ((shm_idx = free_block_idx))
+    {
+        block = get_shm( shm_idx );
+        free_block_idx = *(unsigned int *)block;
+        memset( block, 0, SHM_REPLY_BLOCK_SIZE );
+        return shm_idx;
+    }
+
+    shm_idx = (shm_idx_counter + count - 1) & ~(count - 1);
+    shm_idx_counter = shm_idx + count;
+
+    while (shm_idx_counter * 8 > shm_size)
+    {
+        shm_size += pagesize;
+        if (ftruncate( shm_fd, shm_size ) == -1)
+        {
+            fprintf( stderr, "fsync: couldn't expand %s to size %jd: ",
+                shm_name, shm_size );
+            perror( "ftruncate" );
+        }
+    }
+
+    block = get_shm( shm_idx );
+    assert(block);
+    memset( block, 0, SHM_REPLY_BLOCK_SIZE );
+    return shm_idx;
+#else
+    return 0;
+#endif
+}
+
+/* free the block of a destroyed thread; the client stores into it until
+ * its last request is sent, so it is only reused once the thread is gone */
+void fsync_free_shm_block( unsigned int shm_idx, int unix_pid, int unix_tid )
+{
+    struct retired_block *new_blocks;
+    unsigned int new_size;
+
+    if (!shm_idx) return;
+    if (unix_pid != -1)
+    {
+        if (retired_count == retired_size)
+        {
+            new_size = max( retired_size * 2, 16 );
+            if (!(new_blocks = realloc( retired_blocks, new_size * sizeof(*new_blocks) ))) return;
+            retired_blocks = new_blocks;
+            retired_size = new_size;
+        }
+        retired_blocks[retired_count].shm_idx  = shm_idx;
+        retired_blocks[retired_count].unix_pid = unix_pid;
+        retired_blocks[retired_count].unix_tid = unix_tid;
+        retired_count++;
+        return;
+    }
+    *(unsigned int *)get_shm( shm_idx ) = free_block_idx;
+    free_block_idx = shm_idx;
+}
+
 static int type_matches( enum fsync_type type1, enum fsync_type type2 )
 {
     return (type1 == type2) ||
@@ -523,3 +638,56 @@ DECL_HANDLER(get_fsync_apc_idx)
 {
     reply->shm_idx = current->fsync_apc_idx;
 }
+
+/* the reply to this request still goes through the pipe, see call_req_handler */
+DECL_HANDLER(get_fsync_reply_idx)
+{
+    if (!do_fsync())
+    {
+        set_error( STATUS_NOT_IMPLEMENTED );
+        return;
+    }
+
+    if (!current->fsync_reply_idx && !(current->fsync_reply_idx = fsync_alloc_shm_block()))
+    {
+        set_error( STATUS_NO_MEMORY );
+        return;
+    }
+
+    current->fsync_reply = get_shm( current->fsync_reply_idx );
+    reply->shm_idx = current->fsync_reply_idx;
+}
+
+/* the replies to this request go through the pipe either way, see call_req_handler */
+DECL_HANDLER(set_fsync_reply)
+{
+    if (!current->fsync_reply_idx)
+    {
+        set_error( STATUS_INVALID_PARAMETER );
+        return;
+    }
+    current->fsync_reply = req->enable ? get_shm( current->fsync_reply_idx ) : NULL;
+}
+
+/* write a reply to the thread shared memory block and wake it up if needed */
+void fsync_send_reply( struct thread *thread, const void *reply, size_t size,
+                       const void *data, data_size_t data_size )
+{
+    char *block = thread->fsync_reply;
+
+    memcpy( block + SHM_REPLY_HEADER_SIZE, reply, size );
+    if (data_size) memcpy( block + SHM_REPLY_HEADER_SIZE + size, data, data_size );
+    if (__atomic_exchange_n( (int *)block, SHM_REPLY_READY, __ATOMIC_SEQ_CST ) == SHM_REPLY_WAITING)
+        futex_wake( (int *)block, 1 );
+}
+
+/* tell a thread blocked on its reply block that no reply will come */
+void fsync_close_reply( struct thread *thread )
+{
+    int *state = thread->fsync_reply;
+
+    if (!state) return;
+    thread->fsync_reply = NULL;
+    if (__atomic_exchange_n( state, SHM_REPLY_CLOSED, __ATOMIC_SEQ_CST ) == SHM_REPLY_WAITING)
+        futex_wake( state, 1 );
+}
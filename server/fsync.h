@@ -21,6 +21,11 @@
 extern int do_fsync(void);
 extern void fsync_init(void);
 extern unsigned int fsync_alloc_shm( int low, int high );
+extern unsigned int fsync_alloc_shm_block(void);
+extern void fsync_free_shm_block( unsigned int shm_idx, int unix_pid, int unix_tid );
+extern void fsync_send_reply( struct thread *thread, const void *reply, size_t size,
+                              const void *data, data_size_t data_size );
+extern void fsync_close_reply( struct thread *thread );
 extern void fsync_wake_futex( unsigned int shm_idx );
 extern void fsync_clear_futex( unsigned int shm_idx );
 extern void fsync_wake_up( struct object *obj );
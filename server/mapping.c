@@ -288,7 +288,7 @@ static int check_current_dir_for_exec(void)
 }
 
 /* create a temp file for anonymous mappings */
-static int create_temp_file( file_pos_t size )
+int create_temp_file( file_pos_t size )
 {
     static int temp_dir_fd = -1;
     char tmpfn[] = "anonmap.XXXXXX";
@@ -1090,6 +1090,20 @@ int get_page_size(void)
     return page_mask + 1;
 }
 
+/* size of the transparent huge pages used for large page allocations */
+static unsigned int get_large_page_size(void)
+{
+    unsigned long size = 0;
+    FILE *f;
+
+    if ((f = fopen( "/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r" )))
+    {
+        if (fscanf( f, "%lu", &size ) != 1 || (size & (size - 1)) || size > 0x40000000) size = 0;
+        fclose( f );
+    }
+    return size ? size : 2 * 1024 * 1024;
+}
+
 struct object *create_user_data_mapping( struct object *root, const struct unicode_str *name,
                                         unsigned int attr, const struct security_descriptor *sd )
 {
@@ -1103,10 +1117,26 @@ struct object *create_user_data_mapping( struct object *root, const struct unico
     {
         user_shared_data = ptr;
         user_shared_data->SystemCall = 1;
+        user_shared_data->LargePageMinimum = get_large_page_size();
     }
     return &mapping->obj;
 }
 
+/* create a mapping holding server state that clients map read-only */
+struct object *create_shared_memory_mapping( struct object *root, const struct unicode_str *name,
+                                             mem_size_t size, unsigned int attr,
+                                             const struct security_descriptor *sd, void **ptr )
+{
+    void *base;
+    struct mapping *mapping;
+
+    if (!(mapping = create_mapping( root, name, attr, size, SEC_COMMIT, 0,
+                                    FILE_READ_DATA | FILE_WRITE_DATA, sd ))) return NULL;
+    base = mmap( NULL, mapping->size, PROT_READ | PROT_WRITE, MAP_SHARED, get_unix_fd( mapping->fd ), 0 );
+    if (base != MAP_FAILED) *ptr = base;
+    return &mapping->obj;
+}
+
 /* create a file mapping */
 DECL_HANDLER(create_mapping)
 {
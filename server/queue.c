@@ -149,6 +149,7 @@ struct msg_queue
     int                    esync_in_msgwait; /* our thread is currently waiting on us */
     unsigned int           fsync_idx;
     int                    fsync_in_msgwait; /* our thread is currently waiting on us */
+    unsigned int           shared_idx;      /* index in the shared queue mapping */
 };
 
 struct hotkey
@@ -292,6 +293,36 @@ static struct thread_input *create_thread_input( struct thread *thread )
     return input;
 }
 
+struct queue_shared_memory *queue_shared_data = NULL;
+static unsigned int queue_shared_count;  /* number of shared entries ever allocated */
+static unsigned int *queue_shared_free;  /* stack of freed shared entries */
+static unsigned int queue_shared_nb_free, queue_shared_max_free;
+
+/* allocate an entry in the shared queue mapping */
+static unsigned int alloc_queue_shared(void)
+{
+    if (!queue_shared_data) return ~0u;
+    if (queue_shared_nb_free) return queue_shared_free[--queue_shared_nb_free];
+    if (queue_shared_count < QUEUE_SHARED_MAX_QUEUES) return queue_shared_count++;
+    return ~0u;
+}
+
+/* free an entry of the shared queue mapping */
+static void free_queue_shared( unsigned int idx )
+{
+    if (idx == ~0u) return;
+    memset( &queue_shared_data[idx], 0, sizeof(queue_shared_data[idx]) );
+    if (queue_shared_nb_free == queue_shared_max_free)
+    {
+        unsigned int new_max = max( 64, queue_shared_max_free * 2 );
+        unsigned int *new_free = realloc( queue_shared_free, new_max * sizeof(*new_free) );
+        if (!new_free) return;  /* leak the entry */
+        queue_shared_free = new_free;
+        queue_shared_max_free = new_max;
+    }
+    queue_shared_free[queue_shared_nb_free++] = idx;
+}
+
 /* create a message queue object */
 static struct msg_queue *create_msg_queue( struct thread *thread, struct thread_input *input )
 {
@@ -327,6 +358,7 @@ static struct msg_queue *create_msg_queue( struct thread *thread, struct thread_
         queue->esync_in_msgwait = 0;
         queue->fsync_idx       = 0;
         queue->fsync_in_msgwait = 0;
+        queue->shared_idx      = alloc_queue_shared();
         list_init( &queue->send_result );
         list_init( &queue->callback_result );
         list_init( &queue->pending_timers );
@@ -426,6 +458,16 @@ static struct message *alloc_hardware_message( lparam_t info, struct hw_msg_sour
     return msg;
 }
 
+/* mirror the cursor state into the shared desktop state */
+static void update_desktop_shared_cursor( struct desktop *desktop )
+{
+    shared_write_begin( &desktop->shared->seq );
+    desktop->shared->cursor_x = desktop->cursor.x;
+    desktop->shared->cursor_y = desktop->cursor.y;
+    desktop->shared->cursor_last_change = desktop->cursor.last_change;
+    shared_write_end( &desktop->shared->seq );
+}
+
 static int update_desktop_cursor_pos( struct desktop *desktop, int x, int y )
 {
     int updated;
@@ -436,6 +478,7 @@ static int update_desktop_cursor_pos( struct desktop *desktop, int x, int y )
     desktop->cursor.x = x;
     desktop->cursor.y = y;
     desktop->cursor.last_change = get_tick_count();
+    update_desktop_shared_cursor( desktop );
 
     return updated;
 }
@@ -529,6 +572,14 @@ static inline int is_signaled( struct msg_queue *queue )
     return ((queue->wake_bits & queue->wake_mask) || (queue->changed_bits & queue->changed_mask));
 }
 
+/* mirror the queue bits into the shared queue mapping */
+static inline void update_queue_shared( struct msg_queue *queue )
+{
+    if (queue->shared_idx == ~0u) return;
+    queue_shared_data[queue->shared_idx].wake_bits = queue->wake_bits;
+    queue_shared_data[queue->shared_idx].changed_bits = queue->changed_bits;
+}
+
 /* set some queue bits */
 static inline void set_queue_bits( struct msg_queue *queue, unsigned int bits )
 {
@@ -539,6 +590,7 @@ static inline void set_queue_bits( struct msg_queue *queue, unsigned int bits )
     }
     queue->wake_bits |= bits;
     queue->changed_bits |= bits;
+    update_queue_shared( queue );
     if (is_signaled( queue )) wake_up( &queue->obj, 0 );
 }
 
@@ -547,6 +599,7 @@ static inline void clear_queue_bits( struct msg_queue *queue, unsigned int bits
 {
     queue->wake_bits &= ~bits;
     queue->changed_bits &= ~bits;
+    update_queue_shared( queue );
     if (!(queue->wake_bits & (QS_KEY | QS_MOUSEBUTTON)))
     {
         if (queue->keystate_lock) unlock_input_keystate( queue->input );
@@ -1127,6 +1180,7 @@ static void msg_queue_destroy( struct object *obj )
     release_object( queue->input );
     if (queue->hooks) release_object( queue->hooks );
     if (queue->fd) release_object( queue->fd );
+    free_queue_shared( queue->shared_idx );
 }
 
 static void msg_queue_poll_event( struct fd *fd, int event )
@@ -1859,6 +1913,7 @@ static int queue_mouse_message( struct desktop *desktop, user_handle_t win, cons
     };
 
     desktop->cursor.last_change = get_tick_count();
+    update_desktop_shared_cursor( desktop );
     flags = input->mouse.flags;
     time  = input->mouse.time;
     if (!time) time = desktop->cursor.last_change;
@@ -2484,7 +2539,12 @@ DECL_HANDLER(get_msg_queue)
     struct msg_queue *queue = get_current_queue();
 
     reply->handle = 0;
-    if (queue) reply->handle = alloc_handle( current->process, queue, SYNCHRONIZE, 0 );
+    reply->shared = ~0u;
+    if (queue)
+    {
+        reply->handle = alloc_handle( current->process, queue, SYNCHRONIZE, 0 );
+        reply->shared = queue->shared_idx;
+    }
 }
 
 
@@ -2543,6 +2603,7 @@ DECL_HANDLER(get_queue_status)
         reply->wake_bits    = queue->wake_bits;
         reply->changed_bits = queue->changed_bits;
         queue->changed_bits &= ~req->clear_bits;
+        update_queue_shared( queue );
 
         if (do_fsync() && !is_signaled( queue ))
             fsync_clear( &queue->obj );
@@ -2742,6 +2803,7 @@ DECL_HANDLER(get_message)
     }
     if (filter & QS_INPUT) queue->changed_bits &= ~QS_INPUT;
     if (filter & QS_PAINT) queue->changed_bits &= ~QS_PAINT;
+    update_queue_shared( queue );
 
     /* then check for posted messages */
     if ((filter & QS_POSTMESSAGE) &&
@@ -36,6 +36,9 @@
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -89,7 +92,10 @@ struct key
     int               last_value;  /* last in use value */
     int               nb_values;   /* count of allocated values in array */
     struct key_value *values;      /* values array */
+    struct name_index *subkey_index; /* hash index of subkeys for large keys */
+    struct name_index *value_index;  /* hash index of values for large keys */
     unsigned int      flags;       /* flags */
+    unsigned int      gen_slot;    /* index of the key generation in the registry cache mapping */
     timeout_t         modif;       /* last modification time */
     struct list       notify_list; /* list of notifications */
 };
@@ -101,6 +107,7 @@ struct key
 #define KEY_SYMLINK  0x0008  /* key is a symbolic link */
 #define KEY_WOW64    0x0010  /* key contains a Wow6432Node subkey */
 #define KEY_WOWSHARE 0x0020  /* key is a Wow64 shared key (used for Software\Classes) */
+#define KEY_CHANGED  0x0040  /* key values or subkey list have been modified */
 
 /* a key value */
 struct key_value
@@ -115,6 +122,25 @@ struct key_value
 #define MIN_SUBKEYS  8   /* min. number of allocated subkeys per key */
 #define MIN_VALUES   8   /* min. number of allocated values per key */
 
+/* Keys with many subkeys or values get a hash index of their names. New
+ * entries are then appended to the array instead of being inserted at their
+ * sorted position, and the array is only sorted again when it needs to be
+ * enumerated in order. */
+#define MIN_INDEX_ENTRIES 256  /* min. number of entries to create an index */
+
+struct index_bucket
+{
+    int               pos;     /* position in the array + 1, 0 if empty */
+    unsigned int      hash;    /* hash of the entry name */
+};
+
+struct name_index
+{
+    unsigned int         size;    /* number of buckets, a power of 2 */
+    int                  sorted;  /* number of sorted entries at the start of the array */
+    struct index_bucket *buckets; /* hash buckets */
+};
+
 #define MAX_NAME_LEN  256    /* max. length of a key name */
 #define MAX_VALUE_LEN 16383  /* max. length of a value name */
 
@@ -126,6 +152,14 @@ static const timeout_t save_period = 30 * -TICKS_PER_SEC;  /* delay between peri
 static struct timeout_user *save_timeout_user;  /* saving timer */
 static enum prefix_type { PREFIX_UNKNOWN, PREFIX_32BIT, PREFIX_64BIT } prefix_type;
 
+/* Clients cache the values they read, and validate them against a shared
+ * array of key generations that is bumped whenever a key is modified. Keys
+ * share the generation slots in round-robin order. */
+#define REGISTRY_GEN_SLOTS 4096
+
+static unsigned int *key_generations;  /* shared key generations */
+static int key_generations_fd = -1;    /* fd of the key generations mapping */
+
 static const WCHAR root_name[] = { '\\','R','e','g','i','s','t','r','y','\\' };
 static const WCHAR wow6432node[] = {'W','o','w','6','4','3','2','N','o','d','e'};
 static const WCHAR symlink_value[] = {'S','y','m','b','o','l','i','c','L','i','n','k','V','a','l','u','e'};
@@ -133,17 +167,26 @@ static const struct unicode_str symlink_str = { symlink_value, sizeof(symlink_va
 
 static void set_periodic_save_timer(void);
 static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index );
+static void sort_subkeys( struct key *key );
+static void sort_values( struct key *key );
+static void free_index( struct name_index *index );
+static inline void bump_key_generation( struct key *key );
 
 /* information about where to save a registry branch */
 struct save_branch_info
 {
     struct key  *key;
     const char  *path;
+    timeout_t    generation;   /* generation of the binary hive, 0 if none */
+    file_pos_t   hive_size;    /* size of the binary hive */
+    file_pos_t   journal_size; /* size of the hive journal */
+    int          text_stale;   /* text file is older than the binary hive */
 };
 
 #define MAX_SAVE_BRANCH_INFO 3
 static int save_branch_count;
 static struct save_branch_info save_branch_info[MAX_SAVE_BRANCH_INFO];
+static int binary_registry;  /* use binary hives with a journal for periodic saves */
 
 
 /* information about a file being loaded */
@@ -273,11 +316,13 @@ static void dump_value( const struct key_value *value, FILE *f )
 }
 
 /* save a registry and all its subkeys to a text file */
-static void save_subkeys( const struct key *key, const struct key *base, FILE *f )
+static void save_subkeys( struct key *key, const struct key *base, FILE *f )
 {
     int i;
 
     if (key->flags & KEY_VOLATILE) return;
+    sort_subkeys( key );
+    sort_values( key );
     /* save key if it has either some values or no subkeys, or needs special options */
     /* keys with no values but subkeys are saved implicitly by saving the subkeys */
     if ((key->last_value >= 0) || (key->last_subkey == -1) || key->class || (key->flags & KEY_SYMLINK))
@@ -433,6 +478,8 @@ static int key_close_handle( struct object *obj, struct process *process, obj_ha
     struct key * key = (struct key *) obj;
     struct notify *notify = find_notify( key, process, handle );
     if (notify) do_notification( key, notify, 1 );
+    /* the process caches values by handle, and can't tell when another process closes its handle */
+    if ((!current || current->process != process) && !process->is_terminating) bump_key_generation( key );
     return 1;  /* ok to close */
 }
 
@@ -451,12 +498,14 @@ static void key_destroy( struct object *obj )
         free( key->values[i].data );
     }
     free( key->values );
+    free_index( key->value_index );
     for (i = 0; i <= key->last_subkey; i++)
     {
         key->subkeys[i]->parent = NULL;
         release_object( key->subkeys[i] );
     }
     free( key->subkeys );
+    free_index( key->subkey_index );
     /* unconditionally notify everything waiting on this key */
     while ((ptr = list_head( &key->notify_list )))
     {
@@ -508,6 +557,7 @@ static struct unicode_str *get_path_token( const struct unicode_str *path, struc
 /* allocate a key object */
 static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
 {
+    static unsigned int next_gen_slot;
     struct key *key;
     if ((key = alloc_object( &key_ops )))
     {
@@ -522,6 +572,9 @@ static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
         key->nb_values   = 0;
         key->last_value  = -1;
         key->values      = NULL;
+        key->subkey_index = NULL;
+        key->value_index = NULL;
+        key->gen_slot    = next_gen_slot++ % REGISTRY_GEN_SLOTS;
         key->modif       = modif;
         key->parent      = NULL;
         list_init( &key->notify_list );
@@ -534,6 +587,12 @@ static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
     return key;
 }
 
+/* invalidate the values of a key cached by the clients */
+static inline void bump_key_generation( struct key *key )
+{
+    if (key_generations) key_generations[key->gen_slot]++;
+}
+
 /* mark a key and all its parents as dirty (modified) */
 static void make_dirty( struct key *key )
 {
@@ -552,10 +611,22 @@ static void make_clean( struct key *key )
 
     if (key->flags & KEY_VOLATILE) return;
     if (!(key->flags & KEY_DIRTY)) return;
-    key->flags &= ~KEY_DIRTY;
+    key->flags &= ~(KEY_DIRTY | KEY_CHANGED);
     for (i = 0; i <= key->last_subkey; i++) make_clean( key->subkeys[i] );
 }
 
+/* mark a key and all its subkeys as modified */
+static void make_tree_dirty( struct key *key )
+{
+    int i;
+
+    if (key->flags & KEY_VOLATILE) return;
+    make_dirty( key );
+    key->flags |= KEY_CHANGED;
+    bump_key_generation( key );
+    for (i = 0; i <= key->last_subkey; i++) make_tree_dirty( key->subkeys[i] );
+}
+
 /* go through all the notifications and send them if necessary */
 static void check_notify( struct key *key, unsigned int change, int not_subtree )
 {
@@ -576,6 +647,8 @@ static void touch_key( struct key *key, unsigned int change )
 
     key->modif = current_time;
     make_dirty( key );
+    if (!(key->flags & KEY_VOLATILE)) key->flags |= KEY_CHANGED;
+    bump_key_generation( key );
 
     /* do notifications */
     check_notify( key, change, 1 );
@@ -583,6 +656,234 @@ static void touch_key( struct key *key, unsigned int change )
         check_notify( k, change, 0 );
 }
 
+/* case-insensitive comparison of entry names, in the order of the subkeys and values arrays */
+static int compare_names( const WCHAR *name1, data_size_t len1, const WCHAR *name2, data_size_t len2 )
+{
+    int res = memicmp_strW( name1, name2, min( len1, len2 ) );
+    if (!res) res = len1 - len2;
+    return res;
+}
+
+static int compare_subkeys( const void *p1, const void *p2 )
+{
+    const struct key *key1 = *(struct key * const *)p1;
+    const struct key *key2 = *(struct key * const *)p2;
+    return compare_names( key1->name, key1->namelen, key2->name, key2->namelen );
+}
+
+static int compare_values( const void *p1, const void *p2 )
+{
+    const struct key_value *value1 = p1;
+    const struct key_value *value2 = p2;
+    return compare_names( value1->name, value1->namelen, value2->name, value2->namelen );
+}
+
+static const WCHAR *get_subkey_name( const struct key *key, int pos, data_size_t *len )
+{
+    *len = key->subkeys[pos]->namelen;
+    return key->subkeys[pos]->name;
+}
+
+static const WCHAR *get_value_name( const struct key *key, int pos, data_size_t *len )
+{
+    *len = key->values[pos].namelen;
+    return key->values[pos].name;
+}
+
+typedef const WCHAR *(*get_name_func)( const struct key *key, int pos, data_size_t *len );
+
+static inline unsigned int hash_name( const WCHAR *name, data_size_t len )
+{
+    return hash_strW( name, len, ~0u );
+}
+
+static void free_index( struct name_index *index )
+{
+    if (!index) return;
+    free( index->buckets );
+    free( index );
+}
+
+static void index_add( struct name_index *index, int pos, unsigned int hash )
+{
+    unsigned int i, mask = index->size - 1;
+
+    for (i = hash & mask; index->buckets[i].pos; i = (i + 1) & mask) ;
+    index->buckets[i].pos  = pos + 1;
+    index->buckets[i].hash = hash;
+}
+
+/* find an entry in the index and return its position in the array, or -1 */
+static int index_find( const struct name_index *index, const struct key *key, get_name_func get_name,
+                       const struct unicode_str *name )
+{
+    unsigned int i, hash = hash_name( name->str, name->len ), mask = index->size - 1;
+    const WCHAR *str;
+    data_size_t len;
+
+    for (i = hash & mask; index->buckets[i].pos; i = (i + 1) & mask)
+    {
+        if (index->buckets[i].hash != hash) continue;
+        str = get_name( key, index->buckets[i].pos - 1, &len );
+        if (!compare_names( str, len, name->str, name->len )) return index->buckets[i].pos - 1;
+    }
+    return -1;
+}
+
+/* adjust the positions of the entries at or after pos */
+static void index_shift( struct name_index *index, int pos, int delta )
+{
+    unsigned int i;
+
+    for (i = 0; i < index->size; i++)
+        if (index->buckets[i].pos > pos) index->buckets[i].pos += delta;
+}
+
+/* remove the entry at pos from the index, using backward shift deletion */
+static void index_remove( struct name_index *index, int pos, unsigned int hash )
+{
+    unsigned int i, j, home, mask = index->size - 1;
+
+    for (i = hash & mask; index->buckets[i].pos != pos + 1; i = (i + 1) & mask)
+        assert( index->buckets[i].pos );
+
+    for (j = (i + 1) & mask; index->buckets[j].pos; j = (j + 1) & mask)
+    {
+        home = index->buckets[j].hash & mask;
+        if (((j - home) & mask) < ((j - i) & mask)) continue;
+        index->buckets[i] = index->buckets[j];
+        i = j;
+    }
+    index->buckets[i].pos = 0;
+}
+
+/* fill the index with the first count entries of the array; return 1 if OK, 0 on error */
+static int build_index( struct name_index *index, const struct key *key, get_name_func get_name, int count )
+{
+    struct index_bucket *buckets;
+    unsigned int size = 16;
+    const WCHAR *name;
+    data_size_t len;
+    int i;
+
+    while (size < 2 * (unsigned int)(count + 1)) size *= 2;
+    if (!(buckets = mem_alloc( size * sizeof(*buckets) ))) return 0;
+    memset( buckets, 0, size * sizeof(*buckets) );
+    free( index->buckets );
+    index->buckets = buckets;
+    index->size    = size;
+    for (i = 0; i < count; i++)
+    {
+        name = get_name( key, i, &len );
+        index_add( index, i, hash_name( name, len ));
+    }
+    return 1;
+}
+
+/* create an index for a sorted array of count entries; return NULL if it can't be built */
+static struct name_index *create_index( const struct key *key, get_name_func get_name, int count )
+{
+    struct name_index *index;
+
+    /* the index is only an optimization, failing to build it is not an error */
+    if (!(index = mem_alloc( sizeof(*index) ))) goto failed;
+    index->buckets = NULL;
+    index->sorted  = count;
+    if (!build_index( index, key, get_name, count ))
+    {
+        free( index );
+        goto failed;
+    }
+    return index;
+
+failed:
+    clear_error();
+    return NULL;
+}
+
+/* make room for one more entry in the index; return 1 if OK, 0 on error */
+static int grow_index( struct name_index *index, const struct key *key, get_name_func get_name, int count )
+{
+    if (2 * (unsigned int)(count + 1) <= index->size) return 1;
+    return build_index( index, key, get_name, count );
+}
+
+/* update the index after the array entry at pos was inserted */
+static void index_insert( struct name_index *index, const struct key *key, get_name_func get_name,
+                          int pos, int last )
+{
+    const WCHAR *name;
+    data_size_t len;
+
+    if (pos < last) index_shift( index, pos, 1 );
+    if (pos < index->sorted) index->sorted = pos;
+    name = get_name( key, pos, &len );
+    index_add( index, pos, hash_name( name, len ));
+}
+
+/* merge the unsorted tail of an indexed array into its sorted start */
+static void merge_sorted( void *array, size_t size, int sorted, int count,
+                          int (*compare)( const void *, const void * ) )
+{
+    char *base = array, *tail;
+    int i = sorted - 1, j = count - sorted - 1, k;
+
+    qsort( base + sorted * size, count - sorted, size, compare );
+    if (!sorted || compare( base + (sorted - 1) * size, base + sorted * size ) <= 0) return;
+
+    if (!(tail = malloc( (count - sorted) * size )))
+    {
+        qsort( base, count, size, compare );
+        return;
+    }
+    memcpy( tail, base + sorted * size, (count - sorted) * size );
+    for (k = count - 1; j >= 0; k--)
+    {
+        if (i >= 0 && compare( base + i * size, tail + j * size ) > 0)
+            memcpy( base + k * size, base + i-- * size, size );
+        else
+            memcpy( base + k * size, tail + j-- * size, size );
+    }
+    free( tail );
+}
+
+/* make sure the subkeys array is sorted, for ordered enumeration */
+static void sort_subkeys( struct key *key )
+{
+    struct name_index *index = key->subkey_index;
+    int count = key->last_subkey + 1;
+
+    if (!index || index->sorted == count) return;
+    merge_sorted( key->subkeys, sizeof(*key->subkeys), index->sorted, count, compare_subkeys );
+    if (!build_index( index, key, get_subkey_name, count ))
+    {
+        /* fall back to binary search */
+        free_index( index );
+        key->subkey_index = NULL;
+        clear_error();
+        return;
+    }
+    index->sorted = count;
+}
+
+/* make sure the values array is sorted, for ordered enumeration */
+static void sort_values( struct key *key )
+{
+    struct name_index *index = key->value_index;
+    int count = key->last_value + 1;
+
+    if (!index || index->sorted == count) return;
+    merge_sorted( key->values, sizeof(*key->values), index->sorted, count, compare_values );
+    if (!build_index( index, key, get_value_name, count ))
+    {
+        free_index( index );
+        key->value_index = NULL;
+        clear_error();
+        return;
+    }
+    index->sorted = count;
+}
+
 /* try to grow the array of subkeys; return 1 if OK, 0 on error */
 static int grow_subkeys( struct key *key )
 {
@@ -625,12 +926,19 @@ static struct key *alloc_subkey( struct key *parent, const struct unicode_str *n
         /* need to grow the array */
         if (!grow_subkeys( parent )) return NULL;
     }
+    if (parent->subkey_index &&
+        !grow_index( parent->subkey_index, parent, get_subkey_name, parent->last_subkey + 1 ))
+        return NULL;
     if ((key = alloc_key( name, modif )) != NULL)
     {
         key->parent = parent;
         for (i = ++parent->last_subkey; i > index; i--)
             parent->subkeys[i] = parent->subkeys[i-1];
         parent->subkeys[index] = key;
+        if (parent->subkey_index)
+            index_insert( parent->subkey_index, parent, get_subkey_name, index, parent->last_subkey );
+        else if (parent->last_subkey + 1 >= MIN_INDEX_ENTRIES)
+            parent->subkey_index = create_index( parent, get_subkey_name, parent->last_subkey + 1 );
         if (is_wow6432node( key->name, key->namelen ) && !is_wow6432node( parent->name, parent->namelen ))
             parent->flags |= KEY_WOW64;
     }
@@ -647,10 +955,25 @@ static void free_subkey( struct key *parent, int index )
     assert( index <= parent->last_subkey );
 
     key = parent->subkeys[index];
+    if (parent->subkey_index)
+    {
+        struct name_index *name_index = parent->subkey_index;
+
+        index_remove( name_index, index, hash_name( key->name, key->namelen ));
+        if (index < parent->last_subkey) index_shift( name_index, index + 1, -1 );
+        if (index < name_index->sorted) name_index->sorted--;
+    }
     for (i = index; i < parent->last_subkey; i++) parent->subkeys[i] = parent->subkeys[i + 1];
     parent->last_subkey--;
+    if (parent->subkey_index && parent->last_subkey + 1 < MIN_INDEX_ENTRIES / 2)
+    {
+        sort_subkeys( parent );
+        free_index( parent->subkey_index );
+        parent->subkey_index = NULL;
+    }
     key->flags |= KEY_DELETED;
     key->parent = NULL;
+    bump_key_generation( key );
     if (is_wow6432node( key->name, key->namelen )) parent->flags &= ~KEY_WOW64;
     release_object( key );
 
@@ -673,6 +996,17 @@ static struct key *find_subkey( const struct key *key, const struct unicode_str
     int i, min, max, res;
     data_size_t len;
 
+    if (key->subkey_index)
+    {
+        if ((i = index_find( key->subkey_index, key, get_subkey_name, name )) != -1)
+        {
+            *index = i;
+            return key->subkeys[i];
+        }
+        *index = key->last_subkey + 1;  /* new entries are appended */
+        return NULL;
+    }
+
     min = 0;
     max = key->last_subkey;
     while (min <= max)
@@ -848,7 +1182,7 @@ static struct key *create_key( struct key *key, const struct unicode_str *name,
 
     if (options & REG_OPTION_CREATE_LINK) key->flags |= KEY_SYMLINK;
     if (options & REG_OPTION_VOLATILE) key->flags |= KEY_VOLATILE;
-    else key->flags |= KEY_DIRTY;
+    else key->flags |= KEY_DIRTY | KEY_CHANGED;
 
     if (sd) default_set_sd( &key->obj, sd, OWNER_SECURITY_INFORMATION | GROUP_SECURITY_INFORMATION |
                             DACL_SECURITY_INFORMATION | SACL_SECURITY_INFORMATION );
@@ -866,7 +1200,9 @@ static struct key *create_key( struct key *key, const struct unicode_str *name,
 }
 
 /* recursively create a subkey (for internal use only) */
-static struct key *create_key_recursive( struct key *key, const struct unicode_str *name, timeout_t modif )
+/* saved keys are loaded with follow_links unset, so that their path is never redirected by a symlink */
+static struct key *create_key_recursive( struct key *key, const struct unicode_str *name, timeout_t modif,
+                                         int follow_links )
 {
     struct key *base;
     int index;
@@ -879,7 +1215,7 @@ static struct key *create_key_recursive( struct key *key, const struct unicode_s
         struct key *subkey;
         if (!(subkey = find_subkey( key, &token, &index ))) break;
         key = subkey;
-        if (!(key = follow_symlink( key, 0 )))
+        if (follow_links && !(key = follow_symlink( key, 0 )))
         {
             set_error( STATUS_OBJECT_NAME_NOT_FOUND );
             return NULL;
@@ -925,6 +1261,7 @@ static void enum_key( struct key *key, int index, int info_class, struct enum_ke
             set_error( STATUS_NO_MORE_ENTRIES );
             return;
         }
+        sort_subkeys( key );
         key = key->subkeys[index];
     }
 
@@ -1017,9 +1354,17 @@ static int delete_key( struct key *key, int recurse )
         if (0 > delete_key(key->subkeys[key->last_subkey], 1))
             return -1;
 
-    for (index = 0; index <= parent->last_subkey; index++)
-        if (parent->subkeys[index] == key) break;
-    assert( index <= parent->last_subkey );
+    if (parent->subkey_index)
+    {
+        struct unicode_str name = { key->name, key->namelen };
+        find_subkey( parent, &name, &index );
+    }
+    else
+    {
+        for (index = 0; index <= parent->last_subkey; index++)
+            if (parent->subkeys[index] == key) break;
+    }
+    assert( index <= parent->last_subkey && parent->subkeys[index] == key );
 
     /* we can only delete a key that has no subkeys */
     if (key->last_subkey >= 0)
@@ -1065,6 +1410,17 @@ static struct key_value *find_value( const struct key *key, const struct unicode
     int i, min, max, res;
     data_size_t len;
 
+    if (key->value_index)
+    {
+        if ((i = index_find( key->value_index, key, get_value_name, name )) != -1)
+        {
+            *index = i;
+            return &key->values[i];
+        }
+        *index = key->last_value + 1;  /* new entries are appended */
+        return NULL;
+    }
+
     min = 0;
     max = key->last_value;
     while (min <= max)
@@ -1101,6 +1457,8 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
     {
         if (!grow_values( key )) return NULL;
     }
+    if (key->value_index && !grow_index( key->value_index, key, get_value_name, key->last_value + 1 ))
+        return NULL;
     if (name->len && !(new_name = memdup( name->str, name->len ))) return NULL;
     for (i = ++key->last_value; i > index; i--) key->values[i] = key->values[i - 1];
     value = &key->values[index];
@@ -1108,6 +1466,10 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
     value->namelen = name->len;
     value->len     = 0;
     value->data    = NULL;
+    if (key->value_index)
+        index_insert( key->value_index, key, get_value_name, index, key->last_value );
+    else if (key->last_value + 1 >= MIN_INDEX_ENTRIES)
+        key->value_index = create_index( key, get_value_name, key->last_value + 1 );
     return value;
 }
 
@@ -1190,6 +1552,7 @@ static void enum_value( struct key *key, int i, int info_class, struct enum_key_
         void *data;
         data_size_t namelen, maxlen;
 
+        sort_values( key );
         value = &key->values[i];
         reply->type = value->type;
         namelen = value->namelen;
@@ -1242,10 +1605,24 @@ static void delete_value( struct key *key, const struct unicode_str *name )
         return;
     }
     if (debug_level > 1) dump_operation( key, value, "Delete" );
+    if (key->value_index)
+    {
+        struct name_index *name_index = key->value_index;
+
+        index_remove( name_index, index, hash_name( value->name, value->namelen ));
+        if (index < key->last_value) index_shift( name_index, index + 1, -1 );
+        if (index < name_index->sorted) name_index->sorted--;
+    }
     free( value->name );
     free( value->data );
     for (i = index; i < key->last_value; i++) key->values[i] = key->values[i + 1];
     key->last_value--;
+    if (key->value_index && key->last_value + 1 < MIN_INDEX_ENTRIES / 2)
+    {
+        sort_values( key );
+        free_index( key->value_index );
+        key->value_index = NULL;
+    }
     touch_key( key, REG_NOTIFY_CHANGE_LAST_SET );
 
     /* try to shrink the array */
@@ -1410,7 +1787,7 @@ static struct key *load_key( struct key *base, const char *buffer, int prefix_le
     }
     name.str = p;
     name.len = len - (p - info->tmp + 1) * sizeof(WCHAR);
-    return create_key_recursive( base, &name, 0 );
+    return create_key_recursive( base, &name, 0, 0 );
 }
 
 /* update the modification time of a key (and its parents) after it has been loaded from a file */
@@ -1726,33 +2103,615 @@ static void load_registry( struct key *key, obj_handle_t handle )
         {
             load_keys( key, NULL, f, -1 );
             fclose( f );
+            make_tree_dirty( key );
         }
         else file_set_error();
     }
 }
 
-/* load one of the initial registry files */
-static int load_init_registry_from_file( const char *filename, struct key *key )
+/* Binary hives
+ *
+ * When WINE_BINARY_REGISTRY is set, each saved registry branch also gets a
+ * binary hive (<file>.bin) that is loaded with a single mapping, and an
+ * append-only journal (<file>.log) to which periodic saves only write the keys
+ * modified since the previous save. The hive is rewritten when the journal
+ * grows too large. The text file remains the reference format: it is
+ * rewritten when the registry is flushed, and the hive is ignored if it
+ * doesn't match the current text file. */
+
+#define HIVE_MAGIC          0x76696857  /* "Whiv" */
+#define JOURNAL_MAGIC       0x676f6c57  /* "Wlog" */
+#define HIVE_VERSION        1
+#define HIVE_TEXT_CURRENT   0x0001      /* text file was saved along with the hive */
+#define MIN_COMPACT_SIZE    (1024 * 1024)  /* min. journal size before rewriting the hive */
+#define HIVE_ALIGN(len)     (((len) + 7) & ~(size_t)7)
+
+struct hive_header
+{
+    unsigned int  magic;       /* HIVE_MAGIC or JOURNAL_MAGIC */
+    unsigned int  version;     /* HIVE_VERSION */
+    unsigned int  arch;        /* prefix type */
+    unsigned int  flags;       /* HIVE_TEXT_* flags */
+    timeout_t     generation;  /* hive generation, shared with its journal */
+    timeout_t     text_time;   /* modification time of the matching text file */
+    file_pos_t    text_size;   /* size of the matching text file */
+    file_pos_t    text_inode;  /* inode of the matching text file */
+};
+
+/* a key record, followed by the path, class, values and subkey names, each aligned to 8 bytes */
+struct hive_key
 {
-    FILE *f;
+    data_size_t   size;        /* size of the whole record */
+    data_size_t   path_len;    /* length of the path relative to the branch root */
+    data_size_t   class_len;   /* length of the class name */
+    unsigned int  flags;       /* HIVE_KEY_* flags */
+    int           value_count; /* number of values */
+    int           subkey_count;/* number of subkey names */
+    timeout_t     modif;       /* last modification time */
+};
+
+#define HIVE_KEY_SYMLINK  0x0001  /* key is a symbolic link */
+#define HIVE_KEY_SUBKEYS  0x0002  /* subkey names are listed, other subkeys are deleted */
+
+/* a value record, followed by the name and data, each aligned to 8 bytes */
+struct hive_value
+{
+    unsigned int  type;        /* value type */
+    data_size_t   namelen;     /* length of value name */
+    data_size_t   len;         /* length of value data */
+    unsigned int  unused;
+};
 
-    if ((f = fopen( filename, "r" )))
+struct hive_buffer
+{
+    char         *data;        /* buffer data */
+    size_t        size;        /* allocated size */
+    size_t        pos;         /* current position */
+    int           error;       /* allocation failure */
+};
+
+static char *get_hive_file_name( const char *path, const char *ext )
+{
+    char *ret;
+
+    if ((ret = malloc( strlen(path) + strlen(ext) + 1 )))
+    {
+        strcpy( ret, path );
+        strcat( ret, ext );
+    }
+    return ret;
+}
+
+/* reserve aligned space in a hive buffer */
+static void *hive_reserve( struct hive_buffer *buf, size_t len )
+{
+    void *ret;
+
+    if (buf->error) return NULL;
+    len = HIVE_ALIGN( len );
+    if (buf->pos + len > buf->size)
     {
-        load_keys( key, filename, f, 0 );
-        fclose( f );
-        if (get_error() == STATUS_NOT_REGISTRY_FILE)
+        size_t new_size = max( buf->size * 2, buf->pos + len + 65536 );
+        char *new_data;
+
+        if (!(new_data = realloc( buf->data, new_size )))
         {
-            fprintf( stderr, "%s is not a valid registry file\n", filename );
-            return 1;
+            buf->error = 1;
+            return NULL;
         }
+        buf->data = new_data;
+        buf->size = new_size;
     }
+    ret = buf->data + buf->pos;
+    memset( ret, 0, len );
+    buf->pos += len;
+    return ret;
+}
+
+static void hive_put( struct hive_buffer *buf, const void *data, size_t len )
+{
+    void *ptr = hive_reserve( buf, len );
+    if (ptr && len) memcpy( ptr, data, len );
+}
+
+/* store the path of a key relative to the branch root */
+static data_size_t hive_put_path( struct hive_buffer *buf, const struct key *key, const struct key *base )
+{
+    const struct key *k;
+    data_size_t len = 0, pos;
+    WCHAR *path;
+
+    for (k = key; k != base; k = k->parent) len += k->namelen + sizeof(WCHAR);
+    if (len) len -= sizeof(WCHAR);
+    if (!(path = hive_reserve( buf, len ))) return 0;
+    for (k = key, pos = len; k != base; k = k->parent)
+    {
+        pos -= k->namelen;
+        memcpy( (char *)path + pos, k->name, k->namelen );
+        if (!pos) break;
+        pos -= sizeof(WCHAR);
+        path[pos / sizeof(WCHAR)] = '\\';
+    }
+    return len;
+}
+
+/* store the record of a key */
+static void hive_put_key( struct hive_buffer *buf, struct key *key, const struct key *base, int subkeys )
+{
+    size_t offset = buf->pos;
+    struct hive_value value;
+    struct hive_key *rec;
+    data_size_t path_len;
+    int i, count = 0;
+
+    sort_values( key );
+    if (!hive_reserve( buf, sizeof(*rec) )) return;
+    path_len = hive_put_path( buf, key, base );
+    hive_put( buf, key->class, key->classlen );
+    for (i = 0; i <= key->last_value; i++)
+    {
+        value.type    = key->values[i].type;
+        value.namelen = key->values[i].namelen;
+        value.len     = key->values[i].len;
+        value.unused  = 0;
+        hive_put( buf, &value, sizeof(value) );
+        hive_put( buf, key->values[i].name, key->values[i].namelen );
+        hive_put( buf, key->values[i].data, key->values[i].len );
+    }
+    if (subkeys)
+    {
+        sort_subkeys( key );
+        for (i = 0; i <= key->last_subkey; i++)
+        {
+            if (key->subkeys[i]->flags & KEY_VOLATILE) continue;
+            hive_put( buf, &key->subkeys[i]->namelen, sizeof(key->subkeys[i]->namelen) );
+            hive_put( buf, key->subkeys[i]->name, key->subkeys[i]->namelen );
+            count++;
+        }
+    }
+    if (buf->error) return;
+
+    rec = (struct hive_key *)(buf->data + offset);
+    rec->size         = buf->pos - offset;
+    rec->path_len     = path_len;
+    rec->class_len    = key->classlen;
+    rec->flags        = 0;
+    rec->value_count  = key->last_value + 1;
+    rec->subkey_count = count;
+    rec->modif        = key->modif;
+    if (key->flags & KEY_SYMLINK) rec->flags |= HIVE_KEY_SYMLINK;
+    if (subkeys) rec->flags |= HIVE_KEY_SUBKEYS;
+}
+
+/* store the records of a key and all its subkeys */
+static void hive_put_tree( struct hive_buffer *buf, struct key *key, const struct key *base )
+{
+    int i;
+
+    if (key->flags & KEY_VOLATILE) return;
+    hive_put_key( buf, key, base, 0 );
+    sort_subkeys( key );
+    for (i = 0; i <= key->last_subkey; i++) hive_put_tree( buf, key->subkeys[i], base );
+}
+
+/* store the records of the keys modified since the last save */
+static void hive_put_changes( struct hive_buffer *buf, struct key *key, const struct key *base )
+{
+    int i;
+
+    if (key->flags & KEY_VOLATILE) return;
+    if (!(key->flags & KEY_DIRTY)) return;
+    if (key->flags & KEY_CHANGED) hive_put_key( buf, key, base, 1 );
+    for (i = 0; i <= key->last_subkey; i++) hive_put_changes( buf, key->subkeys[i], base );
+}
+
+static int hive_skip( const char **ptr, const char *end, data_size_t len )
+{
+    if (len > end - *ptr) return 0;
+    *ptr += HIVE_ALIGN( len );
+    return 1;
+}
+
+/* check a key record and return its size, or 0 if it is invalid */
+static data_size_t hive_check_key( const char *ptr, const char *end )
+{
+    const struct hive_key *rec = (const struct hive_key *)ptr;
+    const struct hive_value *value;
+    const data_size_t *len;
+    const char *p;
+    int i;
+
+    if (end - ptr < sizeof(*rec)) return 0;
+    if (rec->size < sizeof(*rec) || rec->size > end - ptr || rec->size % 8) return 0;
+    if (rec->value_count < 0 || rec->subkey_count < 0) return 0;
+    if ((rec->path_len | rec->class_len) % sizeof(WCHAR)) return 0;
+    end = ptr + rec->size;
+    p = ptr + sizeof(*rec);
+    if (!hive_skip( &p, end, rec->path_len ) || !hive_skip( &p, end, rec->class_len )) return 0;
+    for (i = 0; i < rec->value_count; i++)
+    {
+        value = (const struct hive_value *)p;
+        if (!hive_skip( &p, end, sizeof(*value) )) return 0;
+        if (value->namelen > MAX_VALUE_LEN * sizeof(WCHAR) || value->namelen % sizeof(WCHAR)) return 0;
+        if (!hive_skip( &p, end, value->namelen ) || !hive_skip( &p, end, value->len )) return 0;
+    }
+    for (i = 0; i < rec->subkey_count; i++)
+    {
+        len = (const data_size_t *)p;
+        if (!hive_skip( &p, end, sizeof(*len) )) return 0;
+        if (*len > MAX_NAME_LEN * sizeof(WCHAR) || *len % sizeof(WCHAR)) return 0;
+        if (!hive_skip( &p, end, *len )) return 0;
+    }
+    return p == end ? rec->size : 0;
+}
+
+/* check the records of a hive or journal and return the end of the valid ones */
+static const char *hive_check_records( const char *ptr, const char *end, unsigned int *count )
+{
+    data_size_t size;
+
+    while (ptr < end && (size = hive_check_key( ptr, end )))
+    {
+        ptr += size;
+        (*count)++;
+    }
+    return ptr;
+}
+
+/* delete the subkeys of a key that are not listed in its record */
+static void hive_delete_subkeys( struct key *key, const char *ptr, int count )
+{
+    const data_size_t *len;
+    struct key *subkey;
+    int i = 0, res;
+
+    sort_subkeys( key );
+    while (i <= key->last_subkey)
+    {
+        subkey = key->subkeys[i];
+        res = 1;
+        while (count)
+        {
+            len = (const data_size_t *)ptr;
+            res = compare_names( (const WCHAR *)(ptr + HIVE_ALIGN( sizeof(*len) )), *len,
+                                 subkey->name, subkey->namelen );
+            if (res >= 0) break;
+            ptr += HIVE_ALIGN( sizeof(*len) ) + HIVE_ALIGN( *len );
+            count--;
+        }
+        if ((count && !res) || (subkey->flags & KEY_VOLATILE) || delete_key( subkey, 1 ) == -1) i++;
+    }
+}
+
+/* load a key from its record */
+static void hive_load_key( struct key *base, const char *ptr )
+{
+    const struct hive_key *rec = (const struct hive_key *)ptr;
+    const struct hive_value *val;
+    struct key_value *value;
+    struct unicode_str name;
+    struct key *key;
+    int i, index;
+
+    ptr += sizeof(*rec);
+    name.str = (const WCHAR *)ptr;
+    name.len = rec->path_len;
+    ptr += HIVE_ALIGN( rec->path_len );
+    if (!(key = create_key_recursive( base, &name, rec->modif, 0 ))) return;
+
+    if (rec->flags & HIVE_KEY_SYMLINK) key->flags |= KEY_SYMLINK;
+    else key->flags &= ~KEY_SYMLINK;
+    free( key->class );
+    key->class = NULL;
+    key->classlen = 0;
+    if (rec->class_len && (key->class = memdup( ptr, rec->class_len ))) key->classlen = rec->class_len;
+    ptr += HIVE_ALIGN( rec->class_len );
+
+    /* the record replaces all the existing values */
+    for (i = 0; i <= key->last_value; i++)
+    {
+        free( key->values[i].name );
+        free( key->values[i].data );
+    }
+    key->last_value = -1;
+    free_index( key->value_index );
+    key->value_index = NULL;
+
+    for (i = 0; i < rec->value_count; i++)
+    {
+        val = (const struct hive_value *)ptr;
+        ptr += HIVE_ALIGN( sizeof(*val) );
+        name.str = (const WCHAR *)ptr;
+        name.len = val->namelen;
+        ptr += HIVE_ALIGN( val->namelen );
+        if (!(value = find_value( key, &name, &index )) &&
+            !(value = insert_value( key, &name, index ))) break;
+        free( value->data );
+        value->data = val->len ? memdup( ptr, val->len ) : NULL;
+        value->len  = value->data ? val->len : 0;
+        value->type = val->type;
+        ptr += HIVE_ALIGN( val->len );
+    }
+    if (i == rec->value_count && (rec->flags & HIVE_KEY_SUBKEYS))
+        hive_delete_subkeys( key, ptr, rec->subkey_count );
+    /* set last, deleting the subkeys touches the key */
+    key->modif = rec->modif;
+    release_object( key );
+}
+
+static void hive_load_records( struct key *key, const char *ptr, const char *end )
+{
+    while (ptr < end)
+    {
+        hive_load_key( key, ptr );
+        ptr += ((const struct hive_key *)ptr)->size;
+    }
+}
+
+static void get_text_file_info( struct hive_header *header, const struct stat *st )
+{
+    header->text_time  = (timeout_t)st->st_mtime * TICKS_PER_SEC + ticks_1601_to_1970;
+    header->text_size  = st->st_size;
+    header->text_inode = st->st_ino;
+}
+
+/* check that a hive header matches the text file */
+static int check_hive_header( const struct hive_header *header, unsigned int magic, const struct stat *st )
+{
+    struct hive_header text;
+
+    if (header->magic != magic || header->version != HIVE_VERSION) return 0;
+    if (header->arch != PREFIX_32BIT && header->arch != PREFIX_64BIT) return 0;
+    if (prefix_type != PREFIX_UNKNOWN && header->arch != prefix_type) return 0;
+    get_text_file_info( &text, st );
+    return (header->text_time == text.text_time && header->text_size == text.text_size &&
+            header->text_inode == text.text_inode);
+}
+
+static int write_hive_data( int fd, const void *data, size_t size )
+{
+    const char *ptr = data;
+    ssize_t ret;
+
+    while (size)
+    {
+        if ((ret = write( fd, ptr, size )) == -1)
+        {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        ptr += ret;
+        size -= ret;
+    }
+    return 1;
+}
+
+/* replay the journal of a binary hive, and return the number of records */
+static unsigned int load_journal( struct key *key, struct save_branch_info *info, const struct stat *text_st )
+{
+    const struct hive_header *header;
+    const char *end = NULL;
+    unsigned int count = 0;
+    struct stat st;
+    char *journal;
+    void *map;
+    int fd;
+
+    if (!(journal = get_hive_file_name( info->path, ".log" ))) return 0;
+    fd = open( journal, O_RDWR );
+    free( journal );
+    if (fd == -1) return 0;
+    if (fstat( fd, &st ) || st.st_size < sizeof(*header) ||
+        (map = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 )) == MAP_FAILED)
+    {
+        close( fd );
+        return 0;
+    }
+    header = map;
+    if (check_hive_header( header, JOURNAL_MAGIC, text_st ) && header->generation == info->generation)
+    {
+        end = hive_check_records( (const char *)(header + 1), (const char *)map + st.st_size, &count );
+        hive_load_records( key, (const char *)(header + 1), end );
+        info->journal_size = end - (const char *)map;
+        /* drop a partially written save so that new records can be appended */
+        if (info->journal_size < st.st_size) ftruncate( fd, info->journal_size );
+    }
+    munmap( map, st.st_size );
+    close( fd );
+    if (!end) info->generation = 0;  /* journal is unusable, write a new hive on next save */
+    return count;
+}
+
+/* load a registry branch from its binary hive */
+static int load_hive( struct key *key, struct save_branch_info *info )
+{
+    timeout_t start = monotonic_counter();
+    const struct hive_header *header;
+    const char *end;
+    unsigned int count = 0, journal_count;
+    struct stat st, text_st;
+    char *hive;
+    void *map;
+    int fd, ret = 0;
+
+    if (stat( info->path, &text_st )) return 0;
+    if (!(hive = get_hive_file_name( info->path, ".bin" ))) return 0;
+    fd = open( hive, O_RDONLY );
+    free( hive );
+    if (fd == -1) return 0;
+    if (fstat( fd, &st ) || st.st_size < sizeof(*header) ||
+        (map = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 )) == MAP_FAILED)
+    {
+        close( fd );
+        return 0;
+    }
+    close( fd );
+
+    header = map;
+    end = (const char *)map + st.st_size;
+    if (check_hive_header( header, HIVE_MAGIC, &text_st ) &&
+        hive_check_records( (const char *)(header + 1), end, &count ) == end)
+    {
+        prefix_type = header->arch;
+        hive_load_records( key, (const char *)(header + 1), end );
+        info->generation = header->generation;
+        info->hive_size  = st.st_size;
+        info->text_stale = !(header->flags & HIVE_TEXT_CURRENT);
+        ret = 1;
+    }
+    munmap( map, st.st_size );
+    if (!ret) return 0;
+
+    if ((journal_count = load_journal( key, info, &text_st ))) info->text_stale = 1;
+    make_clean( key );
+    if (debug_level > 1)
+        fprintf( stderr, "%s: loaded %u keys from binary hive and %u from journal in %u ms\n",
+                 info->path, count, journal_count, (unsigned int)((monotonic_counter() - start) / 10000) );
+    return 1;
+}
+
+/* write the binary hive of a registry branch and start a new journal */
+static int save_hive( struct save_branch_info *info, int text_current )
+{
+    struct hive_buffer buf = { NULL };
+    struct hive_header header;
+    struct stat st;
+    char *hive = NULL, *tmp = NULL, *journal = NULL;
+    int fd, ret = 0;
+
+    memset( &header, 0, sizeof(header) );
+    header.magic      = HIVE_MAGIC;
+    header.version    = HIVE_VERSION;
+    header.arch       = prefix_type;
+    header.flags      = text_current ? HIVE_TEXT_CURRENT : 0;
+    header.generation = max( current_time, info->generation + 1 );
+    if (!stat( info->path, &st )) get_text_file_info( &header, &st );
+
+    hive_put( &buf, &header, sizeof(header) );
+    hive_put_tree( &buf, info->key, info->key );
+    if (buf.error) goto done;
+
+    if (!(hive = get_hive_file_name( info->path, ".bin" ))) goto done;
+    if (!(tmp = get_hive_file_name( info->path, ".bin.tmp" ))) goto done;
+    if (!(journal = get_hive_file_name( info->path, ".log" ))) goto done;
+
+    /* the journal of the previous generation is ignored once the new hive is in place */
+    if ((fd = open( tmp, O_CREAT | O_TRUNC | O_WRONLY, 0666 )) == -1) goto done;
+    ret = write_hive_data( fd, buf.data, buf.pos );
+    if (close( fd )) ret = 0;
+    if (ret) ret = !rename( tmp, hive );
+    if (!ret)
+    {
+        unlink( tmp );
+        goto done;
+    }
+
+    header.magic = JOURNAL_MAGIC;
+    if ((fd = open( journal, O_CREAT | O_TRUNC | O_WRONLY, 0666 )) == -1) ret = 0;
+    else
+    {
+        ret = write_hive_data( fd, &header, sizeof(header) );
+        if (close( fd )) ret = 0;
+    }
+
+done:
+    if (ret)
+    {
+        info->generation   = header.generation;
+        info->hive_size    = buf.pos;
+        info->journal_size = sizeof(header);
+        info->text_stale   = !text_current;
+    }
+    else info->generation = 0;
+    free( hive );
+    free( tmp );
+    free( journal );
+    free( buf.data );
+    return ret;
+}
+
+/* append the keys modified since the last save to the journal */
+static int save_journal( struct save_branch_info *info )
+{
+    struct hive_buffer buf = { NULL };
+    char *journal;
+    int fd, ret = 0;
+
+    hive_put_changes( &buf, info->key, info->key );
+    if (!buf.error && (journal = get_hive_file_name( info->path, ".log" )))
+    {
+        if ((fd = open( journal, O_WRONLY | O_APPEND )) != -1)
+        {
+            ret = write_hive_data( fd, buf.data, buf.pos );
+            if (close( fd )) ret = 0;
+        }
+        free( journal );
+    }
+    if (ret)
+    {
+        info->journal_size += buf.pos;
+        info->text_stale = 1;
+    }
+    else info->generation = 0;  /* the journal may be corrupted, write a new hive on next save */
+    free( buf.data );
+    return ret;
+}
+
+/* save the modified keys of a registry branch to its binary hive */
+static int save_branch_hive( struct save_branch_info *info )
+{
+    timeout_t start = monotonic_counter();
+    int compact, ret;
+
+    if (!(info->key->flags & KEY_DIRTY)) return 1;
+
+    compact = !info->generation || info->journal_size > max( info->hive_size, MIN_COMPACT_SIZE );
+    if (compact) ret = save_hive( info, 0 );
+    else ret = save_journal( info );
+    if (ret) make_clean( info->key );
+
+    if (debug_level > 1)
+        fprintf( stderr, "%s: saved %s in %u ms\n", info->path, compact ? "binary hive" : "journal",
+                 (unsigned int)((monotonic_counter() - start) / 10000) );
+    return ret;
+}
+
+/* load one of the initial registry files */
+static int load_init_registry_from_file( const char *filename, struct key *key )
+{
+    struct save_branch_info *info;
+    timeout_t start = monotonic_counter();
+    FILE *f = NULL;
+    int ret = 1;
 
     assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
 
-    save_branch_info[save_branch_count].path = filename;
-    save_branch_info[save_branch_count++].key = (struct key *)grab_object( key );
+    info = &save_branch_info[save_branch_count];
+    info->path = filename;
+    info->key  = key;
+
+    if (!binary_registry || !load_hive( key, info ))
+    {
+        if ((f = fopen( filename, "r" )))
+        {
+            load_keys( key, filename, f, 0 );
+            fclose( f );
+            if (get_error() == STATUS_NOT_REGISTRY_FILE)
+            {
+                fprintf( stderr, "%s is not a valid registry file\n", filename );
+                return 1;
+            }
+            if (debug_level > 1)
+                fprintf( stderr, "%s: loaded in %u ms\n", filename,
+                         (unsigned int)((monotonic_counter() - start) / 10000) );
+        }
+        else ret = 0;
+    }
+
+    save_branch_count++;
+    grab_object( key );
     make_object_permanent( &key->obj );
-    return (f != NULL);
+    return ret;
 }
 
 static WCHAR *format_user_registry_path( const SID *sid, struct unicode_str *path )
@@ -1819,6 +2778,8 @@ void init_registry(void)
 
     if (fchdir( config_dir_fd ) == -1) fatal_error( "chdir to config dir: %s\n", strerror( errno ));
 
+    binary_registry = (p = getenv( "WINE_BINARY_REGISTRY" )) && atoi( p );
+
     /* create the root key */
     root_key = alloc_key( &root_name, current_time );
     assert( root_key );
@@ -1826,7 +2787,7 @@ void init_registry(void)
 
     /* load system.reg into Registry\Machine */
 
-    if (!(hklm = create_key_recursive( root_key, &HKLM_name, current_time )))
+    if (!(hklm = create_key_recursive( root_key, &HKLM_name, current_time, 1 )))
         fatal_error( "could not create Machine registry key\n" );
 
     if (!load_init_registry_from_file( "system.reg", hklm ))
@@ -1841,7 +2802,7 @@ void init_registry(void)
 
     /* load userdef.reg into Registry\User\.Default */
 
-    if (!(key = create_key_recursive( root_key, &HKU_name, current_time )))
+    if (!(key = create_key_recursive( root_key, &HKU_name, current_time, 1 )))
         fatal_error( "could not create User\\.Default registry key\n" );
 
     load_init_registry_from_file( "userdef.reg", key );
@@ -1852,7 +2813,7 @@ void init_registry(void)
     /* FIXME: match default user in token.c. should get from process token instead */
     current_user_path = format_user_registry_path( security_local_user_sid, &current_user_str );
     if (!current_user_path ||
-        !(hkcu = create_key_recursive( root_key, &current_user_str, current_time )))
+        !(hkcu = create_key_recursive( root_key, &current_user_str, current_time, 1 )))
         fatal_error( "could not create HKEY_CURRENT_USER registry key\n" );
     free( current_user_path );
     load_init_registry_from_file( "user.reg", hkcu );
@@ -1860,7 +2821,7 @@ void init_registry(void)
     /* set the shared flag on Software\Classes\Wow6432Node */
     if (prefix_type == PREFIX_64BIT)
     {
-        if ((key = create_key_recursive( hklm, &classes_name, current_time )))
+        if ((key = create_key_recursive( hklm, &classes_name, current_time, 1 )))
         {
             key->flags |= KEY_WOWSHARE;
             release_object( key );
@@ -1935,6 +2896,7 @@ static void save_registry( struct key *key, obj_handle_t handle )
 /* save a registry branch to a file */
 static int save_branch( struct key *key, const char *path )
 {
+    timeout_t start = monotonic_counter();
     struct stat st;
     char *p, *tmp = NULL;
     int fd, count = 0, ret = 0;
@@ -2003,6 +2965,8 @@ static int save_branch( struct key *key, const char *path )
 done:
     free( tmp );
     if (ret) make_clean( key );
+    if (debug_level > 1)
+        fprintf( stderr, "%s: saved in %u ms\n", path, (unsigned int)((monotonic_counter() - start) / 10000) );
     return ret;
 }
 
@@ -2014,7 +2978,10 @@ static void periodic_save( void *arg )
     if (fchdir( config_dir_fd ) == -1) return;
     save_timeout_user = NULL;
     for (i = 0; i < save_branch_count; i++)
-        save_branch( save_branch_info[i].key, save_branch_info[i].path );
+    {
+        if (binary_registry) save_branch_hive( &save_branch_info[i] );
+        else save_branch( save_branch_info[i].key, save_branch_info[i].path );
+    }
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
     set_periodic_save_timer();
 }
@@ -2034,12 +3001,18 @@ void flush_registry(void)
     if (fchdir( config_dir_fd ) == -1) return;
     for (i = 0; i < save_branch_count; i++)
     {
-        if (!save_branch( save_branch_info[i].key, save_branch_info[i].path ))
+        struct save_branch_info *info = &save_branch_info[i];
+        int changed = (info->key->flags & KEY_DIRTY) || info->text_stale;
+
+        /* the text file also needs to be written if the changes only went to the journal */
+        if (info->text_stale) make_dirty( info->key );
+        if (!save_branch( info->key, info->path ))
         {
-            fprintf( stderr, "wineserver: could not save registry branch to %s",
-                     save_branch_info[i].path );
+            fprintf( stderr, "wineserver: could not save registry branch to %s", info->path );
             perror( " " );
         }
+        else if (binary_registry && (changed || !info->generation)) save_hive( info, 1 );
+        else info->text_stale = 0;
     }
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
 }
@@ -2179,6 +3152,8 @@ DECL_HANDLER(get_key_value)
     reply->total = 0;
     if ((key = get_hkey_obj( req->hkey, KEY_QUERY_VALUE )))
     {
+        reply->gen_slot = key->gen_slot;
+        if (key_generations) reply->generation = key_generations[key->gen_slot];
         get_value( key, &name, &reply->type, &reply->total );
         release_object( key );
     }
@@ -2337,3 +3312,26 @@ DECL_HANDLER(set_registry_notification)
         release_object( key );
     }
 }
+
+/* retrieve the mapping of key generations */
+DECL_HANDLER(get_registry_cache)
+{
+    data_size_t size = REGISTRY_GEN_SLOTS * sizeof(*key_generations);
+    void *ptr;
+
+    if (key_generations_fd == -1)
+    {
+        if ((key_generations_fd = create_temp_file( size )) == -1) return;
+        ptr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, key_generations_fd, 0 );
+        if (ptr == MAP_FAILED)
+        {
+            file_set_error();
+            close( key_generations_fd );
+            key_generations_fd = -1;
+            return;
+        }
+        key_generations = ptr;
+    }
+    reply->size = size;
+    send_client_fd( current->process, key_generations_fd, 0 );
+}
@@ -69,6 +69,7 @@
 #include "handle.h"
 #define WANT_REQUEST_HANDLERS
 #include "request.h"
+#include "fsync.h"
 
 /* Some versions of glibc don't define this */
 #ifndef SCM_RIGHTS
@@ -79,6 +80,9 @@
 static const char * const server_socket_name = "socket";   /* name of the socket file */
 static const char * const server_lock_name = "lock";       /* name of the server lock file */
 
+/* max number of queued requests handled for a thread before going back to the main loop */
+#define MAX_BATCHED_REQUESTS 16
+
 struct master_socket
 {
     struct object        obj;        /* object header */
@@ -302,6 +306,8 @@ static void call_req_handler( struct thread *thread )
 {
     union generic_reply reply;
     enum request req = thread->req.request_header.req;
+    /* decide before calling the handler, so that enabling the shm block doesn't apply to its own reply */
+    int shm_reply = thread->fsync_reply && thread->req.request_header.reply_size <= SHM_REPLY_MAX_DATA;
 
     current = thread;
     current->reply_size = 0;
@@ -322,7 +328,13 @@ static void call_req_handler( struct thread *thread )
             reply.reply_header.error = current->error;
             reply.reply_header.reply_size = current->reply_size;
             if (debug_level) trace_reply( req, &reply );
-            send_reply( &reply );
+            if (shm_reply && current->fsync_reply)
+            {
+                fsync_send_reply( current, &reply, sizeof(reply), current->reply_data, current->reply_size );
+                free( current->reply_data );
+                current->reply_data = NULL;
+            }
+            else send_reply( &reply );
         }
         else
         {
@@ -333,8 +345,8 @@ static void call_req_handler( struct thread *thread )
     current = NULL;
 }
 
-/* read a request from a thread */
-void read_request( struct thread *thread )
+/* read a request from a thread; returns 1 if a request was handled */
+static int read_one_request( struct thread *thread )
 {
     int ret;
 
@@ -346,13 +358,13 @@ void read_request( struct thread *thread )
         {
             /* no data, handle request at once */
             call_req_handler( thread );
-            return;
+            return 1;
         }
         if (!(thread->req_data = malloc( thread->req_toread )))
         {
             fatal_protocol_error( thread, "no memory for %u bytes request %d\n",
                                   thread->req_toread, thread->req.request_header.req );
-            return;
+            return 0;
         }
     }
 
@@ -369,7 +381,7 @@ void read_request( struct thread *thread )
             call_req_handler( thread );
             free( thread->req_data );
             thread->req_data = NULL;
-            return;
+            return 1;
         }
     }
 
@@ -380,6 +392,19 @@ error:
         fatal_protocol_error( thread, "partial read %d\n", ret );
     else if (errno != EWOULDBLOCK && (EWOULDBLOCK == EAGAIN || errno != EAGAIN))
         fatal_protocol_error( thread, "read: %s\n", strerror( errno ));
+    return 0;
+}
+
+/* read requests from a thread, handling at once the ones that are already queued in the pipe */
+void read_request( struct thread *thread )
+{
+    unsigned int count = 0;
+
+    while (read_one_request( thread ) && ++count < MAX_BATCHED_REQUESTS)
+    {
+        /* stop if the thread is gone or is still waiting for the end of a reply */
+        if (!thread->request_fd || thread->reply_towrite) break;
+    }
 }
 
 /* receive a file descriptor on the process socket */
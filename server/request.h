@@ -207,6 +207,7 @@ DECL_HANDLER(flush_key);
 DECL_HANDLER(enum_key);
 DECL_HANDLER(set_key_value);
 DECL_HANDLER(get_key_value);
+DECL_HANDLER(get_registry_cache);
 DECL_HANDLER(enum_key_value);
 DECL_HANDLER(delete_key_value);
 DECL_HANDLER(load_registry);
@@ -305,7 +306,6 @@ DECL_HANDLER(set_active_window);
 DECL_HANDLER(set_capture_window);
 DECL_HANDLER(set_caret_window);
 DECL_HANDLER(set_caret_info);
-DECL_HANDLER(get_active_hooks);
 DECL_HANDLER(set_hook);
 DECL_HANDLER(remove_hook);
 DECL_HANDLER(start_hook_chain);
@@ -404,6 +404,8 @@ DECL_HANDLER(open_fsync);
 DECL_HANDLER(get_fsync_idx);
 DECL_HANDLER(fsync_msgwait);
 DECL_HANDLER(get_fsync_apc_idx);
+DECL_HANDLER(get_fsync_reply_idx);
+DECL_HANDLER(set_fsync_reply);
 DECL_HANDLER(get_next_thread);
 DECL_HANDLER(prevent_kill);
 
@@ -500,6 +502,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_enum_key,
     (req_handler)req_set_key_value,
     (req_handler)req_get_key_value,
+    (req_handler)req_get_registry_cache,
     (req_handler)req_enum_key_value,
     (req_handler)req_delete_key_value,
     (req_handler)req_load_registry,
@@ -598,7 +601,6 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_set_capture_window,
     (req_handler)req_set_caret_window,
     (req_handler)req_set_caret_info,
-    (req_handler)req_get_active_hooks,
     (req_handler)req_set_hook,
     (req_handler)req_remove_hook,
     (req_handler)req_start_hook_chain,
@@ -697,6 +699,8 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_get_fsync_idx,
     (req_handler)req_fsync_msgwait,
     (req_handler)req_get_fsync_apc_idx,
+    (req_handler)req_get_fsync_reply_idx,
+    (req_handler)req_set_fsync_reply,
     (req_handler)req_get_next_thread,
     (req_handler)req_prevent_kill,
 };
@@ -1246,7 +1250,12 @@ C_ASSERT( FIELD_OFFSET(struct get_key_value_request, hkey) == 12 );
 C_ASSERT( sizeof(struct get_key_value_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_key_value_reply, type) == 8 );
 C_ASSERT( FIELD_OFFSET(struct get_key_value_reply, total) == 12 );
-C_ASSERT( sizeof(struct get_key_value_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_key_value_reply, gen_slot) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_key_value_reply, generation) == 20 );
+C_ASSERT( sizeof(struct get_key_value_reply) == 24 );
+C_ASSERT( sizeof(struct get_registry_cache_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_registry_cache_reply, size) == 8 );
+C_ASSERT( sizeof(struct get_registry_cache_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct enum_key_value_request, hkey) == 12 );
 C_ASSERT( FIELD_OFFSET(struct enum_key_value_request, index) == 16 );
 C_ASSERT( FIELD_OFFSET(struct enum_key_value_request, info_class) == 20 );
@@ -1331,6 +1340,7 @@ C_ASSERT( FIELD_OFFSET(struct get_atom_information_reply, total) == 16 );
 C_ASSERT( sizeof(struct get_atom_information_reply) == 24 );
 C_ASSERT( sizeof(struct get_msg_queue_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_msg_queue_reply, handle) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_msg_queue_reply, shared) == 12 );
 C_ASSERT( sizeof(struct get_msg_queue_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_queue_fd_request, handle) == 12 );
 C_ASSERT( sizeof(struct set_queue_fd_request) == 16 );
@@ -1387,7 +1397,8 @@ C_ASSERT( FIELD_OFFSET(struct get_message_reply, type) == 32 );
 C_ASSERT( FIELD_OFFSET(struct get_message_reply, x) == 36 );
 C_ASSERT( FIELD_OFFSET(struct get_message_reply, y) == 40 );
 C_ASSERT( FIELD_OFFSET(struct get_message_reply, time) == 44 );
-C_ASSERT( FIELD_OFFSET(struct get_message_reply, total) == 48 );
+C_ASSERT( FIELD_OFFSET(struct get_message_reply, active_hooks) == 48 );
+C_ASSERT( FIELD_OFFSET(struct get_message_reply, total) == 52 );
 C_ASSERT( sizeof(struct get_message_reply) == 56 );
 C_ASSERT( FIELD_OFFSET(struct reply_message_request, remove) == 12 );
 C_ASSERT( FIELD_OFFSET(struct reply_message_request, result) == 16 );
@@ -1702,6 +1713,7 @@ C_ASSERT( sizeof(struct close_desktop_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_thread_desktop_request, tid) == 12 );
 C_ASSERT( sizeof(struct get_thread_desktop_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_thread_desktop_reply, handle) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_thread_desktop_reply, shared) == 12 );
 C_ASSERT( sizeof(struct get_thread_desktop_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_thread_desktop_request, handle) == 12 );
 C_ASSERT( sizeof(struct set_thread_desktop_request) == 16 );
@@ -1741,11 +1753,14 @@ C_ASSERT( sizeof(struct get_thread_input_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_thread_input_reply, focus) == 8 );
 C_ASSERT( FIELD_OFFSET(struct get_thread_input_reply, capture) == 12 );
 C_ASSERT( FIELD_OFFSET(struct get_thread_input_reply, active) == 16 );
-C_ASSERT( FIELD_OFFSET(struct get_thread_input_reply, menu_owner) == 20 );
-C_ASSERT( FIELD_OFFSET(struct get_thread_input_reply, move_size) == 24 );
-C_ASSERT( FIELD_OFFSET(struct get_thread_input_reply, caret) == 28 );
-C_ASSERT( FIELD_OFFSET(struct get_thread_input_reply, rect) == 32 );
-C_ASSERT( sizeof(struct get_thread_input_reply) == 48 );
+C_ASSERT( FIELD_OFFSET(struct get_thread_input_reply, foreground) == 20 );
+C_ASSERT( FIELD_OFFSET(struct get_thread_input_reply, menu_owner) == 24 );
+C_ASSERT( FIELD_OFFSET(struct get_thread_input_reply, move_size) == 28 );
+C_ASSERT( FIELD_OFFSET(struct get_thread_input_reply, caret) == 32 );
+C_ASSERT( FIELD_OFFSET(struct get_thread_input_reply, cursor) == 36 );
+C_ASSERT( FIELD_OFFSET(struct get_thread_input_reply, show_count) == 40 );
+C_ASSERT( FIELD_OFFSET(struct get_thread_input_reply, rect) == 44 );
+C_ASSERT( sizeof(struct get_thread_input_reply) == 64 );
 C_ASSERT( sizeof(struct get_last_input_time_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_last_input_time_reply, time) == 8 );
 C_ASSERT( sizeof(struct get_last_input_time_reply) == 16 );
@@ -1797,9 +1812,6 @@ C_ASSERT( FIELD_OFFSET(struct set_caret_info_reply, old_rect) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_caret_info_reply, old_hide) == 28 );
 C_ASSERT( FIELD_OFFSET(struct set_caret_info_reply, old_state) == 32 );
 C_ASSERT( sizeof(struct set_caret_info_reply) == 40 );
-C_ASSERT( sizeof(struct get_active_hooks_request) == 16 );
-C_ASSERT( FIELD_OFFSET(struct get_active_hooks_reply, active_hooks) == 8 );
-C_ASSERT( sizeof(struct get_active_hooks_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_hook_request, id) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_hook_request, pid) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_hook_request, tid) == 20 );
@@ -2317,6 +2329,11 @@ C_ASSERT( sizeof(struct fsync_msgwait_request) == 16 );
 C_ASSERT( sizeof(struct get_fsync_apc_idx_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_fsync_apc_idx_reply, shm_idx) == 8 );
 C_ASSERT( sizeof(struct get_fsync_apc_idx_reply) == 16 );
+C_ASSERT( sizeof(struct get_fsync_reply_idx_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_fsync_reply_idx_reply, shm_idx) == 8 );
+C_ASSERT( sizeof(struct get_fsync_reply_idx_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct set_fsync_reply_request, enable) == 12 );
+C_ASSERT( sizeof(struct set_fsync_reply_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_next_thread_request, process) == 12 );
 C_ASSERT( FIELD_OFFSET(struct get_next_thread_request, last) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_next_thread_request, access) == 20 );
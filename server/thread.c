@@ -277,6 +277,8 @@ static inline void init_thread_structure( struct thread *thread )
     thread->esync_fd        = -1;
     thread->esync_apc_fd    = -1;
     thread->fsync_idx       = 0;
+    thread->fsync_reply_idx = 0;
+    thread->fsync_reply     = NULL;
     thread->system_regs     = 0;
     thread->queue           = NULL;
     thread->wait            = NULL;
@@ -468,6 +470,7 @@ static void cleanup_thread( struct thread *thread )
     clear_apc_queue( &thread->user_apc );
     free( thread->req_data );
     free( thread->reply_data );
+    if (do_fsync()) fsync_close_reply( thread );
     if (thread->request_fd) release_object( thread->request_fd );
     if (thread->reply_fd) release_object( thread->reply_fd );
     if (thread->wait_fd) release_object( thread->wait_fd );
@@ -508,6 +511,8 @@ static void destroy_thread( struct object *obj )
 
     if (do_esync())
         close( thread->esync_fd );
+    if (do_fsync())
+        fsync_free_shm_block( thread->fsync_reply_idx, thread->unix_pid, thread->unix_tid );
 }
 
 /* dump a thread on stdout for debugging purposes */
@@ -58,6 +58,8 @@ struct thread
     int                    esync_apc_fd;  /* esync apc fd (signalled when APCs are present) */
     unsigned int           fsync_idx;
     unsigned int           fsync_apc_idx;
+    unsigned int           fsync_reply_idx; /* shm block receiving replies, if any */
+    void                  *fsync_reply;   /* mapping of the reply block */
     unsigned int           system_regs;   /* which system regs have been set */
     struct msg_queue      *queue;         /* message queue */
     struct thread_wait    *wait;          /* current wait condition if sleeping */
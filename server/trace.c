@@ -2409,9 +2409,20 @@ static void dump_get_key_value_reply( const struct get_key_value_reply *req )
 {
     fprintf( stderr, " type=%d", req->type );
     fprintf( stderr, ", total=%u", req->total );
+    fprintf( stderr, ", gen_slot=%08x", req->gen_slot );
+    fprintf( stderr, ", generation=%08x", req->generation );
     dump_varargs_bytes( ", data=", cur_size );
 }
 
+static void dump_get_registry_cache_request( const struct get_registry_cache_request *req )
+{
+}
+
+static void dump_get_registry_cache_reply( const struct get_registry_cache_reply *req )
+{
+    fprintf( stderr, " size=%u", req->size );
+}
+
 static void dump_enum_key_value_request( const struct enum_key_value_request *req )
 {
     fprintf( stderr, " hkey=%04x", req->hkey );
@@ -2603,6 +2614,7 @@ static void dump_get_msg_queue_request( const struct get_msg_queue_request *req
 static void dump_get_msg_queue_reply( const struct get_msg_queue_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", shared=%08x", req->shared );
 }
 
 static void dump_set_queue_fd_request( const struct set_queue_fd_request *req )
@@ -2677,6 +2689,7 @@ static void dump_send_hardware_message_reply( const struct send_hardware_message
     fprintf( stderr, ", prev_y=%d", req->prev_y );
     fprintf( stderr, ", new_x=%d", req->new_x );
     fprintf( stderr, ", new_y=%d", req->new_y );
+    dump_varargs_bytes( ", keystate=", cur_size );
 }
 
 static void dump_get_message_request( const struct get_message_request *req )
@@ -2700,6 +2713,7 @@ static void dump_get_message_reply( const struct get_message_reply *req )
     fprintf( stderr, ", x=%d", req->x );
     fprintf( stderr, ", y=%d", req->y );
     fprintf( stderr, ", time=%08x", req->time );
+    fprintf( stderr, ", active_hooks=%08x", req->active_hooks );
     fprintf( stderr, ", total=%u", req->total );
     dump_varargs_message_data( ", data=", cur_size );
 }
@@ -3327,6 +3341,7 @@ static void dump_get_thread_desktop_request( const struct get_thread_desktop_req
 static void dump_get_thread_desktop_reply( const struct get_thread_desktop_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", shared=%08x", req->shared );
 }
 
 static void dump_set_thread_desktop_request( const struct set_thread_desktop_request *req )
@@ -3404,9 +3419,12 @@ static void dump_get_thread_input_reply( const struct get_thread_input_reply *re
     fprintf( stderr, " focus=%08x", req->focus );
     fprintf( stderr, ", capture=%08x", req->capture );
     fprintf( stderr, ", active=%08x", req->active );
+    fprintf( stderr, ", foreground=%08x", req->foreground );
     fprintf( stderr, ", menu_owner=%08x", req->menu_owner );
     fprintf( stderr, ", move_size=%08x", req->move_size );
     fprintf( stderr, ", caret=%08x", req->caret );
+    fprintf( stderr, ", cursor=%08x", req->cursor );
+    fprintf( stderr, ", show_count=%d", req->show_count );
     dump_rectangle( ", rect=", &req->rect );
 }
 
@@ -3514,15 +3532,6 @@ static void dump_set_caret_info_reply( const struct set_caret_info_reply *req )
     fprintf( stderr, ", old_state=%d", req->old_state );
 }
 
-static void dump_get_active_hooks_request( const struct get_active_hooks_request *req )
-{
-}
-
-static void dump_get_active_hooks_reply( const struct get_active_hooks_reply *req )
-{
-    fprintf( stderr, " active_hooks=%08x", req->active_hooks );
-}
-
 static void dump_set_hook_request( const struct set_hook_request *req )
 {
     fprintf( stderr, " id=%d", req->id );
@@ -4591,6 +4600,20 @@ static void dump_get_fsync_apc_idx_reply( const struct get_fsync_apc_idx_reply *
     fprintf( stderr, " shm_idx=%08x", req->shm_idx );
 }
 
+static void dump_get_fsync_reply_idx_request( const struct get_fsync_reply_idx_request *req )
+{
+}
+
+static void dump_get_fsync_reply_idx_reply( const struct get_fsync_reply_idx_reply *req )
+{
+    fprintf( stderr, " shm_idx=%08x", req->shm_idx );
+}
+
+static void dump_set_fsync_reply_request( const struct set_fsync_reply_request *req )
+{
+    fprintf( stderr, " enable=%d", req->enable );
+}
+
 static void dump_get_next_thread_request( const struct get_next_thread_request *req )
 {
     fprintf( stderr, " process=%04x", req->process );
@@ -4698,6 +4721,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_enum_key_request,
     (dump_func)dump_set_key_value_request,
     (dump_func)dump_get_key_value_request,
+    (dump_func)dump_get_registry_cache_request,
     (dump_func)dump_enum_key_value_request,
     (dump_func)dump_delete_key_value_request,
     (dump_func)dump_load_registry_request,
@@ -4796,7 +4820,6 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_set_capture_window_request,
     (dump_func)dump_set_caret_window_request,
     (dump_func)dump_set_caret_info_request,
-    (dump_func)dump_get_active_hooks_request,
     (dump_func)dump_set_hook_request,
     (dump_func)dump_remove_hook_request,
     (dump_func)dump_start_hook_chain_request,
@@ -4895,6 +4918,8 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_fsync_idx_request,
     (dump_func)dump_fsync_msgwait_request,
     (dump_func)dump_get_fsync_apc_idx_request,
+    (dump_func)dump_get_fsync_reply_idx_request,
+    (dump_func)dump_set_fsync_reply_request,
     (dump_func)dump_get_next_thread_request,
     (dump_func)dump_prevent_kill_request,
 };
@@ -4988,6 +5013,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_enum_key_reply,
     NULL,
     (dump_func)dump_get_key_value_reply,
+    (dump_func)dump_get_registry_cache_reply,
     (dump_func)dump_enum_key_value_reply,
     NULL,
     NULL,
@@ -5086,7 +5112,6 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_set_capture_window_reply,
     (dump_func)dump_set_caret_window_reply,
     (dump_func)dump_set_caret_info_reply,
-    (dump_func)dump_get_active_hooks_reply,
     (dump_func)dump_set_hook_reply,
     (dump_func)dump_remove_hook_reply,
     (dump_func)dump_start_hook_chain_reply,
@@ -5185,6 +5210,8 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_fsync_idx_reply,
     NULL,
     (dump_func)dump_get_fsync_apc_idx_reply,
+    (dump_func)dump_get_fsync_reply_idx_reply,
+    NULL,
     (dump_func)dump_get_next_thread_reply,
     NULL,
 };
@@ -5278,6 +5305,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "enum_key",
     "set_key_value",
     "get_key_value",
+    "get_registry_cache",
     "enum_key_value",
     "delete_key_value",
     "load_registry",
@@ -5376,7 +5404,6 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "set_capture_window",
     "set_caret_window",
     "set_caret_info",
-    "get_active_hooks",
     "set_hook",
     "remove_hook",
     "start_hook_chain",
@@ -5475,6 +5502,8 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "get_fsync_idx",
     "fsync_msgwait",
     "get_fsync_apc_idx",
+    "get_fsync_reply_idx",
+    "set_fsync_reply",
     "get_next_thread",
     "prevent_kill",
 };
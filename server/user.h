@@ -76,9 +76,25 @@ struct desktop
     struct thread_input *foreground_input; /* thread input of foreground thread */
     unsigned int         users;            /* processes and threads using this desktop */
     struct global_cursor cursor;           /* global cursor information */
-    unsigned char        keystate[256];    /* asynchronous key state */
+    unsigned char       *keystate;         /* asynchronous key state, in the shared desktop state */
+    struct desktop_shared_memory *shared;  /* desktop state shared with the clients */
+    unsigned int         shared_idx;       /* index in the shared desktop mapping, ~0 if private */
 };
 
+/* update functions for the state mirrored in the shared desktop and window
+ * mappings; readers retry while the sequence number is odd or has changed */
+
+static inline void shared_write_begin( unsigned int *seq )
+{
+    __atomic_store_n( seq, *seq + 1, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+}
+
+static inline void shared_write_end( unsigned int *seq )
+{
+    __atomic_store_n( seq, *seq + 1, __ATOMIC_RELEASE );
+}
+
 /* user handles functions */
 
 extern user_handle_t alloc_user_handle( void *ptr, enum user_object type );
@@ -36,6 +36,7 @@
 #include "request.h"
 #include "thread.h"
 #include "process.h"
+#include "file.h"
 #include "user.h"
 #include "unicode.h"
 
@@ -144,6 +145,43 @@ static inline int is_desktop_window( const struct window *win )
     return !win->parent;  /* only desktop windows have no parent */
 }
 
+struct window_shared_memory *window_shared_data = NULL;
+
+/* mirror the window state into the shared window mapping */
+static void update_window_shared( struct window *win )
+{
+    struct window_shared_memory *shared;
+
+    if (!window_shared_data) return;
+    shared = &window_shared_data[((win->handle & 0xffff) - FIRST_USER_HANDLE) >> 1];
+    shared_write_begin( &shared->seq );
+    shared->handle   = win->handle;
+    shared->parent   = win->parent ? win->parent->handle : 0;
+    shared->owner    = win->owner;
+    shared->tid      = win->thread ? get_thread_id( win->thread ) : 0;
+    shared->pid      = win->thread ? get_process_id( win->thread->process ) : 0;
+    shared->style    = win->style;
+    shared->ex_style = win->ex_style;
+    shared->id       = win->id;
+    shared->dpi      = win->dpi;
+    shared->instance = win->instance;
+    shared->window   = win->window_rect;
+    shared->client   = win->client_rect;
+    shared_write_end( &shared->seq );
+}
+
+/* remove a destroyed window from the shared window mapping */
+static void free_window_shared( struct window *win )
+{
+    struct window_shared_memory *shared;
+
+    if (!window_shared_data) return;
+    shared = &window_shared_data[((win->handle & 0xffff) - FIRST_USER_HANDLE) >> 1];
+    shared_write_begin( &shared->seq );
+    shared->handle = 0;
+    shared_write_end( &shared->seq );
+}
+
 /* get next window in Z-order list */
 static inline struct window *get_next_window( struct window *win )
 {
@@ -241,6 +279,7 @@ static void link_window( struct window *win, struct window *previous )
     }
 
     win->is_linked = 1;
+    update_window_shared( win );
 }
 
 /* change the parent of a window (or unlink the window if the new parent is NULL) */
@@ -283,6 +322,7 @@ static int set_parent_window( struct window *win, struct window *parent )
         list_add_head( &win->parent->unlinked, &win->entry );
         win->is_linked = 0;
     }
+    update_window_shared( win );
     return 1;
 }
 
@@ -421,6 +461,7 @@ static void detach_window_thread( struct window *win )
     /* destroyed when the desktop ref count reaches zero */
     release_object( win->desktop );
     win->thread = NULL;
+    update_window_shared( win );
 }
 
 /* get the process owning the top window of a given desktop */
@@ -548,6 +589,7 @@ static struct window *create_window( struct window *parent, struct window *owner
     }
 
     current->desktop_users++;
+    update_window_shared( win );
     return win;
 
 failed:
@@ -1702,6 +1744,7 @@ static void set_window_pos( struct window *win, struct window *previous,
     if (!(swp_flags & SWP_NOZORDER) && win->parent) link_window( win, previous );
     if (swp_flags & SWP_SHOWWINDOW) win->style |= WS_VISIBLE;
     else if (swp_flags & SWP_HIDEWINDOW) win->style &= ~WS_VISIBLE;
+    update_window_shared( win );
 
     /* keep children at the same position relative to top right corner when the parent is mirrored */
     if (win->ex_style & WS_EX_LAYOUTRTL)
@@ -1716,6 +1759,7 @@ static void set_window_pos( struct window *win, struct window *previous,
             offset_rect( &child->visible_rect, new_size - old_size, 0 );
             offset_rect( &child->surface_rect, new_size - old_size, 0 );
             offset_rect( &child->client_rect, new_size - old_size, 0 );
+            update_window_shared( child );
         }
     }
 
@@ -1901,6 +1945,7 @@ void destroy_window( struct window *win )
     if (win == taskman_window) taskman_window = NULL;
     free_hotkeys( win->desktop, win->handle );
     cleanup_clipboard_window( win->desktop, win->handle );
+    free_window_shared( win );
     free_user_handle( win->handle );
     destroy_properties( win );
     list_remove( &win->entry );
@@ -1965,6 +2010,7 @@ DECL_HANDLER(create_window)
         win->dpi_awareness = req->awareness;
         win->dpi = req->dpi;
     }
+    update_window_shared( win );
 
     reply->handle    = win->handle;
     reply->parent    = win->parent ? win->parent->handle : 0;
@@ -2027,6 +2073,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->top_window );
             desktop->top_window->style  = WS_POPUP | WS_VISIBLE | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_window_shared( desktop->top_window );
         }
     }
 
@@ -2039,6 +2086,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->msg_window );
             desktop->msg_window->style = WS_POPUP | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_window_shared( desktop->msg_window );
         }
     }
 
@@ -2074,6 +2122,7 @@ DECL_HANDLER(set_window_owner)
 
     reply->prev_owner = win->owner;
     reply->full_owner = win->owner = owner ? owner->handle : 0;
+    update_window_shared( win );
 }
 
 
@@ -2148,6 +2197,7 @@ DECL_HANDLER(set_window_info)
 
     /* changing window style triggers a non-client paint */
     if (req->flags & SET_WIN_STYLE) win->paint_flags |= PAINT_NONCLIENT;
+    if (req->flags) update_window_shared( win );
 }
 
 
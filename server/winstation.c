@@ -220,6 +220,33 @@ struct desktop *get_desktop_obj( struct process *process, obj_handle_t handle, u
     return (struct desktop *)get_handle_obj( process, handle, access, &desktop_ops );
 }
 
+struct desktop_shared_memory *desktop_shared_data = NULL;
+static unsigned char desktop_shared_used[DESKTOP_SHARED_MAX_DESKTOPS];
+
+/* allocate the shared state of a desktop, in the shared mapping if possible */
+static int alloc_desktop_shared( struct desktop *desktop )
+{
+    unsigned int i;
+
+    for (i = 0; desktop_shared_data && i < DESKTOP_SHARED_MAX_DESKTOPS; i++)
+    {
+        if (desktop_shared_used[i]) continue;
+        desktop_shared_used[i] = 1;
+        desktop->shared_idx = i;
+        desktop->shared = &desktop_shared_data[i];
+        return 1;
+    }
+    desktop->shared_idx = ~0u;
+    return (desktop->shared = mem_alloc( sizeof(*desktop->shared) )) != NULL;
+}
+
+/* free the shared state of a desktop */
+static void free_desktop_shared( struct desktop *desktop )
+{
+    if (desktop->shared_idx != ~0u) desktop_shared_used[desktop->shared_idx] = 0;
+    else free( desktop->shared );
+}
+
 /* create a desktop object */
 static struct desktop *create_desktop( const struct unicode_str *name, unsigned int attr,
                                        unsigned int flags, struct winstation *winstation )
@@ -239,10 +266,18 @@ static struct desktop *create_desktop( const struct unicode_str *name, unsigned
             desktop->close_timeout = NULL;
             desktop->foreground_input = NULL;
             desktop->users = 0;
+            desktop->shared = NULL;
+            desktop->shared_idx = ~0u;
             memset( &desktop->cursor, 0, sizeof(desktop->cursor) );
-            memset( desktop->keystate, 0, sizeof(desktop->keystate) );
             list_add_tail( &winstation->desktops, &desktop->entry );
             list_init( &desktop->hotkeys );
+            if (!alloc_desktop_shared( desktop ))
+            {
+                release_object( desktop );
+                return NULL;
+            }
+            memset( desktop->shared, 0, sizeof(*desktop->shared) );
+            desktop->keystate = desktop->shared->keystate;
         }
         else clear_error();
     }
@@ -297,6 +332,7 @@ static void desktop_destroy( struct object *obj )
     if (desktop->close_timeout) remove_timeout_user( desktop->close_timeout );
     list_remove( &desktop->entry );
     release_object( desktop->winstation );
+    free_desktop_shared( desktop );
 }
 
 /* retrieve the thread desktop, checking the handle access rights */
@@ -590,9 +626,17 @@ DECL_HANDLER(close_desktop)
 DECL_HANDLER(get_thread_desktop)
 {
     struct thread *thread;
+    struct desktop *desktop;
 
     if (!(thread = get_thread_from_id( req->tid ))) return;
     reply->handle = thread->desktop;
+    reply->shared = ~0u;
+    if (thread->desktop && (desktop = get_desktop_obj( thread->process, thread->desktop, 0 )))
+    {
+        reply->shared = desktop->shared_idx;
+        release_object( desktop );
+    }
+    else clear_error();
     release_object( thread );
 }
 
@@ -268,6 +268,8 @@ dumpers[] =
     {SIG_FNT,           get_kind_fnt,   fnt_dump},
     {SIG_TLB,           get_kind_tlb,   tlb_dump},
     {SIG_NLS,           get_kind_nls,   nls_dump},
+    {SIG_RELAY,         get_kind_relay, relay_dump},
+    {SIG_PROFILE,       get_kind_profile, profile_dump},
     {SIG_UNKNOWN,       NULL,           NULL} /* sentinel */
 };
 
@@ -0,0 +1,280 @@
+/*
+ * Dump a sampling profiler file
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "windef.h"
+#include "winbase.h"
+#include "winedump.h"
+#include "wine/profile_record.h"
+
+struct profile_export
+{
+    DWORD       rva;
+    const char *name;
+};
+
+struct profile_module
+{
+    const struct profile_record_module *rec;
+    const char                         *name;
+    struct profile_export              *exports;
+};
+
+struct profile_stack
+{
+    char         *str;
+    unsigned int  count;
+};
+
+static struct profile_module *modules;
+static unsigned int nb_modules;
+static struct profile_stack *stacks;
+static unsigned int nb_stacks, max_stacks;
+
+static void *xrealloc( void *ptr, size_t size )
+{
+    if (!(ptr = realloc( ptr, size ))) fatal( "Out of memory" );
+    return ptr;
+}
+
+static int compare_exports( const void *p1, const void *p2 )
+{
+    const struct profile_export *e1 = p1, *e2 = p2;
+
+    if (e1->rva != e2->rva) return e1->rva < e2->rva ? -1 : 1;
+    return strcmp( e1->name, e2->name );
+}
+
+static void add_module( const struct profile_record_module *rec )
+{
+    const DWORD *rvas = (const DWORD *)(rec + 1);
+    const char *p = (const char *)(rvas + rec->nb_exports), *end = (const char *)rec + rec->hdr.size;
+    struct profile_module *module;
+    unsigned int i;
+
+    if (p >= end || !memchr( p, 0, end - p )) return;
+
+    modules = xrealloc( modules, (nb_modules + 1) * sizeof(*modules) );
+    module = &modules[nb_modules++];
+    module->rec = rec;
+    module->name = *p ? p : "<noname>";
+    module->exports = xrealloc( NULL, rec->nb_exports * sizeof(*module->exports) + 1 );
+    p += strlen( p ) + 1;
+    for (i = 0; i < rec->nb_exports; i++)
+    {
+        module->exports[i].rva = rvas[i];
+        if (p < end && memchr( p, 0, end - p ))
+        {
+            module->exports[i].name = p;
+            p += strlen( p ) + 1;
+        }
+        else module->exports[i].name = "";
+    }
+    qsort( module->exports, rec->nb_exports, sizeof(*module->exports), compare_exports );
+}
+
+static const struct profile_module *find_module( DWORD id )
+{
+    unsigned int i;
+
+    for (i = 0; i < nb_modules; i++) if (modules[i].rec->id == id) return &modules[i];
+    return NULL;
+}
+
+static const char *get_frame_name( const struct profile_record_frame *frame, BOOL syscall )
+{
+    static char buffer[256];
+    const struct profile_module *module = frame->module ? find_module( frame->module ) : NULL;
+    DWORD rva = frame->function ? frame->function : frame->address;
+    int min, max, pos, found = -1;
+
+    if (!module) return syscall ? "[unix]" : "[unknown]";
+
+    /* find the closest export before the function */
+    min = 0;
+    max = module->rec->nb_exports - 1;
+    while (min <= max)
+    {
+        pos = (min + max) / 2;
+        if (module->exports[pos].rva <= rva)
+        {
+            found = pos;
+            min = pos + 1;
+        }
+        else max = pos - 1;
+    }
+    /* prefer the first name exported at that address */
+    while (found > 0 && module->exports[found - 1].rva == module->exports[found].rva) found--;
+
+    if (found == -1)
+        snprintf( buffer, sizeof(buffer), "%s!0x%x", module->name, rva );
+    else if (module->exports[found].rva == rva)
+        snprintf( buffer, sizeof(buffer), "%s!%s", module->name, module->exports[found].name );
+    else
+        snprintf( buffer, sizeof(buffer), "%s!%s+0x%x", module->name, module->exports[found].name,
+                  rva - module->exports[found].rva );
+    return buffer;
+}
+
+static void add_sample( const struct profile_record_sample *sample )
+{
+    const struct profile_record_frame *frames = (const struct profile_record_frame *)(sample + 1);
+    size_t len = 0;
+    char *str = NULL;
+    int i;
+
+    /* folded stacks start with the outermost frame */
+    for (i = sample->count - 1; i >= 0; i--)
+    {
+        const char *name = get_frame_name( &frames[i], i == 0 && sample->count > 1 );
+        size_t name_len = strlen( name );
+
+        str = xrealloc( str, len + name_len + 2 );
+        if (len) str[len++] = ';';
+        memcpy( str + len, name, name_len + 1 );
+        len += name_len;
+    }
+    if (!str) return;
+
+    if (nb_stacks == max_stacks)
+    {
+        max_stacks = max( 256, max_stacks * 2 );
+        stacks = xrealloc( stacks, max_stacks * sizeof(*stacks) );
+    }
+    stacks[nb_stacks].str = str;
+    stacks[nb_stacks].count = 1;
+    nb_stacks++;
+}
+
+static int compare_stack_names( const void *p1, const void *p2 )
+{
+    const struct profile_stack *s1 = p1, *s2 = p2;
+    return strcmp( s1->str, s2->str );
+}
+
+static int compare_stack_counts( const void *p1, const void *p2 )
+{
+    const struct profile_stack *s1 = p1, *s2 = p2;
+
+    if (s1->count != s2->count) return s1->count > s2->count ? -1 : 1;
+    return strcmp( s1->str, s2->str );
+}
+
+/* merge identical entries, adding up their counts */
+static void merge_stacks(void)
+{
+    unsigned int i, count = 0;
+
+    qsort( stacks, nb_stacks, sizeof(*stacks), compare_stack_names );
+    for (i = 0; i < nb_stacks; i++)
+    {
+        if (count && !strcmp( stacks[count - 1].str, stacks[i].str ))
+        {
+            stacks[count - 1].count += stacks[i].count;
+            free( stacks[i].str );
+        }
+        else stacks[count++] = stacks[i];
+    }
+    nb_stacks = count;
+    qsort( stacks, nb_stacks, sizeof(*stacks), compare_stack_counts );
+}
+
+/* replace each stack by its innermost function */
+static void keep_leaf_functions(void)
+{
+    unsigned int i;
+    char *p;
+
+    for (i = 0; i < nb_stacks; i++)
+        if ((p = strrchr( stacks[i].str, ';' ))) memmove( stacks[i].str, p + 1, strlen( p + 1 ) + 1 );
+}
+
+enum FileSig get_kind_profile(void)
+{
+    const struct profile_record_header *hdr = PRD( 0, sizeof(*hdr) );
+
+    if (hdr && hdr->magic == PROFILE_RECORD_MAGIC) return SIG_PROFILE;
+    return SIG_UNKNOWN;
+}
+
+void profile_dump(void)
+{
+    const struct profile_record_header *header = PRD( 0, sizeof(*header) );
+    const struct profile_record_block *block;
+    unsigned int i, total;
+    unsigned long pos;
+
+    printf( "Profile of process %04x, version %u, interval %u us\n\n",
+            header->pid, header->version, header->interval );
+    if (header->version != PROFILE_RECORD_VERSION)
+    {
+        printf( "Unsupported version\n" );
+        return;
+    }
+
+    for (pos = sizeof(*header); (block = PRD( pos, sizeof(*block) )); pos += block->size)
+    {
+        if (block->size < sizeof(*block) || !PRD( pos, block->size ))
+        {
+            printf( "Truncated block at %lx\n", pos );
+            break;
+        }
+        switch (block->type)
+        {
+        case PROFILE_RECORD_MODULE:
+            if (block->size >= sizeof(struct profile_record_module))
+                add_module( (const struct profile_record_module *)block );
+            break;
+        case PROFILE_RECORD_SAMPLE:
+        {
+            const struct profile_record_sample *sample = (const struct profile_record_sample *)block;
+            if (block->size >= sizeof(*sample) + sample->count * sizeof(struct profile_record_frame))
+                add_sample( sample );
+            break;
+        }
+        default:
+            printf( "Unknown block type %u at %lx\n", block->type, pos );
+            break;
+        }
+    }
+
+    if (globals.do_dumpheader)
+    {
+        /* flat profile of the functions the samples landed in */
+        keep_leaf_functions();
+        merge_stacks();
+        for (i = total = 0; i < nb_stacks; i++) total += stacks[i].count;
+        printf( "%10s %7s  %s\n", "Samples", "%", "Function" );
+        for (i = 0; i < nb_stacks; i++)
+            printf( "%10u %6.2f%%  %s\n", stacks[i].count, stacks[i].count * 100.0 / total, stacks[i].str );
+        printf( "\n" );
+        return;
+    }
+
+    /* folded stacks, as expected by flamegraph.pl */
+    merge_stacks();
+    for (i = 0; i < nb_stacks; i++) printf( "%s %u\n", stacks[i].str, stacks[i].count );
+    printf( "\n" );
+}
@@ -0,0 +1,222 @@
+/*
+ * Dump a binary relay trace file
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "windef.h"
+#include "winbase.h"
+#include "winedump.h"
+#include "wine/relay_record.h"
+
+struct relay_module
+{
+    const struct relay_record_module *rec;
+    const char                      **names;
+};
+
+struct relay_stats
+{
+    const struct relay_module *module;
+    unsigned int               ordinal;
+    ULONGLONG                  count;
+    ULONGLONG                  total;
+    ULONGLONG                  max;
+};
+
+static const struct relay_record_header *header;
+static struct relay_module *modules;
+static unsigned int nb_modules;
+static struct relay_stats *stats;
+static unsigned int nb_stats, max_stats;
+
+static const char *get_hex64( ULONGLONG value )
+{
+    static char buffers[RELAY_RECORD_ARGS + 1][20];
+    static unsigned int idx;
+    char *buffer = buffers[idx++ % ARRAY_SIZE(buffers)];
+
+    if (value >> 32) sprintf( buffer, "%lx%08lx", (unsigned long)(value >> 32), (unsigned long)value );
+    else sprintf( buffer, "%lx", (unsigned long)value );
+    return buffer;
+}
+
+static const struct relay_module *find_module( DWORD id )
+{
+    unsigned int i;
+
+    for (i = 0; i < nb_modules; i++) if (modules[i].rec->id == id) return &modules[i];
+    return NULL;
+}
+
+static void add_module( const struct relay_record_module *rec )
+{
+    const char *p = (const char *)(rec + 1), *end = (const char *)rec + rec->hdr.size;
+    struct relay_module *module;
+    unsigned int i;
+
+    if (!(modules = realloc( modules, (nb_modules + 1) * sizeof(*modules) ))) fatal( "Out of memory" );
+    module = &modules[nb_modules++];
+    module->rec = rec;
+    if (!(module->names = malloc( rec->count * sizeof(*module->names) ))) fatal( "Out of memory" );
+    for (i = 0; i < rec->count; i++)
+    {
+        if (p >= end || !memchr( p, 0, end - p ))
+        {
+            module->names[i] = "";
+            continue;
+        }
+        module->names[i] = p;
+        p += strlen( p ) + 1;
+    }
+}
+
+static const char *get_func_name( const struct relay_module *module, unsigned int ordinal )
+{
+    static char buffer[128];
+
+    if (!module) sprintf( buffer, "<unknown>.%u", ordinal );
+    else if (ordinal < module->rec->count && module->names[ordinal][0])
+        snprintf( buffer, sizeof(buffer), "%.40s.%s", module->rec->name, module->names[ordinal] );
+    else
+        sprintf( buffer, "%.40s.%u", module->rec->name, module->rec->base + ordinal );
+    return buffer;
+}
+
+static double to_usecs( ULONGLONG ticks )
+{
+    return header->frequency ? ticks * 1000000.0 / header->frequency : 0;
+}
+
+static void add_stats( const struct relay_module *module, const struct relay_record_call *call )
+{
+    struct relay_stats *stat;
+    unsigned int i;
+
+    for (i = 0; i < nb_stats; i++)
+        if (stats[i].module == module && stats[i].ordinal == call->ordinal) break;
+
+    if (i == nb_stats)
+    {
+        if (nb_stats == max_stats)
+        {
+            max_stats = max( 64, max_stats * 2 );
+            if (!(stats = realloc( stats, max_stats * sizeof(*stats) ))) fatal( "Out of memory" );
+        }
+        stat = &stats[nb_stats++];
+        stat->module = module;
+        stat->ordinal = call->ordinal;
+        stat->count = stat->total = stat->max = 0;
+    }
+    else stat = &stats[i];
+
+    stat->count++;
+    stat->total += call->duration;
+    if (call->duration > stat->max) stat->max = call->duration;
+}
+
+static void dump_calls( const struct relay_record_calls *calls )
+{
+    const struct relay_module *module;
+    const struct relay_record_call *call;
+    unsigned int i, j;
+
+    for (i = 0; i < calls->count; i++)
+    {
+        call = &calls->calls[i];
+        module = find_module( call->module );
+        add_stats( module, call );
+        if (globals.do_dumpheader) continue;
+
+        printf( "%04x %14.3f %s(", calls->tid, to_usecs( call->start ), get_func_name( module, call->ordinal ));
+        for (j = 0; j < min( call->nb_args, RELAY_RECORD_ARGS ); j++)
+            printf( "%s%s", j ? "," : "", get_hex64( call->args[j] ));
+        if (call->nb_args > RELAY_RECORD_ARGS) printf( ",..." );
+        printf( ") retval=%s %.3f us\n", get_hex64( call->retval ), to_usecs( call->duration ));
+    }
+}
+
+static int compare_stats( const void *p1, const void *p2 )
+{
+    const struct relay_stats *s1 = p1, *s2 = p2;
+
+    if (s1->total != s2->total) return s1->total > s2->total ? -1 : 1;
+    return s1->count > s2->count ? -1 : s1->count < s2->count;
+}
+
+enum FileSig get_kind_relay(void)
+{
+    const struct relay_record_header *hdr = PRD( 0, sizeof(*hdr) );
+
+    if (hdr && hdr->magic == RELAY_RECORD_MAGIC) return SIG_RELAY;
+    return SIG_UNKNOWN;
+}
+
+void relay_dump(void)
+{
+    const struct relay_record_block *block;
+    unsigned long pos;
+    unsigned int i;
+
+    header = PRD( 0, sizeof(*header) );
+    printf( "Relay trace of process %04x, version %u, %u-bit, timestamp frequency %.0f\n\n",
+            header->pid, header->version, header->ptr_size * 8, (double)header->frequency );
+    if (header->version != RELAY_RECORD_VERSION)
+    {
+        printf( "Unsupported version\n" );
+        return;
+    }
+
+    for (pos = sizeof(*header); (block = PRD( pos, sizeof(*block) )); pos += block->size)
+    {
+        if (block->size < sizeof(*block) || !PRD( pos, block->size ))
+        {
+            printf( "Truncated block at %lx\n", pos );
+            break;
+        }
+        switch (block->type)
+        {
+        case RELAY_RECORD_MODULE:
+            if (block->size >= sizeof(struct relay_record_module))
+                add_module( (const struct relay_record_module *)block );
+            break;
+        case RELAY_RECORD_CALLS:
+        {
+            const struct relay_record_calls *calls = (const struct relay_record_calls *)block;
+            if (block->size >= offsetof( struct relay_record_calls, calls[calls->count] ))
+                dump_calls( calls );
+            break;
+        }
+        default:
+            printf( "Unknown block type %u at %lx\n", block->type, pos );
+            break;
+        }
+    }
+
+    qsort( stats, nb_stats, sizeof(*stats), compare_stats );
+    printf( "\n%10s %14s %12s %12s  %s\n", "Calls", "Total (us)", "Avg (us)", "Max (us)", "Function" );
+    for (i = 0; i < nb_stats; i++)
+        printf( "%10.0f %14.3f %12.3f %12.3f  %s\n", (double)stats[i].count,
+                to_usecs( stats[i].total ), to_usecs( stats[i].total ) / stats[i].count,
+                to_usecs( stats[i].max ), get_func_name( stats[i].module, stats[i].ordinal ));
+}
@@ -216,7 +216,7 @@ const char *get_machine_str(int mach);
 
 /* file dumping functions */
 enum FileSig {SIG_UNKNOWN, SIG_DOS, SIG_PE, SIG_DBG, SIG_PDB, SIG_NE, SIG_LE, SIG_MDMP, SIG_COFFLIB, SIG_LNK,
-              SIG_EMF, SIG_FNT, SIG_TLB, SIG_NLS};
+              SIG_EMF, SIG_FNT, SIG_TLB, SIG_NLS, SIG_RELAY, SIG_PROFILE};
 
 const void*	PRD(unsigned long prd, unsigned long len);
 unsigned long	Offset(const void* ptr);
@@ -259,6 +259,10 @@ enum FileSig    get_kind_tlb(void);
 void            tlb_dump(void);
 enum FileSig    get_kind_nls(void);
 void            nls_dump(void);
+enum FileSig    get_kind_relay(void);
+void            relay_dump(void);
+enum FileSig    get_kind_profile(void);
+void            profile_dump(void);
 
 BOOL            codeview_dump_symbols(const void* root, unsigned long size);
 BOOL            codeview_dump_types_from_offsets(const void* table, const DWORD* offsets, unsigned num_types);